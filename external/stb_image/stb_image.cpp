@@ -1,2 +1,74 @@
+#include "stb_image_target.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// The decoders allocate their output buffer with STBI_MALLOC, so it can be redirected to memory given by the caller
+namespace
+{
+    struct OutputTarget
+    {
+        void  *memory = nullptr;
+        size_t size   = 0;
+        bool   used   = false;
+    };
+    thread_local OutputTarget output_target = {};
+
+    void *stbi_target_malloc(size_t size)
+    {
+        if (output_target.memory != nullptr && !output_target.used && size == output_target.size)
+        {
+            output_target.used = true;
+            return output_target.memory;
+        }
+        return malloc(size);
+    }
+
+    void stbi_target_free(void *pointer)
+    {
+        if (pointer != nullptr && pointer == output_target.memory)
+        {
+            // The decoder gave up on it, for example after converting it into another buffer
+            output_target.used = false;
+            return;
+        }
+        free(pointer);
+    }
+
+    void *stbi_target_realloc(void *pointer, size_t size)
+    {
+        if (pointer != nullptr && pointer == output_target.memory)
+        {
+            if (size <= output_target.size)
+            {
+                return pointer;
+            }
+
+            // The target is too small, move the content out of it
+            void *moved = malloc(size);
+            if (moved != nullptr)
+            {
+                memcpy(moved, pointer, output_target.size);
+                output_target.used = false;
+            }
+            return moved;
+        }
+        return realloc(pointer, size);
+    }
+} // namespace
+
+void stbi_set_output_target(void *memory, size_t size)
+{
+    output_target = OutputTarget {
+        .memory = memory,
+        .size   = size,
+        .used   = false,
+    };
+}
+
+#define STBI_MALLOC(size)           stbi_target_malloc(size)
+#define STBI_FREE(pointer)          stbi_target_free(pointer)
+#define STBI_REALLOC(pointer, size) stbi_target_realloc(pointer, size)
+
 #define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
\ No newline at end of file
+#include "stb_image.h"
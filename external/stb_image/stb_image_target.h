@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Makes the next image decoded on this thread be written directly in the given memory, if its decoded size is exactly the given
+ * one. The decoding functions then return that pointer, which must not be given to stbi_image_free. Otherwise, they return a
+ * buffer allocated as usual.
+ * Passing nullptr removes the target.
+ */
+void stbi_set_output_target(void *memory, size_t size);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <railguard/utils/geometry/aabb.h>
+#include <railguard/utils/io.h>
 #include <railguard/utils/vector.h>
 
 #include <glm/vec2.hpp>
@@ -10,6 +12,9 @@ namespace rg
     using MeshPartId = uint64_t;
     class Renderer;
 
+    /** Maximum number of levels of detail of a mesh part, including the base level. */
+    constexpr uint32_t MAX_MESH_LOD_COUNT = 8;
+
     struct Vertex
     {
         glm::vec3 position;
@@ -17,6 +22,31 @@ namespace rg
         glm::vec2 tex_coord;
     };
 
+    /** Layout of the vertices of a mesh part in the vertex buffer. */
+    enum class VertexFormat
+    {
+        /** Vertex struct, with 32-bit floats everywhere. 32 bytes per vertex. */
+        FULL = 0,
+        /** CompressedVertex struct. 16 bytes per vertex, for a precision that is usually enough for rendering. */
+        COMPRESSED = 1,
+    };
+    constexpr uint32_t VERTEX_FORMAT_COUNT = 2;
+
+    /**
+     * Compact version of a vertex.
+     * The position is quantized on 16 bits in the bounds of the mesh part. It is restored with the dequantization offset and scale of
+     * the part, which are applied by the renderer with the object transform.
+     */
+    struct CompressedVertex
+    {
+        /** Normalized position in the part, in [-1, 1]. The last component is only padding. */
+        int16_t position[4];
+        /** Normal, encoded on the two dimensions of an octahedron (see https://jcgt.org/published/0003/02/01/). */
+        int16_t normal[2];
+        /** Half-precision floats. */
+        uint16_t tex_coord[2];
+    };
+
     struct Triangle
     {
         uint32_t index[3] = {0, 0, 0};
@@ -26,16 +56,141 @@ namespace rg
         }
     };
 
+    /**
+     * Level of detail of a mesh part. It is a range of the indices of the part, which draws a simplified version of the shape with
+     * the same vertices.
+     */
+    struct MeshLod
+    {
+        /** Offset of the first index of the level, in the indices of the part: the base triangles, then the simplified ones. */
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+        /** Estimation of the maximum distance between the simplified surface and the original one, in model space. */
+        float error = 0.0f;
+    };
+
+    /** Defines how the vertices of an OBJ file are converted to the vertices of a mesh part. */
+    enum class ObjImportMode
+    {
+        /**
+         * There is a vertex per position of the file. It is fast, but the normals and texture coordinates are wrong where a
+         * position is used with different ones, for example on the edges of a cube.
+         */
+        SHARED_POSITIONS = 0,
+        /** There are three unique vertices per triangle. Everything is correct, but nothing is shared. */
+        DUPLICATED_VERTICES = 1,
+        /**
+         * The vertices with the same position, normal and texture coordinates are shared. Then, the triangles and vertices are
+         * reordered to make a better use of the caches of the GPU.
+         */
+        INDEXED = 2,
+    };
+
+    /** Measures of an import in the INDEXED mode, see ObjImportOptions::statistics. */
+    struct ObjImportStatistics
+    {
+        size_t part_count = 0;
+        /** Number of vertices before and after their deduplication. */
+        size_t duplicated_vertex_count = 0;
+        size_t vertex_count            = 0;
+        size_t triangle_count          = 0;
+        /** Average cache miss ratio of the triangles in the order of the file, then after the optimization. See MeshPart::acmr. */
+        float file_order_acmr = 0.0f;
+        float optimized_acmr  = 0.0f;
+    };
+
+    struct ObjImportOptions
+    {
+        ObjImportMode mode = ObjImportMode::INDEXED;
+        /** Number of levels of detail to generate, see MeshPart::generate_lods. 1 keeps only the base level. */
+        uint32_t     lod_count     = 1;
+        VertexFormat vertex_format = VertexFormat::FULL;
+        /**
+         * The result of the import is saved in a mesh cache (name of the file, with .rgmesh appended). The next imports with the same
+         * options load it instead, as long as the file didn't change.
+         */
+        bool use_cache = false;
+        /** Directory of the mesh cache, which must exist. If null, the cache is saved next to the file. */
+        const char *cache_directory = nullptr;
+        /**
+         * Used by MeshPart::load_parts_from_obj: shapes with more triangles are split in spatial clusters, so that they can be culled
+         * and their levels of detail selected piecewise.
+         */
+        uint32_t max_part_triangle_count = 16384;
+        /** The parts are saved with Renderer::save_mesh_part as GPU-resident only: their data is released once uploaded. */
+        bool gpu_resident_only = false;
+        /** If set, filled with the measures of the import. They are left untouched when the parts come from the mesh cache. */
+        ObjImportStatistics *statistics = nullptr;
+    };
+
     /** Set of vertices and indices constituting a shape, e.g a cube. */
     class MeshPart
     {
       private:
         Vector<Vertex>   m_vertices {10};
         Vector<Triangle> m_triangles {10};
+        /** Triangles of the simplified levels of detail, one level after the other. */
+        Vector<Triangle> m_lod_triangles {10};
+        /** Levels of detail of the part, from the most detailed to the least. The first one is the base level. */
+        Vector<MeshLod> m_lods {MAX_MESH_LOD_COUNT};
+
+        VertexFormat m_vertex_format = VertexFormat::FULL;
+        // Dequantization of the positions: position = offset + scale * stored_position
+        glm::vec3 m_position_offset = glm::vec3(0.0f);
+        float     m_position_scale  = 1.0f;
+
+        AABB m_bounds = {};
+        /** xyz is the center and w the radius. */
+        glm::vec4 m_bounding_sphere = glm::vec4(0.0f);
+        float     m_uv_density      = 0.0f;
+
+        // Parts loaded from a mesh cache don't have their vertices and triangles: they only reference the encoded data in the file
+        MappedFile  m_cache_file            = {};
+        const void *m_cached_vertices       = nullptr;
+        const void *m_cached_indices        = nullptr;
+        size_t      m_cached_vertex_count   = 0;
+        size_t      m_cached_triangle_count = 0;
+
+        /** Reorders the triangles for the post-transform vertex cache, with Tom Forsyth's algorithm. */
+        static void optimize_triangle_order(Triangle *triangles, size_t triangle_count, size_t vertex_count);
+        void        compute_bounds();
+        void        compute_uv_density();
 
       public:
         MeshPart(Vector<Vertex> &&vertices, Vector<Triangle> &&triangles);
 
+        /**
+         * Generates simplified levels of detail of the part, replacing the previous ones. Edges are collapsed in the order given
+         * by the quadric error metric, so the vertices are kept: the levels only add indices.
+         * The generation stops early when the shape can't be simplified further.
+         * @param lod_count Maximum number of levels, including the base level. Clamped to MAX_MESH_LOD_COUNT.
+         * @param triangle_ratio Ratio between the triangle counts of a level and of the previous one.
+         */
+        void generate_lods(uint32_t lod_count = 4, float triangle_ratio = 0.5f);
+
+        // Optimization
+        // The indices of the levels of detail are kept valid, but it is better to optimize the part before generating them.
+
+        /**
+         * Merges the vertices that have exactly the same position, normal and texture coordinates.
+         * @return the number of removed vertices.
+         */
+        size_t deduplicate_vertices();
+        /** Reorders the triangles of each level so that their vertices are more likely to be in the post-transform cache. */
+        void optimize_vertex_cache();
+        /**
+         * Reorders the vertices in the order in which the triangles use them, so that they are fetched sequentially.
+         * Unused vertices are removed.
+         */
+        void optimize_vertex_fetch();
+        /**
+         * Computes the average cache miss ratio of the base level: the number of vertices transformed per triangle, with a simulated
+         * FIFO post-transform cache. It goes from 3 when nothing is shared down to about 0.5 for a regular grid.
+         */
+        [[nodiscard]] float acmr(uint32_t cache_size = 32) const;
+
+        // The vertices and triangles are empty for cached parts
+
         [[nodiscard]] inline const Vector<Vertex> &vertices() const
         {
             return m_vertices;
@@ -44,29 +199,132 @@ namespace rg
         {
             return m_triangles;
         }
+        [[nodiscard]] inline const Vector<Triangle> &lod_triangles() const
+        {
+            return m_lod_triangles;
+        }
+        [[nodiscard]] inline const Vector<MeshLod> &lods() const
+        {
+            return m_lods;
+        }
+
+        // Vertex format
 
-        [[nodiscard]] static constexpr size_t vertex_byte_size()
+        /**
+         * Sets the format of the vertices in the vertex buffer. The vertices of the part are kept with full precision, they are only
+         * encoded when written. For the compressed format, the dequantization parameters are computed from the current positions.
+         */
+        void set_vertex_format(VertexFormat format);
+        [[nodiscard]] inline VertexFormat vertex_format() const
+        {
+            return m_vertex_format;
+        }
+        /** Translation to apply to the stored positions, after the scale. Null for the full format. */
+        [[nodiscard]] inline const glm::vec3 &position_offset() const
+        {
+            return m_position_offset;
+        }
+        /** Uniform scale to apply to the stored positions. 1 for the full format. */
+        [[nodiscard]] inline float position_scale() const
         {
-            return sizeof(Vertex);
+            return m_position_scale;
         }
-        [[nodiscard]] static constexpr size_t triangle_byte_size()
+
+        [[nodiscard]] inline size_t vertex_byte_size() const
+        {
+            return m_vertex_format == VertexFormat::COMPRESSED ? sizeof(CompressedVertex) : sizeof(Vertex);
+        }
+        /** Parts with less than 65536 vertices use 16-bit indices. */
+        [[nodiscard]] inline bool uses_16_bit_indices() const
         {
-            return sizeof(Triangle);
+            return vertex_count() < 65536;
         }
-        [[nodiscard]] static constexpr size_t index_byte_size()
+        [[nodiscard]] inline size_t index_byte_size() const
         {
-            return sizeof(uint32_t);
+            return uses_16_bit_indices() ? sizeof(uint16_t) : sizeof(uint32_t);
         }
 
+        /**
+         * Writes the vertices in the vertex format of the part.
+         * The destination must hold vertex_count() * vertex_byte_size() bytes.
+         */
+        void write_vertices(void *destination) const;
+        /**
+         * Writes the indices of every level of detail, with the index size of the part.
+         * The destination must hold total_triangle_count() * 3 * index_byte_size() bytes.
+         */
+        void write_indices(void *destination) const;
+        /**
+         * Hash of the data written by write_vertices and write_indices, and of the levels of detail. Parts with the same hash are
+         * drawn identically, whether they were loaded from a mesh cache or not. It is never 0.
+         */
+        [[nodiscard]] uint64_t content_hash() const;
+
         [[nodiscard]] inline size_t vertex_count() const
         {
-            return m_vertices.size();
+            return is_cached() ? m_cached_vertex_count : m_vertices.size();
         }
         [[nodiscard]] inline size_t triangle_count() const
         {
-            return m_triangles.size();
+            return m_lods[0].index_count / 3;
+        }
+        [[nodiscard]] inline size_t lod_count() const
+        {
+            return m_lods.size();
+        }
+        /** Number of triangles of the part, including the ones of the simplified levels. */
+        [[nodiscard]] inline size_t total_triangle_count() const
+        {
+            return is_cached() ? m_cached_triangle_count : m_triangles.size() + m_lod_triangles.size();
         }
 
+        /** Bounds of the vertices, in model space. */
+        [[nodiscard]] inline const AABB &bounds() const
+        {
+            return m_bounds;
+        }
+        /**
+         * Sphere containing the vertices, in model space. xyz is the center and w the radius.
+         * The center of the bounding box is not the optimal center of the sphere, but it is cheap and close enough.
+         */
+        [[nodiscard]] inline const glm::vec4 &bounding_sphere() const
+        {
+            return m_bounding_sphere;
+        }
+        /**
+         * Average ratio between the lengths in texture space and in model space, from the areas of the triangles of the base level.
+         * It gives the resolution of the textures needed to draw the part at a given size on screen. 0 without texture coordinates.
+         */
+        [[nodiscard]] inline float uv_density() const
+        {
+            return m_uv_density;
+        }
+
+        // Mesh cache
+
+        /**
+         * A cached part was loaded from a mesh cache. Its vertices and indices are only available in their encoded form, through
+         * write_vertices and write_indices, and it can't be modified.
+         */
+        [[nodiscard]] inline bool is_cached() const
+        {
+            return m_cached_vertices != nullptr;
+        }
+
+        /**
+         * Saves parts in a mesh cache file: a header, then for each part its bounds, levels of detail, and its vertices and indices
+         * already encoded for the GPU. The data is in the native byte order: the cache is not meant to be shared between machines.
+         * @param source_stamp Value identifying the source of the parts, checked when loading the cache.
+         * @return true if the file was written.
+         */
+        static bool save_cache(const char *path, const MeshPart *parts, size_t part_count, uint64_t source_stamp);
+        /**
+         * Maps a mesh cache file and creates cached parts referencing its data. Nothing is copied: the encoded vertices and indices
+         * are read from the mapping when the parts are uploaded.
+         * @return the parts, or an empty vector if the file doesn't exist, is invalid, or has another source stamp.
+         */
+        static Vector<MeshPart> load_cache(const char *path, uint64_t source_stamp);
+
         // Loader
         // Temporary, before full structure is added
 
@@ -74,7 +332,18 @@ namespace rg
          * Loads a mesh part from an OBJ file and stores it in the renderer.
          * @return the id of the mesh part in the renderer, or NULL_ID if it failed.
          */
-        static MeshPartId load_from_obj(const char *filename, Renderer &renderer, bool duplicate_vertices = false);
+        static MeshPartId load_from_obj(const char *filename, Renderer &renderer, const ObjImportOptions &options = {});
+        /**
+         * Loads a mesh part from an OBJ file without optimizing it, with either shared positions or duplicated vertices.
+         * @return the id of the mesh part in the renderer, or NULL_ID if it failed.
+         */
+        static MeshPartId load_from_obj(const char *filename, Renderer &renderer, bool duplicate_vertices);
+        /**
+         * Loads an OBJ file as several mesh parts: one per object or group of the file, or per spatial cluster of triangles when a
+         * shape is too big (see ObjImportOptions::max_part_triangle_count). Each part has its own bounds.
+         * @return the ids of the mesh parts in the renderer. It is empty if the loading failed.
+         */
+        static Vector<MeshPartId> load_parts_from_obj(const char *filename, Renderer &renderer, const ObjImportOptions &options = {});
     };
 
 } // namespace rg
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <railguard/core/mesh.h>
+#include <railguard/utils/vector.h>
+
+#include <string>
+
+namespace rg
+{
+    /** Object or group of an OBJ file ("o" and "g" statements). Its triangles follow each other in the geometry. */
+    struct ObjShape
+    {
+        uint32_t first_triangle = 0;
+        uint32_t triangle_count = 0;
+    };
+
+    /** Geometry of an OBJ file, ready to be given to a mesh part. */
+    struct ObjGeometry
+    {
+        Vector<Vertex>   vertices {1};
+        Vector<Triangle> triangles {1};
+        /** Non-empty shapes of the file. The faces before the first statement form a shape as well. */
+        Vector<ObjShape> shapes {1};
+    };
+
+    /**
+     * Parses the geometry of an OBJ file: positions, normals, texture coordinates and faces. Polygons are split in triangle fans,
+     * and the other statements (materials, lines...) are ignored.
+     *
+     * The file is memory-mapped and split at line boundaries into chunks, which are parsed in parallel. The chunks are then merged
+     * by writing their vertices and triangles in place in the result, also in parallel.
+     *
+     * @param mode Defines how the vertices are created. INDEXED gives the same result as DUPLICATED_VERTICES: the vertices are merged
+     * by MeshPart::deduplicate_vertices afterwards.
+     * @param thread_count Number of threads to use. 0 uses one thread per core.
+     * @param error Set to a description of the problem when the parsing fails.
+     * @return true if the parsing succeeded.
+     */
+    bool parse_obj(const char *path, ObjImportMode mode, ObjGeometry &geometry, std::string &error, uint32_t thread_count = 0);
+} // namespace rg
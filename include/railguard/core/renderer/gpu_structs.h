@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
 
 namespace rg
 {
@@ -15,4 +18,74 @@ namespace rg
     {
         glm::mat4 transform = {};
     };
+
+    /** Instance of a render stage: links an object of the object buffer to the draw that renders it. */
+    struct GPUInstanceData
+    {
+        uint32_t object_index = 0;
+        uint32_t draw_index   = 0;
+        /** With bindless textures, offset of the texture slots of the material of the object in the material buffer. */
+        uint32_t material_index = 0;
+    };
+
+    /** Draw of a render stage, as seen by the culling shader. */
+    struct GPUDrawData
+    {
+        // Same layout as VkDrawIndexedIndirectCommand
+        uint32_t index_count    = 0;
+        uint32_t instance_count = 0;
+        uint32_t first_index    = 0;
+        int32_t  vertex_offset  = 0;
+        uint32_t first_instance = 0;
+
+        /** Index of the batch containing this draw. */
+        uint32_t batch_index = 0;
+        /** Index of the first draw of the batch in the indirect buffer. */
+        uint32_t batch_offset = 0;
+        /**
+         * Number of levels of detail of the mesh part, set on the draw of the base level. The draws of the other levels follow it.
+         * The instances reference the draw of the base level, and are moved to the one of their level by the culling.
+         */
+        uint32_t lod_count = 0;
+        /** Bounding sphere of the mesh part, in model space. xyz is the center and w the radius. */
+        glm::vec4 bounding_sphere = {};
+        /** Error of the level of detail drawn by this draw, in model space. */
+        float    lod_error  = 0.0f;
+        uint32_t padding[3] = {};
+    };
+
+    /** Push constants of the culling shader. */
+    struct GPUCullingParameters
+    {
+        glm::vec4 frustum_planes[6] = {};
+        /** Position of the camera, from which the levels of detail are selected. */
+        glm::vec3 camera_position = {};
+        /** See LodSelection in the renderer. 0 disables the selection of the levels of detail. */
+        float    lod_factor     = 0.0f;
+        uint32_t instance_count = 0;
+        uint32_t draw_count     = 0;
+        /** 0 to cull the instances, 1 to compact the draws. */
+        uint32_t pass = 0;
+    };
+
+    /**
+     * Push constants of the occlusion culling shader.
+     * The frustum planes don't fit next to the matrix in the guaranteed push constant size, so they are extracted by the shader.
+     */
+    struct GPUOcclusionCullingParameters
+    {
+        glm::mat4 view_projection = {};
+        glm::vec3 camera_position = {};
+        float     lod_factor      = 0.0f;
+        /** Size of the first level of the depth pyramid, in texels. */
+        glm::vec2 depth_pyramid_size = {};
+        uint32_t  instance_count     = 0;
+        uint32_t  draw_count         = 0;
+        /** 0 to cull the instances, 1 to compact the draws. */
+        uint32_t pass = 0;
+        /** 0 for the first phase, before the stage is drawn, 1 for the second one. */
+        uint32_t phase = 0;
+        /** 1 if the depth pyramid contains the depth of a previous frame, 0 if it was just created. */
+        uint32_t depth_pyramid_ready = 0;
+    };
 } // namespace rg
\ No newline at end of file
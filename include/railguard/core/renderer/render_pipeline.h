@@ -35,6 +35,14 @@ namespace rg
          */
         uint8_t vertex_count = 6;
         bool do_depth_test        = false;
+        /**
+         * If true, the instances hidden behind the geometry drawn in the previous frame are not drawn. The stage needs to use the
+         * material system and to have a depth attachment, and occlusion culling shaders must be set in the renderer.
+         *
+         * The stage is then drawn in two passes: the instances that were visible in the depth of the previous frame are drawn first,
+         * then the others are tested again against the new depth, and the ones that became visible are drawn in a second pass.
+         */
+        bool occlusion_culling = false;
     };
 
     /**
@@ -2,6 +2,7 @@
 
 #include <railguard/core/renderer/types.h>
 
+#include <cstddef>
 #include <cstdint>
 
 namespace rg
@@ -10,10 +11,14 @@ namespace rg
     class Window;
     template<typename T>
     class Array;
+    template<typename T>
+    class Vector;
     class MeshPart;
     struct RenderPipelineDescription;
 
     struct Transform;
+    struct AABB;
+    struct Ray;
 
     // ---==== Definitions ====---
 
@@ -58,6 +63,85 @@ namespace rg
         ShaderStage stages = ShaderStage::FRAGMENT;
     };
 
+    /** Sampling characteristics of a loaded texture */
+    struct TextureOptions
+    {
+        FilterMode filter_mode = FilterMode::LINEAR;
+        /**
+         * Number of mip levels, generated on the GPU when the texture is uploaded. 0 generates the full chain, and 1 disables
+         * mipmapping. It is limited to the full chain, and to 1 if the device can't generate them.
+         */
+        uint32_t mip_levels = 0;
+        /** Maximum anisotropy of the filtering. 1 disables it. It is limited to what the device supports. */
+        float max_anisotropy = 16.0f;
+        /** Added to the mip level selected when sampling. Positive values give blurrier textures. */
+        float lod_bias = 0.0f;
+        /**
+         * Format of the texture on the GPU. Images are encoded in the formats other than RGBA8 when they are loaded, with their
+         * mip levels. For streamed textures, the result is cached in a KTX2 file next to them. KTX2 files keep their own format and
+         * levels.
+         * If the device can't sample a block-compressed format, the texture is decoded before its upload.
+         */
+        TextureFormat format = TextureFormat::RGBA8_SRGB;
+        /** Use the KTX2 cache of encoded images if it exists. Streamed textures also create it if it doesn't. */
+        bool use_cache = true;
+        /**
+         * Only load the least detailed levels at first, and stream the other ones in when the objects using the texture need them
+         * on screen, within the texture memory budget. The levels are generated on the CPU, so RGBA8 images are encoded as well.
+         */
+        bool streamed = false;
+    };
+
+    /** State of the uploads of textures and mesh parts to the GPU, for monitoring. */
+    struct UploadStatistics
+    {
+        /** Number of textures and mesh parts waiting to be uploaded. */
+        size_t pending_upload_count = 0;
+        /** Total size of the data waiting to be uploaded, in bytes. */
+        size_t pending_upload_bytes = 0;
+        /** Size of the data uploaded during the last frame, in bytes. */
+        size_t last_frame_upload_bytes = 0;
+        /**
+         * True when mesh parts and objects are written directly in device-local memory, which the CPU can access on integrated GPUs,
+         * with resizable BAR and on software renderers. Otherwise, they go through staging memory. Textures always do.
+         */
+        bool uses_direct_writes = false;
+        /** Number of textures whose image couldn't be decoded. They are never uploaded, and the materials using them aren't drawn. */
+        size_t failed_texture_count = 0;
+    };
+
+    /** Draws of the stages that use the material system during the last completed frame, for monitoring. */
+    struct DrawStatistics
+    {
+        /** Number of instances in the draw caches. */
+        size_t instance_count = 0;
+        /** Number of indirect draws before culling: one per level of detail of each mesh part of each batch. */
+        size_t draw_count = 0;
+        /** Number of instances kept by the culling. It is instance_count when culling is disabled. */
+        size_t visible_instance_count = 0;
+        /** Number of draws with at least one visible instance. It is draw_count when culling is disabled. */
+        size_t visible_draw_count = 0;
+    };
+
+    /** State of the streaming of the mip levels of the textures, for monitoring. */
+    struct TextureStreamingStatistics
+    {
+        size_t streamed_texture_count = 0;
+        /** Number of streamed textures whose resident levels are less detailed than the ones needed on screen. */
+        size_t missing_level_texture_count = 0;
+        /** Estimated GPU memory used by the resident levels of the streamed textures, in bytes. */
+        size_t resident_bytes = 0;
+        /** Estimated GPU memory needed by the levels used on screen, in bytes. */
+        size_t wanted_bytes = 0;
+        /** Budget of the resident levels, in bytes: the one set with set_texture_memory_budget, limited by the device. */
+        size_t budget_bytes = 0;
+        // Totals since the creation of the renderer
+        size_t streamed_in_count = 0;
+        size_t streamed_in_bytes = 0;
+        size_t evicted_count     = 0;
+        size_t evicted_bytes     = 0;
+    };
+
     // ---==== Main classes ====---
 
     /**
@@ -134,6 +218,65 @@ namespace rg
          */
         void set_global_shader_effect(RenderStageKind stage_kind, ShaderEffectId effect_id);
 
+        /**
+         * Sets the compute shader used to cull the instances of the stages that use the material system. It tests the bounding
+         * sphere of each instance against the camera frustum, and writes the visible draws in the indirect buffer.
+         * @param compute_shader Compute shader module, or NULL_ID to disable GPU culling.
+         * @return true if GPU culling is enabled. It may not be supported by the device, in which case every instance is drawn.
+         */
+        bool set_culling_shader(ShaderModuleId compute_shader);
+
+        /**
+         * Sets the compute shaders used by the stages that enable occlusion culling in their description. The depth of those stages
+         * is reduced into a depth pyramid, against which the instances are tested. GPU culling needs to be enabled as well.
+         * @param culling_shader Compute shader testing the instances against the frustum and the depth pyramid, or NULL_ID to disable
+         * occlusion culling.
+         * @param depth_reduce_shader Compute shader writing a level of the depth pyramid from the previous one, or NULL_ID.
+         * @return true if occlusion culling is enabled.
+         */
+        bool set_occlusion_culling_shaders(ShaderModuleId culling_shader, ShaderModuleId depth_reduce_shader);
+
+        /**
+         * Enables or disables the culling of the instances on the CPU. It is used when GPU culling is disabled, and is enabled by
+         * default.
+         */
+        void set_cpu_culling(bool enabled);
+
+        /**
+         * Enables or disables bindless textures. All the textures are then in a single array, and the shaders find the ones of
+         * their material in the material buffer, at the index given by the material index vertex input (location 4). The materials
+         * thus don't need to bind their own set, and the models using the same pipeline are drawn together. It needs to be set
+         * before the shader effects and the materials are created.
+         * @return true if bindless textures are enabled. They may not be supported by the device.
+         */
+        bool set_bindless_textures(bool enabled);
+
+        /**
+         * Sets the bias of the selection of the levels of detail of the mesh parts. The most simplified level whose error stays
+         * below a pixel on screen is drawn, and each unit of bias doubles that threshold. Negative values favor details.
+         */
+        void set_lod_bias(float bias);
+
+        /**
+         * Limits the amount of data uploaded to the GPU at each frame. Textures and mesh parts are queued when they are loaded, and
+         * the queue is drained across frames within that budget. A model is only drawn once its mesh part and the textures of its
+         * material are uploaded. The first upload of a frame is always done, even if it is bigger than the budget.
+         * @param bytes_per_frame Maximum size of the uploads of a frame, or 0 to upload everything at the next frame (default).
+         */
+        void set_upload_budget(size_t bytes_per_frame);
+
+        [[nodiscard]] UploadStatistics get_upload_statistics() const;
+
+        /**
+         * Limits the GPU memory used by the streamed textures. Their levels are loaded when the visible objects need them, from the
+         * most lacking textures, and the extra levels of the least recently used textures are evicted to stay within the budget.
+         * It is also limited by the memory budget of the device, minus what the rest of the application uses.
+         * @param bytes Maximum size of the resident levels, or 0 to only be limited by the device (default).
+         */
+        void set_texture_memory_budget(size_t bytes);
+
+        [[nodiscard]] TextureStreamingStatistics get_texture_streaming_statistics() const;
+
         // Material templates
 
         MaterialTemplateId create_material_template(const Array<ShaderEffectId> &available_effects);
@@ -156,7 +299,13 @@ namespace rg
 
         // Meshes
 
-        MeshPartId save_mesh_part(MeshPart &&mesh_part);
+        /**
+         * Stores a mesh part. It is uploaded to the GPU before the next draw.
+         * @param gpu_resident_only If true, the vertices and indices are released from the host memory once uploaded, and only
+         * the description of the part is kept. Use it for parts that are only drawn, to avoid keeping two copies of them.
+         * @return the id of the new mesh part.
+         */
+        MeshPartId save_mesh_part(MeshPart &&mesh_part, bool gpu_resident_only = false);
         void       destroy_mesh_part(MeshPartId id);
         void       clear_mesh_parts();
 
@@ -171,14 +320,34 @@ namespace rg
 
         RenderNodeId create_render_node(ModelId model);
         void         destroy_render_node(RenderNodeId id);
+        Transform   &get_render_node_transform(RenderNodeId id);
         void         clear_render_nodes();
 
+        /**
+         * Finds the closest render node whose bounding box is hit by the ray, for example to pick an object under the cursor.
+         * The bounds are the ones of the last drawn frame.
+         * @return the id of the hit node, or NULL_ID if there is none before max_distance.
+         */
+        [[nodiscard]] RenderNodeId raycast_render_nodes(const Ray &ray, float max_distance) const;
+        /** Lists the render nodes whose bounding box overlaps the given box, as of the last drawn frame. */
+        [[nodiscard]] Vector<RenderNodeId> get_render_nodes_in_box(const AABB &box) const;
+
         // Textures
 
         TextureId load_texture(const char *path, FilterMode filter_mode);
+        TextureId load_texture(const char *path, const TextureOptions &options);
         void      destroy_texture(TextureId id);
         void      clear_textures();
 
+        /**
+         * Enables or disables the block-compressed formats for the textures loaded afterwards. Without them, the textures in those
+         * formats are decoded on the CPU before their upload, except the BC7 ones, which fail to load.
+         * @return true if the block-compressed formats are used. They may not be supported by the device.
+         */
+        bool set_block_compression(bool enabled);
+        /** Returns the format of the texture on the GPU, which is the decoded one if its format isn't used by the renderer. */
+        [[nodiscard]] TextureFormat get_texture_format(TextureId id) const;
+
         // Cameras
         CameraId create_orthographic_camera(uint32_t window_index, float near, float far);
         CameraId create_orthographic_camera(uint32_t window_index, float width, float height, float near, float far);
@@ -212,6 +381,17 @@ namespace rg
         // Rendering
         void draw();
 
+        /**
+         * Returns the time the GPU spent in a render stage during the last completed frame, in milliseconds. It is measured with
+         * timestamps around the render passes of the stage. Returns 0 if the device doesn't support timestamps on the graphics queue.
+         */
+        [[nodiscard]] double get_stage_gpu_time(size_t stage_index) const;
+        /**
+         * Returns the number of instances and draws before and after culling during the last completed frame. The results of the
+         * GPU culling are read back once the frame is done. With occlusion culling, the draws of both phases are counted.
+         */
+        [[nodiscard]] DrawStatistics get_draw_statistics() const;
+
         ~Renderer();
     };
 } // namespace rg
\ No newline at end of file
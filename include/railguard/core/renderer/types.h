@@ -55,11 +55,37 @@ namespace rg
         LINEAR  = 1,
     };
 
+    /** Storage of the texels of a texture on the GPU. The block-compressed (BC) formats encode blocks of 4x4 texels. */
+    enum class TextureFormat
+    {
+        RGBA8_SRGB  = 0,
+        RGBA8_UNORM = 1,
+        /** Single channel, for example for masks. */
+        R8_UNORM = 2,
+        /** Two channels, for example for normal maps whose third component is computed in the shader. */
+        RG8_UNORM = 3,
+        /** Color with a 1-bit alpha, in 8 bytes per block: 8 times smaller than RGBA8. */
+        BC1_SRGB  = 4,
+        BC1_UNORM = 5,
+        /** Color of BC1 with a smooth alpha, in 16 bytes per block. */
+        BC3_SRGB  = 6,
+        BC3_UNORM = 7,
+        /** Single channel, in 8 bytes per block. */
+        BC4_UNORM = 8,
+        /** Two channels encoded like BC4, in 16 bytes per block. */
+        BC5_UNORM = 9,
+        /** High quality color and alpha, in 16 bytes per block. It can only be read from KTX2 files, not encoded. */
+        BC7_SRGB  = 10,
+        BC7_UNORM = 11,
+    };
+    constexpr uint32_t TEXTURE_FORMAT_COUNT = 12;
+
     enum class ShaderStage : uint32_t
     {
         INVALID  = 0,
         VERTEX   = 1,
         FRAGMENT = 2,
+        COMPUTE  = 4,
     };
     // Operators to make it usable as flags to define several stages at once
     constexpr ShaderStage operator|(ShaderStage a, ShaderStage b)
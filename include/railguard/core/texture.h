@@ -0,0 +1,112 @@
+#pragma once
+
+#include <railguard/core/renderer/types.h>
+#include <railguard/utils/array.h>
+#include <railguard/utils/io.h>
+#include <railguard/utils/vector.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rg
+{
+    /** Mip level of a texture, in the data of the texture. */
+    struct TextureLevel
+    {
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        /** Offset of the texels of the level from the start of the data of the texture. */
+        size_t offset = 0;
+        size_t size   = 0;
+    };
+
+    /** Returns true if the format encodes blocks of 4x4 texels. */
+    [[nodiscard]] bool is_block_compressed(TextureFormat format);
+    /** Returns the size of a texel, or of a block of texels for the block-compressed formats. */
+    [[nodiscard]] size_t get_texel_block_size(TextureFormat format);
+    /** Returns the size of an image of the given dimensions in the format. */
+    [[nodiscard]] size_t get_texture_level_size(TextureFormat format, uint32_t width, uint32_t height);
+    /** Returns the uncompressed format with the same channels as the given one, in which it can be decoded. */
+    [[nodiscard]] TextureFormat get_decoded_format(TextureFormat format);
+    /** Returns the number of levels of the full mip chain of an image, down to a single texel. */
+    [[nodiscard]] uint32_t get_full_mip_count(uint32_t width, uint32_t height);
+
+    /**
+     * Texels of a texture and of its mip levels, in a format that can be copied as is to the GPU.
+     * It is either encoded from RGBA pixels, or read from a KTX2 file, whose data is mapped and not copied.
+     */
+    class TextureData
+    {
+      private:
+        TextureFormat        m_format = TextureFormat::RGBA8_SRGB;
+        Vector<TextureLevel> m_levels = Vector<TextureLevel>(1);
+
+        // Encoded textures own their texels, loaded ones reference the mapping of their file
+        Array<uint8_t> m_texels = {};
+        MappedFile     m_file   = {};
+
+        /** Encodes an image of RGBA pixels in the format of the texture. The output must have the size of the level. */
+        void encode_level(const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *output) const;
+
+      public:
+        /** Creates an invalid texture, without any level. */
+        TextureData() = default;
+        /**
+         * Encodes RGBA pixels in the given format. The formats with less channels keep the first ones.
+         * @param mip_levels Number of levels, downsampled on the CPU. 0 generates the full chain. It is clamped to the full chain.
+         */
+        TextureData(const uint8_t *pixels, uint32_t width, uint32_t height, TextureFormat format, uint32_t mip_levels);
+
+        /**
+         * Maps a KTX2 file. Only 2D textures without supercompression, in one of the texture formats, are supported.
+         * @param source_stamp If it isn't 0, the file is only loaded if it was saved with the same stamp.
+         * @return an invalid texture if the file can't be loaded.
+         */
+        static TextureData load_ktx2(const char *path, uint64_t source_stamp = 0);
+        /**
+         * Saves the texture in a KTX2 file, which can then be loaded by other tools as well.
+         * @param source_stamp Value identifying the source of the texture, stored in the metadata of the file, or 0.
+         */
+        bool save_ktx2(const char *path, uint64_t source_stamp = 0) const;
+
+        /**
+         * Identifies the version of an image file and the parameters of its encoding, to know if a KTX2 file saved from it is
+         * outdated. Returns 0 if the file can't be found.
+         */
+        [[nodiscard]] static uint64_t get_source_stamp(const char *path, TextureFormat format, uint32_t mip_levels);
+
+        /**
+         * Decodes a level in the format returned by get_decoded_format, for devices that don't support the format of the texture.
+         * BC7 can't be decoded.
+         * @param output Memory of the size of the decoded level.
+         * @return false if the format can't be decoded.
+         */
+        bool decode_level(size_t level, uint8_t *output) const;
+
+        [[nodiscard]] inline bool is_valid() const
+        {
+            return !m_levels.is_empty();
+        }
+        [[nodiscard]] inline TextureFormat format() const
+        {
+            return m_format;
+        }
+        [[nodiscard]] inline uint32_t width() const
+        {
+            return m_levels.is_empty() ? 0 : m_levels[0].width;
+        }
+        [[nodiscard]] inline uint32_t height() const
+        {
+            return m_levels.is_empty() ? 0 : m_levels[0].height;
+        }
+        [[nodiscard]] inline const Vector<TextureLevel> &levels() const
+        {
+            return m_levels;
+        }
+        [[nodiscard]] const uint8_t *data() const;
+        [[nodiscard]] inline const uint8_t *level_data(size_t level) const
+        {
+            return data() + m_levels[level].offset;
+        }
+    };
+} // namespace rg
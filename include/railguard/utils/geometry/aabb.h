@@ -0,0 +1,114 @@
+#pragma once
+
+#include <railguard/utils/geometry/ray.h>
+
+#include <algorithm>
+#include <glm/common.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <limits>
+
+namespace rg
+{
+    /** Axis-aligned bounding box. */
+    struct AABB
+    {
+        // Default box is empty: extending it with a point gives a box containing only that point
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+        [[nodiscard]] inline bool is_empty() const
+        {
+            return min.x > max.x || min.y > max.y || min.z > max.z;
+        }
+
+        [[nodiscard]] inline glm::vec3 center() const
+        {
+            return (min + max) * 0.5f;
+        }
+
+        [[nodiscard]] inline glm::vec3 extent() const
+        {
+            return max - min;
+        }
+
+        inline void extend(const glm::vec3 &point)
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        inline void extend(const AABB &other)
+        {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        [[nodiscard]] inline bool intersects(const AABB &other) const
+        {
+            return min.x <= other.max.x && max.x >= other.min.x && min.y <= other.max.y && max.y >= other.min.y
+                   && min.z <= other.max.z && max.z >= other.min.z;
+        }
+
+        /** Area of the faces of the box. Used to estimate the probability that a ray or a query hits it. */
+        [[nodiscard]] inline float surface_area() const
+        {
+            if (is_empty())
+            {
+                return 0.0f;
+            }
+            const auto e = extent();
+            return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        }
+
+        /**
+         * Tests if the ray hits the box before max_distance.
+         * @param distance Set to the distance along the ray at which the box is entered, or 0 if the origin is inside the box.
+         */
+        [[nodiscard]] inline bool intersects_ray(const Ray &ray, float max_distance, float &distance) const
+        {
+            if (is_empty())
+            {
+                return false;
+            }
+
+            // Slab method: intersect the intervals in which the ray is between the two planes of each axis
+            const glm::vec3 inverse_direction = 1.0f / ray.direction;
+            const glm::vec3 t1                = (min - ray.origin) * inverse_direction;
+            const glm::vec3 t2                = (max - ray.origin) * inverse_direction;
+            const glm::vec3 t_near            = glm::min(t1, t2);
+            const glm::vec3 t_far             = glm::max(t1, t2);
+
+            const float enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+            const float exit  = std::min({t_far.x, t_far.y, t_far.z, max_distance});
+            if (enter > exit)
+            {
+                return false;
+            }
+
+            distance = enter;
+            return true;
+        }
+
+        /** Returns the smallest axis-aligned box containing this box once transformed by the given matrix. */
+        [[nodiscard]] inline AABB transformed(const glm::mat4 &transform) const
+        {
+            if (is_empty())
+            {
+                return {};
+            }
+
+            // Each axis of the transformed box is the sum of the absolute contributions of the transformed axes (Arvo's method)
+            const glm::vec3 half_extent     = extent() * 0.5f;
+            const glm::vec3 new_center      = glm::vec3(transform * glm::vec4(center(), 1.0f));
+            const glm::vec3 new_half_extent = glm::abs(glm::vec3(transform[0])) * half_extent.x
+                                              + glm::abs(glm::vec3(transform[1])) * half_extent.y
+                                              + glm::abs(glm::vec3(transform[2])) * half_extent.z;
+
+            return {
+                .min = new_center - new_half_extent,
+                .max = new_center + new_half_extent,
+            };
+        }
+    };
+} // namespace rg
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <railguard/utils/array.h>
+#include <railguard/utils/geometry/aabb.h>
+#include <railguard/utils/vector.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rg
+{
+    struct Frustum;
+    struct Ray;
+
+    /**
+     * Bounding volume hierarchy over a set of axis-aligned boxes, called items.
+     * It allows to find the items visible by a frustum, hit by a ray or overlapping a box without testing all of them.
+     *
+     * Items are identified by their index in the array given to build. When only the boxes change, refit is much cheaper than a
+     * new build, but the quality of the tree slowly decreases, which can be measured by comparing the cost with the one after the
+     * build.
+     */
+    class BVH
+    {
+      public:
+        struct Node
+        {
+            AABB bounds;
+            /** For an internal node, index of the left child (the right one follows it). For a leaf, index of the first item. */
+            uint32_t left_or_first = 0;
+            /** Number of items of a leaf, or 0 for an internal node. */
+            uint32_t item_count = 0;
+
+            [[nodiscard]] inline bool is_leaf() const
+            {
+                return item_count > 0;
+            }
+        };
+
+      private:
+        /** Nodes of the tree. The root is the first one, and children are always stored after their parent. */
+        Array<Node> m_nodes      = {};
+        size_t      m_node_count = 0;
+        /** Items referenced by the leaves, grouped by leaf. */
+        Array<uint32_t> m_item_indices = {};
+        /** Copy of the boxes of the items, indexed by item. */
+        Array<AABB> m_item_bounds = {};
+        /** Surface area heuristic cost of the tree, see cost(). */
+        float m_cost = 0.0f;
+
+        [[nodiscard]] float compute_cost() const;
+
+      public:
+        BVH() = default;
+
+        /**
+         * Builds the tree with the surface area heuristic, evaluated on a fixed number of bins per axis.
+         * @param bounds Array of count boxes. Empty boxes are allowed but are never returned by queries.
+         */
+        void build(const AABB *bounds, size_t count);
+
+        /**
+         * Updates the boxes of the items without changing the structure of the tree.
+         * @param bounds Array of boxes, with the same number of items as the last build.
+         */
+        void refit(const AABB *bounds);
+
+        /**
+         * Finds the items whose box intersects the frustum. Whole subtrees are accepted or rejected at once when possible.
+         * @param visibility Array of item_count() elements, set to 1 for the visible items and 0 for the others.
+         */
+        void cull(const Frustum &frustum, uint8_t *visibility) const;
+
+        /**
+         * Finds the closest item whose box is hit by the ray.
+         * @param max_distance Items further than that distance along the ray are ignored.
+         * @param hit_item Set to the index of the hit item, if there is one.
+         * @param hit_distance Set to the distance along the ray at which the box of the item is entered.
+         * @return true if an item was hit.
+         */
+        bool raycast(const Ray &ray, float max_distance, uint32_t &hit_item, float &hit_distance) const;
+
+        /** Appends to results the items whose box intersects the given one. */
+        void query_box(const AABB &box, Vector<uint32_t> &results) const;
+
+        [[nodiscard]] inline size_t item_count() const
+        {
+            return m_item_bounds.size();
+        }
+
+        [[nodiscard]] inline size_t node_count() const
+        {
+            return m_node_count;
+        }
+
+        [[nodiscard]] inline bool is_empty() const
+        {
+            return m_node_count == 0;
+        }
+
+        /**
+         * Sum of the surface areas of the nodes, relative to the one of the root. It is proportional to the expected cost of a query.
+         * It is computed by build and refit.
+         */
+        [[nodiscard]] inline float cost() const
+        {
+            return m_cost;
+        }
+    };
+} // namespace rg
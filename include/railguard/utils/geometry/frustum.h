@@ -0,0 +1,58 @@
+#pragma once
+
+#include <railguard/utils/geometry/aabb.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+namespace rg
+{
+    /** Position of a volume relative to a frustum. */
+    enum class FrustumIntersection
+    {
+        OUTSIDE      = 0,
+        INTERSECTING = 1,
+        INSIDE       = 2,
+    };
+
+    /** Volume visible by a camera, delimited by 6 planes. */
+    struct Frustum
+    {
+        /**
+         * Planes in the order left, right, bottom, top, near, far.
+         * For each plane, xyz is the normal, pointing inside the frustum, and w is the distance to the origin.
+         * A point p is on the inner side of the plane if dot(plane.xyz, p) + plane.w >= 0.
+         */
+        glm::vec4 planes[6] = {};
+
+        /**
+         * Extracts the planes of the frustum from a view projection matrix.
+         * The resulting planes are in world space and normalized.
+         */
+        [[nodiscard]] static Frustum from_view_projection(const glm::mat4 &view_projection);
+
+        /** Returns true if the sphere is at least partially inside the frustum. */
+        [[nodiscard]] bool intersects_sphere(const glm::vec3 &center, float radius) const;
+
+        /** Returns true if the box is at least partially inside the frustum. It may return true for boxes near the corners. */
+        [[nodiscard]] bool intersects_box(const AABB &box) const;
+
+        /**
+         * Same as intersects_box, but also tells if the box is entirely inside the frustum.
+         * It allows hierarchical culling to accept a whole group of objects without testing them.
+         */
+        [[nodiscard]] FrustumIntersection classify_box(const AABB &box) const;
+
+        /**
+         * Tests a batch of spheres against the frustum. The spheres are given as a structure of arrays, so that several of them can
+         * be tested at once with SIMD instructions (AVX if it is enabled at compile time, SSE otherwise).
+         * @param x, y, z, radius Arrays of count elements describing the spheres.
+         * @param visibility Array of count elements, set to 1 for the spheres that intersect the frustum and 0 for the others.
+         */
+        void cull_spheres(const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visibility)
+            const;
+    };
+} // namespace rg
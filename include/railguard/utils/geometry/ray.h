@@ -0,0 +1,14 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+
+namespace rg
+{
+    /** Half-line starting at an origin and going in a direction. */
+    struct Ray
+    {
+        glm::vec3 origin = glm::vec3(0.0f);
+        /** Direction of the ray. It doesn't need to be normalized, but the distances along the ray are expressed in its length. */
+        glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f);
+    };
+} // namespace rg
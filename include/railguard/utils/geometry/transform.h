@@ -13,5 +13,6 @@ namespace rg
 
         // Methods
         [[nodiscard]] glm::mat4 view_matrix() const;
+        [[nodiscard]] bool      operator==(const Transform &other) const;
     };
 } // namespace rg
\ No newline at end of file
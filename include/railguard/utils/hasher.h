@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rg
+{
+    /** FNV-1a hash, fed byte per byte. It is fast and stable across runs, so it can identify contents saved in files. */
+    struct Hasher
+    {
+        uint64_t hash = 0xcbf29ce484222325;
+
+        inline void add(const void *data, size_t size)
+        {
+            const auto *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3;
+            }
+        }
+
+        /** Adds the 8 bytes of the value, from the least significant one, so that the result doesn't depend on the platform. */
+        inline void add(uint64_t value)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                hash ^= (value >> (i * 8)) & 0xff;
+                hash *= 0x100000001b3;
+            }
+        }
+    };
+} // namespace rg
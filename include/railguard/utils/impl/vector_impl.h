@@ -44,6 +44,11 @@ namespace rg::_impl
 
         void  ensure_capacity(size_t required_minimum_capacity);
         void *push_slot();
+        /**
+         * Pushes count slots at once and returns the first one. Contrary to push_slot, the slots are not zeroed: they are expected
+         * to be entirely written by the caller.
+         */
+        void *push_slots(size_t count);
         /**
          * Pops the last slot from the vector. The m_data is not freed, and it is assumed that there is at least one element in the
          * vector.
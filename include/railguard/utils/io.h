@@ -4,4 +4,31 @@
 
 namespace rg {
     void *load_binary_file(const char *path, size_t *size);
-}
\ No newline at end of file
+
+    /**
+     * Read-only memory mapping of a whole file. The pages are loaded by the OS when they are accessed, so opening a big file is
+     * almost free. Copies share the same mapping, which is released with the last copy.
+     */
+    class MappedFile
+    {
+      private:
+        struct Data;
+        Data *m_data = nullptr;
+
+        void release();
+
+      public:
+        MappedFile() = default;
+        /** Maps the file. If it doesn't exist or can't be mapped, the mapping is invalid, which can be checked with is_valid. */
+        explicit MappedFile(const char *path);
+        MappedFile(const MappedFile &other);
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(const MappedFile &other);
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        ~MappedFile();
+
+        [[nodiscard]] bool        is_valid() const;
+        [[nodiscard]] const void *data() const;
+        [[nodiscard]] size_t      size() const;
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <railguard/utils/optional.h>
+#include <railguard/utils/vector.h>
+
+#include <cstddef>
+
+namespace rg
+{
+    /**
+     * Suballocator of ranges in a linear space of a given capacity, for example a GPU buffer. It only does the bookkeeping: the
+     * memory itself is managed by the user.
+     *
+     * Free ranges are kept in a list and allocations take the smallest one that fits (best fit). Freed ranges are merged with
+     * their free neighbours, so that the space doesn't get fragmented when everything is freed.
+     */
+    class RangeAllocator
+    {
+      public:
+        struct Range
+        {
+            size_t offset = 0;
+            size_t size   = 0;
+        };
+
+      private:
+        /** Free ranges, in no particular order. Two of them are never adjacent. */
+        Vector<Range> m_free_ranges {8};
+        size_t        m_capacity  = 0;
+        size_t        m_used_size = 0;
+
+        void add_free_range(size_t offset, size_t size);
+
+      public:
+        RangeAllocator() = default;
+        explicit RangeAllocator(size_t capacity);
+
+        /**
+         * Allocates a range of the given size.
+         * @param alignment The offset of the range will be a multiple of it.
+         * @return The allocated range, or nothing if no free range is big enough. In that case, grow can be used to make space.
+         */
+        [[nodiscard]] Optional<Range> allocate(size_t size, size_t alignment = 1);
+
+        /** Makes a range returned by allocate available again. */
+        void free(const Range &range);
+
+        /** Extends the space to the given capacity. The new space is free, and the existing ranges don't move. */
+        void grow(size_t new_capacity);
+
+        /** Frees every range. */
+        void clear();
+
+        [[nodiscard]] inline size_t capacity() const
+        {
+            return m_capacity;
+        }
+
+        /** Sum of the sizes of the allocated ranges, without the padding added for the alignment. */
+        [[nodiscard]] inline size_t used_size() const
+        {
+            return m_used_size;
+        }
+
+        [[nodiscard]] inline size_t free_range_count() const
+        {
+            return m_free_ranges.size();
+        }
+    };
+} // namespace rg
@@ -4,6 +4,8 @@
 #include <railguard/utils/impl/vector_impl.h>
 #include <railguard/utils/optional.h>
 
+#include <type_traits>
+
 namespace rg
 {
     template<typename T>
@@ -90,6 +92,16 @@ namespace rg
             new (slot) T(std::move(value));
         }
 
+        /**
+         * Adds count elements at the end of the vector without initializing them, and returns a pointer to the first one.
+         * This allows big vectors to be filled in place, for example by several threads at once.
+         */
+        inline T *push_uninitialized(size_t count)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Uninitialized elements can only be of a trivial type.");
+            return static_cast<T *>(m_impl.push_slots(count));
+        }
+
         // Extend
 
         inline void extend(const Vector<T> &other)
@@ -23,15 +23,22 @@ namespace rg
         uint32_t dynamic_storage_count;
         uint32_t storage_count;
         uint32_t combined_image_sampler_count;
+        uint32_t storage_image_count;
 
         [[nodiscard]] inline uint32_t total() const
         {
-            return dynamic_uniform_count + dynamic_storage_count + storage_count + combined_image_sampler_count;
+            return dynamic_uniform_count + dynamic_storage_count + storage_count + combined_image_sampler_count + storage_image_count;
         }
 
         inline DescriptorBalance operator*(uint32_t v) const
         {
-            return {dynamic_uniform_count * v, dynamic_storage_count * v, storage_count * v, combined_image_sampler_count * v};
+            return {
+                dynamic_uniform_count * v,
+                dynamic_storage_count * v,
+                storage_count * v,
+                combined_image_sampler_count * v,
+                storage_image_count * v,
+            };
         }
 
         inline DescriptorBalance &operator+=(const DescriptorBalance &other)
@@ -40,6 +47,7 @@ namespace rg
             dynamic_storage_count += other.dynamic_storage_count;
             storage_count += other.storage_count;
             combined_image_sampler_count += other.combined_image_sampler_count;
+            storage_image_count += other.storage_image_count;
             return *this;
         }
 
@@ -50,6 +58,7 @@ namespace rg
                 dynamic_storage_count + other.dynamic_storage_count,
                 storage_count + other.storage_count,
                 combined_image_sampler_count + other.combined_image_sampler_count,
+                storage_image_count + other.storage_image_count,
             };
         }
 
@@ -59,13 +68,15 @@ namespace rg
             dynamic_storage_count -= other.dynamic_storage_count;
             storage_count -= other.storage_count;
             combined_image_sampler_count -= other.combined_image_sampler_count;
+            storage_image_count -= other.storage_image_count;
             return *this;
         }
 
         inline bool operator>=(const DescriptorBalance &other) const
         {
             return dynamic_uniform_count >= other.dynamic_uniform_count && dynamic_storage_count >= other.dynamic_storage_count
-                   && storage_count >= other.storage_count && combined_image_sampler_count >= other.combined_image_sampler_count;
+                   && storage_count >= other.storage_count && combined_image_sampler_count >= other.combined_image_sampler_count
+                   && storage_image_count >= other.storage_image_count;
         }
     };
 
@@ -122,7 +133,12 @@ namespace rg
         DescriptorSetBuilder &add_dynamic_uniform_buffer(VkBuffer buffer, size_t range, size_t offset = 0);
         DescriptorSetBuilder &add_dynamic_storage_buffer(VkBuffer buffer, size_t range, size_t offset = 0);
         DescriptorSetBuilder &add_storage_buffer(VkBuffer buffer, size_t range, size_t offset = 0);
-        DescriptorSetBuilder &add_combined_image_sampler(VkSampler sampler, VkImageView image_view);
+        DescriptorSetBuilder &add_image(VkDescriptorType type, VkSampler sampler, VkImageView image_view, VkImageLayout image_layout);
+        DescriptorSetBuilder &add_combined_image_sampler(VkSampler     sampler,
+                                                         VkImageView   image_view,
+                                                         VkImageLayout image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        /** Adds an image that can be written by shaders. It must be in the general layout when it is used. */
+        DescriptorSetBuilder &add_storage_image(VkImageView image_view);
 
         DescriptorSetBuilder &save_descriptor_set(VkDescriptorSetLayout layout, VkDescriptorSet *set);
 
@@ -143,6 +159,7 @@ namespace rg
         DescriptorSetLayoutBuilder &add_dynamic_uniform_buffer(VkShaderStageFlags stages);
         DescriptorSetLayoutBuilder &add_storage_buffer(VkShaderStageFlags stages);
         DescriptorSetLayoutBuilder &add_combined_image_sampler(VkShaderStageFlags stages);
+        DescriptorSetLayoutBuilder &add_storage_image(VkShaderStageFlags stages);
 
         DescriptorSetLayoutBuilder &save_descriptor_set_layout(VkDescriptorSetLayout *layout);
     };
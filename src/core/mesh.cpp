@@ -1,167 +1,333 @@
 #include "railguard/core/mesh.h"
 
+#include <railguard/core/obj_parser.h>
 #include <railguard/core/renderer/renderer.h>
+#include <railguard/utils/array.h>
+#include <railguard/utils/hasher.h>
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <glm/geometric.hpp>
 #include <iostream>
-#include <tiny_obj_loader.h>
+#include <string>
 
 namespace rg
 {
-
-    MeshPart::MeshPart(Vector<Vertex> &&vertices, Vector<Triangle> &&triangles)
-        : m_vertices(std::move(vertices)),
-          m_triangles(std::move(triangles))
+    namespace
     {
-    }
+        /** Extension appended to the path of an OBJ file to get the path of its mesh cache. */
+        constexpr const char *MESH_CACHE_EXTENSION = ".rgmesh";
 
-    MeshPartId MeshPart::load_from_obj(const char *filename, Renderer &renderer, bool duplicate_vertices)
-    {
-        // Attrib will contain the vertex arrays
-        tinyobj::attrib_t attrib;
-        // Shapes contain the infos for each separate object in the file
-        std::vector<tinyobj::shape_t> shapes;
-        // Material contains the infos about the material of each shape
-        std::vector<tinyobj::material_t> materials;
-
-        // Store errors and warnings
-        std::string warn;
-        std::string err;
-
-        // Get the directory of the file, so that we can look for the material relatively to the model
-        std::string dir = filename;
-        dir             = dir.substr(0, dir.find_last_of('/') + 1);
-
-        // Load the OBJ file
-        tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, dir.c_str());
-
-        // Print warnings and errors
-        if (!warn.empty())
+        /**
+         * Identifies the version of an OBJ file and the options of its import. It changes when the file is modified, or when the
+         * options would give different parts, which invalidates the mesh cache.
+         * Returns 0 if the file can't be found.
+         */
+        uint64_t get_source_stamp(const char *filename, const ObjImportOptions &options, bool split_shapes)
         {
-            std::cout << "[Mesh Loader Warning] " << warn;
+            std::error_code ec;
+            const auto      size = std::filesystem::file_size(filename, ec);
+            if (ec)
+            {
+                return 0;
+            }
+            const auto write_time = std::filesystem::last_write_time(filename, ec);
+            if (ec)
+            {
+                return 0;
+            }
+
+            Hasher hasher;
+            hasher.add(static_cast<uint64_t>(size));
+            hasher.add(static_cast<uint64_t>(write_time.time_since_epoch().count()));
+            hasher.add(static_cast<uint64_t>(options.mode));
+            hasher.add(static_cast<uint64_t>(options.lod_count));
+            hasher.add(static_cast<uint64_t>(options.vertex_format));
+            hasher.add(static_cast<uint64_t>(split_shapes ? options.max_part_triangle_count : 0));
+            return hasher.hash;
         }
-        // If we have any error, print it to the console, and break the mesh loading.
-        // This happens if the file can't be found or is malformed
-        if (!err.empty())
+
+        /** The cache is next to the file, unless a directory is given. */
+        std::string get_cache_path(const char *filename, const ObjImportOptions &options)
         {
-            std::cerr << "[Mesh Loader Error] " << err;
-            return NULL_ID;
+            if (options.cache_directory == nullptr)
+            {
+                return std::string(filename) + MESH_CACHE_EXTENSION;
+            }
+
+            auto path = std::filesystem::path(options.cache_directory) / std::filesystem::path(filename).filename();
+            path += MESH_CACHE_EXTENSION;
+            return path.string();
         }
 
-        // Hardcode the loading of triangles
-        constexpr int32_t vertices_per_face = 3;
+        constexpr uint32_t NO_VERTEX = ~0u;
 
-        Vector<Vertex>   vertices(attrib.vertices.size() / 3);
-        Vector<Triangle> triangles(shapes.size() * vertices_per_face);
+        struct TriangleRange
+        {
+            size_t begin;
+            size_t end;
+        };
 
-        // Add all vertices
-        if (!duplicate_vertices)
+        /**
+         * Creates a part per shape of the geometry. Shapes with more than max_triangle_count triangles are split in spatial clusters,
+         * by cutting them in two at the median of their triangles along their longest axis, until they are small enough.
+         */
+        void split_geometry(const ObjGeometry &geometry, uint32_t max_triangle_count, Vector<MeshPart> &parts)
         {
-            for (auto i = 0; i < attrib.vertices.size(); i += vertices_per_face)
+            const auto triangle_count = geometry.triangles.size();
+            max_triangle_count        = std::max(max_triangle_count, 1u);
+
+            // The clusters are ranges of this array of triangles
+            Array<uint32_t>  order(triangle_count);
+            Array<glm::vec3> centroids(triangle_count);
+            for (size_t t = 0; t < triangle_count; t++)
             {
-                vertices.push_back(Vertex {
-                    .position = {attrib.vertices[i], attrib.vertices[i + 1], attrib.vertices[i + 2]},
-                });
+                const auto &triangle = geometry.triangles[t];
+                const auto &p0       = geometry.vertices[triangle.index[0]].position;
+                const auto &p1       = geometry.vertices[triangle.index[1]].position;
+                const auto &p2       = geometry.vertices[triangle.index[2]].position;
+                order[t]             = static_cast<uint32_t>(t);
+                centroids[t]         = (p0 + p1 + p2) / 3.0f;
             }
 
-            // For now, we merge all the shapes into one mesh part
-            // When the tree structure is implemented, we will have to split the mesh into mesh parts
-            // TODO
-            for (auto &shape : shapes)
+            // Start with the shapes, in reverse so that the first one is handled first
+            Vector<TriangleRange> ranges(std::max<size_t>(geometry.shapes.size(), 1));
+            for (size_t s = geometry.shapes.size(); s > 0; s--)
             {
-                // We have an indexed model, but not as much as the Wavefront format
-                // The wavefront format supports having 3 indices per vertex to also avoid duplicating normals and texture
-                // coords
-                // Here, we only have one index per vertex
-                // So we will need to store the normals and texture coords with the vertex itself
+                const auto &shape = geometry.shapes[s - 1];
+                ranges.push_back({shape.first_triangle, shape.first_triangle + shape.triangle_count});
+            }
 
-                // Note that for now, this doesn't support having several values for the same vertex in different faces
-                // If the values change, later faces will overwrite the first
-                // Maybe later, store normals and texture coords separately and find a way to index them
-                // Alternatively, duplicate a vertex if the combination with normal and tex coords change.
+            // Each part only takes the vertices its triangles use. The remap is shared between the parts and reset after each one.
+            Array<uint32_t> remap(geometry.vertices.size());
+            std::fill(remap.data(), remap.data() + remap.size(), NO_VERTEX);
 
-                size_t index_offset = 0;
+            while (!ranges.is_empty())
+            {
+                const auto range = ranges.last();
+                ranges.pop_back();
+                const auto range_size = range.end - range.begin;
 
-                // For each face
-                for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
+                if (range_size > max_triangle_count)
                 {
-                    Triangle triangle {0, 0, 0};
-
-                    // For each vertex of that face
-                    for (size_t v = 0; v < vertices_per_face; v++)
+                    AABB bounds;
+                    for (size_t i = range.begin; i < range.end; i++)
                     {
-                        tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-
-                        // Store triangle indices for index buffer
-                        triangle.index[v] = idx.vertex_index;
-
-                        // Store the normal in the associated vertex
-                        vertices[idx.vertex_index].normal = glm::vec3 {
-                            attrib.normals[3 * idx.normal_index + 0],
-                            attrib.normals[3 * idx.normal_index + 1],
-                            attrib.normals[3 * idx.normal_index + 2],
-                        };
-
-                        // Store the texture coords as well
-                        vertices[idx.vertex_index].tex_coord = glm::vec2 {
-                            attrib.texcoords[2 * idx.texcoord_index + 0],
-                            1 - attrib.texcoords[2 * idx.texcoord_index + 1],
-                        };
+                        bounds.extend(centroids[order[i]]);
                     }
+                    const auto extent = bounds.extent();
+                    const int  axis   = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
 
-                    triangles.push_back(triangle);
+                    const auto middle = range.begin + range_size / 2;
+                    std::nth_element(order.data() + range.begin,
+                                     order.data() + middle,
+                                     order.data() + range.end,
+                                     [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+                    ranges.push_back({middle, range.end});
+                    ranges.push_back({range.begin, middle});
+                    continue;
+                }
 
-                    index_offset += vertices_per_face;
+                Vector<Vertex>   vertices(range_size * 3);
+                Vector<Triangle> triangles(range_size);
+                for (size_t i = range.begin; i < range.end; i++)
+                {
+                    Triangle triangle = geometry.triangles[order[i]];
+                    for (auto &index : triangle.index)
+                    {
+                        if (remap[index] == NO_VERTEX)
+                        {
+                            remap[index] = static_cast<uint32_t>(vertices.size());
+                            vertices.push_back(geometry.vertices[index]);
+                        }
+                        index = remap[index];
+                    }
+                    triangles.push_back(triangle);
                 }
+                for (size_t i = range.begin; i < range.end; i++)
+                {
+                    for (const auto index : geometry.triangles[order[i]].index)
+                    {
+                        remap[index] = NO_VERTEX;
+                    }
+                }
+
+                parts.push_back(MeshPart(std::move(vertices), std::move(triangles)));
             }
         }
-        else
+
+        /** Loads the parts of an OBJ file, from its mesh cache if possible. Returns no part if it failed. */
+        Vector<MeshPart> import_obj(const char *filename, const ObjImportOptions &options, bool split_shapes)
         {
-            for (auto &shape : shapes)
+            Vector<MeshPart> parts(4);
+
+            // Try the mesh cache first: its vertices and indices are mapped and copied as is to the GPU
+            const auto        source_stamp = options.use_cache ? get_source_stamp(filename, options, split_shapes) : 0;
+            const std::string cache_path   = get_cache_path(filename, options);
+            if (source_stamp != 0)
             {
-                size_t index_offset = 0;
+                parts = MeshPart::load_cache(cache_path.c_str(), source_stamp);
+                if (!parts.is_empty())
+                {
+                    return parts;
+                }
+            }
+
+            // Parse the file
+            ObjGeometry geometry;
+            std::string error;
+            if (!parse_obj(filename, options.mode, geometry, error))
+            {
+                // This happens if the file can't be found or is malformed
+                std::cerr << "[Mesh Loader Error] " << error << '\n';
+                return parts;
+            }
+
+            if (split_shapes)
+            {
+                split_geometry(geometry, options.max_part_triangle_count, parts);
+            }
+            else
+            {
+                parts.push_back(MeshPart(std::move(geometry.vertices), std::move(geometry.triangles)));
+            }
 
-                // For each face
-                for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
+            ObjImportStatistics statistics        = {.part_count = parts.size()};
+            float               file_order_misses = 0.0f;
+            float               optimized_misses  = 0.0f;
+            for (auto &part : parts)
+            {
+                if (options.mode == ObjImportMode::INDEXED)
                 {
-                    Triangle triangle {0, 0, 0};
+                    statistics.duplicated_vertex_count += part.vertex_count();
+                    part.deduplicate_vertices();
+                    file_order_misses += part.acmr() * static_cast<float>(part.triangle_count());
 
-                    // For each vertex of that face
-                    for (size_t v = 0; v < vertices_per_face; v++)
-                    {
-                        tinyobj::index_t idx = shape.mesh.indices[index_offset + v];
-                        // Store triangle indices for index buffer
-                        triangle.index[v] = vertices.size();
-
-                        vertices.push_back(Vertex {
-                            .position =
-                                glm::vec3 {
-                                    attrib.vertices[3 * idx.vertex_index + 0],
-                                    attrib.vertices[3 * idx.vertex_index + 1],
-                                    attrib.vertices[3 * idx.vertex_index + 2],
-                                },
-                            .normal =
-                                glm::vec3 {
-                                    attrib.normals[3 * idx.normal_index + 0],
-                                    attrib.normals[3 * idx.normal_index + 1],
-                                    attrib.normals[3 * idx.normal_index + 2],
-                                },
-                            .tex_coord =
-                                glm::vec2 {
-                                    attrib.texcoords[2 * idx.texcoord_index + 0],
-                                    1 - attrib.texcoords[2 * idx.texcoord_index + 1],
-                                },
-                        });
-                    }
+                    part.optimize_vertex_cache();
+                    part.optimize_vertex_fetch();
+                    optimized_misses += part.acmr() * static_cast<float>(part.triangle_count());
+                    statistics.vertex_count += part.vertex_count();
+                    statistics.triangle_count += part.triangle_count();
+                }
 
-                    triangles.push_back(triangle);
-                    index_offset += vertices_per_face;
+                // The levels of detail are generated last, so that they share the optimized vertices
+                part.generate_lods(options.lod_count);
+                part.set_vertex_format(options.vertex_format);
+            }
+
+            if (options.statistics != nullptr)
+            {
+                if (statistics.triangle_count > 0)
+                {
+                    const auto triangles       = static_cast<float>(statistics.triangle_count);
+                    statistics.file_order_acmr = file_order_misses / triangles;
+                    statistics.optimized_acmr  = optimized_misses / triangles;
                 }
+                *options.statistics = statistics;
             }
+
+            // Save the result for the next time
+            // If the cache can't be written, the file will simply be imported again
+            if (source_stamp != 0)
+            {
+                MeshPart::save_cache(cache_path.c_str(), parts.data(), parts.size(), source_stamp);
+            }
+
+            return parts;
+        }
+    } // namespace
+
+    MeshPart::MeshPart(Vector<Vertex> &&vertices, Vector<Triangle> &&triangles)
+        : m_vertices(std::move(vertices)),
+          m_triangles(std::move(triangles))
+    {
+        // The base level draws every triangle
+        m_lods.push_back(MeshLod {
+            .first_index = 0,
+            .index_count = static_cast<uint32_t>(m_triangles.size() * 3),
+            .error       = 0.0f,
+        });
+
+        compute_bounds();
+        compute_uv_density();
+    }
+
+    void MeshPart::compute_bounds()
+    {
+        m_bounds          = AABB {};
+        m_bounding_sphere = glm::vec4(0.0f);
+        if (m_vertices.is_empty())
+        {
+            return;
+        }
+
+        for (const auto &vertex : m_vertices)
+        {
+            m_bounds.extend(vertex.position);
+        }
+        const glm::vec3 center = m_bounds.center();
+
+        float radius_squared = 0.0f;
+        for (const auto &vertex : m_vertices)
+        {
+            const glm::vec3 offset = vertex.position - center;
+            radius_squared         = std::max(radius_squared, glm::dot(offset, offset));
         }
 
-        // Now, we have our mesh part
-        // TODO and soon we will have to store it in the tree structure
-        // For now, just add that mesh and return its id
-        return renderer.save_mesh_part(MeshPart(std::move(vertices), std::move(triangles)));
+        m_bounding_sphere = glm::vec4(center, std::sqrt(radius_squared));
+    }
+
+    void MeshPart::compute_uv_density()
+    {
+        // Ratio of the total areas, so that the big triangles weigh more than the small ones
+        double model_area = 0.0;
+        double uv_area    = 0.0;
+        for (const auto &triangle : m_triangles)
+        {
+            const auto &a = m_vertices[triangle.index[0]];
+            const auto &b = m_vertices[triangle.index[1]];
+            const auto &c = m_vertices[triangle.index[2]];
+
+            const glm::vec2 uv_ab = b.tex_coord - a.tex_coord;
+            const glm::vec2 uv_ac = c.tex_coord - a.tex_coord;
+            model_area += 0.5 * glm::length(glm::cross(b.position - a.position, c.position - a.position));
+            uv_area    += 0.5 * std::abs(uv_ab.x * uv_ac.y - uv_ab.y * uv_ac.x);
+        }
+
+        m_uv_density = model_area > 0.0 ? static_cast<float>(std::sqrt(uv_area / model_area)) : 0.0f;
+    }
+
+    MeshPartId MeshPart::load_from_obj(const char *filename, Renderer &renderer, const ObjImportOptions &options)
+    {
+        // Every shape is merged in a single part
+        auto parts = import_obj(filename, options, false);
+        if (parts.size() != 1)
+        {
+            return NULL_ID;
+        }
+        return renderer.save_mesh_part(std::move(parts[0]), options.gpu_resident_only);
+    }
+
+    MeshPartId MeshPart::load_from_obj(const char *filename, Renderer &renderer, bool duplicate_vertices)
+    {
+        return load_from_obj(filename,
+                             renderer,
+                             ObjImportOptions {
+                                 .mode = duplicate_vertices ? ObjImportMode::DUPLICATED_VERTICES : ObjImportMode::SHARED_POSITIONS,
+                             });
+    }
+
+    Vector<MeshPartId> MeshPart::load_parts_from_obj(const char *filename, Renderer &renderer, const ObjImportOptions &options)
+    {
+        auto parts = import_obj(filename, options, true);
+
+        Vector<MeshPartId> ids(std::max<size_t>(parts.size(), 1));
+        for (auto &part : parts)
+        {
+            ids.push_back(renderer.save_mesh_part(std::move(part), options.gpu_resident_only));
+        }
+        return ids;
     }
 } // namespace rg
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "railguard/core/mesh.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace rg
+{
+    namespace
+    {
+        constexpr char     MESH_CACHE_MAGIC[8]    = "RGMESH";
+        constexpr uint32_t MESH_CACHE_VERSION     = 2;
+        constexpr uint64_t MESH_CACHE_ALIGNMENT   = 32;
+        constexpr uint8_t  MESH_CACHE_PADDING[32] = {};
+
+        struct MeshCacheHeader
+        {
+            char     magic[8];
+            uint32_t version;
+            uint32_t part_count;
+            uint64_t source_stamp;
+        };
+
+        /** Description of a part in the cache. The table of parts follows the header. */
+        struct MeshCachePart
+        {
+            uint32_t vertex_format;
+            uint32_t lod_count;
+            uint64_t vertex_count;
+            uint64_t index_count;
+            MeshLod  lods[MAX_MESH_LOD_COUNT];
+            float    position_offset[3];
+            float    position_scale;
+            float    bounds_min[3];
+            float    bounds_max[3];
+            float    bounding_sphere[4];
+            float    uv_density;
+            // Offsets of the encoded data from the start of the file
+            uint64_t vertex_data_offset;
+            uint64_t index_data_offset;
+        };
+
+        inline uint64_t align_offset(uint64_t offset)
+        {
+            return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+        }
+    } // namespace
+
+    bool MeshPart::save_cache(const char *path, const MeshPart *parts, size_t part_count, uint64_t source_stamp)
+    {
+        // Fill the table first, to know where each blob goes
+        Vector<MeshCachePart> table(std::max<size_t>(part_count, 1));
+        uint64_t              offset       = align_offset(sizeof(MeshCacheHeader) + part_count * sizeof(MeshCachePart));
+        size_t                biggest_blob = 0;
+        for (size_t i = 0; i < part_count; i++)
+        {
+            const auto &part = parts[i];
+            if (part.is_cached())
+            {
+                // Its data is already in a cache
+                return false;
+            }
+
+            MeshCachePart entry  = {};
+            entry.vertex_format  = static_cast<uint32_t>(part.m_vertex_format);
+            entry.lod_count      = static_cast<uint32_t>(part.m_lods.size());
+            entry.vertex_count   = part.vertex_count();
+            entry.index_count    = part.total_triangle_count() * 3;
+            entry.position_scale = part.m_position_scale;
+            entry.uv_density     = part.m_uv_density;
+            for (size_t level = 0; level < part.m_lods.size(); level++)
+            {
+                entry.lods[level] = part.m_lods[level];
+            }
+            for (int axis = 0; axis < 3; axis++)
+            {
+                entry.position_offset[axis] = part.m_position_offset[axis];
+                entry.bounds_min[axis]      = part.m_bounds.min[axis];
+                entry.bounds_max[axis]      = part.m_bounds.max[axis];
+            }
+            for (int component = 0; component < 4; component++)
+            {
+                entry.bounding_sphere[component] = part.m_bounding_sphere[component];
+            }
+
+            const auto vertex_data_size = entry.vertex_count * part.vertex_byte_size();
+            const auto index_data_size  = entry.index_count * part.index_byte_size();
+            entry.vertex_data_offset    = offset;
+            entry.index_data_offset     = align_offset(offset + vertex_data_size);
+            offset                      = align_offset(entry.index_data_offset + index_data_size);
+            biggest_blob                = std::max({biggest_blob, vertex_data_size, index_data_size});
+
+            table.push_back(entry);
+        }
+
+        FILE *file = std::fopen(path, "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        MeshCacheHeader header = {};
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version      = MESH_CACHE_VERSION;
+        header.part_count   = static_cast<uint32_t>(part_count);
+        header.source_stamp = source_stamp;
+
+        bool success = std::fwrite(&header, sizeof(header), 1, file) == 1
+                       && (part_count == 0 || std::fwrite(table.data(), sizeof(MeshCachePart), part_count, file) == part_count);
+
+        // The blobs are encoded with the same functions as the upload to the GPU, so that loading them is a plain copy
+        void    *blob    = std::malloc(std::max<size_t>(biggest_blob, 1));
+        uint64_t written = sizeof(MeshCacheHeader) + part_count * sizeof(MeshCachePart);
+        success          = success && blob != nullptr;
+
+        auto write_blob = [&](uint64_t blob_offset, const void *data, size_t size)
+        {
+            // Pad up to the aligned offset of the blob
+            const auto padding = blob_offset - written;
+            success            = success && std::fwrite(MESH_CACHE_PADDING, 1, padding, file) == padding
+                                 && (size == 0 || std::fwrite(data, 1, size, file) == size);
+            written            = blob_offset + size;
+        };
+
+        for (size_t i = 0; i < part_count && success; i++)
+        {
+            const auto &part  = parts[i];
+            const auto &entry = table[i];
+
+            part.write_vertices(blob);
+            write_blob(entry.vertex_data_offset, blob, entry.vertex_count * part.vertex_byte_size());
+            part.write_indices(blob);
+            write_blob(entry.index_data_offset, blob, entry.index_count * part.index_byte_size());
+        }
+        std::free(blob);
+
+        success = std::fclose(file) == 0 && success;
+        if (!success)
+        {
+            // Don't leave a truncated cache behind
+            std::remove(path);
+        }
+        return success;
+    }
+
+    Vector<MeshPart> MeshPart::load_cache(const char *path, uint64_t source_stamp)
+    {
+        Vector<MeshPart> parts(1);
+
+        MappedFile file(path);
+        if (!file.is_valid() || file.size() < sizeof(MeshCacheHeader))
+        {
+            return parts;
+        }
+
+        const auto *bytes  = static_cast<const uint8_t *>(file.data());
+        const auto *header = static_cast<const MeshCacheHeader *>(file.data());
+        if (std::memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0 || header->version != MESH_CACHE_VERSION
+            || header->source_stamp != source_stamp
+            || file.size() < sizeof(MeshCacheHeader) + static_cast<uint64_t>(header->part_count) * sizeof(MeshCachePart))
+        {
+            // Outdated or invalid cache
+            return parts;
+        }
+
+        // Check the whole table before creating anything, so that a corrupted file is entirely ignored
+        const auto *table = reinterpret_cast<const MeshCachePart *>(bytes + sizeof(MeshCacheHeader));
+        for (uint32_t i = 0; i < header->part_count; i++)
+        {
+            const auto &entry = table[i];
+            if (entry.vertex_format >= VERTEX_FORMAT_COUNT || entry.lod_count == 0 || entry.lod_count > MAX_MESH_LOD_COUNT
+                || entry.index_count % 3 != 0)
+            {
+                return parts;
+            }
+
+            const size_t vertex_size = entry.vertex_format == static_cast<uint32_t>(VertexFormat::COMPRESSED)
+                                         ? sizeof(CompressedVertex)
+                                         : sizeof(Vertex);
+            const size_t index_size  = entry.vertex_count < 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+            if (entry.vertex_data_offset > file.size() || entry.vertex_count > (file.size() - entry.vertex_data_offset) / vertex_size
+                || entry.index_data_offset > file.size() || entry.index_count > (file.size() - entry.index_data_offset) / index_size)
+            {
+                return parts;
+            }
+            for (uint32_t level = 0; level < entry.lod_count; level++)
+            {
+                if (static_cast<uint64_t>(entry.lods[level].first_index) + entry.lods[level].index_count > entry.index_count)
+                {
+                    return parts;
+                }
+            }
+        }
+
+        for (uint32_t i = 0; i < header->part_count; i++)
+        {
+            const auto &entry = table[i];
+
+            MeshPart part(Vector<Vertex>(1), Vector<Triangle>(1));
+            part.m_lods.clear();
+            for (uint32_t level = 0; level < entry.lod_count; level++)
+            {
+                part.m_lods.push_back(entry.lods[level]);
+            }
+
+            part.m_vertex_format  = static_cast<VertexFormat>(entry.vertex_format);
+            part.m_position_scale = entry.position_scale;
+            part.m_uv_density     = entry.uv_density;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                part.m_position_offset[axis] = entry.position_offset[axis];
+                part.m_bounds.min[axis]      = entry.bounds_min[axis];
+                part.m_bounds.max[axis]      = entry.bounds_max[axis];
+            }
+            for (int component = 0; component < 4; component++)
+            {
+                part.m_bounding_sphere[component] = entry.bounding_sphere[component];
+            }
+
+            // The part keeps the file mapped as long as it references it
+            part.m_cache_file            = file;
+            part.m_cached_vertices       = bytes + entry.vertex_data_offset;
+            part.m_cached_indices        = bytes + entry.index_data_offset;
+            part.m_cached_vertex_count   = entry.vertex_count;
+            part.m_cached_triangle_count = entry.index_count / 3;
+
+            parts.push_back(std::move(part));
+        }
+
+        return parts;
+    }
+} // namespace rg
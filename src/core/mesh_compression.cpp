@@ -0,0 +1,252 @@
+#include "railguard/core/mesh.h"
+
+#include <railguard/utils/hasher.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rg
+{
+    namespace
+    {
+        /** Converts a float in [-1, 1] to a signed normalized 16-bit integer, as read by the SNORM vertex formats. */
+        inline int16_t to_snorm16(float value)
+        {
+            return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+        }
+
+        /** Converts a float to a IEEE 754 half-precision float, rounding to the nearest value. */
+        uint16_t to_half(float value)
+        {
+            uint32_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(float));
+
+            const auto     sign     = static_cast<uint16_t>((bits >> 16) & 0x8000);
+            const int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+            const uint32_t mantissa = bits & 0x7fffff;
+
+            // NaN and infinity
+            if (((bits >> 23) & 0xff) == 0xff)
+            {
+                return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+            }
+            // Too big: infinity
+            if (exponent >= 31)
+            {
+                return static_cast<uint16_t>(sign | 0x7c00);
+            }
+            // Too small even for a subnormal: zero
+            if (exponent < -10)
+            {
+                return sign;
+            }
+            // Subnormal: the implicit leading bit becomes explicit
+            if (exponent <= 0)
+            {
+                const uint32_t full_mantissa = mantissa | 0x800000;
+                const auto     shift         = static_cast<uint32_t>(14 - exponent);
+                // Round to nearest, ties to even
+                const uint32_t half_mantissa = full_mantissa >> shift;
+                const uint32_t remainder     = full_mantissa & ((1u << shift) - 1);
+                const uint32_t halfway       = 1u << (shift - 1);
+                const bool     round_up      = remainder > halfway || (remainder == halfway && (half_mantissa & 1) != 0);
+                return static_cast<uint16_t>(sign | (half_mantissa + (round_up ? 1 : 0)));
+            }
+
+            // Normal: a carry of the rounding correctly increments the exponent, up to infinity
+            const uint32_t half      = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+            const uint32_t remainder = mantissa & 0x1fff;
+            const bool     round_up  = remainder > 0x1000 || (remainder == 0x1000 && (half & 1) != 0);
+            return static_cast<uint16_t>(sign | (half + (round_up ? 1 : 0)));
+        }
+
+        /**
+         * Projects a normal on an octahedron, then unfolds its lower half on the upper one, so that it is stored in two components.
+         * The vertex shaders do the opposite.
+         */
+        inline void encode_octahedral(const glm::vec3 &normal, int16_t *encoded)
+        {
+            const float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+            if (length == 0.0f)
+            {
+                encoded[0] = 0;
+                encoded[1] = 0;
+                return;
+            }
+
+            float x = normal.x / length;
+            float y = normal.y / length;
+            if (normal.z < 0.0f)
+            {
+                const float folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+                const float folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+                x                    = folded_x;
+                y                    = folded_y;
+            }
+
+            encoded[0] = to_snorm16(x);
+            encoded[1] = to_snorm16(y);
+        }
+
+        inline CompressedVertex compress_vertex(const Vertex &vertex, const glm::vec3 &position_offset, float inverse_scale)
+        {
+            const auto position = (vertex.position - position_offset) * inverse_scale;
+
+            CompressedVertex compressed = {};
+            compressed.position[0]      = to_snorm16(position.x);
+            compressed.position[1]      = to_snorm16(position.y);
+            compressed.position[2]      = to_snorm16(position.z);
+            compressed.position[3]      = 0;
+            encode_octahedral(vertex.normal, compressed.normal);
+            compressed.tex_coord[0] = to_half(vertex.tex_coord.x);
+            compressed.tex_coord[1] = to_half(vertex.tex_coord.y);
+            return compressed;
+        }
+
+        /** Hashes the indices of the triangles as they are written by write_triangles. */
+        template<typename Index>
+        void hash_triangles(Hasher &hasher, const Vector<Triangle> &triangles)
+        {
+            for (const auto &triangle : triangles)
+            {
+                for (const auto index : triangle.index)
+                {
+                    const auto written_index = static_cast<Index>(index);
+                    hasher.add(&written_index, sizeof(Index));
+                }
+            }
+        }
+
+        template<typename Index>
+        Index *write_triangles(const Vector<Triangle> &triangles, Index *destination)
+        {
+            for (const auto &triangle : triangles)
+            {
+                for (const auto index : triangle.index)
+                {
+                    *destination++ = static_cast<Index>(index);
+                }
+            }
+            return destination;
+        }
+    } // namespace
+
+    void MeshPart::set_vertex_format(VertexFormat format)
+    {
+        // Cached parts keep the format in which they were saved
+        if (is_cached())
+        {
+            return;
+        }
+
+        m_vertex_format   = format;
+        m_position_offset = glm::vec3(0.0f);
+        m_position_scale  = 1.0f;
+
+        if (format == VertexFormat::COMPRESSED && !m_vertices.is_empty())
+        {
+            // The positions are mapped to [-1, 1] in the bounds of the part
+            // The same scale is used on every axis, so that the transform of the objects stays uniform with the dequantization
+            const auto half_extent = m_bounds.extent() * 0.5f;
+            m_position_offset      = m_bounds.center();
+            m_position_scale       = std::max({half_extent.x, half_extent.y, half_extent.z});
+            if (m_position_scale <= 0.0f)
+            {
+                // Every vertex is at the same position
+                m_position_scale = 1.0f;
+            }
+        }
+    }
+
+    void MeshPart::write_vertices(void *destination) const
+    {
+        // Cached vertices are already encoded
+        if (is_cached())
+        {
+            std::memcpy(destination, m_cached_vertices, m_cached_vertex_count * vertex_byte_size());
+            return;
+        }
+
+        if (m_vertex_format == VertexFormat::FULL)
+        {
+            std::memcpy(destination, m_vertices.data(), m_vertices.size() * sizeof(Vertex));
+            return;
+        }
+
+        auto       *compressed_vertices = static_cast<CompressedVertex *>(destination);
+        const float inverse_scale       = 1.0f / m_position_scale;
+        for (const auto &vertex : m_vertices)
+        {
+            *compressed_vertices++ = compress_vertex(vertex, m_position_offset, inverse_scale);
+        }
+    }
+
+    void MeshPart::write_indices(void *destination) const
+    {
+        if (is_cached())
+        {
+            std::memcpy(destination, m_cached_indices, m_cached_triangle_count * 3 * index_byte_size());
+        }
+        else if (uses_16_bit_indices())
+        {
+            auto *indices = write_triangles(m_triangles, static_cast<uint16_t *>(destination));
+            write_triangles(m_lod_triangles, indices);
+        }
+        else
+        {
+            auto *indices = write_triangles(m_triangles, static_cast<uint32_t *>(destination));
+            write_triangles(m_lod_triangles, indices);
+        }
+    }
+
+    uint64_t MeshPart::content_hash() const
+    {
+        Hasher hasher;
+
+        // Description of the part
+        const uint64_t counts[2] = {vertex_count(), total_triangle_count()};
+        hasher.add(counts, sizeof(counts));
+        hasher.add(&m_vertex_format, sizeof(m_vertex_format));
+        hasher.add(&m_position_offset, sizeof(m_position_offset));
+        hasher.add(&m_position_scale, sizeof(m_position_scale));
+        hasher.add(m_lods.data(), m_lods.size() * sizeof(MeshLod));
+
+        // The data is hashed as it is written by write_vertices and write_indices, but without writing it anywhere
+        if (is_cached())
+        {
+            hasher.add(m_cached_vertices, m_cached_vertex_count * vertex_byte_size());
+            hasher.add(m_cached_indices, m_cached_triangle_count * 3 * index_byte_size());
+        }
+        else
+        {
+            if (m_vertex_format == VertexFormat::FULL)
+            {
+                hasher.add(m_vertices.data(), m_vertices.size() * sizeof(Vertex));
+            }
+            else
+            {
+                const float inverse_scale = 1.0f / m_position_scale;
+                for (const auto &vertex : m_vertices)
+                {
+                    const auto compressed = compress_vertex(vertex, m_position_offset, inverse_scale);
+                    hasher.add(&compressed, sizeof(compressed));
+                }
+            }
+
+            if (uses_16_bit_indices())
+            {
+                hash_triangles<uint16_t>(hasher, m_triangles);
+                hash_triangles<uint16_t>(hasher, m_lod_triangles);
+            }
+            else
+            {
+                hasher.add(m_triangles.data(), m_triangles.size() * sizeof(Triangle));
+                hasher.add(m_lod_triangles.data(), m_lod_triangles.size() * sizeof(Triangle));
+            }
+        }
+
+        // 0 is kept as an invalid value
+        return hasher.hash != 0 ? hasher.hash : 1;
+    }
+} // namespace rg
@@ -0,0 +1,361 @@
+#include "railguard/core/mesh.h"
+
+#include <railguard/utils/array.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rg
+{
+    namespace
+    {
+        constexpr uint32_t NO_VERTEX = ~0u;
+
+        // Parameters of the vertex cache optimization, from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+        constexpr uint32_t FORSYTH_CACHE_SIZE        = 32;
+        constexpr float    FORSYTH_LAST_TRIANGLE     = 0.75f;
+        constexpr float    FORSYTH_CACHE_DECAY       = 1.5f;
+        constexpr float    FORSYTH_VALENCE_SCALE     = 2.0f;
+        constexpr float    FORSYTH_VALENCE_POWER     = 0.5f;
+        constexpr uint32_t FORSYTH_MAX_CACHE_ENTRIES = FORSYTH_CACHE_SIZE + 3;
+
+        /** Hashes the bytes of a vertex, so that identical vertices are found in a single pass. */
+        inline uint32_t hash_vertex(const Vertex &vertex)
+        {
+            uint32_t words[sizeof(Vertex) / sizeof(uint32_t)];
+            std::memcpy(words, &vertex, sizeof(Vertex));
+
+            // MurmurHash2 over the words of the vertex
+            constexpr uint32_t m    = 0x5bd1e995;
+            uint32_t           hash = 0;
+            for (auto word : words)
+            {
+                word *= m;
+                word ^= word >> 24;
+                word *= m;
+                hash *= m;
+                hash ^= word;
+            }
+            return hash;
+        }
+
+        /**
+         * Score of a vertex: high when it is in the cache, so that its triangles reuse it, and when few triangles still use it, so
+         * that it does not need to be loaded again later.
+         */
+        inline float vertex_score(int32_t cache_position, uint32_t remaining_triangles)
+        {
+            if (remaining_triangles == 0)
+            {
+                return -1.0f;
+            }
+
+            float score = 0.0f;
+            if (cache_position >= 0)
+            {
+                if (cache_position < 3)
+                {
+                    // The vertices of the last triangle get a fixed score, otherwise the strips would go back and forth
+                    score = FORSYTH_LAST_TRIANGLE;
+                }
+                else
+                {
+                    constexpr float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+                    score = std::pow(1.0f - static_cast<float>(cache_position - 3) * scaler, FORSYTH_CACHE_DECAY);
+                }
+            }
+
+            return score + FORSYTH_VALENCE_SCALE * std::pow(static_cast<float>(remaining_triangles), -FORSYTH_VALENCE_POWER);
+        }
+    } // namespace
+
+    void MeshPart::optimize_triangle_order(Triangle *triangles, size_t triangle_count, size_t vertex_count)
+    {
+        if (triangle_count < 2)
+        {
+            return;
+        }
+
+        // Adjacency: for each vertex, the triangles that use it. The first "remaining" ones are not emitted yet.
+        Array<uint32_t> adjacency_offsets(vertex_count + 1);
+        Array<uint32_t> remaining(vertex_count);
+        for (size_t t = 0; t < triangle_count; t++)
+        {
+            for (const auto index : triangles[t].index)
+            {
+                remaining[index]++;
+            }
+        }
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            adjacency_offsets[v + 1] = adjacency_offsets[v] + remaining[v];
+        }
+
+        Array<uint32_t> adjacency(triangle_count * 3);
+        {
+            Array<uint32_t> fill(vertex_count);
+            for (size_t t = 0; t < triangle_count; t++)
+            {
+                for (const auto index : triangles[t].index)
+                {
+                    adjacency[adjacency_offsets[index] + fill[index]++] = static_cast<uint32_t>(t);
+                }
+            }
+        }
+
+        Array<float> vertex_scores(vertex_count);
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            vertex_scores[v] = vertex_score(-1, remaining[v]);
+        }
+
+        Array<uint8_t> emitted(triangle_count);
+
+        // The cache is simulated as a LRU list. It is a bit bigger than the real one to see the vertices that just fell out of it.
+        uint32_t cache[FORSYTH_MAX_CACHE_ENTRIES];
+        uint32_t new_cache[FORSYTH_MAX_CACHE_ENTRIES];
+        uint32_t cache_size = 0;
+
+        Vector<Triangle> result(triangle_count);
+        size_t           next_unemitted = 0;
+        uint32_t         best_triangle  = 0;
+
+        while (result.size() < triangle_count)
+        {
+            // No triangle touches the cache: start again from the next triangle of the input order
+            if (best_triangle == NO_VERTEX)
+            {
+                while (emitted[next_unemitted])
+                {
+                    next_unemitted++;
+                }
+                best_triangle = static_cast<uint32_t>(next_unemitted);
+            }
+
+            const auto triangle = triangles[best_triangle];
+            result.push_back(triangle);
+            emitted[best_triangle] = 1;
+
+            // Remove the triangle from the adjacency of its vertices
+            for (const auto index : triangle.index)
+            {
+                auto *begin = adjacency.data() + adjacency_offsets[index];
+                auto *end   = begin + remaining[index];
+                auto *it    = std::find(begin, end, best_triangle);
+                std::swap(*it, *(end - 1));
+                remaining[index]--;
+            }
+
+            // Move the vertices of the triangle to the front of the cache
+            uint32_t new_cache_size = 0;
+            for (const auto index : triangle.index)
+            {
+                new_cache[new_cache_size++] = index;
+            }
+            for (uint32_t i = 0; i < cache_size; i++)
+            {
+                const auto index = cache[i];
+                if (index != triangle.index[0] && index != triangle.index[1] && index != triangle.index[2])
+                {
+                    if (new_cache_size < FORSYTH_MAX_CACHE_ENTRIES)
+                    {
+                        new_cache[new_cache_size++] = index;
+                    }
+                    else
+                    {
+                        // Pushed out of the cache
+                        vertex_scores[index] = vertex_score(-1, remaining[index]);
+                    }
+                }
+            }
+            std::copy(new_cache, new_cache + new_cache_size, cache);
+            cache_size = new_cache_size;
+
+            // Update the scores of the vertices in the cache
+            for (uint32_t i = 0; i < cache_size; i++)
+            {
+                const auto index     = cache[i];
+                const auto position  = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+                vertex_scores[index] = vertex_score(position, remaining[index]);
+            }
+
+            // Then the scores of their triangles, and find the best one for the next iteration
+            float best_score = -1.0f;
+            best_triangle    = NO_VERTEX;
+            for (uint32_t i = 0; i < cache_size; i++)
+            {
+                const auto index = cache[i];
+                const auto begin = adjacency_offsets[index];
+                for (uint32_t a = begin; a < begin + remaining[index]; a++)
+                {
+                    const auto  t        = adjacency[a];
+                    const auto &adjacent = triangles[t];
+                    const float score    = vertex_scores[adjacent.index[0]] + vertex_scores[adjacent.index[1]]
+                                      + vertex_scores[adjacent.index[2]];
+
+                    if (score > best_score)
+                    {
+                        best_score    = score;
+                        best_triangle = t;
+                    }
+                }
+            }
+        }
+
+        std::copy(result.data(), result.data() + triangle_count, triangles);
+    }
+
+    size_t MeshPart::deduplicate_vertices()
+    {
+        const auto vertex_count = m_vertices.size();
+        if (vertex_count == 0)
+        {
+            return 0;
+        }
+
+        // Open addressing hash table, with a power of two size at most half full
+        size_t table_size = 1;
+        while (table_size < vertex_count * 2)
+        {
+            table_size <<= 1;
+        }
+        Array<uint32_t> table(table_size);
+        std::fill(table.data(), table.data() + table_size, NO_VERTEX);
+
+        // Find the first occurrence of each vertex, and compact the unique ones at the front
+        Array<uint32_t> remap(vertex_count);
+        size_t          unique_count = 0;
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            const auto &vertex = m_vertices[v];
+            auto        slot   = hash_vertex(vertex) & (table_size - 1);
+
+            while (table[slot] != NO_VERTEX && std::memcmp(&m_vertices[table[slot]], &vertex, sizeof(Vertex)) != 0)
+            {
+                slot = (slot + 1) & (table_size - 1);
+            }
+
+            if (table[slot] == NO_VERTEX)
+            {
+                // New vertex. It can be moved in place since the unique ones are always before the current one.
+                m_vertices[unique_count] = vertex;
+                table[slot]              = static_cast<uint32_t>(unique_count++);
+            }
+            remap[v] = table[slot];
+        }
+
+        for (size_t v = unique_count; v < vertex_count; v++)
+        {
+            m_vertices.pop_back();
+        }
+
+        for (auto &triangle : m_triangles)
+        {
+            for (auto &index : triangle.index)
+            {
+                index = remap[index];
+            }
+        }
+        for (auto &triangle : m_lod_triangles)
+        {
+            for (auto &index : triangle.index)
+            {
+                index = remap[index];
+            }
+        }
+
+        return vertex_count - unique_count;
+    }
+
+    void MeshPart::optimize_vertex_cache()
+    {
+        // The triangles of cached parts are not available, and they were already optimized before being saved
+        if (is_cached())
+        {
+            return;
+        }
+
+        optimize_triangle_order(m_triangles.data(), m_triangles.size(), m_vertices.size());
+
+        // Each level is drawn on its own, so they are optimized separately
+        for (size_t level = 1; level < m_lods.size(); level++)
+        {
+            const auto first_triangle = m_lods[level].first_index / 3 - m_triangles.size();
+            optimize_triangle_order(m_lod_triangles.data() + first_triangle, m_lods[level].index_count / 3, m_vertices.size());
+        }
+    }
+
+    void MeshPart::optimize_vertex_fetch()
+    {
+        if (is_cached())
+        {
+            return;
+        }
+
+        const auto      vertex_count = m_vertices.size();
+        Array<uint32_t> remap(vertex_count);
+        std::fill(remap.data(), remap.data() + vertex_count, NO_VERTEX);
+
+        // Number the vertices in the order of their first use. The base level comes first since it is the most often drawn.
+        uint32_t next_index = 0;
+        auto     renumber   = [&](Vector<Triangle> &triangles)
+        {
+            for (auto &triangle : triangles)
+            {
+                for (auto &index : triangle.index)
+                {
+                    if (remap[index] == NO_VERTEX)
+                    {
+                        remap[index] = next_index++;
+                    }
+                    index = remap[index];
+                }
+            }
+        };
+        renumber(m_triangles);
+        renumber(m_lod_triangles);
+
+        Vector<Vertex> vertices(std::max<size_t>(next_index, 1));
+        for (uint32_t i = 0; i < next_index; i++)
+        {
+            vertices.push_back(Vertex {});
+        }
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            if (remap[v] != NO_VERTEX)
+            {
+                vertices[remap[v]] = m_vertices[v];
+            }
+        }
+        m_vertices = std::move(vertices);
+
+        // The unused vertices may have extended the bounds
+        compute_bounds();
+    }
+
+    float MeshPart::acmr(uint32_t cache_size) const
+    {
+        if (m_triangles.is_empty())
+        {
+            return 0.0f;
+        }
+
+        // FIFO cache: a vertex is still in it if less than cache_size vertices were loaded since it was
+        Array<size_t> load_times(m_vertices.size());
+        size_t        miss_count = 0;
+        for (const auto &triangle : m_triangles)
+        {
+            for (const auto index : triangle.index)
+            {
+                if (load_times[index] == 0 || miss_count - load_times[index] >= cache_size)
+                {
+                    miss_count++;
+                    load_times[index] = miss_count;
+                }
+            }
+        }
+
+        return static_cast<float>(miss_count) / static_cast<float>(m_triangles.size());
+    }
+} // namespace rg
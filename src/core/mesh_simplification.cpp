@@ -0,0 +1,573 @@
+#include "railguard/core/mesh.h"
+
+#include <railguard/utils/array.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <numeric>
+
+namespace rg
+{
+    namespace
+    {
+        constexpr uint32_t NO_VERTEX = ~0u;
+
+        /**
+         * Sum of squared distances to a set of planes, stored as a symmetric 4x4 matrix.
+         * Doubles are used because the terms of big meshes are accumulated over many collapses.
+         */
+        struct Quadric
+        {
+            double xx = 0.0, xy = 0.0, xz = 0.0, xw = 0.0;
+            double yy = 0.0, yz = 0.0, yw = 0.0;
+            double zz = 0.0, zw = 0.0;
+            double ww = 0.0;
+
+            static Quadric from_plane(const glm::vec3 &normal, float distance, double weight)
+            {
+                const double a = normal.x;
+                const double b = normal.y;
+                const double c = normal.z;
+                const double d = distance;
+
+                Quadric quadric;
+                quadric.xx = weight * a * a;
+                quadric.xy = weight * a * b;
+                quadric.xz = weight * a * c;
+                quadric.xw = weight * a * d;
+                quadric.yy = weight * b * b;
+                quadric.yz = weight * b * c;
+                quadric.yw = weight * b * d;
+                quadric.zz = weight * c * c;
+                quadric.zw = weight * c * d;
+                quadric.ww = weight * d * d;
+                return quadric;
+            }
+
+            inline Quadric &operator+=(const Quadric &other)
+            {
+                xx += other.xx;
+                xy += other.xy;
+                xz += other.xz;
+                xw += other.xw;
+                yy += other.yy;
+                yz += other.yz;
+                yw += other.yw;
+                zz += other.zz;
+                zw += other.zw;
+                ww += other.ww;
+                return *this;
+            }
+
+            [[nodiscard]] inline double evaluate(const glm::vec3 &point) const
+            {
+                const double x = point.x;
+                const double y = point.y;
+                const double z = point.z;
+
+                return x * (xx * x + 2.0 * (xy * y + xz * z + xw)) + y * (yy * y + 2.0 * (yz * z + yw)) + z * (zz * z + 2.0 * zw)
+                     + ww;
+            }
+        };
+
+        /** Candidate collapse of the vertex "from" into the vertex "to". */
+        struct Collapse
+        {
+            double   cost         = 0.0;
+            uint32_t from         = NO_VERTEX;
+            uint32_t to           = NO_VERTEX;
+            uint32_t from_version = 0;
+            uint32_t to_version   = 0;
+        };
+
+        /** Orders the heap of collapses so that the cheapest one is on top. */
+        inline bool is_more_expensive(const Collapse &a, const Collapse &b)
+        {
+            return a.cost > b.cost;
+        }
+
+        struct EdgeKey
+        {
+            uint64_t key      = 0;
+            uint32_t triangle = 0;
+        };
+
+        inline uint64_t make_edge_key(uint32_t a, uint32_t b)
+        {
+            return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+        }
+
+        /**
+         * State of the simplification of a mesh part.
+         *
+         * Vertices sharing the same position are welded first, so that the seams of the attributes don't prevent the collapses.
+         * A welded vertex is identified by the index of one of its vertices, and collapsing a vertex into another one only moves
+         * the triangles to an existing vertex. That way, the simplified levels can reuse the vertex buffer of the part.
+         */
+        class Simplifier
+        {
+          private:
+            const Vector<Vertex>   &m_vertices;
+            const Vector<Triangle> &m_triangles;
+
+            /** For each vertex, the welded vertex it belongs to. */
+            Array<uint32_t> m_welded;
+            /** Current welded vertices of the corners of each triangle. */
+            Array<uint32_t> m_corners;
+            Array<uint8_t>  m_alive_triangles;
+            size_t          m_alive_triangle_count = 0;
+
+            /** Triangles around each welded vertex in the original mesh, as offsets in m_adjacency. */
+            Array<uint32_t> m_adjacency_offsets;
+            Array<uint32_t> m_adjacency;
+            /**
+             * The welded vertices collapsed into another one are chained after it, so that the triangles around a vertex are the
+             * ones around each vertex of its chain.
+             */
+            Array<uint32_t> m_next_in_chain;
+            Array<uint32_t> m_last_in_chain;
+
+            Array<Quadric>   m_quadrics;
+            Array<uint32_t>  m_versions;
+            Array<uint8_t>   m_removed;
+            Vector<Collapse> m_heap {64};
+
+            /** Biggest cost of the collapses done so far. */
+            double m_max_cost = 0.0;
+
+            [[nodiscard]] inline const glm::vec3 &position(uint32_t vertex) const
+            {
+                return m_vertices[vertex].position;
+            }
+
+            /** Calls the function for each alive triangle around the welded vertex. */
+            template<typename F>
+            void for_each_triangle(uint32_t vertex, F &&function) const
+            {
+                for (auto member = vertex; member != NO_VERTEX; member = m_next_in_chain[member])
+                {
+                    for (auto i = m_adjacency_offsets[member]; i < m_adjacency_offsets[member + 1]; i++)
+                    {
+                        const auto triangle = m_adjacency[i];
+                        if (m_alive_triangles[triangle])
+                        {
+                            function(triangle);
+                        }
+                    }
+                }
+            }
+
+            void weld_vertices();
+            void build_adjacency();
+            void compute_quadrics();
+            void push_candidate(uint32_t a, uint32_t b);
+            [[nodiscard]] bool is_collapse_valid(uint32_t from, uint32_t to) const;
+            void               collapse(uint32_t from, uint32_t to);
+
+          public:
+            Simplifier(const Vector<Vertex> &vertices, const Vector<Triangle> &triangles);
+
+            /**
+             * Collapses edges until there are at most target_triangle_count triangles left, or until no collapse is possible.
+             */
+            void simplify(size_t target_triangle_count);
+
+            /** Appends the alive triangles to the given vector, with the indices of the original vertices. */
+            void write_triangles(Vector<Triangle> &triangles) const;
+
+            [[nodiscard]] inline size_t alive_triangle_count() const
+            {
+                return m_alive_triangle_count;
+            }
+
+            /** The costs are sums of squared distances, so the root of the biggest one approximates the distance to the original. */
+            [[nodiscard]] inline float error() const
+            {
+                return static_cast<float>(std::sqrt(std::max(m_max_cost, 0.0)));
+            }
+        };
+
+        Simplifier::Simplifier(const Vector<Vertex> &vertices, const Vector<Triangle> &triangles)
+            : m_vertices(vertices),
+              m_triangles(triangles),
+              m_welded(vertices.size()),
+              m_corners(triangles.size() * 3),
+              m_alive_triangles(triangles.size()),
+              m_adjacency_offsets(vertices.size() + 1),
+              m_next_in_chain(vertices.size()),
+              m_last_in_chain(vertices.size()),
+              m_quadrics(vertices.size()),
+              m_versions(vertices.size()),
+              m_removed(vertices.size())
+        {
+            weld_vertices();
+            build_adjacency();
+            compute_quadrics();
+        }
+
+        void Simplifier::weld_vertices()
+        {
+            const auto vertex_count = m_vertices.size();
+
+            // Sort the vertices by position to find the ones at the same place
+            Array<uint32_t> sorted(vertex_count);
+            std::iota(sorted.data(), sorted.data() + vertex_count, 0u);
+            std::sort(sorted.data(),
+                      sorted.data() + vertex_count,
+                      [this](uint32_t a, uint32_t b)
+                      {
+                          const auto &pa = position(a);
+                          const auto &pb = position(b);
+                          if (pa.x != pb.x)
+                          {
+                              return pa.x < pb.x;
+                          }
+                          if (pa.y != pb.y)
+                          {
+                              return pa.y < pb.y;
+                          }
+                          return pa.z < pb.z;
+                      });
+
+            for (size_t i = 0; i < vertex_count; i++)
+            {
+                const auto vertex = sorted[i];
+                if (i > 0 && position(vertex) == position(sorted[i - 1]))
+                {
+                    m_welded[vertex] = m_welded[sorted[i - 1]];
+                }
+                else
+                {
+                    m_welded[vertex] = vertex;
+                }
+
+                m_next_in_chain[vertex] = NO_VERTEX;
+                m_last_in_chain[vertex] = vertex;
+            }
+        }
+
+        void Simplifier::build_adjacency()
+        {
+            // Triangles that become degenerate once the vertices are welded are ignored by the simplified levels
+            for (size_t triangle = 0; triangle < m_triangles.size(); triangle++)
+            {
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    m_corners[triangle * 3 + corner] = m_welded[m_triangles[triangle].index[corner]];
+                }
+
+                const auto *corners = &m_corners[triangle * 3];
+                if (corners[0] != corners[1] && corners[1] != corners[2] && corners[2] != corners[0])
+                {
+                    m_alive_triangles[triangle] = 1;
+                    m_alive_triangle_count++;
+
+                    for (size_t corner = 0; corner < 3; corner++)
+                    {
+                        m_adjacency_offsets[corners[corner] + 1]++;
+                    }
+                }
+            }
+
+            // Prefix sum of the number of triangles around each vertex
+            for (size_t vertex = 0; vertex < m_vertices.size(); vertex++)
+            {
+                m_adjacency_offsets[vertex + 1] += m_adjacency_offsets[vertex];
+            }
+
+            m_adjacency = Array<uint32_t>(m_adjacency_offsets[m_vertices.size()]);
+            Array<uint32_t> fill_offsets(m_vertices.size());
+            for (size_t triangle = 0; triangle < m_triangles.size(); triangle++)
+            {
+                if (m_alive_triangles[triangle])
+                {
+                    for (size_t corner = 0; corner < 3; corner++)
+                    {
+                        const auto vertex = m_corners[triangle * 3 + corner];
+                        m_adjacency[m_adjacency_offsets[vertex] + fill_offsets[vertex]++] = static_cast<uint32_t>(triangle);
+                    }
+                }
+            }
+        }
+
+        void Simplifier::compute_quadrics()
+        {
+            // Collect the edges of the triangles. The ones used by a single triangle are on a border of the mesh.
+            Vector<EdgeKey> edges(m_alive_triangle_count * 3);
+            for (size_t triangle = 0; triangle < m_triangles.size(); triangle++)
+            {
+                if (!m_alive_triangles[triangle])
+                {
+                    continue;
+                }
+
+                const auto *corners = &m_corners[triangle * 3];
+                const auto &p0      = position(corners[0]);
+                const glm::vec3 normal = glm::cross(position(corners[1]) - p0, position(corners[2]) - p0);
+                const float     length = glm::length(normal);
+                if (length > 0.0f)
+                {
+                    // Each corner accumulates the plane of the triangle
+                    const glm::vec3 unit_normal = normal / length;
+                    const auto      quadric     = Quadric::from_plane(unit_normal, -glm::dot(unit_normal, p0), 1.0);
+                    for (size_t corner = 0; corner < 3; corner++)
+                    {
+                        m_quadrics[corners[corner]] += quadric;
+                    }
+                }
+
+                for (size_t corner = 0; corner < 3; corner++)
+                {
+                    edges.push_back(EdgeKey {
+                        .key      = make_edge_key(corners[corner], corners[(corner + 1) % 3]),
+                        .triangle = static_cast<uint32_t>(triangle),
+                    });
+                }
+            }
+
+            std::sort(edges.data(),
+                      edges.data() + edges.size(),
+                      [](const EdgeKey &a, const EdgeKey &b) { return a.key < b.key; });
+
+            // Border edges would shrink freely, since no plane holds them in place
+            // Add a plane perpendicular to the triangle along the edge, with a high weight
+            constexpr double border_weight = 10.0;
+            for (size_t i = 0; i < edges.size();)
+            {
+                size_t end = i + 1;
+                while (end < edges.size() && edges[end].key == edges[i].key)
+                {
+                    end++;
+                }
+
+                const auto a = static_cast<uint32_t>(edges[i].key >> 32);
+                const auto b = static_cast<uint32_t>(edges[i].key & 0xFFFFFFFF);
+                if (end - i == 1)
+                {
+                    const auto     *corners = &m_corners[edges[i].triangle * 3];
+                    const auto     &p0      = position(corners[0]);
+                    const glm::vec3 normal  = glm::cross(position(corners[1]) - p0, position(corners[2]) - p0);
+                    const glm::vec3 border  = glm::cross(position(b) - position(a), normal);
+                    const float     length  = glm::length(border);
+                    if (length > 0.0f)
+                    {
+                        const glm::vec3 unit_border = border / length;
+                        const auto quadric = Quadric::from_plane(unit_border, -glm::dot(unit_border, position(a)), border_weight);
+                        m_quadrics[a] += quadric;
+                        m_quadrics[b] += quadric;
+                    }
+                }
+
+                // Each edge is a first candidate
+                push_candidate(a, b);
+
+                i = end;
+            }
+        }
+
+        void Simplifier::push_candidate(uint32_t a, uint32_t b)
+        {
+            // Both directions keep one of the vertices, so only the cheapest one is considered
+            Quadric quadric = m_quadrics[a];
+            quadric += m_quadrics[b];
+
+            const double a_into_b = quadric.evaluate(position(b));
+            const double b_into_a = quadric.evaluate(position(a));
+
+            Collapse candidate;
+            if (a_into_b <= b_into_a)
+            {
+                candidate = Collapse {a_into_b, a, b, m_versions[a], m_versions[b]};
+            }
+            else
+            {
+                candidate = Collapse {b_into_a, b, a, m_versions[b], m_versions[a]};
+            }
+
+            m_heap.push_back(candidate);
+            std::push_heap(m_heap.data(), m_heap.data() + m_heap.size(), is_more_expensive);
+        }
+
+        bool Simplifier::is_collapse_valid(uint32_t from, uint32_t to) const
+        {
+            // Moving the triangles around "from" must not flip them
+            bool valid = true;
+            for_each_triangle(from,
+                              [&](uint32_t triangle)
+                              {
+                                  const auto *corners = &m_corners[triangle * 3];
+
+                                  // The triangles around the collapsed edge disappear
+                                  if (!valid || corners[0] == to || corners[1] == to || corners[2] == to)
+                                  {
+                                      return;
+                                  }
+
+                                  glm::vec3 old_positions[3];
+                                  glm::vec3 new_positions[3];
+                                  for (size_t corner = 0; corner < 3; corner++)
+                                  {
+                                      old_positions[corner] = position(corners[corner]);
+                                      new_positions[corner] = position(corners[corner] == from ? to : corners[corner]);
+                                  }
+
+                                  const auto old_normal =
+                                      glm::cross(old_positions[1] - old_positions[0], old_positions[2] - old_positions[0]);
+                                  const auto new_normal =
+                                      glm::cross(new_positions[1] - new_positions[0], new_positions[2] - new_positions[0]);
+                                  if (glm::dot(old_normal, new_normal) <= 0.0f)
+                                  {
+                                      valid = false;
+                                  }
+                              });
+            return valid;
+        }
+
+        void Simplifier::collapse(uint32_t from, uint32_t to)
+        {
+            // Move the triangles to the kept vertex, and remove the ones using both
+            for_each_triangle(from,
+                              [&](uint32_t triangle)
+                              {
+                                  auto *corners = &m_corners[triangle * 3];
+                                  if (corners[0] == to || corners[1] == to || corners[2] == to)
+                                  {
+                                      m_alive_triangles[triangle] = 0;
+                                      m_alive_triangle_count--;
+                                      return;
+                                  }
+
+                                  for (size_t corner = 0; corner < 3; corner++)
+                                  {
+                                      if (corners[corner] == from)
+                                      {
+                                          corners[corner] = to;
+                                      }
+                                  }
+                              });
+
+            // The triangles of "from" are now around "to"
+            m_next_in_chain[m_last_in_chain[to]] = from;
+            m_last_in_chain[to]                  = m_last_in_chain[from];
+
+            m_quadrics[to] += m_quadrics[from];
+            m_removed[from] = 1;
+            m_versions[from]++;
+            m_versions[to]++;
+
+            // The costs of the edges around the kept vertex changed
+            for_each_triangle(to,
+                              [&](uint32_t triangle)
+                              {
+                                  const auto *corners = &m_corners[triangle * 3];
+                                  for (size_t corner = 0; corner < 3; corner++)
+                                  {
+                                      if (corners[corner] != to)
+                                      {
+                                          push_candidate(to, corners[corner]);
+                                      }
+                                  }
+                              });
+        }
+
+        void Simplifier::simplify(size_t target_triangle_count)
+        {
+            while (m_alive_triangle_count > target_triangle_count && !m_heap.is_empty())
+            {
+                std::pop_heap(m_heap.data(), m_heap.data() + m_heap.size(), is_more_expensive);
+                const auto candidate = m_heap.last();
+                m_heap.pop_back();
+
+                // The candidate is outdated if one of its vertices changed since it was pushed
+                if (m_removed[candidate.from] || m_removed[candidate.to] || m_versions[candidate.from] != candidate.from_version
+                    || m_versions[candidate.to] != candidate.to_version)
+                {
+                    continue;
+                }
+
+                if (!is_collapse_valid(candidate.from, candidate.to))
+                {
+                    continue;
+                }
+
+                m_max_cost = std::max(m_max_cost, candidate.cost);
+                collapse(candidate.from, candidate.to);
+            }
+        }
+
+        void Simplifier::write_triangles(Vector<Triangle> &triangles) const
+        {
+            triangles.ensure_capacity(triangles.size() + m_alive_triangle_count);
+
+            for (size_t triangle = 0; triangle < m_triangles.size(); triangle++)
+            {
+                if (m_alive_triangles[triangle])
+                {
+                    // Keep the original vertex when the corner didn't move, to keep its attributes
+                    // Otherwise, use the vertex into which it was collapsed
+                    Triangle result {0, 0, 0};
+                    for (size_t corner = 0; corner < 3; corner++)
+                    {
+                        const auto original = m_triangles[triangle].index[corner];
+                        const auto current  = m_corners[triangle * 3 + corner];
+                        result.index[corner] = m_welded[original] == current ? original : current;
+                    }
+                    triangles.push_back(result);
+                }
+            }
+        }
+    } // namespace
+
+    void MeshPart::generate_lods(uint32_t lod_count, float triangle_ratio)
+    {
+        // The triangles of cached parts are not available
+        if (is_cached())
+        {
+            return;
+        }
+
+        // Only keep the base level
+        m_lod_triangles.clear();
+        while (m_lods.size() > 1)
+        {
+            m_lods.pop_back();
+        }
+
+        lod_count = std::min(lod_count, MAX_MESH_LOD_COUNT);
+        if (lod_count <= 1 || m_triangles.is_empty())
+        {
+            return;
+        }
+
+        // Each level continues the simplification of the previous one
+        Simplifier simplifier(m_vertices, m_triangles);
+        size_t     previous_triangle_count = simplifier.alive_triangle_count();
+
+        for (uint32_t level = 1; level < lod_count; level++)
+        {
+            simplifier.simplify(static_cast<size_t>(static_cast<float>(previous_triangle_count) * triangle_ratio));
+
+            // Stop when the simplification stalls, the level would cost almost as much as the previous one
+            constexpr float min_reduction  = 0.9f;
+            const auto      triangle_count = simplifier.alive_triangle_count();
+            const float     max_count      = static_cast<float>(previous_triangle_count) * min_reduction;
+            if (triangle_count == 0 || static_cast<float>(triangle_count) > max_count)
+            {
+                break;
+            }
+
+            const auto first_lod_triangle = m_lod_triangles.size();
+            const auto first_triangle     = m_triangles.size() + first_lod_triangle;
+            simplifier.write_triangles(m_lod_triangles);
+            optimize_triangle_order(m_lod_triangles.data() + first_lod_triangle, triangle_count, m_vertices.size());
+            m_lods.push_back(MeshLod {
+                .first_index = static_cast<uint32_t>(first_triangle * 3),
+                .index_count = static_cast<uint32_t>(triangle_count * 3),
+                .error       = simplifier.error(),
+            });
+
+            previous_triangle_count = triangle_count;
+        }
+    }
+} // namespace rg
@@ -0,0 +1,543 @@
+#include "railguard/core/obj_parser.h"
+
+#include <railguard/utils/io.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+namespace rg
+{
+    namespace
+    {
+        /** Under this size per thread, starting more threads would cost more than it saves. */
+        constexpr size_t OBJ_MIN_CHUNK_SIZE = 256 * 1024;
+
+        constexpr uint32_t OBJ_POSITION  = 0;
+        constexpr uint32_t OBJ_TEX_COORD = 1;
+        constexpr uint32_t OBJ_NORMAL    = 2;
+        /** Value of the index of an attribute that a corner doesn't have. */
+        constexpr int32_t OBJ_MISSING_INDEX = -1;
+
+        /**
+         * Corner of a face, with the indices of its position, texture coordinates and normal.
+         * Absolute indices are stored from 0. Relative ones can only be resolved once the number of elements in the previous chunks
+         * is known, so they are stored relatively to the start of the chunk, and flagged in the relative mask.
+         */
+        struct ObjCorner
+        {
+            int32_t  index[3];
+            uint32_t relative_mask;
+        };
+
+        /** Part of the file parsed by a thread. */
+        struct ObjChunk
+        {
+            const char *begin = nullptr;
+            const char *end   = nullptr;
+
+            Vector<glm::vec3> positions {64};
+            Vector<glm::vec3> normals {64};
+            Vector<glm::vec2> tex_coords {64};
+            // Three corners per triangle
+            Vector<ObjCorner> corners {64};
+            // Index of the first triangle of each shape starting in the chunk
+            Vector<size_t> shape_starts = Vector<size_t>(4);
+
+            // Number of elements in the previous chunks
+            size_t position_offset  = 0;
+            size_t normal_offset    = 0;
+            size_t tex_coord_offset = 0;
+            size_t corner_offset    = 0;
+
+            /** Static description of the first problem found in the chunk, or nullptr. */
+            const char *error = nullptr;
+        };
+
+        /** Calls function(i) for i in [0, count[, each on its own thread. The first one runs on the calling thread. */
+        template<typename Function>
+        void run_parallel(size_t count, const Function &function)
+        {
+            Vector<std::thread> threads(count);
+            for (size_t i = 1; i < count; i++)
+            {
+                threads.push_back(std::thread(function, i));
+            }
+            function(0);
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        inline bool is_blank(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        inline void skip_blanks(const char *&it, const char *end)
+        {
+            while (it < end && is_blank(*it))
+            {
+                it++;
+            }
+        }
+
+        inline bool parse_float(const char *&it, const char *end, float &value)
+        {
+            skip_blanks(it, end);
+            // from_chars doesn't accept the plus sign
+            if (it < end && *it == '+')
+            {
+                it++;
+            }
+
+            const auto result = std::from_chars(it, end, value);
+            if (result.ec != std::errc())
+            {
+                return false;
+            }
+            it = result.ptr;
+            return true;
+        }
+
+        inline bool parse_int(const char *&it, const char *end, int32_t &value)
+        {
+            const bool negative = it < end && *it == '-';
+            if (negative)
+            {
+                it++;
+            }
+            if (it >= end || *it < '0' || *it > '9')
+            {
+                return false;
+            }
+
+            int64_t result = 0;
+            while (it < end && *it >= '0' && *it <= '9' && result <= INT32_MAX)
+            {
+                result = result * 10 + (*it++ - '0');
+            }
+            if (result > INT32_MAX)
+            {
+                return false;
+            }
+
+            value = static_cast<int32_t>(negative ? -result : result);
+            return true;
+        }
+
+        /** Parses a corner of a face: "v", "v/vt", "v//vn" or "v/vt/vn". */
+        bool parse_corner(const char *&it, const char *end, const ObjChunk &chunk, ObjCorner &corner)
+        {
+            const size_t chunk_counts[3] = {chunk.positions.size(), chunk.tex_coords.size(), chunk.normals.size()};
+
+            corner = {{OBJ_MISSING_INDEX, OBJ_MISSING_INDEX, OBJ_MISSING_INDEX}, 0};
+            for (uint32_t attribute = OBJ_POSITION; attribute <= OBJ_NORMAL; attribute++)
+            {
+                if (attribute != OBJ_POSITION)
+                {
+                    // The attributes are separated by slashes. Nothing after a missing slash.
+                    if (it >= end || *it != '/')
+                    {
+                        break;
+                    }
+                    it++;
+                    // The texture coordinates can be empty ("v//vn")
+                    if (it < end && *it == '/')
+                    {
+                        continue;
+                    }
+                }
+
+                int32_t value = 0;
+                if (!parse_int(it, end, value) || value == 0)
+                {
+                    return false;
+                }
+
+                if (value > 0)
+                {
+                    // Indices of the file start at 1
+                    corner.index[attribute] = value - 1;
+                }
+                else
+                {
+                    // Relative to the last element defined before the face
+                    corner.index[attribute] = static_cast<int32_t>(chunk_counts[attribute]) + value;
+                    corner.relative_mask |= 1u << attribute;
+                }
+            }
+            return true;
+        }
+
+        void parse_chunk(ObjChunk &chunk)
+        {
+            const char *it = chunk.begin;
+            while (it < chunk.end)
+            {
+                const char *line_end = static_cast<const char *>(std::memchr(it, '\n', chunk.end - it));
+                if (line_end == nullptr)
+                {
+                    line_end = chunk.end;
+                }
+
+                skip_blanks(it, line_end);
+                const auto remaining = line_end - it;
+                if (remaining >= 2 && it[0] == 'v' && is_blank(it[1]))
+                {
+                    // Extra values (w, vertex colors) are ignored
+                    it += 2;
+                    glm::vec3 position;
+                    if (!parse_float(it, line_end, position.x) || !parse_float(it, line_end, position.y)
+                        || !parse_float(it, line_end, position.z))
+                    {
+                        chunk.error = "invalid position";
+                        return;
+                    }
+                    chunk.positions.push_back(position);
+                }
+                else if (remaining >= 3 && it[0] == 'v' && it[1] == 'n' && is_blank(it[2]))
+                {
+                    it += 3;
+                    glm::vec3 normal;
+                    if (!parse_float(it, line_end, normal.x) || !parse_float(it, line_end, normal.y)
+                        || !parse_float(it, line_end, normal.z))
+                    {
+                        chunk.error = "invalid normal";
+                        return;
+                    }
+                    chunk.normals.push_back(normal);
+                }
+                else if (remaining >= 3 && it[0] == 'v' && it[1] == 't' && is_blank(it[2]))
+                {
+                    it += 3;
+                    glm::vec2 tex_coord(0.0f);
+                    if (!parse_float(it, line_end, tex_coord.x))
+                    {
+                        chunk.error = "invalid texture coordinates";
+                        return;
+                    }
+                    // The second coordinate is optional
+                    parse_float(it, line_end, tex_coord.y);
+                    chunk.tex_coords.push_back(tex_coord);
+                }
+                else if (remaining >= 2 && it[0] == 'f' && is_blank(it[1]))
+                {
+                    it += 2;
+
+                    // Split the polygon in a fan around its first corner
+                    ObjCorner first        = {};
+                    ObjCorner previous     = {};
+                    size_t    corner_count = 0;
+                    while (true)
+                    {
+                        skip_blanks(it, line_end);
+                        if (it >= line_end)
+                        {
+                            break;
+                        }
+
+                        ObjCorner corner = {};
+                        if (!parse_corner(it, line_end, chunk, corner) || (it < line_end && !is_blank(*it)))
+                        {
+                            chunk.error = "invalid face";
+                            return;
+                        }
+
+                        if (corner_count == 0)
+                        {
+                            first = corner;
+                        }
+                        else if (corner_count >= 2)
+                        {
+                            chunk.corners.push_back(first);
+                            chunk.corners.push_back(previous);
+                            chunk.corners.push_back(corner);
+                        }
+                        previous = corner;
+                        corner_count++;
+                    }
+
+                    if (corner_count < 3)
+                    {
+                        chunk.error = "face with less than 3 vertices";
+                        return;
+                    }
+                }
+
+                else if (remaining >= 1 && (it[0] == 'o' || it[0] == 'g') && (remaining == 1 || is_blank(it[1])))
+                {
+                    // Objects and groups are handled the same way. The names are not needed.
+                    chunk.shape_starts.push_back(chunk.corners.size() / 3);
+                }
+
+                // Other statements are ignored
+                it = line_end + 1;
+            }
+        }
+
+        /**
+         * Converts the indices of a corner to indices in the whole file, now that the offsets of the chunk are known.
+         * Returns false if one of them is out of range.
+         */
+        bool resolve_corner(ObjCorner &corner, const ObjChunk &chunk, const size_t counts[3])
+        {
+            const size_t offsets[3] = {chunk.position_offset, chunk.tex_coord_offset, chunk.normal_offset};
+            for (uint32_t attribute = OBJ_POSITION; attribute <= OBJ_NORMAL; attribute++)
+            {
+                // A relative index may be equal to the missing value before being resolved
+                auto       value    = static_cast<int64_t>(corner.index[attribute]);
+                const bool relative = (corner.relative_mask & (1u << attribute)) != 0;
+                if (value == OBJ_MISSING_INDEX && !relative)
+                {
+                    continue;
+                }
+
+                if (relative)
+                {
+                    value += static_cast<int64_t>(offsets[attribute]);
+                }
+                if (value < 0 || value >= static_cast<int64_t>(counts[attribute]))
+                {
+                    return false;
+                }
+                corner.index[attribute] = static_cast<int32_t>(value);
+            }
+
+            corner.relative_mask = 0;
+            return true;
+        }
+
+        /** Copies the stream of a chunk after the ones of the previous chunks. */
+        template<typename T>
+        inline void merge_stream(Vector<T> &result, const Vector<T> &stream, size_t offset)
+        {
+            if (!stream.is_empty())
+            {
+                std::memcpy(result.data() + offset, stream.data(), stream.size() * sizeof(T));
+            }
+        }
+    } // namespace
+
+    bool parse_obj(const char *path, ObjImportMode mode, ObjGeometry &geometry, std::string &error, uint32_t thread_count)
+    {
+        MappedFile file(path);
+        if (!file.is_valid())
+        {
+            error = std::string("unable to map ") + path + ", the file is missing or empty";
+            return false;
+        }
+        const auto *data = static_cast<const char *>(file.data());
+        const auto  size = file.size();
+
+        if (thread_count == 0)
+        {
+            thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        const size_t chunk_count = std::clamp<size_t>(size / OBJ_MIN_CHUNK_SIZE, 1, thread_count);
+
+        // Split the file at line boundaries
+        Vector<ObjChunk> chunks(chunk_count);
+        const char      *chunk_begin = data;
+        for (size_t i = 0; i < chunk_count; i++)
+        {
+            const char *chunk_end = data + size;
+            if (i + 1 < chunk_count)
+            {
+                chunk_end = std::max(chunk_begin, data + size * (i + 1) / chunk_count);
+                chunk_end = static_cast<const char *>(std::memchr(chunk_end, '\n', data + size - chunk_end));
+                chunk_end = chunk_end == nullptr ? data + size : chunk_end + 1;
+            }
+
+            ObjChunk chunk;
+            chunk.begin = chunk_begin;
+            chunk.end   = chunk_end;
+            chunks.push_back(std::move(chunk));
+            chunk_begin = chunk_end;
+        }
+
+        // Parse every chunk on its own
+        run_parallel(chunk_count, [&](size_t i) { parse_chunk(chunks[i]); });
+
+        // Now that the sizes are known, place the chunks in the merged streams
+        size_t position_count  = 0;
+        size_t normal_count    = 0;
+        size_t tex_coord_count = 0;
+        size_t corner_count    = 0;
+        for (auto &chunk : chunks)
+        {
+            if (chunk.error != nullptr)
+            {
+                error = std::string(path) + ": " + chunk.error;
+                return false;
+            }
+
+            chunk.position_offset  = position_count;
+            chunk.normal_offset    = normal_count;
+            chunk.tex_coord_offset = tex_coord_count;
+            chunk.corner_offset    = corner_count;
+            position_count += chunk.positions.size();
+            normal_count += chunk.normals.size();
+            tex_coord_count += chunk.tex_coords.size();
+            corner_count += chunk.corners.size();
+        }
+
+        // The indices are stored on 32 bits
+        if (std::max({position_count, normal_count, tex_coord_count, corner_count}) > INT32_MAX)
+        {
+            error = std::string(path) + ": too many vertices";
+            return false;
+        }
+
+        Vector<glm::vec3> positions(std::max<size_t>(position_count, 1));
+        Vector<glm::vec3> normals(std::max<size_t>(normal_count, 1));
+        Vector<glm::vec2> tex_coords(std::max<size_t>(tex_coord_count, 1));
+        positions.push_uninitialized(position_count);
+        normals.push_uninitialized(normal_count);
+        tex_coords.push_uninitialized(tex_coord_count);
+
+        const bool shared_positions = mode == ObjImportMode::SHARED_POSITIONS;
+        geometry.vertices           = Vector<Vertex>(std::max<size_t>(shared_positions ? position_count : corner_count, 1));
+        geometry.triangles          = Vector<Triangle>(std::max<size_t>(corner_count / 3, 1));
+        auto *vertices              = geometry.vertices.push_uninitialized(shared_positions ? position_count : corner_count);
+        auto *triangles             = geometry.triangles.push_uninitialized(corner_count / 3);
+
+        // Merge the attributes
+        run_parallel(chunk_count,
+                     [&](size_t i)
+                     {
+                         const auto &chunk = chunks[i];
+                         merge_stream(positions, chunk.positions, chunk.position_offset);
+                         merge_stream(normals, chunk.normals, chunk.normal_offset);
+                         merge_stream(tex_coords, chunk.tex_coords, chunk.tex_coord_offset);
+                     });
+
+        // Then build the vertices and triangles of each chunk in place
+        const size_t counts[3] = {position_count, tex_coord_count, normal_count};
+        run_parallel(chunk_count,
+                     [&](size_t i)
+                     {
+                         auto &chunk = chunks[i];
+                         for (size_t c = 0; c < chunk.corners.size(); c++)
+                         {
+                             auto &corner = chunk.corners[c];
+                             if (!resolve_corner(corner, chunk, counts))
+                             {
+                                 chunk.error = "index out of range";
+                                 return;
+                             }
+
+                             if (!shared_positions)
+                             {
+                                 // Optional attributes are zero when missing
+                                 Vertex vertex = {
+                                     .position  = positions.data()[corner.index[OBJ_POSITION]],
+                                     .normal    = glm::vec3(0.0f),
+                                     .tex_coord = glm::vec2(0.0f),
+                                 };
+                                 if (corner.index[OBJ_NORMAL] != OBJ_MISSING_INDEX)
+                                 {
+                                     vertex.normal = normals.data()[corner.index[OBJ_NORMAL]];
+                                 }
+                                 if (corner.index[OBJ_TEX_COORD] != OBJ_MISSING_INDEX)
+                                 {
+                                     const auto &tex_coord = tex_coords.data()[corner.index[OBJ_TEX_COORD]];
+                                     vertex.tex_coord      = glm::vec2(tex_coord.x, 1 - tex_coord.y);
+                                 }
+                                 vertices[chunk.corner_offset + c] = vertex;
+                             }
+                         }
+
+                         for (size_t t = 0; t < chunk.corners.size() / 3; t++)
+                         {
+                             const auto *corners  = chunk.corners.data() + t * 3;
+                             auto       &triangle = triangles[chunk.corner_offset / 3 + t];
+                             if (shared_positions)
+                             {
+                                 triangle = Triangle(corners[0].index[OBJ_POSITION],
+                                                     corners[1].index[OBJ_POSITION],
+                                                     corners[2].index[OBJ_POSITION]);
+                             }
+                             else
+                             {
+                                 const auto first_vertex = static_cast<uint32_t>(chunk.corner_offset + t * 3);
+                                 triangle                = Triangle(first_vertex, first_vertex + 1, first_vertex + 2);
+                             }
+                         }
+                     });
+
+        for (const auto &chunk : chunks)
+        {
+            if (chunk.error != nullptr)
+            {
+                error = std::string(path) + ": " + chunk.error;
+                return false;
+            }
+        }
+
+        // Shapes may span several chunks: only their starts are known
+        const auto triangle_count = static_cast<uint32_t>(corner_count / 3);
+        geometry.shapes           = Vector<ObjShape>(8);
+        uint32_t shape_start      = 0;
+        auto     end_shape        = [&](uint32_t next_start)
+        {
+            if (next_start > shape_start)
+            {
+                geometry.shapes.push_back(ObjShape {
+                    .first_triangle = shape_start,
+                    .triangle_count = next_start - shape_start,
+                });
+            }
+            shape_start = next_start;
+        };
+        for (const auto &chunk : chunks)
+        {
+            for (const auto start : chunk.shape_starts)
+            {
+                end_shape(static_cast<uint32_t>(chunk.corner_offset / 3 + start));
+            }
+        }
+        end_shape(triangle_count);
+
+        if (shared_positions)
+        {
+            // One vertex per position. The other attributes are the ones of the last face using the position.
+            run_parallel(chunk_count,
+                         [&](size_t i)
+                         {
+                             const auto &chunk = chunks[i];
+                             for (size_t p = 0; p < chunk.positions.size(); p++)
+                             {
+                                 vertices[chunk.position_offset + p] = Vertex {
+                                     .position  = chunk.positions[p],
+                                     .normal    = glm::vec3(0.0f),
+                                     .tex_coord = glm::vec2(0.0f),
+                                 };
+                             }
+                         });
+
+            // Faces of a chunk may reference the positions of any chunk: this part stays in the order of the file
+            for (const auto &chunk : chunks)
+            {
+                for (const auto &corner : chunk.corners)
+                {
+                    auto &vertex = vertices[corner.index[OBJ_POSITION]];
+                    if (corner.index[OBJ_NORMAL] != OBJ_MISSING_INDEX)
+                    {
+                        vertex.normal = normals.data()[corner.index[OBJ_NORMAL]];
+                    }
+                    if (corner.index[OBJ_TEX_COORD] != OBJ_MISSING_INDEX)
+                    {
+                        const auto &tex_coord = tex_coords.data()[corner.index[OBJ_TEX_COORD]];
+                        vertex.tex_coord      = glm::vec2(tex_coord.x, 1 - tex_coord.y);
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+} // namespace rg
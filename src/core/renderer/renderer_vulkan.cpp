@@ -3,17 +3,31 @@
 #include <railguard/core/mesh.h>
 #include <railguard/core/renderer/gpu_structs.h>
 #include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/texture.h>
 #include <railguard/core/window.h>
 #include <railguard/utils/array.h>
 #include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/aabb.h>
+#include <railguard/utils/geometry/bvh.h>
+#include <railguard/utils/geometry/frustum.h>
+#include <railguard/utils/geometry/ray.h>
 #include <railguard/utils/geometry/transform.h>
 #include <railguard/utils/io.h>
+#include <railguard/utils/range_allocator.h>
 #include <railguard/utils/storage.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstring>
+#include <future>
+#include <glm/common.hpp>
 #include <glm/ext/matrix_clip_space.hpp>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
 #include <iostream>
 #include <stb_image.h>
+#include <stb_image_target.h>
 #include <string>
 #include <volk.h>
 
@@ -35,6 +49,16 @@
 #define VULKAN_API_VERSION      VK_API_VERSION_1_2
 #define WAIT_FOR_FENCES_TIMEOUT 1000000000
 #define SEMAPHORE_TIMEOUT       1000000000
+// Maximum error of the selected levels of detail, in pixels, when the bias is 0
+#define LOD_ERROR_THRESHOLD 1.0f
+// Specialization constant of the vertex shaders in which the vertex format is given
+#define VERTEX_FORMAT_CONSTANT_ID 0
+// Alignment of the mesh parts in the vertex buffer, so that their first vertex is at a multiple of the stride of any format
+#define VERTEX_BUFFER_ALIGNMENT 32
+// Minimum size of the vertex and index buffers. When they are full, their size is doubled.
+#define MESH_BUFFER_MIN_SIZE (4 * 1024 * 1024)
+// Size of the staging ring through which the uploads go. Bigger uploads get their own staging buffer.
+#define STAGING_RING_SIZE (32 * 1024 * 1024)
 
 namespace rg
 {
@@ -49,6 +73,8 @@ namespace rg
         VmaAllocation allocation = VK_NULL_HANDLE;
         VkBuffer      buffer     = VK_NULL_HANDLE;
         uint32_t      size       = 0;
+        /** Pointer to the content of the buffer if it is persistently mapped, nullptr otherwise. */
+        void *mapped_data = nullptr;
 
         [[nodiscard]] inline bool is_valid() const
         {
@@ -70,6 +96,15 @@ namespace rg
         VkDevice     m_device                = VK_NULL_HANDLE;
         uint32_t     m_graphics_queue_family = 0;
         uint32_t     m_transfer_queue_family = 0;
+        // True when the main device-local heap can be written by the CPU: integrated GPUs, resizable BAR, software renderers
+        bool     m_has_host_visible_device_memory = false;
+        uint32_t m_main_heap_index                = 0;
+
+        [[nodiscard]] AllocatedBuffer create_buffer(size_t                         allocation_size,
+                                                    VkBufferUsageFlags             buffer_usage,
+                                                    const VmaAllocationCreateInfo &allocation_create_info,
+                                                    bool                           concurrent,
+                                                    bool                           persistently_mapped) const;
 
       public:
         Allocator() = default;
@@ -77,7 +112,8 @@ namespace rg
                   VkDevice         device,
                   VkPhysicalDevice physical_device,
                   uint32_t         graphics_queue_family,
-                  uint32_t         transfer_queue_family);
+                  uint32_t         transfer_queue_family,
+                  bool             uses_memory_budget);
         Allocator(Allocator &&other) noexcept;
         Allocator &operator=(Allocator &&other) noexcept;
 
@@ -88,16 +124,38 @@ namespace rg
                                                   VkImageUsageFlags  image_usage,
                                                   VkImageAspectFlags image_aspect,
                                                   VmaMemoryUsage     memory_usage,
-                                                  bool               concurrent = false) const;
+                                                  bool               concurrent = false,
+                                                  uint32_t           mip_levels = 1) const;
         void                         destroy_image(AllocatedImage &image) const;
 
         [[nodiscard]] AllocatedBuffer create_buffer(size_t             allocation_size,
                                                     VkBufferUsageFlags buffer_usage,
                                                     VmaMemoryUsage     memory_usage,
-                                                    bool               concurrent = false) const;
+                                                    bool               concurrent          = false,
+                                                    bool               persistently_mapped = false) const;
         void                          destroy_buffer(AllocatedBuffer &buffer) const;
         void                         *map_buffer(AllocatedBuffer &buffer) const;
         void                          unmap_buffer(AllocatedBuffer &buffer) const;
+        void                          flush_buffer(const AllocatedBuffer &buffer, size_t offset, size_t size) const;
+        void                          invalidate_buffer(const AllocatedBuffer &buffer, size_t offset, size_t size) const;
+
+        /**
+         * Creates a persistently mapped buffer in device-local memory, which the CPU can write directly without any staging.
+         * It can only be used when has_host_visible_device_memory returns true.
+         */
+        [[nodiscard]] AllocatedBuffer create_host_visible_device_buffer(size_t             allocation_size,
+                                                                        VkBufferUsageFlags buffer_usage,
+                                                                        bool               concurrent = false) const;
+        [[nodiscard]] inline bool     has_host_visible_device_memory() const
+        {
+            return m_has_host_visible_device_memory;
+        }
+
+        /**
+         * Returns the usage and the budget of the main device-local heap, in bytes. The budget is only an estimation if the
+         * VK_EXT_memory_budget extension isn't enabled.
+         */
+        [[nodiscard]] VmaBudget get_main_heap_budget() const;
     };
 
     // Material system
@@ -143,6 +201,91 @@ namespace rg
     {
         AllocatedImage image   = {};
         VkSampler      sampler = VK_NULL_HANDLE;
+        /** The materials using the texture are only drawn once it is uploaded. */
+        bool       is_resident = false;
+        uint32_t   mip_levels  = 1;
+        VkExtent3D extent      = {};
+        /** Format of the image on the GPU. It is the decoded format of the texels if the device doesn't support theirs. */
+        TextureFormat format = TextureFormat::RGBA8_SRGB;
+        /** Texels of all the levels of an encoded texture. Streamed textures keep them, the others release them once uploaded. */
+        TextureData *data = nullptr;
+
+        // Streaming
+        // The image of a streamed texture only contains the levels from first_resident_mip. When levels are streamed in or evicted,
+        // it is replaced by an image containing the levels from target_mip.
+        bool     is_streamed        = false;
+        uint32_t first_resident_mip = 0;
+        uint32_t target_mip         = 0;
+        /** The levels from this one are always resident. */
+        uint32_t initial_mip = 0;
+        /** Most detailed level needed by the visible objects, and resolution of the first level needed for it. */
+        uint32_t wanted_mip        = 0;
+        float    wanted_resolution = 0.0f;
+        /** Last frame in which an object using the texture was visible. */
+        uint64_t last_used_frame = 0;
+        /** Estimated GPU memory used by the levels from first_resident_mip and target_mip. */
+        size_t resident_size      = 0;
+        size_t target_size        = 0;
+        bool   has_pending_upload = false;
+        /** The image couldn't be decoded. The texture is never resident, so the materials using it aren't drawn. */
+        bool has_failed = false;
+        /** Index of the texture in the array of the bindless set. */
+        uint32_t bindless_slot = 0;
+    };
+
+    /**
+     * Decoding of an image by a worker thread, directly in a staging buffer reserved for it when the texture is loaded.
+     * The buffer is in host-cached memory, since the decoders read back the rows they already wrote.
+     */
+    struct ImageDecoding
+    {
+        std::string       path           = {};
+        AllocatedBuffer   staging_buffer = {};
+        std::future<bool> result         = {};
+    };
+
+    /** Levels of a texture waiting for their upload. Encoded textures already have the texels of all their levels. */
+    struct PendingTextureUpload
+    {
+        TextureId texture_id = NULL_ID;
+        // Decoding of an image, owned by the upload
+        ImageDecoding *decoding = nullptr;
+        size_t         size     = 0;
+        /** First level to upload. If the texture is already resident, its image is replaced by one starting at that level. */
+        uint32_t first_mip = 0;
+    };
+
+    /**
+     * Image of a destroyed texture. It is destroyed, and its slot is given back, when the frames and the transfers that may still use
+     * it are done.
+     * Images replaced by streaming are retired the same way, without sampler: their texture keeps its sampler and its slot.
+     */
+    struct RetiredTexture
+    {
+        AllocatedImage image;
+        VkSampler      sampler;
+        uint32_t       bindless_slot;
+        /** First frame recorded after the image stopped being used. */
+        uint64_t frame_number;
+        /** Value of the transfer timeline signaled by the last batch that may copy in the image. */
+        uint64_t transfer_value;
+    };
+
+    /** Image of a streamed texture replaced by one containing other levels. */
+    struct ReplacedTextureImage
+    {
+        TextureId      texture_id;
+        AllocatedImage image;
+        /** Frame in which it was replaced. The textures sets of each frame are updated at its next draw. */
+        uint64_t frame_number;
+    };
+
+    /** Generation of the mip levels of an uploaded texture from its first level, done by the graphics queue. */
+    struct MipGeneration
+    {
+        VkImage    image      = VK_NULL_HANDLE;
+        VkExtent3D extent     = {};
+        uint32_t   mip_levels = 1;
     };
 
     struct Material
@@ -152,21 +295,90 @@ namespace rg
         /** Models using this material */
         Vector<ModelId>         models_using_material = {};
         Array<Array<TextureId>> textures              = {};
-        Array<VkDescriptorSet>  textures_sets         = {};
+        /**
+         * Textures sets of each effect, one per overlapping frame: the sets of effect i are at i * NB_OVERLAPPING_FRAMES. When an
+         * image is replaced, the sets of a frame can then be updated without waiting for the others.
+         */
+        Array<VkDescriptorSet> textures_sets = {};
+        /** With bindless textures, offset of the slots of the textures of each effect in the material buffer. */
+        Array<uint32_t> texture_table_offsets = {};
     };
 
     struct StoredMeshPart
     {
+        /** CPU copy of the part. For GPU-resident only parts, it is replaced by an empty part once uploaded. */
         MeshPart mesh_part;
-        size_t   vertex_offset;
-        size_t   index_offset;
-        bool     is_uploaded;
-
-        explicit StoredMeshPart(MeshPart &&part) : mesh_part(std::move(part)), vertex_offset(0), index_offset(0), is_uploaded(false)
+        bool     gpu_resident_only;
+        /** See MeshPart::content_hash. Saving a part with the same content returns this one instead. */
+        uint64_t content_hash;
+        /** Number of saves of the content that weren't destroyed yet. */
+        uint32_t reference_count;
+        // Description of the part, kept after the upload so that the part can be drawn without its CPU copy
+        Vector<MeshLod> lods;
+        VertexFormat    vertex_format;
+        VkIndexType     index_type;
+        glm::vec3       position_offset;
+        float           position_scale;
+        // Ranges allocated for the part in the vertex and index buffers, in bytes
+        RangeAllocator::Range vertex_range;
+        RangeAllocator::Range index_range;
+        // Offsets in the vertex and index buffers, counted in vertices and indices of the formats of the part
+        size_t vertex_offset;
+        size_t index_offset;
+        bool   is_uploaded;
+        /** Bounds of the mesh part, in model space. */
+        AABB bounds;
+        /** Bounding sphere of the mesh part, in model space. xyz is the center and w the radius. */
+        glm::vec4 bounding_sphere;
+        /** See MeshPart::uv_density. */
+        float uv_density;
+        /**
+         * Transform from the space of the vertices in the vertex buffer to model space. It is included in the transforms of the
+         * objects sent to the GPU, so that the shaders don't need to know the format.
+         */
+        glm::mat4 dequantization;
+
+        StoredMeshPart(MeshPart &&part, uint64_t content_hash, bool gpu_resident_only)
+            : mesh_part(std::move(part)),
+              gpu_resident_only(gpu_resident_only),
+              content_hash(content_hash),
+              reference_count(1),
+              lods(mesh_part.lods()),
+              vertex_format(mesh_part.vertex_format()),
+              index_type(mesh_part.uses_16_bit_indices() ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32),
+              position_offset(mesh_part.position_offset()),
+              position_scale(mesh_part.position_scale()),
+              vertex_range(),
+              index_range(),
+              vertex_offset(0),
+              index_offset(0),
+              is_uploaded(false),
+              bounds(mesh_part.bounds()),
+              bounding_sphere(mesh_part.bounding_sphere()),
+              uv_density(mesh_part.uv_density()),
+              dequantization(position_scale)
         {
+            dequantization[3] = glm::vec4(position_offset, 1.0f);
         }
     };
 
+    /** Ranges of a destroyed mesh part. They are freed when the frames that may still draw the part are done. */
+    struct RetiredMeshRanges
+    {
+        RangeAllocator::Range vertex_range;
+        RangeAllocator::Range index_range;
+        /** First frame recorded after the part was destroyed. */
+        uint64_t frame_number;
+    };
+
+    /** Buffer replaced while frames in flight may still use it. It is destroyed when they are done. */
+    struct RetiredBuffer
+    {
+        AllocatedBuffer buffer;
+        /** First frame recorded with the new buffer. */
+        uint64_t frame_number;
+    };
+
     struct Model
     {
         /** MeshPart used by this model */
@@ -181,32 +393,87 @@ namespace rg
          * It can for example be used to adjust the orientation of an imported model which may not use the same axis conventions.
          * */
         Transform transform = {};
+        /**
+         * Index of the first instance of this model in the object buffer.
+         * The instances of a model are stored contiguously, so they can all be drawn with a single indirect command.
+         * Updated each frame when the object buffer is filled.
+         */
+        uint32_t first_instance = 0;
+
+        // Dirty tracking
+        // The transform is given by reference to the user, so we can't know when it is modified.
+        // Instead, we keep the value used for the last computed matrix and compare it each frame.
+
+        /** Value of the transform when the matrix was last computed. */
+        Transform uploaded_transform = {};
+        /** Cached result of uploaded_transform.view_matrix(). */
+        glm::mat4 matrix = glm::mat4(1.0f);
     };
 
     struct RenderNode
     {
         /** Model used by this node */
         ModelId model_id = NULL_ID;
+        /** Transform of this instance, relative to the model's transform. */
+        Transform transform = {};
+
+        // Dirty tracking
+
+        /** Value of the transform when the object data was last computed. */
+        Transform uploaded_transform = {};
+        /** Number of the last frame in which the object data of this node changed. */
+        uint64_t last_change_frame = 0;
     };
 
     // Transfer
 
-    struct TransferCommand
+    /** Staging memory of an upload, mapped on the CPU side. */
+    struct StagingAllocation
     {
-        AllocatedBuffer staging_buffer = {};
-        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
-        VkFence         fence          = VK_NULL_HANDLE;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        size_t   offset = 0;
+        void    *data   = nullptr;
+    };
 
-        // Begin command buffer
-        void begin() const;
-        void end_and_submit(VkQueue queue);
+    /** Uploads recorded between two frames. They are recorded in a single command buffer, submitted before the next frame. */
+    struct TransferBatch
+    {
+        VkCommandPool   command_pool   = VK_NULL_HANDLE;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        bool            is_recording   = false;
+        bool            is_submitted   = false;
+        // Value signaled on the transfer timeline when the transfers are done
+        uint64_t timeline_value = 0;
+        // Position of the staging ring after the allocations of the batch
+        uint64_t staging_end = 0;
+        // Staging buffers created for the uploads that didn't fit in the ring
+        Vector<AllocatedBuffer> dedicated_staging_buffers {1};
     };
 
     struct TransferContext
     {
-        VkCommandPool           transfer_pool = VK_NULL_HANDLE;
-        VkCommandPool           graphics_pool = VK_NULL_HANDLE;
-        Vector<TransferCommand> commands {2};
+        // The batches are recorded and submitted in turn. Only the current one can be recording.
+        TransferBatch batches[NB_OVERLAPPING_FRAMES] = {};
+        size_t        current_batch                  = 0;
+        // Timeline semaphore signaled by the batches, with increasing values. The rendering waits for the values it needs, and the
+        // CPU reads the counter to know which batches can be reused.
+        VkSemaphore timeline = VK_NULL_HANDLE;
+        // Last value signaled by a submitted batch
+        uint64_t submitted_value = 0;
+        // Last value known to be reached by the timeline
+        uint64_t completed_value = 0;
+        // Persistently mapped staging buffer, used as a ring: the allocations follow each other, and are freed in the same order
+        // when their batch is done. Positions only increase, the offset in the buffer is the position modulo its size.
+        AllocatedBuffer staging_ring           = {};
+        uint64_t        staging_write_position = 0;
+        uint64_t        staging_free_position  = 0;
+        // Position up to which the writes of the CPU were flushed, when the last batch was submitted
+        uint64_t staging_flushed_position = 0;
+        // Acquisitions of the uploaded images by the graphics queue, when it has another family than the transfer queue
+        // They are recorded at the beginning of the next frame
+        Vector<VkImageMemoryBarrier> image_acquisitions {4};
+        // Mip levels to generate after that, since blits need a graphics queue
+        Vector<MipGeneration> mip_generations {4};
     };
 
     // Main types
@@ -251,7 +518,63 @@ namespace rg
         size_t           count           = 0;
         VkPipeline       pipeline        = VK_NULL_HANDLE;
         VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
-        VkDescriptorSet  textures_set    = VK_NULL_HANDLE;
+        /** Textures set bound by each overlapping frame. */
+        VkDescriptorSet textures_sets[NB_OVERLAPPING_FRAMES] = {};
+        /** The mesh parts of a batch all use the same index size, since the index buffer is bound with it. */
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        /** Effect drawing the batch. With bindless textures, it gives the textures of the materials to use. */
+        ShaderEffectId effect_id = NULL_ID;
+    };
+
+    /** Per-frame output of the culling pass of a render stage. */
+    struct CulledDraws
+    {
+        /** Copy of the draws of the stage, in which the culling pass counts the visible instances. */
+        AllocatedBuffer draw_buffer = {};
+        /** Compacted indirect commands. Each batch starts at the same offset as in the stage's indirect buffer. */
+        AllocatedBuffer indirect_buffer = {};
+        /** Number of commands in each batch. */
+        AllocatedBuffer count_buffer = {};
+        /** Visible instances, grouped by draw. Bound as per-instance vertex input. */
+        AllocatedBuffer visible_instance_buffer = {};
+
+        // Same, but written by the CPU culling, which doesn't need counts since every draw is kept
+        AllocatedBuffer cpu_indirect_buffer         = {};
+        AllocatedBuffer cpu_visible_instance_buffer = {};
+
+        // With occlusion culling, instances hidden in the first phase are marked here to be tested again in the second one
+        AllocatedBuffer occlusion_buffer = {};
+
+        // The set is rebuilt in its own pool when the buffers change
+        DynamicDescriptorPool descriptor_pool              = {};
+        VkDescriptorSet       culling_set                  = VK_NULL_HANDLE;
+        uint64_t              built_buffers_config_version = 0;
+        // Second set of the occlusion culling shader, which also needs to be rebuilt when the depth pyramid is recreated
+        VkDescriptorSet occlusion_set               = VK_NULL_HANDLE;
+        uint32_t        built_depth_pyramid_version = 0;
+
+        // Statistics
+        // The counts and commands written by each phase of the GPU culling are copied in host-visible buffers, which are read
+        // once the frame is done. The CPU culling counts its visible draws directly.
+        AllocatedBuffer count_readback_buffer      = {};
+        AllocatedBuffer command_readback_buffer    = {};
+        uint32_t        readback_phase_count       = 0;
+        uint32_t        cpu_visible_instance_count = 0;
+        uint32_t        cpu_visible_draw_count     = 0;
+    };
+
+    /** Number of phases of the GPU culling: one without occlusion culling, two with it. */
+    constexpr uint32_t MAX_CULLING_PHASE_COUNT = 2;
+
+    /** Parameters of the selection of the levels of detail of the instances, for a camera. */
+    struct LodSelection
+    {
+        glm::vec3 camera_position = {};
+        /**
+         * A level of detail can be used if its error, multiplied by this factor, is smaller than the distance to the camera.
+         * The most simplified level that can be used is selected. 0 disables the selection: only the base level is drawn.
+         */
+        float factor = 0.0f;
     };
 
     /**
@@ -270,6 +593,47 @@ namespace rg
         Array<VkFramebuffer>      framebuffers    = {};
         AllocatedBuffer           indirect_buffer = {};
         Vector<RenderBatch>       batches {5};
+
+        // Culling data
+
+        /** Draws of the stage with their bounding sphere, copied in the culled draws each frame. */
+        AllocatedBuffer draw_buffer = {};
+        /** Instances of the stage, grouped by draw. Used as per-instance vertex input when culling is disabled. */
+        AllocatedBuffer instance_buffer = {};
+        uint32_t        draw_count      = 0;
+        uint32_t        instance_count  = 0;
+        /**
+         * Size of the visible instance buffers. There is a draw per level of detail of each model, and each of them has room for
+         * all the instances of the model.
+         */
+        uint32_t    visible_instance_capacity = 0;
+        CulledDraws culled_draws[NB_OVERLAPPING_FRAMES];
+
+        // CPU copies of the indirect commands, draws and instances, read by the CPU culling
+        Array<VkDrawIndexedIndirectCommand> cpu_commands  = {};
+        Array<GPUDrawData>                  cpu_draws     = {};
+        Array<GPUInstanceData>              cpu_instances = {};
+
+        // Occlusion culling data
+
+        /**
+         * Hierarchical depth buffer. Each texel of the first level stores the farthest depth of the area of the depth attachment it
+         * covers, and each following level does the same with the previous level.
+         */
+        AllocatedImage     depth_pyramid           = {};
+        VkExtent2D         depth_pyramid_extent    = {};
+        uint32_t           depth_pyramid_mip_count = 0;
+        Array<VkImageView> depth_pyramid_mip_views = {};
+        VkSampler          depth_pyramid_sampler   = VK_NULL_HANDLE;
+        /** Sets of the reduction shader writing the first level, one per image since they read its depth attachment. */
+        Array<VkDescriptorSet> depth_pyramid_source_sets = {};
+        /** Sets of the reduction shader writing each other level, starting at the second one. */
+        Array<VkDescriptorSet> depth_pyramid_reduce_sets = {};
+        /** False until the pyramid is written for the first time. Until then, it can't be used to cull the instances. */
+        bool depth_pyramid_ready = false;
+        /** Incremented each time the pyramid is recreated. */
+        uint32_t depth_pyramid_version = 0;
+
         Vector<AttachmentTexture> output_textures {3};
         /** One per image */
         Array<VkDescriptorSet> output_textures_set = {};
@@ -282,6 +646,15 @@ namespace rg
     {
         RenderStageKind kind           = RenderStageKind::INVALID;
         VkRenderPass    vk_render_pass = VK_NULL_HANDLE;
+
+        // Occlusion culling
+        bool     occlusion_culling      = false;
+        uint32_t depth_attachment_index = 0;
+        /**
+         * Same as vk_render_pass, but the attachments are loaded instead of cleared. It is used to draw the instances found visible in
+         * the second phase of the occlusion culling. Both are compatible, so the framebuffers and pipelines are shared.
+         */
+        VkRenderPass vk_load_render_pass = VK_NULL_HANDLE;
     };
 
     struct FrameData
@@ -292,6 +665,10 @@ namespace rg
         VkSemaphore     render_semaphore  = VK_NULL_HANDLE;
         VkFence         render_fence      = VK_NULL_HANDLE;
 
+        // Timestamps before and after each render stage
+        VkQueryPool timestamp_pool = VK_NULL_HANDLE;
+        bool        has_timestamps = false;
+
         // Descriptor sets
 
         // One descriptor pool per frame: that way we can just reset the pool to free all sets of the frame
@@ -302,10 +679,19 @@ namespace rg
         // Object data
         AllocatedBuffer object_info_buffer = {};
         VkDescriptorSet global_set         = VK_NULL_HANDLE;
+        // Layout of the objects in the buffer. If it is different from the renderer's, the whole buffer needs to be rewritten
+        uint64_t built_object_layout_version = 0;
+        // Number of the last frame in which the object buffer was written
+        uint64_t object_buffer_frame_number = 0;
+        // Objects that changed since the buffer was last written
+        Vector<uint32_t> dirty_objects = Vector<uint32_t>(50);
 
         // Per-swapchain sets and buffers. Dynamic over swapchains
         AllocatedBuffer camera_info_buffer = {};
         VkDescriptorSet swapchain_set      = VK_NULL_HANDLE;
+
+        // Draws recorded in the frame. The results of the GPU culling are added once the frame is done.
+        DrawStatistics draw_statistics = {};
     };
 
     struct Queue
@@ -335,8 +721,9 @@ namespace rg
         VkSurfaceKHR              surface                        = VK_NULL_HANDLE;
         // Pipelines
         // Since vulkan handles are just pointers, a hash map is all we need
-        HashMap  pipelines             = {};
-        uint64_t built_effects_version = 0;
+        // There is a map per vertex format, since the vertex input state is part of the pipeline
+        HashMap  pipelines[VERTEX_FORMAT_COUNT] = {};
+        uint64_t built_effects_version          = 0;
 
         // Internal textures
         /** Pool that is reset every time the swapchain is recreated. Useful for resources that don't require an update at each frame,
@@ -398,20 +785,85 @@ namespace rg
         Storage<RenderNode>       render_nodes       = {};
         Storage<Camera>           cameras            = {};
         Storage<StoredMeshPart>   mesh_parts         = {};
+        // Id of the mesh part having a given content hash
+        HashMap mesh_parts_by_content = {};
 
         // Vertex and index buffer for all the meshes
-        AllocatedBuffer vertex_buffer = {};
-        AllocatedBuffer index_buffer  = {};
+        // The mesh parts are suballocated in them, so that saving or destroying one only uploads or frees its own data
+        AllocatedBuffer           vertex_buffer        = {};
+        AllocatedBuffer           index_buffer         = {};
+        RangeAllocator            vertex_ranges        = {};
+        RangeAllocator            index_ranges         = {};
+        Vector<RetiredMeshRanges> retired_mesh_ranges  = Vector<RetiredMeshRanges>(4);
+        // Value of the transfer timeline signaled once the last copy of a grown mesh buffer is done. Until then, the copy could
+        // overwrite parts that the CPU writes in the new buffer.
+        uint64_t mesh_buffer_copy_value = 0;
 
         // Storage buffer sizes
         size_t object_data_capacity = 100;
 
+        // CPU copy of the object buffer, used to upload only the objects that changed
+        Array<GPUObjectData> object_data = {};
+
+        // World space bounding spheres of the objects, in the same order as object_data
+        // They are stored as a structure of arrays so that the CPU culling can test several of them at once
+        Array<float>   object_bounds_x      = {};
+        Array<float>   object_bounds_y      = {};
+        Array<float>   object_bounds_z      = {};
+        Array<float>   object_bounds_radius = {};
+        Array<uint8_t> object_visibility    = {};
+        // Same bounds as boxes, and the render node of each object
+        Array<AABB>         object_boxes         = {};
+        Array<RenderNodeId> object_nodes         = {};
+        bool                object_boxes_changed = false;
+        // Number of objects when the layout was last computed
+        size_t object_count = 0;
+
+        // Hierarchy over the object boxes, used for culling and scene queries
+        // It is refitted when objects move, and rebuilt in the background when objects are added or removed, or when it degraded
+        BVH              scene_bvh                        = {};
+        uint64_t         scene_bvh_layout_version         = 0;
+        float            scene_bvh_built_cost             = 0.0f;
+        std::future<BVH> scene_bvh_rebuild                = {};
+        uint64_t         scene_bvh_rebuild_layout_version = 0;
+
         // Descriptor pool for sets that don't need to change per frame
         DynamicDescriptorPool static_descriptor_pool = {};
 
         // Descriptor layouts
-        VkDescriptorSetLayout global_set_layout    = VK_NULL_HANDLE;
-        VkDescriptorSetLayout swapchain_set_layout = VK_NULL_HANDLE;
+        VkDescriptorSetLayout global_set_layout       = VK_NULL_HANDLE;
+        VkDescriptorSetLayout swapchain_set_layout    = VK_NULL_HANDLE;
+        VkDescriptorSetLayout culling_set_layout      = VK_NULL_HANDLE;
+        VkDescriptorSetLayout occlusion_set_layout    = VK_NULL_HANDLE;
+        VkDescriptorSetLayout depth_reduce_set_layout = VK_NULL_HANDLE;
+
+        // GPU culling
+        // It is enabled when a culling shader is set and the device supports indirect count
+        bool             supports_draw_indirect_count = false;
+        VkPipelineLayout culling_pipeline_layout      = VK_NULL_HANDLE;
+        VkPipeline       culling_pipeline             = VK_NULL_HANDLE;
+        // Occlusion culling is used by the stages that enable it, when its shaders are set on top of the GPU culling
+        VkPipelineLayout occlusion_culling_pipeline_layout = VK_NULL_HANDLE;
+        VkPipeline       occlusion_culling_pipeline        = VK_NULL_HANDLE;
+        VkPipelineLayout depth_reduce_pipeline_layout      = VK_NULL_HANDLE;
+        VkPipeline       depth_reduce_pipeline             = VK_NULL_HANDLE;
+        // CPU culling is used when GPU culling is not available
+        bool cpu_culling_enabled = true;
+        // Each unit of bias doubles the error allowed on screen when selecting the levels of detail
+        float lod_bias = 0.0f;
+
+        // Textures
+        // BC formats can only be sampled if the feature is enabled, otherwise the textures are decoded on the CPU
+        bool supports_block_compression = false;
+        bool uses_block_compression     = false;
+        // 0 if anisotropic filtering isn't supported
+        float max_sampler_anisotropy = 0.0f;
+
+        // GPU timings of the render stages, read from the timestamps of a frame once it is done
+        bool          supports_timestamps = false;
+        Array<double> stage_gpu_times     = {};
+        // Same for the draws of the stages
+        DrawStatistics draw_statistics = {};
 
         // Number incremented at each created shader effect
         // It is stored in the swapchain when effects are built
@@ -423,9 +875,57 @@ namespace rg
         uint64_t buffer_config_version = 0;
         // Same for draw cache
         uint64_t draw_cache_version = 0;
+        // Set when the last built draw cache skipped data that wasn't uploaded yet, and when new data was uploaded during the frame
+        // The cache is then rebuilt at most once per frame, and only if the new data can be drawn
+        bool draw_cache_skips_uploads = false;
+        bool has_new_uploads          = false;
+        // Same for the position of the objects in the object buffer
+        // It is updated when render nodes or models are added or removed
+        uint64_t object_layout_version = 1;
+        // Version of the layout used to compute object_data
+        uint64_t built_object_layout_version = 0;
         // Idem for meshes, but since the buffers are global to the renderer, a bool is enough
         bool should_update_mesh_buffers = false;
 
+        // Uploads
+        // Loaded textures wait in a queue, in loading order, and the saved mesh parts wait until they are uploaded
+        // At each frame, they are uploaded within the budget, if there is one
+        Vector<PendingTextureUpload> pending_texture_uploads = Vector<PendingTextureUpload>(4);
+        size_t                       upload_budget           = 0;
+        size_t                       frame_upload_bytes      = 0;
+        bool                         upload_budget_exhausted = false;
+        // Destroyed textures, whose images may still be used by the frames in flight or copied by the transfers
+        Vector<RetiredTexture> retired_textures = Vector<RetiredTexture>(4);
+
+        // Mesh, draw cache and material buffers replaced while the frames in flight may still use them
+        Vector<RetiredBuffer> retired_buffers = Vector<RetiredBuffer>(4);
+
+        // Texture streaming
+        // The budget is 0 when it is only limited by the memory budget of the device, which is more precise with VK_EXT_memory_budget
+        // The images replaced by the uploads of a frame are retired once the descriptor sets of every frame are updated
+        bool                         supports_memory_budget       = false;
+        size_t                       texture_memory_budget        = 0;
+        TextureStreamingStatistics   texture_streaming_statistics = {};
+        Vector<ReplacedTextureImage> replaced_texture_images      = Vector<ReplacedTextureImage>(4);
+
+        // Bindless textures
+        // Each texture gets a slot in the array of the bindless set, and the material buffer contains the slots of the textures of
+        // each material. All the effects then use the same set, so the materials don't split the batches anymore.
+        // Each frame in flight has its own set and material buffer, so that a frame can update them while the other ones use theirs.
+        bool                  supports_bindless_textures                      = false;
+        bool                  uses_bindless_textures                          = false;
+        uint32_t              bindless_texture_capacity                       = 0;
+        VkDescriptorSetLayout bindless_set_layout                             = VK_NULL_HANDLE;
+        VkDescriptorPool      bindless_descriptor_pool                        = VK_NULL_HANDLE;
+        VkDescriptorSet       bindless_sets[NB_OVERLAPPING_FRAMES]            = {};
+        AllocatedBuffer       material_buffers[NB_OVERLAPPING_FRAMES]         = {};
+        uint64_t              materials_version                               = 1;
+        uint64_t              material_table_version                          = 0;
+        size_t                material_slot_count                             = 0;
+        uint64_t              built_materials_versions[NB_OVERLAPPING_FRAMES] = {};
+        uint32_t              texture_slot_count         = 0;
+        Vector<uint32_t>      free_texture_slots         = Vector<uint32_t>(8);
+
         // ------------ Methods ------------
 
         inline void                           wait_for_fence(VkFence fence) const;
@@ -435,6 +935,8 @@ namespace rg
         [[nodiscard]] inline const FrameData &get_current_frame() const;
         VkCommandBuffer                       begin_recording();
         void                                  end_recording_and_submit();
+        void                                  read_stage_gpu_times(FrameData &frame);
+        void                                  read_draw_statistics(FrameData &frame, size_t frame_index);
 
         [[nodiscard]] VkSurfaceFormatKHR select_surface_format(const VkSurfaceKHR &surface) const;
         void                             destroy_swapchain_inner(Swapchain &swapchain) const;
@@ -444,7 +946,9 @@ namespace rg
         void                             recreate_swapchain(Swapchain &swapchain, const Extent2D &new_extent);
         uint32_t                         get_next_swapchain_image(Swapchain &swapchain) const;
 
-        [[nodiscard]] VkPipeline build_shader_effect(const VkExtent2D &viewport_extent, const ShaderEffect &effect);
+        [[nodiscard]] VkPipeline build_shader_effect(const VkExtent2D   &viewport_extent,
+                                                     const ShaderEffect &effect,
+                                                     VertexFormat        format);
         void                     build_out_of_date_effects(Swapchain &swapchain);
         void                     clear_pipelines(Swapchain &swapchain) const;
         void                     recreate_pipelines(Swapchain &swapchain);
@@ -453,9 +957,46 @@ namespace rg
         void                     update_descriptor_sets(FrameData &frame) const;
         void                     update_render_stages_output_sets(Swapchain &swapchain) const;
 
-        void update_stage_cache(Swapchain &swapchain);
-
-        void send_camera_data(size_t window_index, const Camera &camera, FrameData &current_frame);
+        [[nodiscard]] AllocatedBuffer create_object_buffer(size_t size) const;
+        void                          update_stage_cache(Swapchain &swapchain);
+
+        [[nodiscard]] VkPipeline  create_compute_pipeline(ShaderModuleId shader, VkPipelineLayout layout, const char *name) const;
+        [[nodiscard]] inline bool uses_gpu_culling() const;
+        void                      destroy_culling_buffers(RenderStageInstance &stage) const;
+        void update_culling_sets(RenderStageInstance &stage, bool occlusion_culling, FrameData &frame, size_t frame_index) const;
+        void reset_culled_draws(const RenderStageInstance &stage, const CulledDraws &culled, VkCommandBuffer cmd) const;
+        void copy_culling_results(const RenderStageInstance &stage, CulledDraws &culled, VkCommandBuffer cmd, uint32_t phase) const;
+        void cull_stage(RenderStageInstance &stage,
+                        VkCommandBuffer      cmd,
+                        size_t               frame_index,
+                        const GPUCameraData &camera_data,
+                        const LodSelection  &lod_selection) const;
+
+        [[nodiscard]] inline bool uses_occlusion_culling(size_t stage_index) const;
+        void                      cull_stage_with_occlusion(RenderStageInstance &stage,
+                                                            VkCommandBuffer      cmd,
+                                                            size_t               frame_index,
+                                                            const GPUCameraData &camera_data,
+                                                            const LodSelection  &lod_selection,
+                                                            uint32_t             phase) const;
+        void build_depth_pyramid(RenderStageInstance &stage, size_t stage_index, uint32_t image_index, VkCommandBuffer cmd) const;
+        void create_depth_pyramid(Swapchain &swapchain, RenderStageInstance &stage, size_t stage_index) const;
+        void destroy_depth_pyramid(RenderStageInstance &stage) const;
+
+        [[nodiscard]] inline bool uses_cpu_culling() const;
+        void                      update_object_bounds(uint32_t object_index, const glm::mat4 &transform, const StoredMeshPart &part);
+        void                      update_scene_bvh();
+        [[nodiscard]] inline bool is_scene_bvh_up_to_date() const;
+        void                      cull_objects_on_cpu(const GPUCameraData &camera_data);
+        void cull_stage_on_cpu(RenderStageInstance &stage, size_t frame_index, const LodSelection &lod_selection) const;
+        void count_recorded_draws(const Swapchain &swapchain, FrameData &frame, size_t frame_index) const;
+        [[nodiscard]] uint32_t
+            select_lod_on_cpu(const GPUDrawData *draws, uint32_t object_index, const LodSelection &lod_selection) const;
+
+        [[nodiscard]] LodSelection get_lod_selection(const GPUCameraData &camera_data, const VkExtent2D &viewport_extent) const;
+
+        [[nodiscard]] static GPUCameraData get_camera_data(const Camera &camera);
+        void send_camera_data(size_t window_index, const GPUCameraData &camera_data, FrameData &current_frame);
 
         void draw_from_cache(const RenderStageInstance &stage,
                              VkCommandBuffer            cmd,
@@ -469,14 +1010,51 @@ namespace rg
                        size_t           window_index) const;
         template<typename T>
         void                 copy_buffer_to_gpu(const T &src, AllocatedBuffer &dst, size_t offset = 0);
+        bool                 reserve_buffer(AllocatedBuffer   &buffer,
+                                            size_t             required_size,
+                                            VkBufferUsageFlags usage,
+                                            VmaMemoryUsage     memory_usage,
+                                            bool               persistently_mapped = false);
+        void                 retire_buffer(AllocatedBuffer &buffer);
+        void                 release_retired_buffers(bool force);
         [[nodiscard]] size_t pad_uniform_buffer_size(size_t original_size) const;
 
-        [[nodiscard]] static VertexInputDescription get_vertex_description();
+        [[nodiscard]] static VertexInputDescription get_vertex_description(VertexFormat format);
         void                                        update_mesh_buffers();
+        void                                        retire_mesh_part(const StoredMeshPart &part);
+        [[nodiscard]] static size_t                 get_upload_size(const MeshPart &mesh_part);
+        [[nodiscard]] bool has_same_content(const StoredMeshPart &stored_part, const MeshPart &mesh_part) const;
+
+        // Uploads
+        bool                         consume_upload_budget(size_t size);
+        [[nodiscard]] bool           supports_format_features(VkFormat format, VkFormatFeatureFlags features) const;
+        [[nodiscard]] AllocatedImage create_texture_image(const Texture &texture, uint32_t first_mip) const;
+        void                         upload_texture(TextureId texture_id, Texture &texture, const PendingTextureUpload &upload);
+        static void                  generate_mipmaps(VkCommandBuffer cmd, const MipGeneration &generation);
+        void                         upload_pending_textures();
+        void                         release_image_decoding(PendingTextureUpload &upload) const;
+        void                         retire_texture(TextureId texture_id, Texture &texture);
+        void                         retire_texture_image(const AllocatedImage &image, VkSampler sampler, uint32_t bindless_slot);
+        void                         release_retired_textures(bool force);
+
+        // Texture streaming
+        void update_texture_streaming();
+        void queue_texture_levels(TextureId texture_id, Texture &texture, uint32_t first_mip);
+        void update_replaced_texture_descriptors();
+
+        // Bindless textures
+        void init_bindless_textures();
+        void write_texture_slot(const Texture &texture) const;
+        void update_material_buffer(uint64_t frame_index);
 
         // Transfer
-        TransferCommand create_transfer_command(VkCommandPool pool) const;
-        void            reset_transfer_context();
+        void              init_transfer_context();
+        void              destroy_transfer_context();
+        void              reclaim_transfer_batches(bool wait);
+        VkCommandBuffer   begin_transfer();
+        StagingAllocation allocate_staging(size_t size, size_t alignment);
+        void              flush_staging_ring();
+        uint64_t          submit_transfers();
     };
 
     // endregion
@@ -553,7 +1131,8 @@ namespace rg
 
         if (forceOne)
         {
-            check(stage == ShaderStage::VERTEX || stage == ShaderStage::FRAGMENT, "Expected a single shader stages, got multiple.");
+            check(stage == ShaderStage::VERTEX || stage == ShaderStage::FRAGMENT || stage == ShaderStage::COMPUTE,
+                  "Expected a single shader stages, got multiple.");
         }
 
         // Stage can be a mask
@@ -565,6 +1144,10 @@ namespace rg
         {
             result |= VK_SHADER_STAGE_FRAGMENT_BIT;
         }
+        if (stage & ShaderStage::COMPUTE)
+        {
+            result |= VK_SHADER_STAGE_COMPUTE_BIT;
+        }
 
         return result;
     }
@@ -589,6 +1172,26 @@ namespace rg
         }
     }
 
+    VkFormat convert_texture_format(TextureFormat format)
+    {
+        switch (format)
+        {
+            case TextureFormat::RGBA8_SRGB: return VK_FORMAT_R8G8B8A8_SRGB;
+            case TextureFormat::RGBA8_UNORM: return VK_FORMAT_R8G8B8A8_UNORM;
+            case TextureFormat::R8_UNORM: return VK_FORMAT_R8_UNORM;
+            case TextureFormat::RG8_UNORM: return VK_FORMAT_R8G8_UNORM;
+            case TextureFormat::BC1_SRGB: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case TextureFormat::BC1_UNORM: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case TextureFormat::BC3_SRGB: return VK_FORMAT_BC3_SRGB_BLOCK;
+            case TextureFormat::BC3_UNORM: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case TextureFormat::BC4_UNORM: return VK_FORMAT_BC4_UNORM_BLOCK;
+            case TextureFormat::BC5_UNORM: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case TextureFormat::BC7_SRGB: return VK_FORMAT_BC7_SRGB_BLOCK;
+            case TextureFormat::BC7_UNORM: return VK_FORMAT_BC7_UNORM_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+        }
+    }
+
     VkImageLayout convert_layout(ImageLayout layout)
     {
         switch (layout)
@@ -784,6 +1387,16 @@ namespace rg
         vkGetPhysicalDeviceProperties(device, &device_properties);
         vkGetPhysicalDeviceFeatures(device, &device_features);
 
+        VkPhysicalDeviceVulkan12Features vulkan_12_features = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .pNext = nullptr,
+        };
+        VkPhysicalDeviceFeatures2 features_2 = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &vulkan_12_features,
+        };
+        vkGetPhysicalDeviceFeatures2(device, &features_2);
+
         // Prefer something else than llvmpipe, which is testing use only
 #ifdef __cpp_lib_starts_ends_with
         if (!std::string(device_properties.deviceName).starts_with("llvmpipe"))
@@ -803,6 +1416,20 @@ namespace rg
             score += 10000;
         }
 
+        // Instances are drawn with indirect commands which don't start at instance 0, and several commands are drawn at once
+        if (!device_features.multiDrawIndirect || !device_features.drawIndirectFirstInstance)
+        {
+            std::cout << "GPU: " << device_properties.deviceName << " doesn't support multi draw indirect.\n";
+            return 0;
+        }
+
+        // The uploads are synchronized with the rendering with a timeline semaphore
+        if (!vulkan_12_features.timelineSemaphore)
+        {
+            std::cout << "GPU: " << device_properties.deviceName << " doesn't support timeline semaphores.\n";
+            return 0;
+        }
+
         // The bigger, the better
         score += device_properties.limits.maxImageDimension2D;
 
@@ -830,7 +1457,8 @@ namespace rg
                          VkDevice         device,
                          VkPhysicalDevice physical_device,
                          uint32_t         graphics_queue_family,
-                         uint32_t         transfer_queue_family)
+                         uint32_t         transfer_queue_family,
+                         bool             uses_memory_budget)
         : m_device(device),
           m_graphics_queue_family(graphics_queue_family),
           m_transfer_queue_family(transfer_queue_family)
@@ -860,6 +1488,7 @@ namespace rg
             .vkGetPhysicalDeviceMemoryProperties2KHR = vkGetPhysicalDeviceMemoryProperties2KHR,
         };
         VmaAllocatorCreateInfo allocator_create_info = {
+            .flags            = uses_memory_budget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u,
             .physicalDevice   = physical_device,
             .device           = device,
             .pVulkanFunctions = &vulkan_functions,
@@ -867,6 +1496,31 @@ namespace rg
         };
 
         vk_check(vmaCreateAllocator(&allocator_create_info, &m_allocator), "Failed to create allocator");
+
+        // Find the biggest device-local heap, which is the main memory of the GPU
+        const VkPhysicalDeviceMemoryProperties *memory_properties = nullptr;
+        vmaGetMemoryProperties(m_allocator, &memory_properties);
+        for (uint32_t heap_i = 0; heap_i < memory_properties->memoryHeapCount; heap_i++)
+        {
+            const auto &heap = memory_properties->memoryHeaps[heap_i];
+            if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0
+                && heap.size > memory_properties->memoryHeaps[m_main_heap_index].size)
+            {
+                m_main_heap_index = heap_i;
+            }
+        }
+
+        // Without resizable BAR, discrete GPUs only expose a small host-visible window of their memory, in its own heap
+        // It is too small to hold the meshes, so the CPU can only write directly when the main heap itself is host-visible
+        constexpr VkMemoryPropertyFlags direct_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        for (uint32_t type_i = 0; type_i < memory_properties->memoryTypeCount; type_i++)
+        {
+            const auto &type = memory_properties->memoryTypes[type_i];
+            if ((type.propertyFlags & direct_flags) == direct_flags && type.heapIndex == m_main_heap_index)
+            {
+                m_has_host_visible_device_memory = true;
+            }
+        }
     }
 
     Allocator::~Allocator()
@@ -882,7 +1536,9 @@ namespace rg
         : m_allocator(other.m_allocator),
           m_device(other.m_device),
           m_graphics_queue_family(other.m_graphics_queue_family),
-          m_transfer_queue_family(other.m_transfer_queue_family)
+          m_transfer_queue_family(other.m_transfer_queue_family),
+          m_has_host_visible_device_memory(other.m_has_host_visible_device_memory),
+          m_main_heap_index(other.m_main_heap_index)
     {
         other.m_allocator = VK_NULL_HANDLE;
     }
@@ -896,9 +1552,13 @@ namespace rg
                 vmaDestroyAllocator(m_allocator);
                 m_allocator = VK_NULL_HANDLE;
             }
-            m_allocator       = other.m_allocator;
-            m_device          = other.m_device;
-            other.m_allocator = VK_NULL_HANDLE;
+            m_allocator                      = other.m_allocator;
+            m_device                         = other.m_device;
+            m_graphics_queue_family          = other.m_graphics_queue_family;
+            m_transfer_queue_family          = other.m_transfer_queue_family;
+            m_has_host_visible_device_memory = other.m_has_host_visible_device_memory;
+            m_main_heap_index                = other.m_main_heap_index;
+            other.m_allocator                = VK_NULL_HANDLE;
         }
         return *this;
     }
@@ -908,7 +1568,8 @@ namespace rg
                                            VkImageUsageFlags  image_usage,
                                            VkImageAspectFlags image_aspect,
                                            VmaMemoryUsage     memory_usage,
-                                           bool               concurrent) const
+                                           bool               concurrent,
+                                           uint32_t           mip_levels) const
     {
         // We use VMA for now. We can always switch to a custom allocator later if we want to.
         AllocatedImage image;
@@ -924,7 +1585,7 @@ namespace rg
             .imageType             = VK_IMAGE_TYPE_2D,
             .format                = image_format,
             .extent                = image_extent,
-            .mipLevels             = 1,
+            .mipLevels             = mip_levels,
             .arrayLayers           = 1,
             .samples               = VK_SAMPLE_COUNT_1_BIT,
             .tiling                = VK_IMAGE_TILING_OPTIMAL,
@@ -936,15 +1597,16 @@ namespace rg
         };
 
         // Sharing mode
+        // The indices need to live until the image is created
+        const uint32_t queue_indices[] = {
+            m_graphics_queue_family,
+            m_transfer_queue_family,
+        };
         if (concurrent && m_graphics_queue_family != m_transfer_queue_family)
         {
-            image_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
-            Array<uint32_t> queue_indices = {
-                m_graphics_queue_family,
-                m_transfer_queue_family,
-            };
-            image_create_info.pQueueFamilyIndices   = queue_indices.data();
-            image_create_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_indices.size());
+            image_create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+            image_create_info.pQueueFamilyIndices   = queue_indices;
+            image_create_info.queueFamilyIndexCount = 2;
         }
 
         VmaAllocationCreateInfo alloc_create_info = {
@@ -956,7 +1618,7 @@ namespace rg
         vk_check(vmaCreateImage(m_allocator, &image_create_info, &alloc_create_info, &image.image, &image.allocation, nullptr),
                  "Failed to create image");
 
-        // Create image view
+        // Create image view, covering every mip level
         VkImageViewCreateInfo image_view_create_info = {
             .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .pNext    = nullptr,
@@ -975,7 +1637,7 @@ namespace rg
                 {
                     image_aspect,
                     0,
-                    1,
+                    mip_levels,
                     0,
                     1,
                 },
@@ -1000,7 +1662,39 @@ namespace rg
     AllocatedBuffer Allocator::create_buffer(size_t             allocation_size,
                                              VkBufferUsageFlags buffer_usage,
                                              VmaMemoryUsage     memory_usage,
-                                             bool               concurrent) const
+                                             bool               concurrent,
+                                             bool               persistently_mapped) const
+    {
+        // A persistently mapped buffer stays mapped for its whole lifetime, so it can be written without any driver call
+        check(!persistently_mapped || memory_usage != VMA_MEMORY_USAGE_GPU_ONLY, "A GPU only buffer can't be mapped.");
+
+        // Create an allocation info
+        const VmaAllocationCreateInfo allocation_create_info = {
+            .usage = memory_usage,
+        };
+        return create_buffer(allocation_size, buffer_usage, allocation_create_info, concurrent, persistently_mapped);
+    }
+
+    AllocatedBuffer Allocator::create_host_visible_device_buffer(size_t             allocation_size,
+                                                                 VkBufferUsageFlags buffer_usage,
+                                                                 bool               concurrent) const
+    {
+        check(m_has_host_visible_device_memory, "The device-local memory of this device can't be written by the CPU.");
+
+        // The memory is required to be in both, and coherent memory is preferred so that it doesn't need to be flushed
+        const VmaAllocationCreateInfo allocation_create_info = {
+            .usage          = VMA_MEMORY_USAGE_UNKNOWN,
+            .requiredFlags  = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+            .preferredFlags = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        };
+        return create_buffer(allocation_size, buffer_usage, allocation_create_info, concurrent, true);
+    }
+
+    AllocatedBuffer Allocator::create_buffer(size_t                         allocation_size,
+                                             VkBufferUsageFlags             buffer_usage,
+                                             const VmaAllocationCreateInfo &allocation_create_info,
+                                             bool                           concurrent,
+                                             bool                           persistently_mapped) const
     {
         // We use VMA for now. We can always switch to a custom allocator later if we want to.
         AllocatedBuffer buffer = {
@@ -1016,31 +1710,39 @@ namespace rg
         };
 
         // Sharing mode
+        // The indices need to live until the buffer is created
+        const uint32_t queue_indices[] = {
+            m_graphics_queue_family,
+            m_transfer_queue_family,
+        };
         if (concurrent && m_graphics_queue_family != m_transfer_queue_family)
         {
-            buffer_create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
-            Array<uint32_t> queue_indices  = {
-                 m_graphics_queue_family,
-                 m_transfer_queue_family,
-            };
-            buffer_create_info.pQueueFamilyIndices   = queue_indices.data();
-            buffer_create_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_indices.size());
+            buffer_create_info.sharingMode           = VK_SHARING_MODE_CONCURRENT;
+            buffer_create_info.pQueueFamilyIndices   = queue_indices;
+            buffer_create_info.queueFamilyIndexCount = 2;
         }
 
-        // Create an allocation info
-        VmaAllocationCreateInfo allocation_create_info = {
-            .usage = memory_usage,
-        };
+        VmaAllocationCreateInfo mapped_allocation_create_info = allocation_create_info;
+        if (persistently_mapped)
+        {
+            mapped_allocation_create_info.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        }
 
         // Create the buffer
+        VmaAllocationInfo allocation_info = {};
         vk_check(vmaCreateBuffer(m_allocator,
                                  &buffer_create_info,
-                                 &allocation_create_info,
+                                 &mapped_allocation_create_info,
                                  &buffer.buffer,
                                  &buffer.allocation,
-                                 VK_NULL_HANDLE),
+                                 &allocation_info),
                  "Couldn't allocate buffer");
 
+        if (persistently_mapped)
+        {
+            buffer.mapped_data = allocation_info.pMappedData;
+        }
+
         return buffer;
     }
 
@@ -1049,14 +1751,21 @@ namespace rg
         if (buffer.buffer != VK_NULL_HANDLE)
         {
             vmaDestroyBuffer(m_allocator, buffer.buffer, buffer.allocation);
-            buffer.buffer     = VK_NULL_HANDLE;
-            buffer.allocation = VK_NULL_HANDLE;
-            buffer.size       = 0;
+            buffer.buffer      = VK_NULL_HANDLE;
+            buffer.allocation  = VK_NULL_HANDLE;
+            buffer.size        = 0;
+            buffer.mapped_data = nullptr;
         }
     }
 
     void *Allocator::map_buffer(AllocatedBuffer &buffer) const
     {
+        // Persistently mapped buffers are already mapped
+        if (buffer.mapped_data != nullptr)
+        {
+            return buffer.mapped_data;
+        }
+
         void *data = nullptr;
         vk_check(vmaMapMemory(m_allocator, buffer.allocation, &data), "Failed to map buffer");
         return data;
@@ -1064,7 +1773,31 @@ namespace rg
 
     void Allocator::unmap_buffer(AllocatedBuffer &buffer) const
     {
-        vmaUnmapMemory(m_allocator, buffer.allocation);
+        // Persistently mapped buffers stay mapped until they are destroyed
+        if (buffer.mapped_data == nullptr)
+        {
+            vmaUnmapMemory(m_allocator, buffer.allocation);
+        }
+    }
+
+    void Allocator::flush_buffer(const AllocatedBuffer &buffer, size_t offset, size_t size) const
+    {
+        // Make host writes visible to the device
+        // VMA ignores the call if the memory is host coherent, so it can be called unconditionally
+        vk_check(vmaFlushAllocation(m_allocator, buffer.allocation, offset, size), "Failed to flush buffer");
+    }
+
+    void Allocator::invalidate_buffer(const AllocatedBuffer &buffer, size_t offset, size_t size) const
+    {
+        // Make device writes visible to the host, ignored as well if the memory is host coherent
+        vk_check(vmaInvalidateAllocation(m_allocator, buffer.allocation, offset, size), "Failed to invalidate buffer");
+    }
+
+    VmaBudget Allocator::get_main_heap_budget() const
+    {
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(m_allocator, budgets);
+        return budgets[m_main_heap_index];
     }
 
     template<typename T>
@@ -1074,15 +1807,73 @@ namespace rg
         char *data = static_cast<char *>(allocator.map_buffer(dst));
 
         // Pad the data if needed
-        if (offset != 0)
-        {
-            data += pad_uniform_buffer_size(sizeof(T)) * offset;
-        }
+        const size_t byte_offset = pad_uniform_buffer_size(sizeof(T)) * offset;
+        data += byte_offset;
 
         memcpy(data, &src, sizeof(T));
+        allocator.flush_buffer(dst, byte_offset, sizeof(T));
         allocator.unmap_buffer(dst);
     }
 
+    /**
+     * Ensures that the buffer exists and is at least of the required size. It is reallocated otherwise, and its content is lost.
+     * @return true if the buffer was (re)allocated.
+     */
+    bool Renderer::Data::reserve_buffer(AllocatedBuffer   &buffer,
+                                        size_t             required_size,
+                                        VkBufferUsageFlags usage,
+                                        VmaMemoryUsage     memory_usage,
+                                        bool               persistently_mapped)
+    {
+        // Big enough, nothing to do
+        if (buffer.is_valid() && buffer.size >= required_size)
+        {
+            return false;
+        }
+
+        // Exists but too small, the frames in flight may still use it
+        retire_buffer(buffer);
+
+        buffer = allocator.create_buffer(required_size, usage, memory_usage, false, persistently_mapped);
+        return true;
+    }
+
+    /**
+     * Hands the buffer over to the deletion queue, since the frames in flight may still use it. The buffer is reset afterwards.
+     */
+    void Renderer::Data::retire_buffer(AllocatedBuffer &buffer)
+    {
+        if (!buffer.is_valid())
+        {
+            return;
+        }
+
+        retired_buffers.push_back(RetiredBuffer {
+            .buffer       = buffer,
+            .frame_number = current_frame_number,
+        });
+        buffer = {};
+    }
+
+    void Renderer::Data::release_retired_buffers(bool force)
+    {
+        // The frames recorded before the retirement are done once the fence of the next frame has been waited for.
+        // The transfers that read the replaced mesh buffers are done as well, since each frame waits for the batch submitted with it.
+        for (size_t i = 0; i < retired_buffers.size();)
+        {
+            auto &retired = retired_buffers[i];
+            if (force || retired.frame_number + NB_OVERLAPPING_FRAMES - 1 <= current_frame_number)
+            {
+                allocator.destroy_buffer(retired.buffer);
+                retired_buffers.remove_at(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
     size_t Renderer::Data::pad_uniform_buffer_size(size_t original_size) const
     {
         // Get the alignment requirement
@@ -1201,6 +1992,38 @@ namespace rg
         begin_info.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         vk_check(vkBeginCommandBuffer(frame.command_buffer, &begin_info));
 
+        // Acquire the images uploaded since the last frame. They are released by the transfer batch submitted with this frame.
+        if (!transfer_context.image_acquisitions.is_empty())
+        {
+            vkCmdPipelineBarrier(frame.command_buffer,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 static_cast<uint32_t>(transfer_context.image_acquisitions.size()),
+                                 transfer_context.image_acquisitions.data());
+            transfer_context.image_acquisitions.clear();
+        }
+
+        // Then generate the mip levels of the textures that need it
+        for (const auto &generation : transfer_context.mip_generations)
+        {
+            generate_mipmaps(frame.command_buffer, generation);
+        }
+        transfer_context.mip_generations.clear();
+
+        // Reset the timestamps of the render stages
+        if (frame.timestamp_pool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(frame.command_buffer,
+                                frame.timestamp_pool,
+                                0,
+                                static_cast<uint32_t>(2 * render_pipeline_description.stages.size()));
+        }
+
         return frame.command_buffer;
     }
 
@@ -1212,22 +2035,118 @@ namespace rg
         // End command buffer
         vk_check(vkEndCommandBuffer(frame.command_buffer));
 
+        // Submit the uploads recorded since the last frame, all at once
+        const uint64_t transfer_value = submit_transfers();
+
         // Submit command buffer
-        VkPipelineStageFlags wait_stage  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        VkSubmitInfo         submit_info = {};
-        submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.commandBufferCount   = 1;
-        submit_info.pCommandBuffers      = &frame.command_buffer;
-        submit_info.pWaitDstStageMask    = &wait_stage;
-        // Wait until the image to render is ready
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores    = &frame.present_semaphore;
+        VkPipelineStageFlags wait_stages[2]     = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT};
+        VkSemaphore          wait_semaphores[2] = {frame.present_semaphore, transfer_context.timeline};
+        // The value of the binary semaphore is ignored
+        uint64_t                      wait_values[2]       = {0, transfer_value};
+        VkTimelineSemaphoreSubmitInfo timeline_submit_info = {
+            .sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .pNext                     = nullptr,
+            .waitSemaphoreValueCount   = transfer_value != 0 ? 2u : 1u,
+            .pWaitSemaphoreValues      = wait_values,
+            .signalSemaphoreValueCount = 0,
+            .pSignalSemaphoreValues    = nullptr,
+        };
+        VkSubmitInfo submit_info       = {};
+        submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext              = &timeline_submit_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers    = &frame.command_buffer;
+        submit_info.pWaitDstStageMask  = wait_stages;
+        // Wait until the image to render is ready, and until the uploads it uses are done, if they aren't already
+        submit_info.waitSemaphoreCount = transfer_value != 0 ? 2 : 1;
+        submit_info.pWaitSemaphores    = wait_semaphores;
         // Signal the render semaphore when the rendering is done
         submit_info.signalSemaphoreCount = 1;
         submit_info.pSignalSemaphores    = &frame.render_semaphore;
 
         // Submit
         vk_check(vkQueueSubmit(graphics_queue.queue, 1, &submit_info, frame.render_fence), "Failed to submit command buffer");
+
+        // Its timestamps can be read once it is done
+        frame.has_timestamps = frame.timestamp_pool != VK_NULL_HANDLE;
+    }
+
+    void Renderer::Data::read_stage_gpu_times(FrameData &frame)
+    {
+        if (!frame.has_timestamps)
+        {
+            return;
+        }
+        frame.has_timestamps = false;
+
+        const auto      stage_count = render_pipeline_description.stages.size();
+        Array<uint64_t> timestamps(2 * stage_count);
+
+        // The fence of the frame was waited, so the results are available
+        const VkResult result = vkGetQueryPoolResults(device,
+                                                      frame.timestamp_pool,
+                                                      0,
+                                                      static_cast<uint32_t>(timestamps.size()),
+                                                      timestamps.size() * sizeof(uint64_t),
+                                                      timestamps.data(),
+                                                      sizeof(uint64_t),
+                                                      VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS)
+        {
+            return;
+        }
+
+        // Convert the ticks to milliseconds
+        const double period = static_cast<double>(device_properties.limits.timestampPeriod) / 1000000.0;
+        for (size_t i = 0; i < stage_count; i++)
+        {
+            stage_gpu_times[i] = static_cast<double>(timestamps[2 * i + 1] - timestamps[2 * i]) * period;
+        }
+    }
+
+    void Renderer::Data::read_draw_statistics(FrameData &frame, size_t frame_index)
+    {
+        // The fence of the frame was waited, so the results that the GPU culling copied are available
+        for (auto &swapchain : swapchains)
+        {
+            for (auto &stage : swapchain.render_stages)
+            {
+                auto &culled = stage.culled_draws[frame_index];
+                if (culled.readback_phase_count == 0)
+                {
+                    continue;
+                }
+
+                const auto counts_size   = culled.readback_phase_count * stage.batches.size() * sizeof(uint32_t);
+                const auto commands_size = culled.readback_phase_count * stage.draw_count * sizeof(VkDrawIndexedIndirectCommand);
+                allocator.invalidate_buffer(culled.count_readback_buffer, 0, counts_size);
+                allocator.invalidate_buffer(culled.command_readback_buffer, 0, commands_size);
+
+                // Each batch starts at the same offset as in the stage's indirect buffer, with its visible draws
+                const auto *counts   = static_cast<const uint32_t *>(culled.count_readback_buffer.mapped_data);
+                const auto *commands = static_cast<const VkDrawIndexedIndirectCommand *>(culled.command_readback_buffer.mapped_data);
+                for (uint32_t phase = 0; phase < culled.readback_phase_count; phase++)
+                {
+                    const auto *phase_counts   = counts + phase * stage.batches.size();
+                    const auto *phase_commands = commands + phase * stage.draw_count;
+                    for (size_t batch_i = 0; batch_i < stage.batches.size(); batch_i++)
+                    {
+                        const auto &batch = stage.batches[batch_i];
+                        const uint32_t visible_draw_count = std::min(phase_counts[batch_i], static_cast<uint32_t>(batch.count));
+                        for (uint32_t draw_i = 0; draw_i < visible_draw_count; draw_i++)
+                        {
+                            const auto &command = phase_commands[batch.offset + draw_i];
+                            frame.draw_statistics.visible_instance_count += command.instanceCount;
+                            frame.draw_statistics.visible_draw_count += command.instanceCount > 0 ? 1 : 0;
+                        }
+                    }
+                }
+                culled.readback_phase_count = 0;
+            }
+        }
+
+        draw_statistics       = frame.draw_statistics;
+        frame.draw_statistics = {};
     }
 
     // endregion
@@ -1263,6 +2182,8 @@ namespace rg
                 vkDestroySampler(device, texture.sampler, nullptr);
             }
             stage.output_textures.clear();
+
+            destroy_depth_pyramid(stage);
         }
 
         // Destroy swapchain
@@ -1287,6 +2208,7 @@ namespace rg
                 {
                     allocator.destroy_buffer(stage.indirect_buffer);
                 }
+                destroy_culling_buffers(stage);
             }
 
             destroy_swapchain_inner(swapchain);
@@ -1425,13 +2347,19 @@ namespace rg
                 // Depth image
                 else if (attachment_desc.final_layout == ImageLayout::DEPTH_STENCIL_OPTIMAL)
                 {
-                    const VkExtent3D depth_image_extent = {extent.width, extent.height, 1};
+                    // With occlusion culling, the depth is read to build the depth pyramid
+                    const VkExtent3D  depth_image_extent = {extent.width, extent.height, 1};
+                    VkImageUsageFlags depth_image_usage  = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+                    if (render_stages[stage_i].occlusion_culling)
+                    {
+                        depth_image_usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+                    }
                     for (uint32_t image_i = 0; image_i < swapchain.image_count; image_i++)
                     {
                         stage.attachments[image_i][attachment_i] =
                             allocator.create_image(convert_format(attachment_desc.format, swapchain.image_format.format),
                                                    depth_image_extent,
-                                                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                                                   depth_image_usage,
                                                    VK_IMAGE_ASPECT_DEPTH_BIT,
                                                    VMA_MEMORY_USAGE_GPU_ONLY);
                     }
@@ -1527,6 +2455,12 @@ namespace rg
                 vk_check(vkCreateFramebuffer(device, &framebuffer_create_info, nullptr, &stage.framebuffers[image_i]),
                          "Failed to create framebuffer");
             }
+
+            // The depth pyramid has the same lifetime as the depth attachments it is built from
+            if (render_stages[stage_i].occlusion_culling)
+            {
+                create_depth_pyramid(swapchain, stage, stage_i);
+            }
         }
     }
 
@@ -1697,16 +2631,32 @@ namespace rg
             // Build all effects
             for (const auto &effect : shader_effects)
             {
-                // Don't build a pipeline that is already built
-                const ShaderEffectId &effect_id = effect.key();
-                auto                  pipeline  = swapchain.pipelines.get(effect_id);
+                // Only the stages that use the material system have vertex input, so the other ones only need one pipeline
+                bool has_vertex_input = false;
+                for (const auto &stage_desc : render_pipeline_description.stages)
+                {
+                    if (stage_desc.kind == effect.value().render_stage_kind)
+                    {
+                        has_vertex_input = stage_desc.uses_material_system;
+                        break;
+                    }
+                }
+                const auto format_count = has_vertex_input ? VERTEX_FORMAT_COUNT : 1;
 
-                if (!pipeline.has_value())
+                for (uint32_t format_i = 0; format_i < format_count; format_i++)
                 {
-                    // Store the pipeline with the same id as the effect
-                    // That way, we can easily find the pipeline of a given effect
-                    swapchain.pipelines.set(effect_id,
-                                            HashMap::Value {.as_ptr = build_shader_effect(swapchain.viewport_extent, effect.value())});
+                    // Don't build a pipeline that is already built
+                    const ShaderEffectId &effect_id = effect.key();
+                    auto                 &pipelines = swapchain.pipelines[format_i];
+
+                    if (!pipelines.get(effect_id).has_value())
+                    {
+                        // Store the pipeline with the same id as the effect
+                        // That way, we can easily find the pipeline of a given effect
+                        const auto format   = static_cast<VertexFormat>(format_i);
+                        const auto pipeline = build_shader_effect(swapchain.viewport_extent, effect.value(), format);
+                        pipelines.set(effect_id, HashMap::Value {.as_ptr = pipeline});
+                    }
                 }
             }
 
@@ -1715,13 +2665,28 @@ namespace rg
         }
     }
 
-    VkPipeline Renderer::Data::build_shader_effect(const VkExtent2D &viewport_extent, const ShaderEffect &effect)
+    VkPipeline Renderer::Data::build_shader_effect(const VkExtent2D &viewport_extent, const ShaderEffect &effect, VertexFormat format)
     {
         // This function will take the m_data contained in the effect and build a pipeline with it
         // First, create all the structs we will need in the pipeline create info
 
         // region Create shader stages
 
+        // The vertex shaders can read the vertex format in the specialization constant 0, to decode the compressed attributes
+        // The constant is ignored by the shaders that don't declare it
+        const auto                     format_constant = static_cast<uint32_t>(format);
+        const VkSpecializationMapEntry format_map_entry {
+            .constantID = VERTEX_FORMAT_CONSTANT_ID,
+            .offset     = 0,
+            .size       = sizeof(uint32_t),
+        };
+        const VkSpecializationInfo vertex_specialization_info {
+            .mapEntryCount = 1,
+            .pMapEntries   = &format_map_entry,
+            .dataSize      = sizeof(uint32_t),
+            .pData         = &format_constant,
+        };
+
         Array<VkPipelineShaderStageCreateInfo> stages(effect.shader_stages.size());
         for (auto i = 0; i < effect.shader_stages.size(); i++)
         {
@@ -1746,7 +2711,7 @@ namespace rg
                 .stage               = stage_flags,
                 .module              = module->module,
                 .pName               = "main",
-                .pSpecializationInfo = nullptr,
+                .pSpecializationInfo = module->stage == ShaderStage::VERTEX ? &vertex_specialization_info : nullptr,
             };
         }
 
@@ -1786,7 +2751,7 @@ namespace rg
         const bool has_vertex_input = render_pipeline_description.stages[stage_index].uses_material_system;
         if (has_vertex_input)
         {
-            const auto vertex_input_description = get_vertex_description();
+            const auto vertex_input_description = get_vertex_description(format);
 
             vertex_input_state_create_info.flags                           = vertex_input_description.flags;
             vertex_input_state_create_info.vertexBindingDescriptionCount   = vertex_input_description.binding_count;
@@ -1969,13 +2934,16 @@ namespace rg
     void Renderer::Data::clear_pipelines(Swapchain &swapchain) const
     {
         // Destroy all pipelines
-        for (auto pipeline : swapchain.pipelines)
+        for (auto &pipelines : swapchain.pipelines)
         {
-            vkDestroyPipeline(device, static_cast<VkPipeline>(pipeline.value.as_ptr), nullptr);
-        }
+            for (auto pipeline : pipelines)
+            {
+                vkDestroyPipeline(device, static_cast<VkPipeline>(pipeline.value.as_ptr), nullptr);
+            }
 
-        // Clear the map
-        swapchain.pipelines.clear();
+            // Clear the map
+            pipelines.clear();
+        }
 
         // Reset the version
         swapchain.built_effects_version = 0;
@@ -1994,15 +2962,18 @@ namespace rg
     {
         if (swapchain.enabled)
         {
-            // Get the pipeline
-            auto pipeline = swapchain.pipelines.get(effect_id);
-            if (pipeline.has_value())
+            for (auto &pipelines : swapchain.pipelines)
             {
-                // Destroy the pipeline
-                vkDestroyPipeline(device, static_cast<VkPipeline>(pipeline.value()->as_ptr), nullptr);
+                // Get the pipeline
+                auto pipeline = pipelines.get(effect_id);
+                if (pipeline.has_value())
+                {
+                    // Destroy the pipeline
+                    vkDestroyPipeline(device, static_cast<VkPipeline>(pipeline.value()->as_ptr), nullptr);
 
-                // Remove the pipeline from the map
-                swapchain.pipelines.remove(effect_id);
+                    // Remove the pipeline from the map
+                    pipelines.remove(effect_id);
+                }
             }
         }
     }
@@ -2015,8 +2986,29 @@ namespace rg
     {
         if (draw_cache_version > swapchain.built_draw_cache_version)
         {
-            // For each stages
-            for (size_t stage_i = 0; stage_i < render_pipeline_description.stages.size(); stage_i++)
+            draw_cache_skips_uploads = false;
+
+            // A material can only be drawn once its textures are uploaded
+            const auto is_material_resident = [this](const Material &material)
+            {
+                for (const auto &effect_textures : material.textures)
+                {
+                    for (const auto &texture_id : effect_textures)
+                    {
+                        const auto texture = textures.get(texture_id);
+                        if (texture.has_value() && !texture->is_resident)
+                        {
+                            // Textures that failed to load are never uploaded, the cache doesn't need to wait for them
+                            draw_cache_skips_uploads |= !texture->has_failed;
+                            return false;
+                        }
+                    }
+                }
+                return true;
+            };
+
+            // For each stages
+            for (size_t stage_i = 0; stage_i < render_pipeline_description.stages.size(); stage_i++)
             {
                 auto       &stage      = swapchain.render_stages[stage_i];
                 const auto &stage_desc = render_pipeline_description.stages[stage_i];
@@ -2038,45 +3030,110 @@ namespace rg
                         // If the effect supports that kind
                         if (effect.value().render_stage_kind == stage_desc.kind)
                         {
-                            // Get the pipeline
-                            auto pipeline = swapchain.pipelines.get(effect.key());
-                            check(pipeline.has_value(), "Tried to draw a shader effect that was not built.");
+                            // Get the pipelines, one per vertex format
+                            VkPipeline pipelines[VERTEX_FORMAT_COUNT] = {};
+                            for (uint32_t format_i = 0; format_i < VERTEX_FORMAT_COUNT; format_i++)
+                            {
+                                auto pipeline = swapchain.pipelines[format_i].get(effect.key());
+                                check(pipeline.has_value(), "Tried to draw a shader effect that was not built.");
+                                pipelines[format_i] = static_cast<VkPipeline>(pipeline.value()->as_ptr);
+                            }
 
-                            // For each material template
+                            // Find the materials using a template using that effect, that have at least one model to render
+                            // Their textures also need to be uploaded
+                            // Note: if this becomes to computationally intensive, we could register materials in the template
+                            // like we do with the models
+                            Vector<MaterialId> effect_materials(8);
                             for (const auto &mat_template : material_templates)
                             {
-                                // If the template has that effect
-                                auto effect_i_in_mat = mat_template.value().shader_effects.find_first_of(effect.key());
-                                if (effect_i_in_mat.has_value())
+                                if (mat_template.value().shader_effects.find_first_of(effect.key()).has_value())
                                 {
-                                    // For each material
-                                    // Note: if this becomes to computationally intensive, we could register materials in the template
-                                    // like we do with the models
                                     for (const auto &material : materials)
                                     {
-                                        // Get the textures' descriptor set for this effect
-                                        check(material.value().textures_sets.size() > effect_i_in_mat.value(),
-                                              "The used texture is not present in the material.");
-                                        VkDescriptorSet textures_set = material.value().textures_sets[effect_i_in_mat.value()];
-
-                                        // If the material has that template and there is at least one model to render
                                         if (material.value().template_id == mat_template.key()
-                                            && !material.value().models_using_material.is_empty())
+                                            && !material.value().models_using_material.is_empty()
+                                            && is_material_resident(material.value()))
                                         {
-                                            // Add a render batch
-                                            // Even though we could for now regroup them by shader effect instead of materials, this
-                                            // may change when we will add descriptor sets So we split batches by materials However, we
-                                            // won't bind a pipeline if it is the same as before, and batches are sorted by effect
-                                            stage.batches.push_back(RenderBatch {
-                                                stage_models.size(),
-                                                material.value().models_using_material.size(),
-                                                static_cast<VkPipeline>(pipeline.value()->as_ptr),
-                                                effect.value().pipeline_layout,
-                                                textures_set,
-                                            });
+                                            effect_materials.push_back(material.key());
+                                        }
+                                    }
+                                }
+                            }
+
+                            // Each material binds its own textures set, so the batches are split by materials. We won't bind a
+                            // pipeline if it is the same as before, and batches are sorted by effect.
+                            // With bindless textures, the materials share the same set, so all of them are drawn together.
+                            const size_t group_size = uses_bindless_textures ? effect_materials.size() : 1;
+                            for (size_t group_start = 0; group_start < effect_materials.size(); group_start += group_size)
+                            {
+                                // Get the textures' descriptor sets of each frame for this effect
+                                VkDescriptorSet textures_sets[NB_OVERLAPPING_FRAMES];
+                                for (uint32_t frame_i = 0; frame_i < NB_OVERLAPPING_FRAMES; frame_i++)
+                                {
+                                    textures_sets[frame_i] = bindless_sets[frame_i];
+                                }
+                                if (!uses_bindless_textures)
+                                {
+                                    const auto &material         = materials[effect_materials[group_start]];
+                                    const auto &template_effects = material_templates[material.template_id].shader_effects;
+                                    const auto  effect_i_in_mat  = template_effects.find_first_of(effect.key());
+                                    const auto  first_set        = effect_i_in_mat.value() * NB_OVERLAPPING_FRAMES;
+                                    check(material.textures_sets.size() >= first_set + NB_OVERLAPPING_FRAMES,
+                                          "The used texture is not present in the material.");
+                                    for (uint32_t frame_i = 0; frame_i < NB_OVERLAPPING_FRAMES; frame_i++)
+                                    {
+                                        textures_sets[frame_i] = material.textures_sets[first_set + frame_i];
+                                    }
+                                }
+
+                                // The mesh parts of a batch also need the same vertex format and index size, so the models of the
+                                // materials are split by those
+                                for (uint32_t format_i = 0; format_i < VERTEX_FORMAT_COUNT; format_i++)
+                                {
+                                    for (const auto index_type : {VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32})
+                                    {
+                                        // Add the models using those materials with that layout
+                                        const auto first_model = stage_models.size();
+                                        for (size_t material_i = group_start; material_i < group_start + group_size; material_i++)
+                                        {
+                                            for (const auto &model_id : materials[effect_materials[material_i]].models_using_material)
+                                            {
+                                                // Models whose part isn't uploaded yet are skipped
+                                                const auto &part = mesh_parts[models[model_id].mesh_part_id];
+                                                if (!part.is_uploaded)
+                                                {
+                                                    draw_cache_skips_uploads = true;
+                                                }
+                                                else if (static_cast<uint32_t>(part.vertex_format) == format_i
+                                                         && part.index_type == index_type)
+                                                {
+                                                    stage_models.push_back(model_id);
+                                                }
+                                            }
+                                        }
 
-                                            // Add the models using that material
-                                            stage_models.extend(material.value().models_using_material);
+                                        if (stage_models.size() > first_model)
+                                        {
+                                            // Models using the same mesh part are put next to each other, so that they are drawn
+                                            // with the same draws
+                                            std::stable_sort(stage_models.data() + first_model,
+                                                             stage_models.data() + stage_models.size(),
+                                                             [this](ModelId a, ModelId b)
+                                                             { return models[a].mesh_part_id < models[b].mesh_part_id; });
+                                            RenderBatch batch = {
+                                                first_model,
+                                                stage_models.size() - first_model,
+                                                pipelines[format_i],
+                                                effect.value().pipeline_layout,
+                                                {},
+                                                index_type,
+                                                effect.key(),
+                                            };
+                                            for (uint32_t frame_i = 0; frame_i < NB_OVERLAPPING_FRAMES; frame_i++)
+                                            {
+                                                batch.textures_sets[frame_i] = textures_sets[frame_i];
+                                            }
+                                            stage.batches.push_back(batch);
                                         }
                                     }
                                 }
@@ -2085,59 +3142,268 @@ namespace rg
                     }
 
                     // If there is something to render
+                    stage.draw_count                = 0;
+                    stage.instance_count            = 0;
+                    stage.visible_instance_capacity = 0;
                     if (!stage_models.is_empty())
                     {
-                        // Prepare draw indirect commands
-                        const VkBufferUsageFlags indirect_buffer_usage = VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
-                                                                         | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-                                                                         | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-                        const VmaMemoryUsage indirect_buffer_memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-                        const size_t required_indirect_buffer_size        = stage_models.size() * sizeof(VkDrawIndexedIndirectCommand);
-
-                        // If it does not exist, create it
-                        if (stage.indirect_buffer.buffer == VK_NULL_HANDLE)
+                        // Each mesh part of a batch has a draw per level of detail, shared by all the models using it. The ranges of
+                        // the batches are thus converted from models to draws. The models of batch i are the ones between offsets i
+                        // and i + 1.
+                        Array<size_t> batch_model_offsets(stage.batches.size() + 1);
+                        uint32_t      stage_instance_count = 0;
+                        for (uint32_t batch_i = 0; batch_i < stage.batches.size(); batch_i++)
                         {
-                            stage.indirect_buffer = allocator.create_buffer(required_indirect_buffer_size,
-                                                                            indirect_buffer_usage,
-                                                                            indirect_buffer_memory_usage);
+                            auto &batch                      = stage.batches[batch_i];
+                            batch_model_offsets[batch_i]     = batch.offset;
+                            batch_model_offsets[batch_i + 1] = batch.offset + batch.count;
+
+                            batch.offset = stage.draw_count;
+                            for (auto i = batch_model_offsets[batch_i]; i < batch_model_offsets[batch_i + 1]; ++i)
+                            {
+                                const auto &model          = models[stage_models[i]];
+                                const auto &part           = mesh_parts[model.mesh_part_id];
+                                const auto  lod_count      = static_cast<uint32_t>(part.lods.size());
+                                const auto  instance_count = static_cast<uint32_t>(model.instances.size());
+
+                                const bool is_first_of_part = i == batch_model_offsets[batch_i]
+                                                           || models[stage_models[i - 1]].mesh_part_id != model.mesh_part_id;
+                                if (is_first_of_part)
+                                {
+                                    stage.draw_count += lod_count;
+                                }
+                                stage_instance_count += instance_count;
+                                stage.visible_instance_capacity += lod_count * instance_count;
+                            }
+                            batch.count = stage.draw_count - batch.offset;
                         }
-                        // If it exists but isn't big enough, recreate it
-                        else if (stage.indirect_buffer.size < required_indirect_buffer_size)
+
+                        // Prepare buffers
+                        // The indirect buffer is used when GPU culling is disabled
+                        // The draw and instance buffers are the inputs of the culling shader
+                        // They are rewritten from the CPU while the frames in flight may still read them, so they are replaced
+                        retire_buffer(stage.indirect_buffer);
+                        retire_buffer(stage.draw_buffer);
+                        retire_buffer(stage.instance_buffer);
+                        reserve_buffer(stage.indirect_buffer,
+                                       stage.draw_count * sizeof(VkDrawIndexedIndirectCommand),
+                                       VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                       VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                       true);
+                        reserve_buffer(stage.draw_buffer,
+                                       stage.draw_count * sizeof(GPUDrawData),
+                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                       VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                       true);
+                        // There is at least one instance slot, so that the buffer always exists for the vertex input
+                        const bool instance_buffer_reallocated =
+                            reserve_buffer(stage.instance_buffer,
+                                           std::max(stage_instance_count, 1u) * sizeof(GPUInstanceData),
+                                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                           VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                           true);
+
+                        // The CPU culling reads its own copy, since reading from mapped memory is slow
+                        if (uses_cpu_culling())
                         {
-                            allocator.destroy_buffer(stage.indirect_buffer);
-                            stage.indirect_buffer = allocator.create_buffer(required_indirect_buffer_size,
-                                                                            indirect_buffer_usage,
-                                                                            indirect_buffer_memory_usage);
+                            if (stage.cpu_commands.size() < stage.draw_count)
+                            {
+                                stage.cpu_commands = Array<VkDrawIndexedIndirectCommand>(stage.draw_count);
+                                stage.cpu_draws    = Array<GPUDrawData>(stage.draw_count);
+                            }
+                            if (stage.cpu_instances.size() < std::max(stage_instance_count, 1u))
+                            {
+                                stage.cpu_instances = Array<GPUInstanceData>(std::max(stage_instance_count, 1u));
+                            }
                         }
 
-                        // At this point, we have an indirect buffer big enough to hold the commands we want to register
+                        // At this point, we have buffers big enough to hold the commands we want to register
 
                         // Register commands
-                        auto *indirect_commands =
-                            static_cast<VkDrawIndexedIndirectCommand *>(allocator.map_buffer(stage.indirect_buffer));
+                        auto *indirect_commands = static_cast<VkDrawIndexedIndirectCommand *>(stage.indirect_buffer.mapped_data);
+                        auto *draws             = static_cast<GPUDrawData *>(stage.draw_buffer.mapped_data);
+                        auto *instances         = static_cast<GPUInstanceData *>(stage.instance_buffer.mapped_data);
+
+                        uint32_t draw_i         = 0;
+                        uint32_t visible_offset = 0;
+                        for (uint32_t batch_i = 0; batch_i < stage.batches.size(); batch_i++)
+                        {
+                            const auto &batch = stage.batches[batch_i];
+                            for (auto i = batch_model_offsets[batch_i]; i < batch_model_offsets[batch_i + 1];)
+                            {
+                                // Get mesh
+                                const auto mesh_part_id = models[stage_models[i]].mesh_part_id;
+                                const auto mesh_res     = mesh_parts.get(mesh_part_id);
+                                check(mesh_res.has_value(), "Tried to draw a mesh part that doesn't exist.");
+                                const auto &part = mesh_res.value();
+                                check(part.is_uploaded, "Tried to draw a mesh part that hasn't been uploaded.");
+
+                                // The instances of the models using that part are stored contiguously in the instance buffer of the
+                                // stage, so that they are drawn together. This is where saving the same mesh part several times pays
+                                // off: the copies are the same part, and thus a single instanced draw.
+                                // They reference the draw of the base level, the culling then moves them to the draw of their level
+                                uint32_t part_instance_count = 0;
+                                for (; i < batch_model_offsets[batch_i + 1]; ++i)
+                                {
+                                    const auto model_res = models.get(stage_models[i]);
+                                    check(model_res.has_value(), "Tried to draw a model that doesn't exist.");
+                                    const auto &model = model_res.value();
+                                    if (model.mesh_part_id != mesh_part_id)
+                                    {
+                                        break;
+                                    }
+
+                                    // With bindless textures, the instances tell the shaders where the texture slots of their
+                                    // material are, since a batch can contain several materials
+                                    uint32_t material_index = 0;
+                                    if (uses_bindless_textures)
+                                    {
+                                        const auto &material = materials[model.material_id];
+                                        const auto  effect_i =
+                                            material_templates[material.template_id].shader_effects.find_first_of(batch.effect_id);
+                                        material_index = material.texture_table_offsets[effect_i.value()];
+                                    }
+
+                                    const auto model_instance_count = static_cast<uint32_t>(model.instances.size());
+                                    for (uint32_t instance_i = 0; instance_i < model_instance_count; instance_i++)
+                                    {
+                                        instances[stage.instance_count + part_instance_count + instance_i] = GPUInstanceData {
+                                            .object_index   = model.first_instance + instance_i,
+                                            .draw_index     = draw_i,
+                                            .material_index = material_index,
+                                        };
+                                    }
+                                    part_instance_count += model_instance_count;
+                                }
+
+                                // The culling works with the transforms sent to the GPU, which include the dequantization of the
+                                // vertices. The bounds and errors are thus given in the space of the vertices.
+                                const float     inverse_scale = 1.0f / part.position_scale;
+                                const glm::vec3 sphere_center = glm::vec3(part.bounding_sphere) - part.position_offset;
+                                const glm::vec4 vertex_sphere(sphere_center * inverse_scale, part.bounding_sphere.w * inverse_scale);
+
+                                const auto &lods = part.lods;
+                                for (uint32_t lod_i = 0; lod_i < lods.size(); lod_i++, draw_i++)
+                                {
+                                    // Without culling, all the instances of the part are drawn at once with the base level
+                                    indirect_commands[draw_i] = VkDrawIndexedIndirectCommand {
+                                        .indexCount    = lods[lod_i].index_count,
+                                        .instanceCount = lod_i == 0 ? part_instance_count : 0,
+                                        .firstIndex    = static_cast<uint32_t>(part.index_offset) + lods[lod_i].first_index,
+                                        .vertexOffset  = static_cast<int32_t>(part.vertex_offset),
+                                        .firstInstance = stage.instance_count,
+                                    };
+
+                                    // Same for the culling, but it will count the visible instances of each level itself
+                                    // They are written in a range of the visible instances reserved for the level
+                                    draws[draw_i] = GPUDrawData {
+                                        .index_count     = indirect_commands[draw_i].indexCount,
+                                        .instance_count  = 0,
+                                        .first_index     = indirect_commands[draw_i].firstIndex,
+                                        .vertex_offset   = indirect_commands[draw_i].vertexOffset,
+                                        .first_instance  = visible_offset,
+                                        .batch_index     = batch_i,
+                                        .batch_offset    = static_cast<uint32_t>(batch.offset),
+                                        .lod_count       = lod_i == 0 ? static_cast<uint32_t>(lods.size()) : 0,
+                                        .bounding_sphere = vertex_sphere,
+                                        .lod_error       = lods[lod_i].error * inverse_scale,
+                                    };
+                                    visible_offset += part_instance_count;
+                                }
+
+                                stage.instance_count += part_instance_count;
+                            }
+                        }
 
-                        for (auto i = 0; i < stage_models.size(); ++i)
+                        if (uses_cpu_culling())
                         {
-                            // Get model
-                            const auto model_id  = stage_models[i];
-                            const auto model_res = models.get(model_id);
-                            check(model_res.has_value(), "Tried to draw a model that doesn't exist.");
-                            const auto &model = model_res.value();
-
-                            // Get mesh
-                            const auto mesh_res = mesh_parts.get(model.mesh_part_id);
-                            check(mesh_res.has_value(), "Tried to draw a mesh part that doesn't exist.");
-                            const auto &part = mesh_res.value();
-                            check(part.is_uploaded, "Tried to draw a mesh part that hasn't been uploaded.");
-
-                            indirect_commands[i].vertexOffset  = static_cast<int32_t>(part.vertex_offset);
-                            indirect_commands[i].indexCount    = part.mesh_part.triangle_count() * 3;
-                            indirect_commands[i].firstIndex    = part.index_offset;
-                            indirect_commands[i].instanceCount = 1; // TODO when instances are added
-                            indirect_commands[i].firstInstance = 0;
+                            memcpy(stage.cpu_commands.data(),
+                                   indirect_commands,
+                                   stage.draw_count * sizeof(VkDrawIndexedIndirectCommand));
+                            memcpy(stage.cpu_draws.data(), draws, stage.draw_count * sizeof(GPUDrawData));
+                            memcpy(stage.cpu_instances.data(), instances, stage.instance_count * sizeof(GPUInstanceData));
                         }
 
-                        allocator.unmap_buffer(stage.indirect_buffer);
+                        allocator.flush_buffer(stage.indirect_buffer, 0, stage.draw_count * sizeof(VkDrawIndexedIndirectCommand));
+                        allocator.flush_buffer(stage.draw_buffer, 0, stage.draw_count * sizeof(GPUDrawData));
+                        allocator.flush_buffer(stage.instance_buffer, 0, stage.instance_count * sizeof(GPUInstanceData));
+
+                        // Prepare the outputs of the culling shader, for each frame
+                        if (uses_gpu_culling())
+                        {
+                            for (auto &culled : stage.culled_draws)
+                            {
+                                if (!culled.draw_buffer.is_valid())
+                                {
+                                    culled.descriptor_pool = DynamicDescriptorPool(device, DescriptorBalance {0, 0, 7, 1, 0});
+                                }
+
+                                // The results read back from the frames in flight were written with the previous cache
+                                culled.readback_phase_count = 0;
+                                reserve_buffer(culled.count_readback_buffer,
+                                               MAX_CULLING_PHASE_COUNT * stage.batches.size() * sizeof(uint32_t),
+                                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                               true);
+                                reserve_buffer(culled.command_readback_buffer,
+                                               MAX_CULLING_PHASE_COUNT * stage.draw_count * sizeof(VkDrawIndexedIndirectCommand),
+                                               VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                               VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                               true);
+
+                                // The culling set also references the instance buffer of the stage
+                                bool reallocated = instance_buffer_reallocated;
+                                reallocated |= reserve_buffer(culled.draw_buffer,
+                                                              stage.draw_count * sizeof(GPUDrawData),
+                                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                              VMA_MEMORY_USAGE_GPU_ONLY);
+                                reallocated |= reserve_buffer(culled.indirect_buffer,
+                                                              stage.draw_count * sizeof(VkDrawIndexedIndirectCommand),
+                                                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                                                  | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                              VMA_MEMORY_USAGE_GPU_ONLY);
+                                reallocated |= reserve_buffer(culled.count_buffer,
+                                                              stage.batches.size() * sizeof(uint32_t),
+                                                              VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                                                  | VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+                                                                  | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                                              VMA_MEMORY_USAGE_GPU_ONLY);
+                                reallocated |= reserve_buffer(culled.visible_instance_buffer,
+                                                              std::max(stage.visible_instance_capacity, 1u) * sizeof(GPUInstanceData),
+                                                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                              VMA_MEMORY_USAGE_GPU_ONLY);
+                                if (uses_occlusion_culling(stage_i))
+                                {
+                                    reallocated |= reserve_buffer(culled.occlusion_buffer,
+                                                                  std::max(stage.instance_count, 1u) * sizeof(uint32_t),
+                                                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                                  VMA_MEMORY_USAGE_GPU_ONLY);
+                                }
+
+                                // The culling set needs to point to the new buffers
+                                if (reallocated)
+                                {
+                                    culled.built_buffers_config_version = 0;
+                                }
+                            }
+                        }
+                        // Same with CPU culling, but the outputs are written by the CPU
+                        else if (uses_cpu_culling())
+                        {
+                            for (auto &culled : stage.culled_draws)
+                            {
+                                reserve_buffer(culled.cpu_indirect_buffer,
+                                               stage.draw_count * sizeof(VkDrawIndexedIndirectCommand),
+                                               VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                               VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                               true);
+                                reserve_buffer(culled.cpu_visible_instance_buffer,
+                                               std::max(stage.visible_instance_capacity, 1u) * sizeof(GPUInstanceData),
+                                               VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                               VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                               true);
+                            }
+                        }
                     }
                 }
             }
@@ -2146,511 +3412,3079 @@ namespace rg
             swapchain.built_draw_cache_version = draw_cache_version;
         }
     }
-    void Renderer::Data::draw_from_cache(const RenderStageInstance &stage,
-                                         VkCommandBuffer            cmd,
-                                         FrameData                 &current_frame,
-                                         size_t                     window_index) const
+
+    // region GPU culling
+
+    VkPipeline Renderer::Data::create_compute_pipeline(ShaderModuleId shader, VkPipelineLayout layout, const char *name) const
     {
-        constexpr uint32_t draw_stride        = sizeof(VkDrawIndexedIndirectCommand);
-        VkPipeline         bound_pipeline     = VK_NULL_HANDLE;
-        bool               global_sets_bound  = false;
-        VkDescriptorSet    bound_textures_set = VK_NULL_HANDLE;
+        auto module = shader_modules.get(shader);
+        check(module.has_value(), std::string(name) + " shader module doesn't exist.");
+        check(module->stage == ShaderStage::COMPUTE, std::string(name) + " shader module must be a compute shader.");
 
-        if (stage.batches.is_empty())
+        VkComputePipelineCreateInfo pipeline_create_info = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage =
+                {
+                    .sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .pNext               = nullptr,
+                    .flags               = 0,
+                    .stage               = VK_SHADER_STAGE_COMPUTE_BIT,
+                    .module              = module->module,
+                    .pName               = "main",
+                    .pSpecializationInfo = nullptr,
+                },
+            .layout             = layout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex  = -1,
+        };
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        vk_check(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_create_info, nullptr, &pipeline),
+                 "Failed to create " + std::string(name) + " pipeline");
+
+        return pipeline;
+    }
+
+    bool Renderer::Data::uses_gpu_culling() const
+    {
+        return culling_pipeline != VK_NULL_HANDLE;
+    }
+
+    void Renderer::Data::destroy_culling_buffers(RenderStageInstance &stage) const
+    {
+        allocator.destroy_buffer(stage.draw_buffer);
+        allocator.destroy_buffer(stage.instance_buffer);
+
+        for (auto &culled : stage.culled_draws)
         {
-            // Nothing to draw
-            return;
+            allocator.destroy_buffer(culled.draw_buffer);
+            allocator.destroy_buffer(culled.indirect_buffer);
+            allocator.destroy_buffer(culled.count_buffer);
+            allocator.destroy_buffer(culled.visible_instance_buffer);
+            allocator.destroy_buffer(culled.cpu_indirect_buffer);
+            allocator.destroy_buffer(culled.cpu_visible_instance_buffer);
+            allocator.destroy_buffer(culled.occlusion_buffer);
+            allocator.destroy_buffer(culled.count_readback_buffer);
+            allocator.destroy_buffer(culled.command_readback_buffer);
+            culled.readback_phase_count = 0;
+            culled.descriptor_pool.clear();
+            culled.culling_set                  = VK_NULL_HANDLE;
+            culled.occlusion_set                = VK_NULL_HANDLE;
+            culled.built_buffers_config_version = 0;
         }
+    }
 
-        // For each batch
-        for (const auto &batch : stage.batches)
-        {
-            // If the pipeline is different from the last one, bind it
-            if (bound_pipeline != batch.pipeline)
-            {
-                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline);
-                bound_pipeline = batch.pipeline;
-            }
+    void Renderer::Data::update_culling_sets(RenderStageInstance &stage,
+                                             bool                 occlusion_culling,
+                                             FrameData           &frame,
+                                             size_t               frame_index) const
+    {
+        auto &culled = stage.culled_draws[frame_index];
 
-            // The first iteration, bind global sets
-            if (!global_sets_bound)
-            {
-                uint32_t                     camera_buffer_offset = pad_uniform_buffer_size(sizeof(GPUCameraData)) * window_index;
-                const Array<uint32_t>        offsets              = {camera_buffer_offset};
-                const Array<VkDescriptorSet> sets                 = {current_frame.swapchain_set, current_frame.global_set};
-                vkCmdBindDescriptorSets(cmd,
-                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                        batch.pipeline_layout,
-                                        0,
-                                        sets.size(),
-                                        sets.data(),
-                                        offsets.size(),
-                                        offsets.data());
-                global_sets_bound = true;
-            }
+        // Nothing to cull in that stage
+        if (!culled.draw_buffer.is_valid())
+        {
+            return;
+        }
 
-            // Rebind descriptor set if it is different
-            if (bound_textures_set != batch.textures_set && batch.textures_set != VK_NULL_HANDLE)
+        // The set also contains the object buffer of the frame, so it needs to be rebuilt when the global sets are
+        // The occlusion set contains the depth pyramid, which is recreated with the swapchain
+        const bool occlusion_set_outdated =
+            occlusion_culling
+            && (culled.occlusion_set == VK_NULL_HANDLE || culled.built_depth_pyramid_version != stage.depth_pyramid_version);
+        if (culled.built_buffers_config_version < buffer_config_version || occlusion_set_outdated)
+        {
+            vk_check(culled.descriptor_pool.reset());
+            culled.culling_set   = VK_NULL_HANDLE;
+            culled.occlusion_set = VK_NULL_HANDLE;
+
+            DescriptorSetBuilder builder(device, culled.descriptor_pool);
+            builder.add_storage_buffer(frame.object_info_buffer.buffer, sizeof(GPUObjectData) * object_data_capacity)
+                .add_storage_buffer(stage.instance_buffer.buffer, stage.instance_buffer.size)
+                .add_storage_buffer(culled.draw_buffer.buffer, culled.draw_buffer.size)
+                .add_storage_buffer(culled.visible_instance_buffer.buffer, culled.visible_instance_buffer.size)
+                .add_storage_buffer(culled.indirect_buffer.buffer, culled.indirect_buffer.size)
+                .add_storage_buffer(culled.count_buffer.buffer, culled.count_buffer.size)
+                .save_descriptor_set(culling_set_layout, &culled.culling_set);
+
+            if (occlusion_culling)
             {
-                vkCmdBindDescriptorSets(cmd,
-                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                        batch.pipeline_layout,
-                                        2, // We have two global sets before, so this one is the third
-                                        1,
-                                        &batch.textures_set,
-                                        0,
-                                        nullptr);
-                bound_textures_set = batch.textures_set;
+                builder.add_storage_buffer(culled.occlusion_buffer.buffer, culled.occlusion_buffer.size)
+                    .add_combined_image_sampler(stage.depth_pyramid_sampler, stage.depth_pyramid.image_view, VK_IMAGE_LAYOUT_GENERAL)
+                    .save_descriptor_set(occlusion_set_layout, &culled.occlusion_set);
+                culled.built_depth_pyramid_version = stage.depth_pyramid_version;
             }
 
-            // Draw the batch
-            const uint32_t &&draw_offset = draw_stride * batch.offset;
+            vk_check(builder.build(), "Couldn't build culling descriptor set.");
 
-            vkCmdDrawIndexedIndirect(cmd, stage.indirect_buffer.buffer, draw_offset, batch.count, draw_stride);
+            culled.built_buffers_config_version = buffer_config_version;
         }
     }
 
-    void Renderer::Data::draw_quad(const Swapchain &swapchain,
-                                   size_t           stage_index,
-                                   size_t           image_index,
-                                   VkCommandBuffer  cmd,
-                                   FrameData       &current_frame,
-                                   size_t           window_index) const
+    /** Makes the writes of the source stages visible to the reads of the destination stages. */
+    void insert_memory_barrier(VkCommandBuffer      cmd,
+                               VkPipelineStageFlags src_stages,
+                               VkAccessFlags        src_access,
+                               VkPipelineStageFlags dst_stages,
+                               VkAccessFlags        dst_access)
     {
-        auto &stage_desc = render_pipeline_description.stages[stage_index];
+        VkMemoryBarrier barrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext         = nullptr,
+            .srcAccessMask = src_access,
+            .dstAccessMask = dst_access,
+        };
+        vkCmdPipelineBarrier(cmd, src_stages, dst_stages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
 
-        // Get global effect id for current stage
-        auto id_result = global_shader_effects.get(static_cast<HashMap::Key>(stage_desc.kind));
-        check(id_result.has_value() && id_result.value()->as_size != NULL_ID,
-              "Missing global shader effect for stage \"" + std::string(stage_desc.name) + "\"");
-        ShaderEffectId id = id_result.value()->as_size;
+    void Renderer::Data::reset_culled_draws(const RenderStageInstance &stage, const CulledDraws &culled, VkCommandBuffer cmd) const
+    {
+        // Reset the counters: the draws are copied with an instance count of 0, and the command counts are set to 0
+        VkBufferCopy draws_copy = {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size      = stage.draw_count * sizeof(GPUDrawData),
+        };
+        vkCmdCopyBuffer(cmd, stage.draw_buffer.buffer, culled.draw_buffer.buffer, 1, &draws_copy);
+        vkCmdFillBuffer(cmd, culled.count_buffer.buffer, 0, stage.batches.size() * sizeof(uint32_t), 0);
+
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    }
 
-        // Using the id, find the effect
-        auto effect_result = shader_effects.get(id);
-        check(effect_result.has_value(),
-              "Invalid global shader effect for stage \"" + std::string(stage_desc.name)
-                  + "\". The stored id doesn't belong to any existing shader effect.");
-        auto &effect = effect_result.value();
+    void Renderer::Data::copy_culling_results(const RenderStageInstance &stage,
+                                              CulledDraws               &culled,
+                                              VkCommandBuffer            cmd,
+                                              uint32_t                   phase) const
+    {
+        if (!culled.count_readback_buffer.is_valid() || !culled.command_readback_buffer.is_valid())
+        {
+            return;
+        }
 
-        // Bind global sets
-        uint32_t                     camera_buffer_offset = pad_uniform_buffer_size(sizeof(GPUCameraData)) * window_index;
-        const Array<uint32_t>        offsets              = {camera_buffer_offset};
-        const Array<VkDescriptorSet> sets                 = {current_frame.swapchain_set, current_frame.global_set};
-        vkCmdBindDescriptorSets(cmd,
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                effect.pipeline_layout,
-                                0,
-                                sets.size(),
-                                sets.data(),
-                                offsets.size(),
-                                offsets.data());
+        // Copy the counts and the compacted commands of the phase, to read them once the frame is done
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_ACCESS_TRANSFER_READ_BIT);
+
+        const VkBufferCopy counts_copy = {
+            .srcOffset = 0,
+            .dstOffset = phase * stage.batches.size() * sizeof(uint32_t),
+            .size      = stage.batches.size() * sizeof(uint32_t),
+        };
+        vkCmdCopyBuffer(cmd, culled.count_buffer.buffer, culled.count_readback_buffer.buffer, 1, &counts_copy);
+        const VkBufferCopy commands_copy = {
+            .srcOffset = 0,
+            .dstOffset = phase * stage.draw_count * sizeof(VkDrawIndexedIndirectCommand),
+            .size      = stage.draw_count * sizeof(VkDrawIndexedIndirectCommand),
+        };
+        vkCmdCopyBuffer(cmd, culled.indirect_buffer.buffer, culled.command_readback_buffer.buffer, 1, &commands_copy);
+
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_TRANSFER_BIT,
+                              VK_ACCESS_TRANSFER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_HOST_BIT,
+                              VK_ACCESS_HOST_READ_BIT);
+        culled.readback_phase_count = phase + 1;
+    }
 
-        // Bind attachment set if needed (to access output attachments of the previous stage, for example for lighting stage in
-        // deferred rendering).
-        if (stage_index != 0)
+    void Renderer::Data::cull_stage(RenderStageInstance &stage,
+                                    VkCommandBuffer      cmd,
+                                    size_t               frame_index,
+                                    const GPUCameraData &camera_data,
+                                    const LodSelection  &lod_selection) const
+    {
+        auto &culled = stage.culled_draws[frame_index];
+
+        // Nothing to cull
+        if (stage.draw_count == 0 || culled.culling_set == VK_NULL_HANDLE)
         {
-            auto &previous_stage = swapchain.render_stages[stage_index - 1];
-            if (!previous_stage.output_textures.is_empty())
-            {
-                VkDescriptorSet attachments_set = previous_stage.output_textures_set[image_index];
-                vkCmdBindDescriptorSets(cmd,
-                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                        effect.pipeline_layout,
-                                        2,
-                                        1,
-                                        &attachments_set,
-                                        0,
-                                        nullptr);
-            }
+            return;
         }
 
-        // Get the pipeline
-        auto pipeline = swapchain.pipelines.get(id);
-        check(pipeline.has_value(), "Tried to draw a shader effect that was not built.");
+        reset_culled_draws(stage, culled, cmd);
 
-        // Bind pipeline
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, static_cast<VkPipeline>(pipeline.value()->as_ptr));
+        // Bind the culling pipeline
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, culling_pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, culling_pipeline_layout, 0, 1, &culled.culling_set, 0, nullptr);
 
-        // Draw
-        vkCmdDraw(cmd, stage_desc.vertex_count, 1, 0, 0);
+        GPUCullingParameters parameters = {
+            .camera_position = lod_selection.camera_position,
+            .lod_factor      = lod_selection.factor,
+            .instance_count  = stage.instance_count,
+            .draw_count      = stage.draw_count,
+            .pass            = 0,
+        };
+        const auto frustum = Frustum::from_view_projection(camera_data.view_projection);
+        for (size_t i = 0; i < 6; i++)
+        {
+            parameters.frustum_planes[i] = frustum.planes[i];
+        }
+
+        // First pass: cull the instances
+        constexpr uint32_t group_size = 64;
+        vkCmdPushConstants(cmd, culling_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingParameters), &parameters);
+        vkCmdDispatch(cmd, (stage.instance_count + group_size - 1) / group_size, 1, 1);
+
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        // Second pass: compact the draws
+        parameters.pass = 1;
+        vkCmdPushConstants(cmd, culling_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GPUCullingParameters), &parameters);
+        vkCmdDispatch(cmd, (stage.draw_count + group_size - 1) / group_size, 1, 1);
+
+        // The results are then used by the indirect draws and as vertex input
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                              VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+        copy_culling_results(stage, culled, cmd, 0);
     }
 
     // endregion
 
-    // region Camera functions
+    // region Occlusion culling
 
-    void Renderer::Data::send_camera_data(size_t window_index, const Camera &camera, FrameData &current_frame)
+    bool Renderer::Data::uses_occlusion_culling(size_t stage_index) const
     {
-        // Get camera infos and send them to the shader
-        GPUCameraData camera_data = {};
-        Swapchain    &swapchain   = swapchains[window_index];
+        return render_stages[stage_index].occlusion_culling && occlusion_culling_pipeline != VK_NULL_HANDLE && uses_gpu_culling();
+    }
 
-        // Projection
-        switch (camera.type)
+    void Renderer::Data::create_depth_pyramid(Swapchain &swapchain, RenderStageInstance &stage, size_t stage_index) const
+    {
+        // Use the previous power of two of the viewport, so that each level is exactly half the size of the previous one
+        const auto previous_power_of_two = [](uint32_t value)
         {
-            case CameraType::PERSPECTIVE:
-                camera_data.projection = glm::perspective(camera.specs.as_perspective.fov,
-                                                          camera.specs.as_perspective.aspect_ratio,
-                                                          camera.specs.as_perspective.near_plane,
-                                                          camera.specs.as_perspective.far_plane);
-                camera_data.projection[1][1] *= -1;
-                break;
-            case CameraType::ORTHOGRAPHIC:
-                camera_data.projection = glm::ortho(-camera.specs.as_orthographic.width / 2.0f,
-                                                    camera.specs.as_orthographic.width / 2.0f,
-                                                    -camera.specs.as_orthographic.height / 2.0f,
-                                                    camera.specs.as_orthographic.height / 2.0f,
-                                                    camera.specs.as_orthographic.near_plane,
-                                                    camera.specs.as_orthographic.far_plane);
-                break;
+            uint32_t result = 1;
+            while (result * 2 <= value)
+            {
+                result *= 2;
+            }
+            return result;
+        };
+        stage.depth_pyramid_extent = {
+            previous_power_of_two(swapchain.viewport_extent.width),
+            previous_power_of_two(swapchain.viewport_extent.height),
+        };
+
+        // Go down to a single texel
+        stage.depth_pyramid_mip_count = 1;
+        for (auto size = std::max(stage.depth_pyramid_extent.width, stage.depth_pyramid_extent.height); size > 1; size /= 2)
+        {
+            stage.depth_pyramid_mip_count++;
         }
 
-        // View
-        camera_data.view = camera.transform.view_matrix();
-        // View projection
+        // The pyramid is written by the reduction shader and read by the next level and the culling shader
+        // It always stays in the general layout
+        const VkExtent3D pyramid_extent = {stage.depth_pyramid_extent.width, stage.depth_pyramid_extent.height, 1};
+        stage.depth_pyramid             = allocator.create_image(VK_FORMAT_R32_SFLOAT,
+                                                                 pyramid_extent,
+                                                                 VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                 VK_IMAGE_ASPECT_COLOR_BIT,
+                                                                 VMA_MEMORY_USAGE_GPU_ONLY,
+                                                                 false,
+                                                                 stage.depth_pyramid_mip_count);
+
+        // The reduction shader writes one level at a time, so it needs a view per level
+        stage.depth_pyramid_mip_views = Array<VkImageView>(stage.depth_pyramid_mip_count);
+        for (uint32_t level = 0; level < stage.depth_pyramid_mip_count; level++)
+        {
+            VkImageViewCreateInfo view_create_info = {
+                .sType    = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext    = nullptr,
+                .flags    = 0,
+                .image    = stage.depth_pyramid.image,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format   = VK_FORMAT_R32_SFLOAT,
+                .components =
+                    {
+                        .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                        .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                        .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                        .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+                    },
+                .subresourceRange =
+                    {
+                        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .baseMipLevel   = level,
+                        .levelCount     = 1,
+                        .baseArrayLayer = 0,
+                        .layerCount     = 1,
+                    },
+            };
+            vk_check(vkCreateImageView(device, &view_create_info, nullptr, &stage.depth_pyramid_mip_views[level]),
+                     "Failed to create depth pyramid view");
+        }
+
+        // The shaders read exact texels, so no filtering is needed
+        VkSamplerCreateInfo sampler_info = {
+            .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext                   = nullptr,
+            .flags                   = 0,
+            .magFilter               = VK_FILTER_NEAREST,
+            .minFilter               = VK_FILTER_NEAREST,
+            .mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .mipLodBias              = 0.0f,
+            .anisotropyEnable        = VK_FALSE,
+            .maxAnisotropy           = 1,
+            .compareEnable           = VK_FALSE,
+            .compareOp               = VK_COMPARE_OP_ALWAYS,
+            .minLod                  = 0.0f,
+            .maxLod                  = static_cast<float>(stage.depth_pyramid_mip_count),
+            .borderColor             = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+            .unnormalizedCoordinates = VK_FALSE,
+        };
+        vk_check(vkCreateSampler(device, &sampler_info, nullptr, &stage.depth_pyramid_sampler), "Failed to create sampler");
+
+        // Create the sets of the reduction shader
+        // They live as long as the swapchain, like the pyramid
+        const auto depth_attachment_index = render_stages[stage_index].depth_attachment_index;
+        stage.depth_pyramid_source_sets   = Array<VkDescriptorSet>(swapchain.image_count);
+        stage.depth_pyramid_reduce_sets   = Array<VkDescriptorSet>(stage.depth_pyramid_mip_count - 1);
+
+        DescriptorSetBuilder builder(device, swapchain.swapchain_static_descriptor_pool);
+        for (uint32_t image_i = 0; image_i < swapchain.image_count; image_i++)
+        {
+            builder
+                .add_combined_image_sampler(stage.depth_pyramid_sampler,
+                                            stage.attachments[image_i][depth_attachment_index].image_view,
+                                            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+                .add_storage_image(stage.depth_pyramid_mip_views[0])
+                .save_descriptor_set(depth_reduce_set_layout, &stage.depth_pyramid_source_sets[image_i]);
+        }
+        for (uint32_t level = 1; level < stage.depth_pyramid_mip_count; level++)
+        {
+            builder
+                .add_combined_image_sampler(stage.depth_pyramid_sampler,
+                                            stage.depth_pyramid_mip_views[level - 1],
+                                            VK_IMAGE_LAYOUT_GENERAL)
+                .add_storage_image(stage.depth_pyramid_mip_views[level])
+                .save_descriptor_set(depth_reduce_set_layout, &stage.depth_pyramid_reduce_sets[level - 1]);
+        }
+        vk_check(builder.build(), "Couldn't build depth pyramid descriptor sets.");
+
+        // The content of the new pyramid is undefined until it is built
+        stage.depth_pyramid_ready = false;
+        stage.depth_pyramid_version++;
+    }
+
+    void Renderer::Data::destroy_depth_pyramid(RenderStageInstance &stage) const
+    {
+        if (stage.depth_pyramid.image == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        // The sets are freed with the swapchain-static pool
+        for (auto &view : stage.depth_pyramid_mip_views)
+        {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        stage.depth_pyramid_mip_views = {};
+        vkDestroySampler(device, stage.depth_pyramid_sampler, nullptr);
+        stage.depth_pyramid_sampler = VK_NULL_HANDLE;
+        allocator.destroy_image(stage.depth_pyramid);
+
+        stage.depth_pyramid_source_sets = {};
+        stage.depth_pyramid_reduce_sets = {};
+        stage.depth_pyramid_ready       = false;
+    }
+
+    /** Creates a barrier that changes the layout of all the levels of an image. */
+    VkImageMemoryBarrier image_layout_barrier(VkImage            image,
+                                              VkImageAspectFlags aspect,
+                                              VkImageLayout      old_layout,
+                                              VkImageLayout      new_layout,
+                                              VkAccessFlags      src_access,
+                                              VkAccessFlags      dst_access)
+    {
+        return VkImageMemoryBarrier {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcAccessMask       = src_access,
+            .dstAccessMask       = dst_access,
+            .oldLayout           = old_layout,
+            .newLayout           = new_layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = image,
+            .subresourceRange =
+                {
+                    .aspectMask     = aspect,
+                    .baseMipLevel   = 0,
+                    .levelCount     = VK_REMAINING_MIP_LEVELS,
+                    .baseArrayLayer = 0,
+                    .layerCount     = 1,
+                },
+        };
+    }
+
+    void Renderer::Data::build_depth_pyramid(RenderStageInstance &stage,
+                                             size_t               stage_index,
+                                             uint32_t             image_index,
+                                             VkCommandBuffer      cmd) const
+    {
+        const auto &depth = stage.attachments[image_index][render_stages[stage_index].depth_attachment_index];
+
+        // Make the depth readable by the reduction shader, and wait for the culling shader to be done with the previous pyramid
+        // The content of the pyramid can be discarded, since it is entirely rewritten
+        const Array<VkImageMemoryBarrier> read_barriers = {
+            image_layout_barrier(depth.image,
+                                 VK_IMAGE_ASPECT_DEPTH_BIT,
+                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                 VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                 VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                                 VK_ACCESS_SHADER_READ_BIT),
+            image_layout_barrier(stage.depth_pyramid.image,
+                                 VK_IMAGE_ASPECT_COLOR_BIT,
+                                 VK_IMAGE_LAYOUT_UNDEFINED,
+                                 VK_IMAGE_LAYOUT_GENERAL,
+                                 VK_ACCESS_SHADER_READ_BIT,
+                                 VK_ACCESS_SHADER_WRITE_BIT),
+        };
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             static_cast<uint32_t>(read_barriers.size()),
+                             read_barriers.data());
+
+        // Write each level from the previous one
+        constexpr uint32_t group_size = 8;
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, depth_reduce_pipeline);
+        for (uint32_t level = 0; level < stage.depth_pyramid_mip_count; level++)
+        {
+            const auto &set = level == 0 ? stage.depth_pyramid_source_sets[image_index] : stage.depth_pyramid_reduce_sets[level - 1];
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, depth_reduce_pipeline_layout, 0, 1, &set, 0, nullptr);
+
+            const uint32_t width  = std::max(stage.depth_pyramid_extent.width >> level, 1u);
+            const uint32_t height = std::max(stage.depth_pyramid_extent.height >> level, 1u);
+            vkCmdDispatch(cmd, (width + group_size - 1) / group_size, (height + group_size - 1) / group_size, 1);
+
+            // The level is read by the next one, or by the culling shader for the last one
+            insert_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_SHADER_READ_BIT);
+        }
+
+        // Give the depth back to the render passes
+        const auto write_barrier = image_layout_barrier(depth.image,
+                                                        VK_IMAGE_ASPECT_DEPTH_BIT,
+                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+                                                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                                                        0,
+                                                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+                                                            | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &write_barrier);
+
+        stage.depth_pyramid_ready = true;
+    }
+
+    void Renderer::Data::cull_stage_with_occlusion(RenderStageInstance &stage,
+                                                   VkCommandBuffer      cmd,
+                                                   size_t               frame_index,
+                                                   const GPUCameraData &camera_data,
+                                                   const LodSelection  &lod_selection,
+                                                   uint32_t             phase) const
+    {
+        auto &culled = stage.culled_draws[frame_index];
+
+        // Nothing to cull
+        if (stage.draw_count == 0 || culled.occlusion_set == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        // In the second phase, the outputs are overwritten, so the draws and the copies of the first phase need to be done reading
+        // them
+        if (phase != 0)
+        {
+            insert_memory_barrier(cmd,
+                                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+                                      | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                  0,
+                                  VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                  VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        }
+
+        reset_culled_draws(stage, culled, cmd);
+
+        // Bind the occlusion culling pipeline
+        const Array<VkDescriptorSet> sets = {culled.culling_set, culled.occlusion_set};
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion_culling_pipeline);
+        vkCmdBindDescriptorSets(cmd,
+                                VK_PIPELINE_BIND_POINT_COMPUTE,
+                                occlusion_culling_pipeline_layout,
+                                0,
+                                static_cast<uint32_t>(sets.size()),
+                                sets.data(),
+                                0,
+                                nullptr);
+
+        GPUOcclusionCullingParameters parameters = {
+            .view_projection     = camera_data.view_projection,
+            .camera_position     = lod_selection.camera_position,
+            .lod_factor          = lod_selection.factor,
+            .depth_pyramid_size  = glm::vec2(stage.depth_pyramid_extent.width, stage.depth_pyramid_extent.height),
+            .instance_count      = stage.instance_count,
+            .draw_count          = stage.draw_count,
+            .pass                = 0,
+            .phase               = phase,
+            .depth_pyramid_ready = stage.depth_pyramid_ready ? 1u : 0u,
+        };
+
+        // First pass: cull the instances
+        constexpr uint32_t group_size = 64;
+        vkCmdPushConstants(cmd,
+                           occlusion_culling_pipeline_layout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(GPUOcclusionCullingParameters),
+                           &parameters);
+        vkCmdDispatch(cmd, (stage.instance_count + group_size - 1) / group_size, 1, 1);
+
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        // Second pass: compact the draws
+        parameters.pass = 1;
+        vkCmdPushConstants(cmd,
+                           occlusion_culling_pipeline_layout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(GPUOcclusionCullingParameters),
+                           &parameters);
+        vkCmdDispatch(cmd, (stage.draw_count + group_size - 1) / group_size, 1, 1);
+
+        // The results are then used by the indirect draws and as vertex input
+        insert_memory_barrier(cmd,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_ACCESS_SHADER_WRITE_BIT,
+                              VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                              VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+
+        copy_culling_results(stage, culled, cmd, phase);
+    }
+
+    // endregion
+
+    // region CPU culling
+
+    bool Renderer::Data::uses_cpu_culling() const
+    {
+        return cpu_culling_enabled && !uses_gpu_culling();
+    }
+
+    void Renderer::Data::update_object_bounds(uint32_t object_index, const glm::mat4 &transform, const StoredMeshPart &part)
+    {
+        const auto &sphere = part.bounding_sphere;
+
+        // The radius is scaled by the biggest scale factor, so that the sphere still contains the mesh with non-uniform scales
+        const glm::vec4 center    = transform * glm::vec4(glm::vec3(sphere), 1.0f);
+        const float     max_scale = std::max({
+            glm::length(glm::vec3(transform[0])),
+            glm::length(glm::vec3(transform[1])),
+            glm::length(glm::vec3(transform[2])),
+        });
+
+        object_bounds_x[object_index]      = center.x;
+        object_bounds_y[object_index]      = center.y;
+        object_bounds_z[object_index]      = center.z;
+        object_bounds_radius[object_index] = sphere.w * max_scale;
+
+        object_boxes[object_index] = part.bounds.transformed(transform);
+        object_boxes_changed       = true;
+    }
+
+    bool Renderer::Data::is_scene_bvh_up_to_date() const
+    {
+        return scene_bvh_layout_version == built_object_layout_version;
+    }
+
+    void Renderer::Data::update_scene_bvh()
+    {
+        // Take the result of the background build once it is done
+        if (scene_bvh_rebuild.valid() && scene_bvh_rebuild.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            auto bvh = scene_bvh_rebuild.get();
+
+            // If objects were added or removed during the build, it is already out of date
+            if (scene_bvh_rebuild_layout_version == built_object_layout_version)
+            {
+                scene_bvh                = std::move(bvh);
+                scene_bvh_layout_version = scene_bvh_rebuild_layout_version;
+                scene_bvh_built_cost     = scene_bvh.cost();
+
+                // The objects may have moved during the build
+                object_boxes_changed = true;
+            }
+        }
+
+        // Moving objects only requires a refit
+        if (is_scene_bvh_up_to_date() && object_boxes_changed)
+        {
+            scene_bvh.refit(object_boxes.data());
+            object_boxes_changed = false;
+        }
+
+        // Refitting makes the nodes overlap more and more, so rebuild it when queries became too expensive
+        constexpr float max_cost_growth = 1.5f;
+        const bool      degraded        = is_scene_bvh_up_to_date() && scene_bvh.cost() > scene_bvh_built_cost * max_cost_growth;
+
+        // Only one build at a time. Until the new tree is ready, the culling falls back to testing every object.
+        if ((!is_scene_bvh_up_to_date() || degraded) && !scene_bvh_rebuild.valid())
+        {
+            scene_bvh_rebuild_layout_version = built_object_layout_version;
+
+            // The build works on a copy of the boxes, since they will keep changing in the meantime
+            scene_bvh_rebuild = std::async(std::launch::async,
+                                           [boxes = object_boxes, count = object_count]()
+                                           {
+                                               BVH bvh;
+                                               bvh.build(boxes.data(), count);
+                                               return bvh;
+                                           });
+        }
+    }
+
+    void Renderer::Data::cull_objects_on_cpu(const GPUCameraData &camera_data)
+    {
+        // Test every object at once: the stages then only need to look up the result
+        const auto frustum = Frustum::from_view_projection(camera_data.view_projection);
+
+        // Use the hierarchy if possible, to skip the groups of objects that are entirely outside or inside the frustum
+        if (is_scene_bvh_up_to_date())
+        {
+            scene_bvh.cull(frustum, object_visibility.data());
+            return;
+        }
+
+        frustum.cull_spheres(object_bounds_x.data(),
+                             object_bounds_y.data(),
+                             object_bounds_z.data(),
+                             object_bounds_radius.data(),
+                             object_count,
+                             object_visibility.data());
+    }
+
+    uint32_t Renderer::Data::select_lod_on_cpu(const GPUDrawData  *draws,
+                                               uint32_t            object_index,
+                                               const LodSelection &lod_selection) const
+    {
+        const glm::vec3 center(object_bounds_x[object_index], object_bounds_y[object_index], object_bounds_z[object_index]);
+        const float     radius = object_bounds_radius[object_index];
+
+        // The radius of the object is the one of the mesh part, scaled by the biggest scale of the object
+        const float scale = draws[0].bounding_sphere.w > 0.0f ? radius / draws[0].bounding_sphere.w : 1.0f;
+        // The error is projected at the nearest point of the sphere, to stay conservative
+        const float distance = std::max(glm::length(center - lod_selection.camera_position) - radius, 0.0f);
+
+        uint32_t lod = 0;
+        while (lod + 1 < draws[0].lod_count && draws[lod + 1].lod_error * scale * lod_selection.factor <= distance)
+        {
+            lod++;
+        }
+        return lod;
+    }
+
+    void Renderer::Data::cull_stage_on_cpu(RenderStageInstance &stage, size_t frame_index, const LodSelection &lod_selection) const
+    {
+        auto &culled                      = stage.culled_draws[frame_index];
+        culled.cpu_visible_instance_count = 0;
+        culled.cpu_visible_draw_count     = 0;
+
+        // Nothing to cull
+        if (stage.draw_count == 0 || !culled.cpu_indirect_buffer.is_valid())
+        {
+            return;
+        }
+
+        auto       *commands          = static_cast<VkDrawIndexedIndirectCommand *>(culled.cpu_indirect_buffer.mapped_data);
+        auto       *visible_instances = static_cast<GPUInstanceData *>(culled.cpu_visible_instance_buffer.mapped_data);
+        const auto *visibility        = object_visibility.data();
+
+        // Keep every draw so that the batches don't move, but only with their visible instances
+        // The draws of the levels of detail of a model follow the one of the base level, which references the instances
+        // The visible instances of each level are compacted at the start of the range of its draw
+        uint32_t draw_i = 0;
+        while (draw_i < stage.draw_count)
+        {
+            const auto &command   = stage.cpu_commands.data()[draw_i];
+            const auto *draws     = stage.cpu_draws.data() + draw_i;
+            const auto *instances = stage.cpu_instances.data() + command.firstInstance;
+            const auto  lod_count = draws[0].lod_count;
+
+            uint32_t visible_counts[MAX_MESH_LOD_COUNT] = {};
+            if (lod_count == 1 || lod_selection.factor <= 0.0f)
+            {
+                // Always write the instance, but only advance if it is visible: it avoids a branch per instance
+                auto *output = visible_instances + draws[0].first_instance;
+                for (uint32_t instance_i = 0; instance_i < command.instanceCount; instance_i++)
+                {
+                    output[visible_counts[0]] = instances[instance_i];
+                    visible_counts[0] += visibility[instances[instance_i].object_index];
+                }
+            }
+            else
+            {
+                for (uint32_t instance_i = 0; instance_i < command.instanceCount; instance_i++)
+                {
+                    const auto object_index = instances[instance_i].object_index;
+                    if (visibility[object_index])
+                    {
+                        const auto lod = select_lod_on_cpu(draws, object_index, lod_selection);
+                        visible_instances[draws[lod].first_instance + visible_counts[lod]++] = instances[instance_i];
+                    }
+                }
+            }
+
+            for (uint32_t lod_i = 0; lod_i < lod_count; lod_i++)
+            {
+                commands[draw_i + lod_i]               = stage.cpu_commands.data()[draw_i + lod_i];
+                commands[draw_i + lod_i].instanceCount = visible_counts[lod_i];
+                commands[draw_i + lod_i].firstInstance = draws[lod_i].first_instance;
+
+                culled.cpu_visible_instance_count += visible_counts[lod_i];
+                culled.cpu_visible_draw_count += visible_counts[lod_i] > 0 ? 1 : 0;
+            }
+            draw_i += lod_count;
+        }
+
+        allocator.flush_buffer(culled.cpu_indirect_buffer, 0, stage.draw_count * sizeof(VkDrawIndexedIndirectCommand));
+        allocator.flush_buffer(culled.cpu_visible_instance_buffer,
+                               0,
+                               std::max(stage.visible_instance_capacity, 1u) * sizeof(GPUInstanceData));
+    }
+
+    void Renderer::Data::count_recorded_draws(const Swapchain &swapchain, FrameData &frame, size_t frame_index) const
+    {
+        for (size_t stage_i = 0; stage_i < render_pipeline_description.stages.size(); stage_i++)
+        {
+            if (!render_pipeline_description.stages[stage_i].uses_material_system)
+            {
+                continue;
+            }
+
+            const auto &stage  = swapchain.render_stages[stage_i];
+            const auto &culled = stage.culled_draws[frame_index];
+            frame.draw_statistics.instance_count += stage.instance_count;
+            frame.draw_statistics.draw_count += stage.draw_count;
+
+            // The results of the GPU culling are only known once the frame is done
+            if (uses_gpu_culling())
+            {
+                continue;
+            }
+
+            if (uses_cpu_culling() && culled.cpu_indirect_buffer.is_valid())
+            {
+                frame.draw_statistics.visible_instance_count += culled.cpu_visible_instance_count;
+                frame.draw_statistics.visible_draw_count += culled.cpu_visible_draw_count;
+            }
+            else
+            {
+                frame.draw_statistics.visible_instance_count += stage.instance_count;
+                frame.draw_statistics.visible_draw_count += stage.draw_count;
+            }
+        }
+    }
+
+    // endregion
+
+    void Renderer::Data::draw_from_cache(const RenderStageInstance &stage,
+                                         VkCommandBuffer            cmd,
+                                         FrameData                 &current_frame,
+                                         size_t                     window_index) const
+    {
+        constexpr uint32_t draw_stride        = sizeof(VkDrawIndexedIndirectCommand);
+        VkPipeline         bound_pipeline     = VK_NULL_HANDLE;
+        bool               global_sets_bound  = false;
+        VkDescriptorSet    bound_textures_set = VK_NULL_HANDLE;
+        bool               index_buffer_bound = false;
+        VkIndexType        bound_index_type   = VK_INDEX_TYPE_UINT32;
+
+        if (stage.batches.is_empty())
+        {
+            // Nothing to draw
+            return;
+        }
+
+        // When GPU culling is enabled, the draws are read from the output of the culling shader
+        // Otherwise, they may have been culled on the CPU
+        const bool  culled       = uses_gpu_culling();
+        const auto &culled_draws = stage.culled_draws[get_current_frame_index()];
+        const bool  cpu_culled   = uses_cpu_culling() && culled_draws.cpu_indirect_buffer.is_valid();
+
+        // Bind the instances of the stage
+        VkDeviceSize instance_offset = 0;
+        VkBuffer     instance_buffer = stage.instance_buffer.buffer;
+        VkBuffer     indirect_buffer = stage.indirect_buffer.buffer;
+        if (culled)
+        {
+            instance_buffer = culled_draws.visible_instance_buffer.buffer;
+        }
+        else if (cpu_culled)
+        {
+            instance_buffer = culled_draws.cpu_visible_instance_buffer.buffer;
+            indirect_buffer = culled_draws.cpu_indirect_buffer.buffer;
+        }
+        vkCmdBindVertexBuffers(cmd, 1, 1, &instance_buffer, &instance_offset);
+
+        // For each batch
+        for (uint32_t batch_i = 0; batch_i < stage.batches.size(); batch_i++)
+        {
+            const auto &batch = stage.batches[batch_i];
+
+            // If the pipeline is different from the last one, bind it
+            if (bound_pipeline != batch.pipeline)
+            {
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.pipeline);
+                bound_pipeline = batch.pipeline;
+            }
+
+            // The first iteration, bind global sets
+            if (!global_sets_bound)
+            {
+                uint32_t                     camera_buffer_offset = pad_uniform_buffer_size(sizeof(GPUCameraData)) * window_index;
+                const Array<uint32_t>        offsets              = {camera_buffer_offset};
+                const Array<VkDescriptorSet> sets                 = {current_frame.swapchain_set, current_frame.global_set};
+                vkCmdBindDescriptorSets(cmd,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        batch.pipeline_layout,
+                                        0,
+                                        sets.size(),
+                                        sets.data(),
+                                        offsets.size(),
+                                        offsets.data());
+                global_sets_bound = true;
+            }
+
+            // Rebind descriptor set if it is different
+            const VkDescriptorSet textures_set = batch.textures_sets[get_current_frame_index()];
+            if (bound_textures_set != textures_set && textures_set != VK_NULL_HANDLE)
+            {
+                vkCmdBindDescriptorSets(cmd,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        batch.pipeline_layout,
+                                        2, // We have two global sets before, so this one is the third
+                                        1,
+                                        &textures_set,
+                                        0,
+                                        nullptr);
+                bound_textures_set = textures_set;
+            }
+
+            // The index buffer contains indices of both sizes, so it is bound again when the size changes
+            if (!index_buffer_bound || bound_index_type != batch.index_type)
+            {
+                vkCmdBindIndexBuffer(cmd, index_buffer.buffer, 0, batch.index_type);
+                index_buffer_bound = true;
+                bound_index_type   = batch.index_type;
+            }
+
+            // Draw the batch
+            const uint32_t &&draw_offset = draw_stride * batch.offset;
+
+            if (culled)
+            {
+                // The culling shader wrote the number of visible draws of the batch in the count buffer
+                vkCmdDrawIndexedIndirectCount(cmd,
+                                              culled_draws.indirect_buffer.buffer,
+                                              draw_offset,
+                                              culled_draws.count_buffer.buffer,
+                                              batch_i * sizeof(uint32_t),
+                                              batch.count,
+                                              draw_stride);
+            }
+            else
+            {
+                vkCmdDrawIndexedIndirect(cmd, indirect_buffer, draw_offset, batch.count, draw_stride);
+            }
+        }
+    }
+
+    void Renderer::Data::draw_quad(const Swapchain &swapchain,
+                                   size_t           stage_index,
+                                   size_t           image_index,
+                                   VkCommandBuffer  cmd,
+                                   FrameData       &current_frame,
+                                   size_t           window_index) const
+    {
+        auto &stage_desc = render_pipeline_description.stages[stage_index];
+
+        // Get global effect id for current stage
+        auto id_result = global_shader_effects.get(static_cast<HashMap::Key>(stage_desc.kind));
+        check(id_result.has_value() && id_result.value()->as_size != NULL_ID,
+              "Missing global shader effect for stage \"" + std::string(stage_desc.name) + "\"");
+        ShaderEffectId id = id_result.value()->as_size;
+
+        // Using the id, find the effect
+        auto effect_result = shader_effects.get(id);
+        check(effect_result.has_value(),
+              "Invalid global shader effect for stage \"" + std::string(stage_desc.name)
+                  + "\". The stored id doesn't belong to any existing shader effect.");
+        auto &effect = effect_result.value();
+
+        // Bind global sets
+        uint32_t                     camera_buffer_offset = pad_uniform_buffer_size(sizeof(GPUCameraData)) * window_index;
+        const Array<uint32_t>        offsets              = {camera_buffer_offset};
+        const Array<VkDescriptorSet> sets                 = {current_frame.swapchain_set, current_frame.global_set};
+        vkCmdBindDescriptorSets(cmd,
+                                VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                effect.pipeline_layout,
+                                0,
+                                sets.size(),
+                                sets.data(),
+                                offsets.size(),
+                                offsets.data());
+
+        // Bind attachment set if needed (to access output attachments of the previous stage, for example for lighting stage in
+        // deferred rendering).
+        if (stage_index != 0)
+        {
+            auto &previous_stage = swapchain.render_stages[stage_index - 1];
+            if (!previous_stage.output_textures.is_empty())
+            {
+                VkDescriptorSet attachments_set = previous_stage.output_textures_set[image_index];
+                vkCmdBindDescriptorSets(cmd,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        effect.pipeline_layout,
+                                        2,
+                                        1,
+                                        &attachments_set,
+                                        0,
+                                        nullptr);
+            }
+        }
+
+        // Get the pipeline
+        // There is no vertex input, so the pipeline of the full format is the only one
+        auto pipeline = swapchain.pipelines[static_cast<size_t>(VertexFormat::FULL)].get(id);
+        check(pipeline.has_value(), "Tried to draw a shader effect that was not built.");
+
+        // Bind pipeline
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, static_cast<VkPipeline>(pipeline.value()->as_ptr));
+
+        // Draw
+        vkCmdDraw(cmd, stage_desc.vertex_count, 1, 0, 0);
+    }
+
+    // endregion
+
+    // region Camera functions
+
+    GPUCameraData Renderer::Data::get_camera_data(const Camera &camera)
+    {
+        GPUCameraData camera_data = {};
+
+        // Projection
+        switch (camera.type)
+        {
+            case CameraType::PERSPECTIVE:
+                camera_data.projection = glm::perspective(camera.specs.as_perspective.fov,
+                                                          camera.specs.as_perspective.aspect_ratio,
+                                                          camera.specs.as_perspective.near_plane,
+                                                          camera.specs.as_perspective.far_plane);
+                camera_data.projection[1][1] *= -1;
+                break;
+            case CameraType::ORTHOGRAPHIC:
+                camera_data.projection = glm::ortho(-camera.specs.as_orthographic.width / 2.0f,
+                                                    camera.specs.as_orthographic.width / 2.0f,
+                                                    -camera.specs.as_orthographic.height / 2.0f,
+                                                    camera.specs.as_orthographic.height / 2.0f,
+                                                    camera.specs.as_orthographic.near_plane,
+                                                    camera.specs.as_orthographic.far_plane);
+                break;
+        }
+
+        // View
+        camera_data.view = camera.transform.view_matrix();
+        // View projection
         camera_data.view_projection = camera_data.projection * camera_data.view;
 
-        // Copy it to buffer
-        copy_buffer_to_gpu(camera_data, current_frame.camera_info_buffer, window_index);
-    }
-    // endregion
+        return camera_data;
+    }
+
+    void Renderer::Data::send_camera_data(size_t window_index, const GPUCameraData &camera_data, FrameData &current_frame)
+    {
+        // Copy it to buffer
+        copy_buffer_to_gpu(camera_data, current_frame.camera_info_buffer, window_index);
+    }
+
+    LodSelection Renderer::Data::get_lod_selection(const GPUCameraData &camera_data, const VkExtent2D &viewport_extent) const
+    {
+        LodSelection selection = {};
+
+        // With an orthographic projection, the size on screen doesn't depend on the distance, so the base level is always used
+        if (camera_data.projection[3][3] == 0.0f)
+        {
+            selection.camera_position = glm::vec3(glm::inverse(camera_data.view)[3]);
+
+            // An error e at a distance d covers e * |p11| / d half-heights of the viewport
+            const float half_height = 0.5f * static_cast<float>(viewport_extent.height);
+            const float threshold   = LOD_ERROR_THRESHOLD * std::exp2(lod_bias);
+            selection.factor        = std::abs(camera_data.projection[1][1]) * half_height / threshold;
+        }
+
+        return selection;
+    }
+    // endregion
+
+    // region Mesh part functions
+
+    VertexInputDescription Renderer::Data::get_vertex_description(VertexFormat format)
+    {
+        static constexpr VkVertexInputBindingDescription full_bindings[2] = {
+            VkVertexInputBindingDescription {
+                .binding   = 0,
+                .stride    = sizeof(Vertex),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+            },
+            // Instances of the stage, either all of them or only the visible ones when GPU culling is enabled
+            VkVertexInputBindingDescription {
+                .binding   = 1,
+                .stride    = sizeof(GPUInstanceData),
+                .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+            },
+        };
+
+        static const VkVertexInputAttributeDescription full_attributes[5] = {
+            // Vertex position attribute: location 0
+            VkVertexInputAttributeDescription {
+                .location = 0,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32B32_SFLOAT,
+                .offset   = static_cast<uint32_t>(offsetof(Vertex, position)),
+            },
+            // Vertex normal attribute: location 1
+            VkVertexInputAttributeDescription {
+                .location = 1,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32B32_SFLOAT,
+                .offset   = static_cast<uint32_t>(offsetof(Vertex, normal)),
+            },
+            // Vertex color coordinates attribute: location 2
+            VkVertexInputAttributeDescription {
+                .location = 2,
+                .binding  = 0,
+                .format   = VK_FORMAT_R32G32_SFLOAT,
+                .offset   = static_cast<uint32_t>(offsetof(Vertex, tex_coord)),
+            },
+            // Object index attribute: location 3
+            VkVertexInputAttributeDescription {
+                .location = 3,
+                .binding  = 1,
+                .format   = VK_FORMAT_R32_UINT,
+                .offset   = static_cast<uint32_t>(offsetof(GPUInstanceData, object_index)),
+            },
+            // Material index attribute: location 4, only read by the shaders using bindless textures
+            VkVertexInputAttributeDescription {
+                .location = 4,
+                .binding  = 1,
+                .format   = VK_FORMAT_R32_UINT,
+                .offset   = static_cast<uint32_t>(offsetof(GPUInstanceData, material_index)),
+            },
+        };
+
+        // Same locations with the compressed format, so that the same shaders can read both
+        // The positions are dequantized by the object transform, but the normals need to be decoded by the shader
+        static constexpr VkVertexInputBindingDescription compressed_bindings[2] = {
+            VkVertexInputBindingDescription {
+                .binding   = 0,
+                .stride    = sizeof(CompressedVertex),
+                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+            },
+            full_bindings[1],
+        };
+
+        static const VkVertexInputAttributeDescription compressed_attributes[5] = {
+            VkVertexInputAttributeDescription {
+                .location = 0,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16B16A16_SNORM,
+                .offset   = static_cast<uint32_t>(offsetof(CompressedVertex, position)),
+            },
+            VkVertexInputAttributeDescription {
+                .location = 1,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16_SNORM,
+                .offset   = static_cast<uint32_t>(offsetof(CompressedVertex, normal)),
+            },
+            VkVertexInputAttributeDescription {
+                .location = 2,
+                .binding  = 0,
+                .format   = VK_FORMAT_R16G16_SFLOAT,
+                .offset   = static_cast<uint32_t>(offsetof(CompressedVertex, tex_coord)),
+            },
+            full_attributes[3],
+            full_attributes[4],
+        };
+
+        static constexpr VertexInputDescription full_description {
+            .flags           = 0,
+            .binding_count   = 2,
+            .bindings        = full_bindings,
+            .attribute_count = 5,
+            .attributes      = full_attributes,
+        };
+        static constexpr VertexInputDescription compressed_description {
+            .flags           = 0,
+            .binding_count   = 2,
+            .bindings        = compressed_bindings,
+            .attribute_count = 5,
+            .attributes      = compressed_attributes,
+        };
+
+        return format == VertexFormat::COMPRESSED ? compressed_description : full_description;
+    }
+
+    void Renderer::Data::update_mesh_buffers()
+    {
+        // region Release retired data
+
+        // Destroyed parts may still be used by the frames in flight. Since we waited for the fence of the current frame, every
+        // frame before the last NB_OVERLAPPING_FRAMES - 1 ones is done. Replaced buffers are released in the same way by
+        // release_retired_buffers.
+        const auto is_released = [this](uint64_t frame_number)
+        {
+            return frame_number + NB_OVERLAPPING_FRAMES - 1 <= current_frame_number;
+        };
+
+        for (size_t i = 0; i < retired_mesh_ranges.size();)
+        {
+            const auto &retired = retired_mesh_ranges[i];
+            if (is_released(retired.frame_number))
+            {
+                vertex_ranges.free(retired.vertex_range);
+                index_ranges.free(retired.index_range);
+                retired_mesh_ranges.remove_at(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        // endregion
+
+        if (!should_update_mesh_buffers)
+        {
+            return;
+        }
+
+        const auto align_up = [](size_t offset, size_t alignment)
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        };
+
+        // region Allocate ranges for the new parts
+
+        // Only the parts saved since the last update are uploaded, the others keep their place in the buffers.
+        // The range allocators only do the bookkeeping: when they grow, the buffers are replaced afterwards.
+        const auto allocate_range = [](RangeAllocator &ranges, size_t size, size_t alignment)
+        {
+            if (size == 0)
+            {
+                return RangeAllocator::Range {};
+            }
+
+            auto range = ranges.allocate(size, alignment);
+            if (!range.has_value())
+            {
+                // Double the capacity, or more if the range doesn't fit in that
+                ranges.grow(std::max({
+                    ranges.capacity() * 2,
+                    ranges.capacity() + size + alignment,
+                    static_cast<size_t>(MESH_BUFFER_MIN_SIZE),
+                }));
+                range = ranges.allocate(size, alignment);
+            }
+            return range.expect("Failed to allocate a range in a mesh buffer.");
+        };
+
+        Vector<StoredMeshPart *> new_parts(8);
+        size_t                   staging_vb_size     = 0;
+        size_t                   staging_ib_size     = 0;
+        bool                     has_remaining_parts = false;
+
+        for (auto &res : mesh_parts)
+        {
+            auto &part = res.value();
+            if (part.is_uploaded)
+            {
+                continue;
+            }
+            if (!consume_upload_budget(get_upload_size(part.mesh_part)))
+            {
+                // The part will be uploaded at a later frame
+                has_remaining_parts = true;
+                continue;
+            }
+
+            // Each part has its own vertex format and index size. They are placed so that their offsets in the buffers are a
+            // whole number of their elements. That way, the buffers are bound once and the draws only give those offsets.
+            const auto &mesh_part   = part.mesh_part;
+            const auto  vertex_size = mesh_part.vertex_byte_size();
+            const auto  index_size  = mesh_part.index_byte_size();
+            part.vertex_range = allocate_range(vertex_ranges, vertex_size * mesh_part.vertex_count(), VERTEX_BUFFER_ALIGNMENT);
+            part.index_range = allocate_range(index_ranges, index_size * mesh_part.total_triangle_count() * 3, sizeof(uint32_t));
+
+            // The offsets are counted in vertices and indices, since they are used as the vertex offset and first index of the draws
+            part.vertex_offset = part.vertex_range.offset / vertex_size;
+            part.index_offset  = part.index_range.offset / index_size;
+
+            staging_vb_size = align_up(staging_vb_size, VERTEX_BUFFER_ALIGNMENT) + part.vertex_range.size;
+            staging_ib_size = align_up(staging_ib_size, sizeof(uint32_t)) + part.index_range.size;
+            new_parts.push_back(&part);
+        }
+
+        // endregion
+
+        if (staging_vb_size + staging_ib_size > 0)
+        {
+            // The GPU-side copies are recorded in the current transfer batch, which is submitted before the next frame
+
+            // region Grow GPU-side buffers
+
+            // When a buffer is too small for its allocator, it is replaced by a bigger one, in which the existing parts are copied
+            // on the GPU side. The buffers are also transfer sources, so that they can be copied again the next time they grow.
+            bool       copied_buffers = false;
+            const auto grow_buffer    = [&](AllocatedBuffer &buffer, const RangeAllocator &ranges, VkBufferUsageFlags usage)
+            {
+                if (ranges.capacity() == 0 || (buffer.is_valid() && buffer.size >= ranges.capacity()))
+                {
+                    return;
+                }
+
+                // When the CPU can write in device-local memory, the buffers are mapped so that the parts are written in place
+                usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+                auto new_buffer = allocator.has_host_visible_device_memory()
+                                    ? allocator.create_host_visible_device_buffer(ranges.capacity(), usage, true)
+                                    : allocator.create_buffer(ranges.capacity(), usage, VMA_MEMORY_USAGE_GPU_ONLY, true);
+
+                if (buffer.is_valid())
+                {
+                    VkBufferCopy copy {
+                        .srcOffset = 0,
+                        .dstOffset = 0,
+                        .size      = buffer.size,
+                    };
+                    vkCmdCopyBuffer(begin_transfer(), buffer.buffer, new_buffer.buffer, 1, &copy);
+                    copied_buffers = true;
+
+                    // The current batch will signal the next value when it is submitted
+                    mesh_buffer_copy_value = transfer_context.submitted_value + 1;
+
+                    // The frames in flight may still use the old buffer
+                    retire_buffer(buffer);
+                }
+                buffer = new_buffer;
+            };
+
+            grow_buffer(vertex_buffer, vertex_ranges, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+            grow_buffer(index_buffer, index_ranges, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+
+            // The copies may also have been recorded in a batch that isn't done yet
+            bool has_pending_copies = mesh_buffer_copy_value > transfer_context.completed_value;
+            if (has_pending_copies && !copied_buffers)
+            {
+                reclaim_transfer_batches(false);
+                has_pending_copies = mesh_buffer_copy_value > transfer_context.completed_value;
+            }
+
+            if (has_pending_copies)
+            {
+                // New parts may be placed in freed ranges, which are also written by the copies. Wait for them before the uploads.
+                // The barrier also covers the copies of the previous batches, since they were submitted before on the same queue.
+                const VkMemoryBarrier barrier = {
+                    .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                };
+                vkCmdPipelineBarrier(begin_transfer(),
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     0,
+                                     1,
+                                     &barrier,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr);
+            }
+
+            // endregion
+
+            // region Upload the new parts
+
+            if (allocator.has_host_visible_device_memory() && !has_pending_copies)
+            {
+                // The CPU can write in the mesh buffers, so the parts are written in place, without staging nor copy
+                // The free ranges are not used by the frames in flight, nor by the copies of the grown buffers which are done, so
+                // they can be written right away
+                auto *vertices = static_cast<uint8_t *>(vertex_buffer.mapped_data);
+                auto *indices  = static_cast<uint8_t *>(index_buffer.mapped_data);
+                for (auto *part : new_parts)
+                {
+                    if (part->vertex_range.size > 0)
+                    {
+                        part->mesh_part.write_vertices(vertices + part->vertex_range.offset);
+                        allocator.flush_buffer(vertex_buffer, part->vertex_range.offset, part->vertex_range.size);
+                    }
+                    if (part->index_range.size > 0)
+                    {
+                        part->mesh_part.write_indices(indices + part->index_range.offset);
+                        allocator.flush_buffer(index_buffer, part->index_range.offset, part->index_range.size);
+                    }
+                }
+            }
+            else
+            {
+                // Otherwise, the parts go through staging memory and are copied on the GPU side
+                // That is also the case until the buffers that grew are filled: the copy of their old content, done later by the
+                // GPU, would overwrite the parts written by the CPU in ranges that were freed
+                const VkCommandBuffer transfer_cmd = begin_transfer();
+
+                // A single staging allocation holds the vertices, followed by the indices
+                const size_t staging_ib_start = align_up(staging_vb_size, sizeof(uint32_t));
+                const auto   staging_alloc    = allocate_staging(staging_ib_start + staging_ib_size, VERTEX_BUFFER_ALIGNMENT);
+                auto         staging          = static_cast<uint8_t *>(staging_alloc.data);
+
+                Vector<VkBufferCopy> vb_copies(new_parts.size());
+                Vector<VkBufferCopy> ib_copies(new_parts.size());
+                size_t               vb_offset = 0;
+                size_t               ib_offset = staging_ib_start;
+
+                for (auto *part : new_parts)
+                {
+                    const auto &mesh_part = part->mesh_part;
+
+                    // Vertex data, encoded in the format of the part
+                    if (part->vertex_range.size > 0)
+                    {
+                        vb_offset = align_up(vb_offset, VERTEX_BUFFER_ALIGNMENT);
+                        mesh_part.write_vertices(staging + vb_offset);
+                        vb_copies.push_back(VkBufferCopy {
+                            .srcOffset = staging_alloc.offset + vb_offset,
+                            .dstOffset = part->vertex_range.offset,
+                            .size      = part->vertex_range.size,
+                        });
+                        vb_offset += part->vertex_range.size;
+                    }
+
+                    // Index data, followed by the simplified levels of detail
+                    if (part->index_range.size > 0)
+                    {
+                        ib_offset = align_up(ib_offset, sizeof(uint32_t));
+                        mesh_part.write_indices(staging + ib_offset);
+                        ib_copies.push_back(VkBufferCopy {
+                            .srcOffset = staging_alloc.offset + ib_offset,
+                            .dstOffset = part->index_range.offset,
+                            .size      = part->index_range.size,
+                        });
+                        ib_offset += part->index_range.size;
+                    }
+                }
+
+                if (!vb_copies.is_empty())
+                {
+                    vkCmdCopyBuffer(transfer_cmd,
+                                    staging_alloc.buffer,
+                                    vertex_buffer.buffer,
+                                    static_cast<uint32_t>(vb_copies.size()),
+                                    vb_copies.data());
+                }
+                if (!ib_copies.is_empty())
+                {
+                    vkCmdCopyBuffer(transfer_cmd,
+                                    staging_alloc.buffer,
+                                    index_buffer.buffer,
+                                    static_cast<uint32_t>(ib_copies.size()),
+                                    ib_copies.data());
+                }
+            }
+
+            // endregion
+        }
+
+        for (auto *part : new_parts)
+        {
+            part->is_uploaded = true;
+
+            // The data is in the staging memory or the mesh buffers, the CPU copy isn't needed anymore
+            // Any later move of the part, when the buffers grow, is done on the GPU side
+            if (part->gpu_resident_only)
+            {
+                part->mesh_part = MeshPart(Vector<Vertex>(1), Vector<Triangle>(1));
+            }
+        }
+
+        // Mesh buffers will now be up-to-date, unless the budget of the frame was exceeded
+        should_update_mesh_buffers = has_remaining_parts;
+
+        // The models using the new parts can now be drawn. The parts don't move when the buffers grow, so the cache only needs to be
+        // rebuilt if it skipped some of them. Destroyed parts already updated it.
+        if (!new_parts.is_empty())
+        {
+            has_new_uploads = true;
+        }
+    }
+
+    size_t Renderer::Data::get_upload_size(const MeshPart &mesh_part)
+    {
+        return mesh_part.vertex_byte_size() * mesh_part.vertex_count()
+               + mesh_part.index_byte_size() * mesh_part.total_triangle_count() * 3;
+    }
+
+    bool Renderer::Data::has_same_content(const StoredMeshPart &stored_part, const MeshPart &mesh_part) const
+    {
+        // The description is compared first, it is enough to tell most parts apart
+        const auto &lods = mesh_part.lods();
+        if (stored_part.vertex_format != mesh_part.vertex_format() || stored_part.position_offset != mesh_part.position_offset()
+            || stored_part.position_scale != mesh_part.position_scale() || stored_part.lods.size() != lods.size()
+            || std::memcmp(stored_part.lods.data(), lods.data(), lods.size() * sizeof(MeshLod)) != 0)
+        {
+            return false;
+        }
+
+        // Then the data, as it is written in the mesh buffers
+        const size_t   vertex_size = mesh_part.vertex_byte_size() * mesh_part.vertex_count();
+        const size_t   index_size  = mesh_part.index_byte_size() * mesh_part.total_triangle_count() * 3;
+        Array<uint8_t> data(vertex_size + index_size);
+        mesh_part.write_vertices(data.data());
+        mesh_part.write_indices(data.data() + vertex_size);
+
+        // The CPU copy of a GPU-resident only part is dropped once it is uploaded
+        if (!stored_part.gpu_resident_only || !stored_part.is_uploaded)
+        {
+            const auto &stored_mesh = stored_part.mesh_part;
+            if (stored_mesh.vertex_count() != mesh_part.vertex_count()
+                || stored_mesh.total_triangle_count() != mesh_part.total_triangle_count())
+            {
+                return false;
+            }
+
+            Array<uint8_t> stored_data(vertex_size + index_size);
+            stored_mesh.write_vertices(stored_data.data());
+            stored_mesh.write_indices(stored_data.data() + vertex_size);
+            return std::memcmp(stored_data.data(), data.data(), data.size()) == 0;
+        }
+
+        // Its data can then only be read back from the mesh buffers if they are mapped, and not being filled by the GPU after
+        // they grew. Otherwise, it can't be compared.
+        if (vertex_buffer.mapped_data == nullptr || index_buffer.mapped_data == nullptr
+            || mesh_buffer_copy_value > transfer_context.completed_value
+            || stored_part.vertex_range.size != vertex_size || stored_part.index_range.size != index_size)
+        {
+            return false;
+        }
+        const auto *stored_vertices = static_cast<const uint8_t *>(vertex_buffer.mapped_data) + stored_part.vertex_range.offset;
+        const auto *stored_indices  = static_cast<const uint8_t *>(index_buffer.mapped_data) + stored_part.index_range.offset;
+        return std::memcmp(stored_vertices, data.data(), vertex_size) == 0
+               && std::memcmp(stored_indices, data.data() + vertex_size, index_size) == 0;
+    }
+
+    void Renderer::Data::retire_mesh_part(const StoredMeshPart &part)
+    {
+        if (part.is_uploaded)
+        {
+            // Its ranges will be given back to the allocators once the frames in flight are done with them
+            retired_mesh_ranges.push_back(RetiredMeshRanges {
+                .vertex_range = part.vertex_range,
+                .index_range  = part.index_range,
+                .frame_number = current_frame_number,
+            });
+        }
+    }
+
+    // endregion
+
+    // region Storage buffers functions
+
+    void Renderer::Data::update_storage_buffers(FrameData &frame)
+    {
+        // region Object data
+
+        // We need to store a GPUObjectData for each render node
+        const size_t instance_count = render_nodes.count();
+
+        // If the capacity is too small, we need to increase it
+        if (object_data_capacity < instance_count)
+        {
+            // For now, we take a fixed margin above the required amount to avoid frequent reallocation's
+            // In the future, maybe a vector approach would be better (i.e. double the growth amount each time)
+            object_data_capacity = instance_count + 50;
+
+            // We also need to update the config version, so that the descriptor sets will be updated
+            buffer_config_version++;
+        }
+
+        // Same for the CPU copy of the buffer
+        if (object_data.size() < object_data_capacity)
+        {
+            object_data          = Array<GPUObjectData>(object_data_capacity);
+            object_bounds_x      = Array<float>(object_data_capacity);
+            object_bounds_y      = Array<float>(object_data_capacity);
+            object_bounds_z      = Array<float>(object_data_capacity);
+            object_bounds_radius = Array<float>(object_data_capacity);
+            object_visibility    = Array<uint8_t>(object_data_capacity);
+            object_boxes         = Array<AABB>(object_data_capacity);
+            object_nodes         = Array<RenderNodeId>(object_data_capacity);
+
+            // The content was lost, so everything needs to be recomputed
+            object_layout_version++;
+        }
+
+        // Each frame has its own buffer, which may still be smaller than the capacity if another frame grew it
+        const auto required_size = sizeof(GPUObjectData) * object_data_capacity;
+        if (!frame.object_info_buffer.is_valid())
+        {
+            // Doesn't exist yet, create it
+            frame.object_info_buffer          = create_object_buffer(required_size);
+            frame.built_object_layout_version = 0;
+        }
+        else if (frame.object_info_buffer.size < required_size)
+        {
+            // Exists but too small, reallocate it
+            allocator.destroy_buffer(frame.object_info_buffer);
+            frame.object_info_buffer          = create_object_buffer(required_size);
+            frame.built_object_layout_version = 0;
+        }
+
+        // Update the CPU copy
+        // The instances of a model are stored contiguously, so that the indirect command of the model can draw them all with
+        // firstInstance and instanceCount. The vertex shaders then find their object with gl_InstanceIndex.
+        if (built_object_layout_version != object_layout_version)
+        {
+            // Objects were added or removed, so their position in the buffer changed: recompute everything
+            uint32_t instance_i = 0;
+            for (auto &model_entry : models)
+            {
+                auto &model              = model_entry.value();
+                model.first_instance     = instance_i;
+                model.uploaded_transform = model.transform;
+                model.matrix             = model.transform.view_matrix();
+
+                const auto &part = mesh_parts[model.mesh_part_id];
+                for (const auto &node_id : model.instances)
+                {
+                    auto &node              = render_nodes[node_id];
+                    node.uploaded_transform = node.transform;
+                    node.last_change_frame  = current_frame_number;
+
+                    const auto transform    = model.matrix * node.transform.view_matrix();
+                    object_data[instance_i] = GPUObjectData {
+                        .transform = transform * part.dequantization,
+                    };
+                    update_object_bounds(instance_i, transform, part);
+                    object_nodes[instance_i] = node_id;
+                    instance_i++;
+                }
+            }
+
+            object_count                = instance_i;
+            built_object_layout_version = object_layout_version;
+        }
+        else
+        {
+            // Only recompute the objects whose transform changed since last time
+            for (auto &model_entry : models)
+            {
+                auto      &model         = model_entry.value();
+                const bool model_changed = model.transform != model.uploaded_transform;
+                if (model_changed)
+                {
+                    model.uploaded_transform = model.transform;
+                    model.matrix             = model.transform.view_matrix();
+                }
+
+                const auto &part       = mesh_parts[model.mesh_part_id];
+                uint32_t    instance_i = model.first_instance;
+                for (const auto &node_id : model.instances)
+                {
+                    auto &node = render_nodes[node_id];
+                    if (model_changed || node.transform != node.uploaded_transform)
+                    {
+                        node.uploaded_transform = node.transform;
+                        const auto transform    = model.matrix * node.transform.view_matrix();
+                        object_data[instance_i] = GPUObjectData {
+                            .transform = transform * part.dequantization,
+                        };
+                        update_object_bounds(instance_i, transform, part);
+
+                        // Register the change in each frame buffer
+                        // If the node already changed since the frame was last written, it is already in its list
+                        for (auto &other_frame : frames)
+                        {
+                            if (node.last_change_frame <= other_frame.object_buffer_frame_number)
+                            {
+                                other_frame.dirty_objects.push_back(instance_i);
+                            }
+                        }
+                        node.last_change_frame = current_frame_number;
+                    }
+                    instance_i++;
+                }
+            }
+        }
+
+        // Copy the objects to the GPU
+        if (frame.built_object_layout_version != object_layout_version)
+        {
+            // The layout changed since the last time this buffer was written, so it needs to be entirely rewritten
+            auto buf = static_cast<GPUObjectData *>(frame.object_info_buffer.mapped_data);
+            memcpy(buf, object_data.data(), sizeof(GPUObjectData) * instance_count);
+            allocator.flush_buffer(frame.object_info_buffer, 0, sizeof(GPUObjectData) * instance_count);
+
+            frame.built_object_layout_version = object_layout_version;
+        }
+        else if (!frame.dirty_objects.is_empty())
+        {
+            // Only copy the objects that changed since the last time this buffer was written
+            // Track the modified range to flush only that part
+            auto     buf       = static_cast<GPUObjectData *>(frame.object_info_buffer.mapped_data);
+            uint32_t min_index = UINT32_MAX;
+            uint32_t max_index = 0;
+            for (const auto &object_i : frame.dirty_objects)
+            {
+                buf[object_i] = object_data[object_i];
+                min_index     = std::min(min_index, object_i);
+                max_index     = std::max(max_index, object_i);
+            }
+            allocator.flush_buffer(frame.object_info_buffer,
+                                   sizeof(GPUObjectData) * min_index,
+                                   sizeof(GPUObjectData) * (max_index - min_index + 1));
+        }
+        frame.dirty_objects.clear();
+        frame.object_buffer_frame_number = current_frame_number;
+
+        // endregion
+    }
+
+    AllocatedBuffer Renderer::Data::create_object_buffer(size_t size) const
+    {
+        // It is written by the CPU, and placed in device-local memory when the CPU can write there, since shaders read it a lot
+        if (allocator.has_host_visible_device_memory())
+        {
+            return allocator.create_host_visible_device_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        }
+        return allocator.create_buffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, false, true);
+    }
+
+    // endregion
+
+    // region Transfer functions
+
+    void Renderer::Data::init_transfer_context()
+    {
+        VkCommandPoolCreateInfo command_pool_create_info = {
+            .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext            = VK_NULL_HANDLE,
+            .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = transfer_queue.family_index,
+        };
+        for (auto &batch : transfer_context.batches)
+        {
+            vk_check(vkCreateCommandPool(device, &command_pool_create_info, nullptr, &batch.command_pool));
+            const VkCommandBufferAllocateInfo cmd_allocate_info = {
+                .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+                .commandPool        = batch.command_pool,
+                .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+                .commandBufferCount = 1,
+            };
+            vk_check(vkAllocateCommandBuffers(device, &cmd_allocate_info, &batch.command_buffer));
+        }
+
+        VkSemaphoreTypeCreateInfo semaphore_type_create_info = {
+            .sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+            .pNext         = nullptr,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+            .initialValue  = 0,
+        };
+        const VkSemaphoreCreateInfo semaphore_create_info = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &semaphore_type_create_info,
+            .flags = 0,
+        };
+        vk_check(vkCreateSemaphore(device, &semaphore_create_info, nullptr, &transfer_context.timeline));
+
+        transfer_context.staging_ring =
+            allocator.create_buffer(STAGING_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, false, true);
+    }
+
+    void Renderer::Data::destroy_transfer_context()
+    {
+        reclaim_transfer_batches(true);
+
+        for (auto &batch : transfer_context.batches)
+        {
+            // Uploads that were never submitted are dropped
+            for (auto &buffer : batch.dedicated_staging_buffers)
+            {
+                allocator.destroy_buffer(buffer);
+            }
+            batch.dedicated_staging_buffers.clear();
+
+            vkDestroyCommandPool(device, batch.command_pool, nullptr);
+        }
+        vkDestroySemaphore(device, transfer_context.timeline, nullptr);
+
+        allocator.destroy_buffer(transfer_context.staging_ring);
+    }
+
+    void Renderer::Data::reclaim_transfer_batches(bool wait)
+    {
+        if (transfer_context.completed_value == transfer_context.submitted_value)
+        {
+            // Every batch is already reclaimed
+            return;
+        }
+
+        if (wait)
+        {
+            const VkSemaphoreWaitInfo wait_info = {
+                .sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                .pNext          = nullptr,
+                .flags          = 0,
+                .semaphoreCount = 1,
+                .pSemaphores    = &transfer_context.timeline,
+                .pValues        = &transfer_context.submitted_value,
+            };
+            vk_check(vkWaitSemaphores(device, &wait_info, WAIT_FOR_FENCES_TIMEOUT), "Failed to wait for the transfers");
+        }
+        vk_check(vkGetSemaphoreCounterValue(device, transfer_context.timeline, &transfer_context.completed_value));
+
+        for (auto &batch : transfer_context.batches)
+        {
+            if (!batch.is_submitted || batch.timeline_value > transfer_context.completed_value)
+            {
+                continue;
+            }
+
+            // The batch is done, its resources can be reused
+            vk_check(vkResetCommandPool(device, batch.command_pool, 0));
+            for (auto &buffer : batch.dedicated_staging_buffers)
+            {
+                allocator.destroy_buffer(buffer);
+            }
+            batch.dedicated_staging_buffers.clear();
+            transfer_context.staging_free_position = std::max(transfer_context.staging_free_position, batch.staging_end);
+            batch.is_submitted                     = false;
+        }
+    }
+
+    VkCommandBuffer Renderer::Data::begin_transfer()
+    {
+        auto &batch = transfer_context.batches[transfer_context.current_batch];
+        if (!batch.is_recording)
+        {
+            // The batch may still be used by a previous submission
+            if (batch.is_submitted)
+            {
+                reclaim_transfer_batches(true);
+            }
+
+            constexpr VkCommandBufferBeginInfo begin_info = {
+                .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+                .pNext            = nullptr,
+                .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+                .pInheritanceInfo = nullptr,
+            };
+            vk_check(vkBeginCommandBuffer(batch.command_buffer, &begin_info));
+            batch.is_recording = true;
+            batch.staging_end  = transfer_context.staging_write_position;
+        }
+        return batch.command_buffer;
+    }
+
+    StagingAllocation Renderer::Data::allocate_staging(size_t size, size_t alignment)
+    {
+        // The allocation belongs to the current batch, which needs to be recording
+        begin_transfer();
+        auto          &batch    = transfer_context.batches[transfer_context.current_batch];
+        auto          &ring     = transfer_context.staging_ring;
+        const uint64_t capacity = ring.size;
+
+        if (size <= capacity)
+        {
+            // An allocation doesn't wrap around the end of the ring: it starts again from the beginning instead
+            uint64_t start = (transfer_context.staging_write_position + alignment - 1) / alignment * alignment;
+            if (start % capacity + size > capacity)
+            {
+                start = (start / capacity + 1) * capacity;
+            }
+
+            // If the ring seems full, some of the submitted batches may be done
+            if (start + size - transfer_context.staging_free_position > capacity)
+            {
+                reclaim_transfer_batches(false);
+            }
+            if (start + size - transfer_context.staging_free_position <= capacity)
+            {
+                transfer_context.staging_write_position = start + size;
+                batch.staging_end                       = transfer_context.staging_write_position;
+
+                const size_t offset = start % capacity;
+                return StagingAllocation {
+                    .buffer = ring.buffer,
+                    .offset = offset,
+                    .data   = static_cast<uint8_t *>(ring.mapped_data) + offset,
+                };
+            }
+        }
+
+        // The ring is full or too small, use a staging buffer for this upload only
+        auto buffer = allocator.create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, false, true);
+        batch.dedicated_staging_buffers.push_back(buffer);
+        return StagingAllocation {
+            .buffer = buffer.buffer,
+            .offset = 0,
+            .data   = buffer.mapped_data,
+        };
+    }
+
+    void Renderer::Data::flush_staging_ring()
+    {
+        const auto    &ring     = transfer_context.staging_ring;
+        const uint64_t start    = transfer_context.staging_flushed_position;
+        const uint64_t end      = transfer_context.staging_write_position;
+        const uint64_t capacity = ring.size;
+
+        // Only the part written since the last submission needs to be flushed
+        if (end - start >= capacity)
+        {
+            allocator.flush_buffer(ring, 0, capacity);
+        }
+        else if (end > start)
+        {
+            const uint64_t offset = start % capacity;
+            if (offset + (end - start) <= capacity)
+            {
+                allocator.flush_buffer(ring, offset, end - start);
+            }
+            else
+            {
+                // The range wraps around the end of the ring
+                allocator.flush_buffer(ring, offset, capacity - offset);
+                allocator.flush_buffer(ring, 0, offset + (end - start) - capacity);
+            }
+        }
+        transfer_context.staging_flushed_position = end;
+    }
+
+    uint64_t Renderer::Data::submit_transfers()
+    {
+        auto &batch = transfer_context.batches[transfer_context.current_batch];
+        if (batch.is_recording)
+        {
+            // Make the writes of the CPU visible to the GPU
+            flush_staging_ring();
+            for (const auto &buffer : batch.dedicated_staging_buffers)
+            {
+                allocator.flush_buffer(buffer, 0, buffer.size);
+            }
+
+            vk_check(vkEndCommandBuffer(batch.command_buffer));
+            batch.timeline_value = ++transfer_context.submitted_value;
+
+            const VkTimelineSemaphoreSubmitInfo timeline_submit_info = {
+                .sType                     = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .pNext                     = nullptr,
+                .waitSemaphoreValueCount   = 0,
+                .pWaitSemaphoreValues      = nullptr,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues    = &batch.timeline_value,
+            };
+            const VkSubmitInfo submit_info = {
+                .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext                = &timeline_submit_info,
+                .waitSemaphoreCount   = 0,
+                .pWaitSemaphores      = nullptr,
+                .pWaitDstStageMask    = nullptr,
+                .commandBufferCount   = 1,
+                .pCommandBuffers      = &batch.command_buffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores    = &transfer_context.timeline,
+            };
+            vk_check(vkQueueSubmit(transfer_queue.queue, 1, &submit_info, VK_NULL_HANDLE));
+
+            batch.is_recording             = false;
+            batch.is_submitted             = true;
+            transfer_context.current_batch = (transfer_context.current_batch + 1) % NB_OVERLAPPING_FRAMES;
+        }
+
+        // The rendering depends on every upload that was submitted, but those that are known to be done don't need to be waited
+        return transfer_context.submitted_value > transfer_context.completed_value ? transfer_context.submitted_value : 0;
+    }
+
+    // endregion
+
+    // region Upload functions
+
+    /** Extension appended to the path of an image to get the path of the KTX2 file caching its encoding. */
+    constexpr const char *TEXTURE_CACHE_EXTENSION = ".ktx2";
+
+    /** The levels of the textures are aligned in staging memory, since copies need offsets multiple of the size of the blocks. */
+    constexpr size_t TEXTURE_LEVEL_ALIGNMENT = 16;
+
+    /**
+     * Returns the size of the levels of an encoded texture in staging memory, in the given format, from first_mip to mip_levels.
+     * It is also the estimation of the GPU memory they use.
+     */
+    size_t get_texture_upload_size(const TextureData &data, TextureFormat format, uint32_t first_mip, uint32_t mip_levels)
+    {
+        size_t size = 0;
+        for (uint32_t level = first_mip; level < mip_levels; level++)
+        {
+            const auto &level_info = data.levels()[level];
+            size  = (size + TEXTURE_LEVEL_ALIGNMENT - 1) / TEXTURE_LEVEL_ALIGNMENT * TEXTURE_LEVEL_ALIGNMENT;
+            size += get_texture_level_size(format, level_info.width, level_info.height);
+        }
+        return size;
+    }
+
+    /**
+     * Encodes an image in the format of the options, or loads it from the KTX2 cache of a previous encoding. The cache is only written
+     * for streamed textures, so that loading the other ones doesn't leave files next to their images.
+     */
+    TextureData load_encoded_image(const char *path, const TextureOptions &options)
+    {
+        // The cache is only used if it was encoded from the same image, with the same options
+        const std::string cache_path   = std::string(path) + TEXTURE_CACHE_EXTENSION;
+        uint64_t          source_stamp = 0;
+        if (options.use_cache)
+        {
+            source_stamp = TextureData::get_source_stamp(path, options.format, options.mip_levels);
+        }
+        if (source_stamp != 0)
+        {
+            auto cached_texture = TextureData::load_ktx2(cache_path.c_str(), source_stamp);
+            if (cached_texture.is_valid())
+            {
+                return cached_texture;
+            }
+        }
+
+        int32_t  width, height, tex_channels;
+        stbi_uc *pixels = stbi_load(path, &width, &height, &tex_channels, STBI_rgb_alpha);
+        if (pixels == nullptr)
+        {
+            return {};
+        }
+        TextureData texture(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), options.format, options.mip_levels);
+        stbi_image_free(pixels);
+
+        // Save the result for the next time
+        if (options.streamed && source_stamp != 0 && texture.is_valid() && !texture.save_ktx2(cache_path.c_str(), source_stamp))
+        {
+            std::cout << "[Texture Loader Warning] Unable to write the texture cache " << cache_path << '\n';
+        }
+        return texture;
+    }
+
+    /** Decodes an image in RGBA8, in memory that must hold exactly its texels. Returns false if it can't be decoded. */
+    bool decode_image(const char *path, void *output, size_t size, VkExtent3D extent)
+    {
+        int32_t width, height, tex_channels;
+        stbi_set_output_target(output, size);
+        stbi_uc *pixels = stbi_load(path, &width, &height, &tex_channels, STBI_rgb_alpha);
+        stbi_set_output_target(nullptr, 0);
+
+        // The file may have changed since its size was read
+        if (pixels == nullptr || static_cast<uint32_t>(width) != extent.width || static_cast<uint32_t>(height) != extent.height)
+        {
+            if (pixels != nullptr && pixels != output)
+            {
+                stbi_image_free(pixels);
+            }
+            return false;
+        }
+        if (pixels != output)
+        {
+            // The decoder didn't write in the output directly, for example because of an intermediate conversion
+            memcpy(output, pixels, size);
+            stbi_image_free(pixels);
+        }
+        return true;
+    }
+
+    bool Renderer::Data::consume_upload_budget(size_t size)
+    {
+        // The first upload of a frame is always done, so that big ones can't be blocked
+        if (upload_budget_exhausted || (upload_budget != 0 && frame_upload_bytes != 0 && frame_upload_bytes + size > upload_budget))
+        {
+            // The next uploads wait as well, so that they keep their order instead of letting smaller ones pass
+            upload_budget_exhausted = true;
+            return false;
+        }
+
+        frame_upload_bytes += size;
+        return true;
+    }
+
+    bool Renderer::Data::supports_format_features(VkFormat format, VkFormatFeatureFlags features) const
+    {
+        VkFormatProperties format_properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+        return (format_properties.optimalTilingFeatures & features) == features;
+    }
+
+    AllocatedImage Renderer::Data::create_texture_image(const Texture &texture, uint32_t first_mip) const
+    {
+        // The generation of the mip levels reads the previous level of the image
+        const uint32_t    level_count = texture.mip_levels - first_mip;
+        VkImageUsageFlags usage       = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (texture.data == nullptr && level_count > 1)
+        {
+            usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+
+        const VkExtent3D extent = {
+            std::max(texture.extent.width >> first_mip, 1u),
+            std::max(texture.extent.height >> first_mip, 1u),
+            1,
+        };
+        return allocator.create_image(convert_texture_format(texture.format),
+                                      extent,
+                                      usage,
+                                      VK_IMAGE_ASPECT_COLOR_BIT,
+                                      VMA_MEMORY_USAGE_GPU_ONLY,
+                                      false,
+                                      level_count);
+    }
+
+    void Renderer::Data::upload_texture(TextureId texture_id, Texture &texture, const PendingTextureUpload &upload)
+    {
+        // The copy is recorded in the current transfer batch, which is submitted before the next frame
+        const VkCommandBuffer cmd = begin_transfer();
+
+        // Encoded textures have all their levels, while images only have their first one: the other ones are generated after it
+        // Streaming replaces the image of a resident texture by one containing other levels, since its size can't change
+        const uint32_t level_count = texture.mip_levels - upload.first_mip;
+        AllocatedImage image       = texture.is_resident ? create_texture_image(texture, upload.first_mip) : texture.image;
+
+        Array<VkBufferImageCopy> copy_regions(texture.data != nullptr ? level_count : 1);
+        VkBuffer                 staging_buffer = VK_NULL_HANDLE;
+        if (texture.data != nullptr)
+        {
+            // The texels are written directly in staging memory, instead of being written in a buffer and copied
+            const auto staging = allocate_staging(upload.size, TEXTURE_LEVEL_ALIGNMENT);
+            staging_buffer     = staging.buffer;
+
+            // They are decoded if the device doesn't support their format
+            const bool needs_decoding = texture.format != texture.data->format();
+            size_t     level_offset   = 0;
+            for (uint32_t image_level = 0; image_level < level_count; image_level++)
+            {
+                const uint32_t level      = upload.first_mip + image_level;
+                const auto    &level_info = texture.data->levels()[level];
+                auto          *output     = static_cast<uint8_t *>(staging.data) + level_offset;
+                if (needs_decoding)
+                {
+                    texture.data->decode_level(level, output);
+                }
+                else
+                {
+                    memcpy(output, texture.data->level_data(level), level_info.size);
+                }
+
+                copy_regions[image_level] = {
+                    .bufferOffset      = staging.offset + level_offset,
+                    .bufferRowLength   = 0,
+                    .bufferImageHeight = 0,
+                    .imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, image_level, 0, 1},
+                    .imageOffset       = {0, 0, 0},
+                    .imageExtent       = {level_info.width, level_info.height, 1},
+                };
+
+                level_offset += get_texture_level_size(texture.format, level_info.width, level_info.height);
+                level_offset  = (level_offset + TEXTURE_LEVEL_ALIGNMENT - 1) / TEXTURE_LEVEL_ALIGNMENT * TEXTURE_LEVEL_ALIGNMENT;
+            }
+        }
+        else
+        {
+            // Images were decoded in their own staging buffer, which is released with the batch
+            auto &decoded_buffer = upload.decoding->staging_buffer;
+            allocator.flush_buffer(decoded_buffer, 0, upload.size);
+            transfer_context.batches[transfer_context.current_batch].dedicated_staging_buffers.push_back(decoded_buffer);
+            staging_buffer = decoded_buffer.buffer;
+            decoded_buffer = {};
+
+            copy_regions[0] = {
+                .bufferOffset      = 0,
+                .bufferRowLength   = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .imageOffset       = {0, 0, 0},
+                .imageExtent       = texture.extent,
+            };
+        }
+
+        // Do the transfer and conversion
+        VkImageSubresourceRange subresource_range   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, level_count, 0, 1};
+        VkImageMemoryBarrier    barrier_to_transfer = {
+               .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+               .pNext = nullptr,
+               // Access mask
+               .srcAccessMask = 0,
+               .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+               // Image layout
+               .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
+               .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+               .image            = image.image,
+               .subresourceRange = subresource_range,
+        };
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier_to_transfer);
+
+        // Copy image data from staging buffer to image
+        vkCmdCopyBufferToImage(cmd,
+                               staging_buffer,
+                               image.image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(copy_regions.size()),
+                               copy_regions.data());
+
+        if (texture.data == nullptr && level_count > 1)
+        {
+            // The other levels are generated by the graphics queue, so the image stays in the transfer layout
+            if (graphics_queue.family_index != transfer_queue.family_index)
+            {
+                VkImageMemoryBarrier barrier_to_graphics = barrier_to_transfer;
+                barrier_to_graphics.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+                barrier_to_graphics.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier_to_graphics.dstAccessMask        = 0;
+                barrier_to_graphics.srcQueueFamilyIndex  = transfer_queue.family_index;
+                barrier_to_graphics.dstQueueFamilyIndex  = graphics_queue.family_index;
+                vkCmdPipelineBarrier(cmd,
+                                     VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                     VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                     0,
+                                     0,
+                                     nullptr,
+                                     0,
+                                     nullptr,
+                                     1,
+                                     &barrier_to_graphics);
+
+                // Acquire it before the generation
+                VkImageMemoryBarrier barrier_to_graphics2 = barrier_to_graphics;
+                barrier_to_graphics2.srcAccessMask        = 0;
+                barrier_to_graphics2.dstAccessMask        = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+                transfer_context.image_acquisitions.push_back(barrier_to_graphics2);
+            }
+
+            transfer_context.mip_generations.push_back(MipGeneration {
+                .image      = image.image,
+                .extent     = texture.extent,
+                .mip_levels = level_count,
+            });
+        }
+        else if (graphics_queue.family_index == transfer_queue.family_index)
+        {
+            // Change its format again
+            VkImageMemoryBarrier barrier_to_readable = barrier_to_transfer;
+            barrier_to_readable.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier_to_readable.newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier_to_readable.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier_to_readable.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &barrier_to_readable);
+        }
+        else
+        {
+            // Release the image from the transfer queue. The layout transition is done by the release and the acquisition.
+            VkImageMemoryBarrier barrier_to_readable = barrier_to_transfer;
+            barrier_to_readable.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier_to_readable.newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier_to_readable.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier_to_readable.dstAccessMask        = 0;
+            barrier_to_readable.srcQueueFamilyIndex  = transfer_queue.family_index;
+            barrier_to_readable.dstQueueFamilyIndex  = graphics_queue.family_index;
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &barrier_to_readable);
+
+            // The graphics queue acquires it at the beginning of the next frame
+            VkImageMemoryBarrier barrier_to_readable2 = barrier_to_readable;
+            barrier_to_readable2.srcAccessMask        = 0;
+            barrier_to_readable2.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+            transfer_context.image_acquisitions.push_back(barrier_to_readable2);
+        }
 
-    // region Mesh part functions
+        // The previous image may still be used by the frames in flight, so it is retired once its descriptors are updated
+        if (texture.is_resident)
+        {
+            replaced_texture_images.push_back(ReplacedTextureImage {
+                .texture_id   = texture_id,
+                .image        = texture.image,
+                .frame_number = current_frame_number,
+            });
+            texture.image = image;
+        }
+        texture.first_resident_mip = upload.first_mip;
+    }
 
-    VertexInputDescription Renderer::Data::get_vertex_description()
+    void Renderer::Data::generate_mipmaps(VkCommandBuffer cmd, const MipGeneration &generation)
     {
-        static constexpr VkVertexInputBindingDescription bindings[1] = {
-            VkVertexInputBindingDescription {
-                .binding   = 0,
-                .stride    = sizeof(Vertex),
-                .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-            },
+        VkImageMemoryBarrier barrier = {
+            .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext               = nullptr,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image               = generation.image,
+            .subresourceRange    = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
         };
 
-        static const VkVertexInputAttributeDescription attributes[3] = {
-            // Vertex position attribute: location 0
-            VkVertexInputAttributeDescription {
-                .location = 0,
-                .binding  = 0,
-                .format   = VK_FORMAT_R32G32B32_SFLOAT,
-                .offset   = static_cast<uint32_t>(offsetof(Vertex, position)),
-            },
-            // Vertex normal attribute: location 1
-            VkVertexInputAttributeDescription {
-                .location = 1,
-                .binding  = 0,
-                .format   = VK_FORMAT_R32G32B32_SFLOAT,
-                .offset   = static_cast<uint32_t>(offsetof(Vertex, normal)),
-            },
-            // Vertex color coordinates attribute: location 2
-            VkVertexInputAttributeDescription {
-                .location = 2,
-                .binding  = 0,
-                .format   = VK_FORMAT_R32G32_SFLOAT,
-                .offset   = static_cast<uint32_t>(offsetof(Vertex, tex_coord)),
-            },
-        };
+        auto width  = static_cast<int32_t>(generation.extent.width);
+        auto height = static_cast<int32_t>(generation.extent.height);
 
-        static constexpr VertexInputDescription description {
-            .flags           = 0,
-            .binding_count   = 1,
-            .bindings        = bindings,
-            .attribute_count = 3,
-            .attributes      = attributes,
-        };
+        // Each level is downsampled from the previous one, which is then ready to be sampled
+        for (uint32_t level = 1; level < generation.mip_levels; level++)
+        {
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            barrier.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout                     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask                 = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &barrier);
+
+            const int32_t next_width  = width > 1 ? width / 2 : 1;
+            const int32_t next_height = height > 1 ? height / 2 : 1;
+
+            // Downsample the whole previous level
+            VkImageBlit blit = {
+                .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1},
+                .srcOffsets     = {{0, 0, 0}, {width, height, 1}},
+                .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1},
+                .dstOffsets     = {{0, 0, 0}, {next_width, next_height, 1}},
+            };
+            vkCmdBlitImage(cmd,
+                           generation.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           generation.image,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1,
+                           &blit,
+                           VK_FILTER_LINEAR);
+
+            barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr,
+                                 1,
+                                 &barrier);
 
-        return description;
+            width  = next_width;
+            height = next_height;
+        }
+
+        // The last level was only written
+        barrier.subresourceRange.baseMipLevel = generation.mip_levels - 1;
+        barrier.oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout                     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask                 = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier);
     }
 
-    void Renderer::Data::update_mesh_buffers()
+    void Renderer::Data::upload_pending_textures()
     {
-        // For now, keep it simple: we create a buffer big enough for every mesh in the storage and send it.
-        // Later, we can try to introduce more local updates to the existing buffer (for example define it like a gpu vector) TODO
-
-        if (should_update_mesh_buffers)
+        size_t uploaded_count = 0;
+        for (; uploaded_count < pending_texture_uploads.size(); uploaded_count++)
         {
-            // Create transfer commands
-            TransferCommand vb_transfer_command = create_transfer_command(transfer_context.transfer_pool);
-            TransferCommand ib_transfer_command = create_transfer_command(transfer_context.transfer_pool);
+            auto &upload  = pending_texture_uploads[uploaded_count];
+            auto  texture = textures.get(upload.texture_id);
+            if (!texture.has_value())
+            {
+                // The texture was destroyed before its upload
+                release_image_decoding(upload);
+                continue;
+            }
+
+            // Images are uploaded once their worker is done decoding them
+            if (upload.decoding != nullptr
+                && upload.decoding->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                break;
+            }
+
+            if (!consume_upload_budget(upload.size))
+            {
+                break;
+            }
 
-            constexpr size_t vertex_size   = MeshPart::vertex_byte_size();
-            constexpr size_t triangle_size = MeshPart::triangle_byte_size();
-            constexpr size_t index_size    = MeshPart::index_byte_size();
+            texture->has_pending_upload = false;
+            if (upload.decoding != nullptr && !upload.decoding->result.get())
+            {
+                // The texture stays non-resident, and the materials using it aren't drawn
+                std::cerr << "Failed to load texture: " << upload.decoding->path << std::endl;
+                texture->has_failed = true;
+                release_image_decoding(upload);
+                continue;
+            }
 
-            // Determine the size of all meshes
-            size_t total_vb_size = 0;
-            size_t total_ib_size = 0;
+            const uint32_t previous_first_mip = texture->first_resident_mip;
+            upload_texture(upload.texture_id, *texture, upload);
+            if (!texture->is_resident)
+            {
+                texture->is_resident = true;
+                write_texture_slot(*texture);
 
-            for (auto &res : mesh_parts)
+                // The materials using it can now be drawn, the draw cache is rebuilt once for the whole frame if it skipped them
+                has_new_uploads = true;
+            }
+            else if (upload.first_mip < previous_first_mip)
+            {
+                texture_streaming_statistics.streamed_in_count++;
+                texture_streaming_statistics.streamed_in_bytes += upload.size - texture->resident_size;
+            }
+            else
             {
-                const auto &part = res.value();
+                texture_streaming_statistics.evicted_count++;
+                texture_streaming_statistics.evicted_bytes += texture->resident_size - upload.size;
+            }
+            texture->resident_size = upload.size;
+            release_image_decoding(upload);
 
-                total_vb_size += vertex_size * part.mesh_part.vertex_count();
-                total_ib_size += triangle_size * part.mesh_part.triangle_count();
+            // The texels of the textures that aren't streamed aren't needed anymore
+            if (!texture->is_streamed)
+            {
+                delete texture->data;
+                texture->data = nullptr;
             }
+        }
+
+        // Remove the uploaded textures from the queue, keeping the order of the other ones
+        const size_t remaining_count = pending_texture_uploads.size() - uploaded_count;
+        for (size_t i = 0; i < remaining_count; i++)
+        {
+            pending_texture_uploads[i] = pending_texture_uploads[uploaded_count + i];
+        }
+        for (size_t i = 0; i < uploaded_count; i++)
+        {
+            pending_texture_uploads.pop_back();
+        }
+    }
+
+    void Renderer::Data::release_image_decoding(PendingTextureUpload &upload) const
+    {
+        if (upload.decoding == nullptr)
+        {
+            return;
+        }
+
+        // The worker may still be writing in the staging buffer
+        if (upload.decoding->result.valid())
+        {
+            upload.decoding->result.wait();
+        }
+        if (upload.decoding->staging_buffer.is_valid())
+        {
+            allocator.destroy_buffer(upload.decoding->staging_buffer);
+        }
+        delete upload.decoding;
+        upload.decoding = nullptr;
+    }
 
-            // region Create GPU-side buffers
+    void Renderer::Data::retire_texture(TextureId texture_id, Texture &texture)
+    {
+        // Drop its uploads that weren't recorded yet, keeping the order of the other ones
+        size_t kept_count = 0;
+        for (size_t i = 0; i < pending_texture_uploads.size(); i++)
+        {
+            if (pending_texture_uploads[i].texture_id == texture_id)
+            {
+                release_image_decoding(pending_texture_uploads[i]);
+            }
+            else
+            {
+                pending_texture_uploads[kept_count++] = pending_texture_uploads[i];
+            }
+        }
+        while (pending_texture_uploads.size() > kept_count)
+        {
+            pending_texture_uploads.pop_back();
+        }
 
-            // Vertex buffer
-            auto vb_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-            if (!vertex_buffer.is_valid())
+        // The next frame doesn't need to acquire its image or generate its levels anymore
+        for (size_t i = 0; i < transfer_context.image_acquisitions.size();)
+        {
+            if (transfer_context.image_acquisitions[i].image == texture.image.image)
             {
-                // Doesn't exist yet, create it
-                vertex_buffer = allocator.create_buffer(total_vb_size, vb_usage, VMA_MEMORY_USAGE_GPU_ONLY, true);
+                transfer_context.image_acquisitions.remove_at(i);
             }
-            else if (vertex_buffer.size < total_vb_size)
+            else
             {
-                // Exists but too small, reallocate it
-                allocator.destroy_buffer(vertex_buffer);
-                vertex_buffer = allocator.create_buffer(total_vb_size, vb_usage, VMA_MEMORY_USAGE_GPU_ONLY, true);
+                i++;
             }
-            // Index buffer
-            auto ib_usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-            if (!index_buffer.is_valid())
+        }
+        for (size_t i = 0; i < transfer_context.mip_generations.size();)
+        {
+            if (transfer_context.mip_generations[i].image == texture.image.image)
             {
-                // Doesn't exist yet, create it
-                index_buffer = allocator.create_buffer(total_ib_size, ib_usage, VMA_MEMORY_USAGE_GPU_ONLY, true);
+                transfer_context.mip_generations.remove_at(i);
             }
-            else if (index_buffer.size < total_ib_size)
+            else
             {
-                // Exists but too small, reallocate it
-                allocator.destroy_buffer(index_buffer);
-                index_buffer = allocator.create_buffer(total_ib_size, ib_usage, VMA_MEMORY_USAGE_GPU_ONLY, true);
+                i++;
             }
+        }
 
-            // endregion
+        retire_texture_image(texture.image, texture.sampler, texture.bindless_slot);
+
+        delete texture.data;
+        texture.data = nullptr;
+    }
+
+    void Renderer::Data::retire_texture_image(const AllocatedImage &image, VkSampler sampler, uint32_t bindless_slot)
+    {
+        // A copy in the image may already be recorded in the current batch, which will signal the next value
+        const bool is_recording = transfer_context.batches[transfer_context.current_batch].is_recording;
+        retired_textures.push_back(RetiredTexture {
+            .image          = image,
+            .sampler        = sampler,
+            .bindless_slot  = bindless_slot,
+            .frame_number   = current_frame_number,
+            .transfer_value = transfer_context.submitted_value + (is_recording ? 1 : 0),
+        });
+    }
+
+    void Renderer::Data::release_retired_textures(bool force)
+    {
+        // Like the mesh parts, the images are released once the frame that followed their destruction is done. The transfers are
+        // checked separately, since the texture may have been destroyed after its copy was recorded.
+        for (size_t i = 0; i < retired_textures.size();)
+        {
+            const auto &retired = retired_textures[i];
+            if (force
+                || (retired.frame_number + NB_OVERLAPPING_FRAMES - 1 <= current_frame_number
+                    && retired.transfer_value <= transfer_context.completed_value))
+            {
+                allocator.destroy_image(retired.image);
+                if (retired.sampler != VK_NULL_HANDLE)
+                {
+                    vkDestroySampler(device, retired.sampler, nullptr);
+                    free_texture_slots.push_back(retired.bindless_slot);
+                }
+                retired_textures.remove_at(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    // endregion
 
-            // region Setup transfer buffers
+    // region Texture streaming functions
 
-            vb_transfer_command.staging_buffer =
-                allocator.create_buffer(total_vb_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-            ib_transfer_command.staging_buffer =
-                allocator.create_buffer(total_ib_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    /** Number of frames between two evaluations of the levels needed by the visible objects. */
+    constexpr uint64_t TEXTURE_STREAMING_INTERVAL = 4;
+    /** Streamed textures are first loaded from the most detailed level that fits in this size, which then stays resident. */
+    constexpr uint32_t TEXTURE_STREAMING_INITIAL_SIZE = 64;
+    /** Distance under which the objects are considered to touch the camera, to avoid dividing by 0. */
+    constexpr float TEXTURE_STREAMING_MIN_DISTANCE = 0.001f;
 
-            // Copy data to the buffers
-            size_t vb_offset = 0;
-            size_t ib_offset = 0;
+    void Renderer::Data::update_texture_streaming()
+    {
+        // The needed levels change slowly, so they are only evaluated every few frames
+        if (current_frame_number % TEXTURE_STREAMING_INTERVAL != 0)
+        {
+            return;
+        }
 
-            // Map buffers
-            auto vb = static_cast<Vertex *>(allocator.map_buffer(vb_transfer_command.staging_buffer));
-            auto ib = static_cast<Triangle *>(allocator.map_buffer(ib_transfer_command.staging_buffer));
+        for (auto &res : textures)
+        {
+            res.value().wanted_resolution = 0.0f;
+        }
 
-            for (auto &res : mesh_parts)
+        // Find the resolution that the visible objects of each camera need in their textures
+        for (auto &cam_entry : cameras)
+        {
+            const auto &camera = cam_entry.value();
+            if (!camera.enabled || object_count == 0)
             {
-                auto &part = res.value();
+                continue;
+            }
+
+            const auto &swapchain   = swapchains[camera.target_swapchain_index];
+            const auto  camera_data = get_camera_data(camera);
+            cull_objects_on_cpu(camera_data);
 
-                // Copy vertex data
-                part.vertex_offset = vb_offset;
-                for (const auto &vertex : part.mesh_part.vertices())
+            // A length l at a distance d covers l * |p11| / d half-heights of the viewport, and l * |p11| in orthographic
+            const bool      is_perspective  = camera_data.projection[3][3] == 0.0f;
+            const glm::vec3 camera_position = glm::vec3(glm::inverse(camera_data.view)[3]);
+            const float     half_height     = 0.5f * static_cast<float>(swapchain.viewport_extent.height);
+            const float     pixels_per_unit = std::abs(camera_data.projection[1][1]) * half_height;
+
+            for (const auto &model_entry : models)
+            {
+                const auto &model    = model_entry.value();
+                const auto &part     = mesh_parts[model.mesh_part_id];
+                const auto  material = materials.get(model.material_id);
+                if (!material.has_value() || part.uv_density <= 0.0f || part.bounding_sphere.w <= 0.0f)
                 {
-                    vb[vb_offset] = vertex;
-                    vb_offset++;
+                    continue;
                 }
 
-                // Copy index data
-                part.index_offset = ib_offset;
-                for (const auto &triangle : part.mesh_part.triangles())
+                // The nearest visible instance needs the most detail. Its radius gives the scale of the model.
+                float        resolution = 0.0f;
+                const size_t end        = std::min(static_cast<size_t>(model.first_instance) + model.instances.size(), object_count);
+                for (size_t object_i = model.first_instance; object_i < end; object_i++)
                 {
-                    ib[ib_offset] = triangle;
-                    ib_offset++;
+                    if (object_visibility[object_i] == 0)
+                    {
+                        continue;
+                    }
+
+                    // Pixels covered by a unit of model space
+                    const float radius      = object_bounds_radius[object_i];
+                    float       unit_pixels = pixels_per_unit * radius / part.bounding_sphere.w;
+                    if (is_perspective)
+                    {
+                        const glm::vec3 center(object_bounds_x[object_i], object_bounds_y[object_i], object_bounds_z[object_i]);
+                        const float     distance = glm::length(center - camera_position) - radius;
+                        unit_pixels /= std::max(distance, TEXTURE_STREAMING_MIN_DISTANCE);
+                    }
+
+                    // The density gives the size of the texture for which a texel covers a pixel
+                    resolution = std::max(resolution, unit_pixels / part.uv_density);
                 }
 
-                part.is_uploaded = true;
+                if (resolution == 0.0f)
+                {
+                    continue;
+                }
+                for (size_t effect_i = 0; effect_i < material->textures.size(); effect_i++)
+                {
+                    const auto &effect_textures = material->textures[effect_i];
+                    for (size_t texture_i = 0; texture_i < effect_textures.size(); texture_i++)
+                    {
+                        auto texture = textures.get(effect_textures[texture_i]);
+                        if (texture.has_value())
+                        {
+                            texture->wanted_resolution = std::max(texture->wanted_resolution, resolution);
+                            texture->last_used_frame   = current_frame_number;
+                        }
+                    }
+                }
             }
+        }
 
-            // Unmap buffers
-            allocator.unmap_buffer(vb_transfer_command.staging_buffer);
-            allocator.unmap_buffer(ib_transfer_command.staging_buffer);
+        // Convert the resolutions to levels, and find the textures whose levels need to change
+        TextureStreamingStatistics &statistics = texture_streaming_statistics;
+        statistics.streamed_texture_count      = 0;
+        statistics.missing_level_texture_count = 0;
+        statistics.resident_bytes              = 0;
+        statistics.wanted_bytes                = 0;
+
+        size_t            target_bytes = 0;
+        Vector<TextureId> stream_ins(4);
+        Vector<TextureId> evictions(4);
+        for (auto &res : textures)
+        {
+            auto &texture = res.value();
+            if (!texture.is_streamed)
+            {
+                continue;
+            }
 
-            // endregion
+            texture.wanted_mip = texture.initial_mip;
+            if (texture.wanted_resolution > 0.0f)
+            {
+                const auto  size   = static_cast<float>(std::max(texture.extent.width, texture.extent.height));
+                const float mip    = std::floor(std::log2(size / texture.wanted_resolution));
+                texture.wanted_mip = static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture.initial_mip)));
+            }
 
-            // region Copy data to GPU
+            statistics.streamed_texture_count++;
+            statistics.resident_bytes += texture.resident_size;
+            statistics.wanted_bytes +=
+                get_texture_upload_size(*texture.data, texture.format, texture.wanted_mip, texture.mip_levels);
+            if (texture.first_resident_mip > texture.wanted_mip)
+            {
+                statistics.missing_level_texture_count++;
+            }
+            target_bytes += texture.target_size;
 
-            // Vertex buffer
-            vb_transfer_command.begin();
-            VkBufferCopy vb_copy {
-                .srcOffset = 0,
-                .dstOffset = 0,
-                .size      = total_vb_size,
-            };
-            vkCmdCopyBuffer(vb_transfer_command.command_buffer,
-                            vb_transfer_command.staging_buffer.buffer,
-                            vertex_buffer.buffer,
-                            1,
-                            &vb_copy);
-            vb_transfer_command.end_and_submit(transfer_queue.queue);
-
-            // Index buffer
-            ib_transfer_command.begin();
-            VkBufferCopy ib_copy {
-                .srcOffset = 0,
-                .dstOffset = 0,
-                .size      = total_ib_size,
-            };
-            vkCmdCopyBuffer(ib_transfer_command.command_buffer,
-                            ib_transfer_command.staging_buffer.buffer,
-                            index_buffer.buffer,
-                            1,
-                            &ib_copy);
-            ib_transfer_command.end_and_submit(transfer_queue.queue);
+            // The textures being uploaded are evaluated again once they are done
+            if (texture.has_pending_upload)
+            {
+                continue;
+            }
+            if (texture.wanted_mip < texture.target_mip)
+            {
+                stream_ins.push_back(res.key());
+            }
+            else if (texture.target_mip < texture.wanted_mip)
+            {
+                evictions.push_back(res.key());
+            }
+        }
 
-            // endregion
+        // The textures can use the memory that the rest of the application leaves in the budget of the device
+        const VmaBudget heap_budget  = allocator.get_main_heap_budget();
+        const size_t    other_usage  = heap_budget.usage - std::min<size_t>(heap_budget.usage, statistics.resident_bytes);
+        size_t          budget_bytes = heap_budget.budget > other_usage ? heap_budget.budget - other_usage : 0;
+        if (texture_memory_budget != 0)
+        {
+            budget_bytes = std::min(budget_bytes, texture_memory_budget);
+        }
+        statistics.budget_bytes = budget_bytes;
+
+        // The textures missing the most levels are streamed in first, and the extra levels of the least recently used ones are
+        // evicted to make room for them. The levels needed on screen are never evicted, so the textures don't keep switching.
+        std::sort(stream_ins.data(),
+                  stream_ins.data() + stream_ins.size(),
+                  [this](TextureId a, TextureId b)
+                  {
+                      const auto &texture_a = textures[a];
+                      const auto &texture_b = textures[b];
+                      return texture_a.target_mip - texture_a.wanted_mip > texture_b.target_mip - texture_b.wanted_mip;
+                  });
+        std::sort(evictions.data(),
+                  evictions.data() + evictions.size(),
+                  [this](TextureId a, TextureId b) { return textures[a].last_used_frame < textures[b].last_used_frame; });
+
+        size_t eviction_i = 0;
+        for (size_t i = 0; i < stream_ins.size(); i++)
+        {
+            auto &texture = textures[stream_ins[i]];
+
+            // If the wanted levels don't fit, less detailed ones are tried
+            for (uint32_t mip = texture.wanted_mip; mip < texture.target_mip; mip++)
+            {
+                const size_t size = get_texture_upload_size(*texture.data, texture.format, mip, texture.mip_levels);
+                while (target_bytes - texture.target_size + size > budget_bytes && eviction_i < evictions.size())
+                {
+                    const TextureId evicted_id = evictions[eviction_i++];
+                    auto           &evicted    = textures[evicted_id];
+                    target_bytes              -= evicted.target_size;
+                    queue_texture_levels(evicted_id, evicted, evicted.wanted_mip);
+                    target_bytes += evicted.target_size;
+                }
 
-            // Store the commands
-            transfer_context.commands.push_back(vb_transfer_command);
-            transfer_context.commands.push_back(ib_transfer_command);
+                if (target_bytes - texture.target_size + size <= budget_bytes)
+                {
+                    target_bytes -= texture.target_size;
+                    queue_texture_levels(stream_ins[i], texture, mip);
+                    target_bytes += texture.target_size;
+                    break;
+                }
+            }
+        }
 
-            // Mesh buffers will now be up-to-date
-            should_update_mesh_buffers = false;
+        // If the budget decreased, the extra levels are evicted as well
+        while (target_bytes > budget_bytes && eviction_i < evictions.size())
+        {
+            const TextureId evicted_id = evictions[eviction_i++];
+            auto           &evicted    = textures[evicted_id];
+            target_bytes              -= evicted.target_size;
+            queue_texture_levels(evicted_id, evicted, evicted.wanted_mip);
+            target_bytes += evicted.target_size;
+        }
+    }
 
-            // Though, we need to update draw cache because the buffers might have changed
-            draw_cache_version++;
+    void Renderer::Data::queue_texture_levels(TextureId texture_id, Texture &texture, uint32_t first_mip)
+    {
+        // The image is replaced when the levels are uploaded, so the size is already the one it will have
+        texture.target_mip         = first_mip;
+        texture.target_size        = get_texture_upload_size(*texture.data, texture.format, first_mip, texture.mip_levels);
+        texture.has_pending_upload = true;
+
+        pending_texture_uploads.push_back(PendingTextureUpload {
+            .texture_id = texture_id,
+            .decoding   = nullptr,
+            .size       = texture.target_size,
+            .first_mip  = first_mip,
+        });
+    }
+
+    void Renderer::Data::update_replaced_texture_descriptors()
+    {
+        if (replaced_texture_images.is_empty())
+        {
+            return;
+        }
+
+        // With bindless textures, the replaced textures keep their slot. The set can be updated after being bound, so the slot is
+        // written once, in the frame of the replacement.
+        for (const auto &replaced : replaced_texture_images)
+        {
+            const auto texture = textures.get(replaced.texture_id);
+            if (replaced.frame_number == current_frame_number && texture.has_value())
+            {
+                write_texture_slot(*texture);
+            }
+        }
+
+        // Update the sets of the current frame of the materials that use the replaced textures. Since we waited for its fence, no
+        // frame in flight uses them, and the sets of the other frames are updated at their next draw. The handles of the sets don't
+        // change, so the draw cache stays valid.
+        const uint64_t frame_index = get_current_frame_index();
+        for (auto &material_entry : materials)
+        {
+            auto &material = material_entry.value();
+            for (size_t effect_i = 0; effect_i < material.textures.size(); effect_i++)
+            {
+                const auto &effect_textures = material.textures[effect_i];
+                const auto  textures_set    = material.textures_sets[effect_i * NB_OVERLAPPING_FRAMES + frame_index];
+                bool        uses_replaced   = false;
+                for (size_t texture_i = 0; texture_i < effect_textures.size() && !uses_replaced; texture_i++)
+                {
+                    for (const auto &replaced : replaced_texture_images)
+                    {
+                        uses_replaced |= effect_textures[texture_i] == replaced.texture_id;
+                    }
+                }
+                if (!uses_replaced || textures_set == VK_NULL_HANDLE)
+                {
+                    continue;
+                }
+
+                // The textures are bound in order from the binding 0, like when the material was created
+                Array<VkDescriptorImageInfo> image_infos(effect_textures.size());
+                Array<VkWriteDescriptorSet>  writes(effect_textures.size());
+                uint32_t                     write_count = 0;
+                for (size_t texture_i = 0; texture_i < effect_textures.size(); texture_i++)
+                {
+                    const auto texture = textures.get(effect_textures[texture_i]);
+                    if (!texture.has_value())
+                    {
+                        continue;
+                    }
+
+                    image_infos[write_count] = {
+                        .sampler     = texture->sampler,
+                        .imageView   = texture->image.image_view,
+                        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    };
+                    writes[write_count] = {
+                        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .pNext           = nullptr,
+                        .dstSet          = textures_set,
+                        .dstBinding      = static_cast<uint32_t>(texture_i),
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                        .pImageInfo      = &image_infos[write_count],
+                    };
+                    write_count++;
+                }
+                vkUpdateDescriptorSets(device, write_count, writes.data(), 0, nullptr);
+            }
+        }
+
+        // Once the sets of every frame are updated, the previous images are only used by the frames in flight
+        for (size_t i = 0; i < replaced_texture_images.size();)
+        {
+            const auto &replaced = replaced_texture_images[i];
+            if (replaced.frame_number + NB_OVERLAPPING_FRAMES - 1 <= current_frame_number)
+            {
+                retire_texture_image(replaced.image, VK_NULL_HANDLE, 0);
+                replaced_texture_images.remove_at(i);
+            }
+            else
+            {
+                i++;
+            }
         }
     }
 
     // endregion
 
-    // region Storage buffers functions
+    // region Bindless texture functions
 
-    void Renderer::Data::update_storage_buffers(FrameData &frame)
+    /** Maximum number of textures in the array of the bindless set. It is also limited by the device. */
+    constexpr uint32_t BINDLESS_TEXTURE_CAPACITY = 4096;
+
+    void Renderer::Data::init_bindless_textures()
     {
-        // region Object data
+        VkPhysicalDeviceVulkan12Properties vulkan_12_properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES,
+            .pNext = nullptr,
+        };
+        VkPhysicalDeviceProperties2 properties = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+            .pNext = &vulkan_12_properties,
+        };
+        vkGetPhysicalDeviceProperties2(physical_device, &properties);
+        bindless_texture_capacity = std::min({
+            BINDLESS_TEXTURE_CAPACITY,
+            vulkan_12_properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+            vulkan_12_properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            vulkan_12_properties.maxDescriptorSetUpdateAfterBindSamplers,
+            vulkan_12_properties.maxDescriptorSetUpdateAfterBindSampledImages,
+        });
 
-        // We do it each frame because we want to be able to move objects around
+        // The material buffer of a set is only replaced when its frame is done, but the slots of the new textures are written in
+        // every set while they are bound. The slots that are not written yet are never read.
+        const VkDescriptorSetLayoutBinding bindings[2] = {
+            {
+                .binding            = 0,
+                .descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount    = 1,
+                .stageFlags         = VK_SHADER_STAGE_ALL_GRAPHICS,
+                .pImmutableSamplers = nullptr,
+            },
+            {
+                .binding            = 1,
+                .descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .descriptorCount    = bindless_texture_capacity,
+                .stageFlags         = VK_SHADER_STAGE_ALL_GRAPHICS,
+                .pImmutableSamplers = nullptr,
+            },
+        };
+        const VkDescriptorBindingFlags binding_flags[2] = {
+            0,
+            VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT
+                | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+        };
+        const VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_create_info = {
+            .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+            .pNext         = nullptr,
+            .bindingCount  = 2,
+            .pBindingFlags = binding_flags,
+        };
+        const VkDescriptorSetLayoutCreateInfo layout_create_info = {
+            .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext        = &binding_flags_create_info,
+            .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+            .bindingCount = 2,
+            .pBindings    = bindings,
+        };
+        vk_check(vkCreateDescriptorSetLayout(device, &layout_create_info, nullptr, &bindless_set_layout),
+                 "Couldn't create bindless set layout");
 
-        // We need to store a GPUObjectData for each model
-        // TODO, later, it will be for each render node
+        // The sets of the frames get their own pool
+        const VkDescriptorPoolSize pool_sizes[2] = {
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, NB_OVERLAPPING_FRAMES},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, bindless_texture_capacity * NB_OVERLAPPING_FRAMES},
+        };
+        const VkDescriptorPoolCreateInfo pool_create_info = {
+            .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext         = nullptr,
+            .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+            .maxSets       = NB_OVERLAPPING_FRAMES,
+            .poolSizeCount = 2,
+            .pPoolSizes    = pool_sizes,
+        };
+        vk_check(vkCreateDescriptorPool(device, &pool_create_info, nullptr, &bindless_descriptor_pool),
+                 "Couldn't create bindless descriptor pool");
 
-        // If the capacity is too small, we need to increase it
-        if (object_data_capacity < models.count())
+        VkDescriptorSetLayout set_layouts[NB_OVERLAPPING_FRAMES];
+        for (auto &set_layout : set_layouts)
         {
-            // For now, we take a fixed margin above the required amount to avoid frequent reallocation's
-            // In the future, maybe a vector approach would be better (i.e. double the growth amount each time)
-            object_data_capacity = models.count() + 50;
-
-            // We also need to update the config version, so that the descriptor sets will be updated
-            buffer_config_version++;
-
-            const auto required_size = sizeof(GPUObjectData) * object_data_capacity;
-            if (!frame.object_info_buffer.is_valid())
-            {
-                // Doesn't exist yet, create it
-                frame.object_info_buffer =
-                    allocator.create_buffer(required_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-            }
-            else if (frame.object_info_buffer.size < required_size)
-            {
-                // Exists but too small, reallocate it
-                allocator.destroy_buffer(frame.object_info_buffer);
-                frame.object_info_buffer =
-                    allocator.create_buffer(required_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-            }
+            set_layout = bindless_set_layout;
         }
-        // Copy model data to the GPU
-        if (frame.object_info_buffer.is_valid())
-        {
-            auto buf = static_cast<GPUObjectData *>(allocator.map_buffer(frame.object_info_buffer));
+        const VkDescriptorSetAllocateInfo allocate_info = {
+            .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext              = nullptr,
+            .descriptorPool     = bindless_descriptor_pool,
+            .descriptorSetCount = NB_OVERLAPPING_FRAMES,
+            .pSetLayouts        = set_layouts,
+        };
+        vk_check(vkAllocateDescriptorSets(device, &allocate_info, bindless_sets), "Couldn't allocate bindless sets");
 
-            auto i = 0;
-            for (const auto &model : models)
+        // Write the textures that were uploaded before
+        for (const auto &res : textures)
+        {
+            if (res.value().is_resident)
             {
-                buf[i] = GPUObjectData {
-                    .transform = model.value().transform.view_matrix(),
-                };
-                i++;
+                write_texture_slot(res.value());
             }
-
-            allocator.unmap_buffer(frame.object_info_buffer);
         }
-
-        // endregion
     }
 
-    // endregion
-
-    // region Transfer functions
-
-    void Renderer::Data::reset_transfer_context()
+    void Renderer::Data::write_texture_slot(const Texture &texture) const
     {
-        // Nothing to reset
-        if (transfer_context.commands.is_empty())
+        if (bindless_sets[0] == VK_NULL_HANDLE || texture.bindless_slot >= bindless_texture_capacity)
         {
             return;
         }
 
-        // Wait for the transfer queue to finish
-        Array<VkFence> fences {transfer_context.commands.size()};
-        for (size_t i = 0; i < transfer_context.commands.size(); i++)
+        const VkDescriptorImageInfo image_info = {
+            .sampler     = texture.sampler,
+            .imageView   = texture.image.image_view,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        VkWriteDescriptorSet writes[NB_OVERLAPPING_FRAMES];
+        for (uint32_t frame_i = 0; frame_i < NB_OVERLAPPING_FRAMES; frame_i++)
+        {
+            writes[frame_i] = VkWriteDescriptorSet {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = bindless_sets[frame_i],
+                .dstBinding      = 1,
+                .dstArrayElement = texture.bindless_slot,
+                .descriptorCount = 1,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo      = &image_info,
+            };
+        }
+        vkUpdateDescriptorSets(device, NB_OVERLAPPING_FRAMES, writes, 0, nullptr);
+    }
+
+    void Renderer::Data::update_material_buffer(uint64_t frame_index)
+    {
+        if (!uses_bindless_textures)
         {
-            fences[i] = transfer_context.commands[i].fence;
+            return;
         }
-        vkWaitForFences(device, fences.size(), fences.data(), VK_TRUE, WAIT_FOR_FENCES_TIMEOUT);
 
-        for (auto &command : transfer_context.commands)
+        // The slots of the textures of each effect of a material follow each other, in the order of the bindings
+        if (material_table_version != materials_version)
         {
-            // Destroy the staging buffers
-            if (command.staging_buffer.is_valid())
+            material_slot_count = 0;
+            for (auto &material_entry : materials)
             {
-                allocator.destroy_buffer(command.staging_buffer);
+                auto &material                 = material_entry.value();
+                material.texture_table_offsets = Array<uint32_t>(material.textures.size());
+                for (size_t effect_i = 0; effect_i < material.textures.size(); effect_i++)
+                {
+                    material.texture_table_offsets[effect_i] = static_cast<uint32_t>(material_slot_count);
+                    material_slot_count += material.textures[effect_i].size();
+                }
             }
-            // Destroy fence
-            vkDestroyFence(device, command.fence, nullptr);
-        }
 
-        // Reset command pool
-        vkResetCommandPool(device, transfer_context.transfer_pool, 0);
-        vkResetCommandPool(device, transfer_context.graphics_pool, 0);
+            // The instances reference the offsets of their material
+            material_table_version = materials_version;
+            draw_cache_version++;
+        }
 
-        // Clear the commands
-        transfer_context.commands.clear();
-    }
+        // The buffer of the other frames may still be read, they will update theirs when they are recorded
+        if (built_materials_versions[frame_index] == materials_version)
+        {
+            return;
+        }
 
-    TransferCommand Renderer::Data::create_transfer_command(VkCommandPool pool) const
-    {
-        const VkCommandBufferAllocateInfo cmd_allocate_info = {
-            .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-            .commandPool        = pool,
-            .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1,
-        };
-        constexpr VkFenceCreateInfo fence_create_info = {
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-            .flags = 0,
-        };
-        TransferCommand command = {};
-        vk_check(vkAllocateCommandBuffers(device, &cmd_allocate_info, &command.command_buffer));
-        vk_check(vkCreateFence(device, &fence_create_info, nullptr, &command.fence));
-        return command;
-    }
+        // There is at least one slot, so that the buffer always exists for the set
+        auto      &material_buffer = material_buffers[frame_index];
+        const auto buffer_size     = std::max(material_slot_count, static_cast<size_t>(1)) * sizeof(uint32_t);
+        const bool reallocated =
+            reserve_buffer(material_buffer, buffer_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, true);
 
-    void TransferCommand::begin() const
-    {
-        constexpr VkCommandBufferBeginInfo begin_info = {
-            .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-            .pNext            = nullptr,
-            .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            .pInheritanceInfo = nullptr,
-        };
-        vkBeginCommandBuffer(command_buffer, &begin_info);
-    }
+        auto *slots = static_cast<uint32_t *>(material_buffer.mapped_data);
+        for (const auto &material_entry : materials)
+        {
+            const auto &material = material_entry.value();
+            for (size_t effect_i = 0; effect_i < material.textures.size(); effect_i++)
+            {
+                const auto &effect_textures = material.textures[effect_i];
+                for (size_t texture_i = 0; texture_i < effect_textures.size(); texture_i++)
+                {
+                    const auto texture = textures.get(effect_textures[texture_i]);
+                    slots[material.texture_table_offsets[effect_i] + texture_i] = texture.has_value() ? texture->bindless_slot : 0;
+                }
+            }
+        }
+        allocator.flush_buffer(material_buffer, 0, buffer_size);
 
-    void TransferCommand::end_and_submit(VkQueue queue)
-    {
-        vk_check(vkEndCommandBuffer(command_buffer));
+        if (reallocated)
+        {
+            const VkDescriptorBufferInfo buffer_info = {
+                .buffer = material_buffer.buffer,
+                .offset = 0,
+                .range  = VK_WHOLE_SIZE,
+            };
+            const VkWriteDescriptorSet write = {
+                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext           = nullptr,
+                .dstSet          = bindless_sets[frame_index],
+                .dstBinding      = 0,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo     = &buffer_info,
+            };
+            vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        }
 
-        // Submit commands
-        const VkSubmitInfo submit_info = {
-            .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .pNext                = nullptr,
-            .waitSemaphoreCount   = 0,
-            .pWaitSemaphores      = nullptr,
-            .pWaitDstStageMask    = nullptr,
-            .commandBufferCount   = 1,
-            .pCommandBuffers      = &command_buffer,
-            .signalSemaphoreCount = 0,
-            .pSignalSemaphores    = nullptr,
-        };
-        vk_check(vkQueueSubmit(queue, 1, &submit_info, fence));
+        built_materials_versions[frame_index] = materials_version;
     }
 
     // endregion
@@ -2853,6 +6687,10 @@ namespace rg
 
             // Get GPU properties
             vkGetPhysicalDeviceProperties(m_data->physical_device, &m_data->device_properties);
+
+            // The render stages are timed with timestamps written by the graphics queue
+            m_data->supports_timestamps = queue_family_properties[m_data->graphics_queue.family_index].timestampValidBits > 0
+                                          && m_data->device_properties.limits.timestampPeriod > 0.0f;
         }
 
         // endregion
@@ -2898,15 +6736,78 @@ namespace rg
                 });
             }
 
-            Array<const char *> required_device_extensions = {
-                VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+            // The budget of the texture streaming is more precise when the driver reports the memory budget
+            m_data->supports_memory_budget =
+                check_device_extension_support(m_data->physical_device, {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME});
+            Array<const char *> required_device_extensions(m_data->supports_memory_budget ? 2 : 1);
+            required_device_extensions[0] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+            if (m_data->supports_memory_budget)
+            {
+                required_device_extensions[1] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+            }
+
+            // Check optional features
+            VkPhysicalDeviceVulkan12Features supported_vulkan_12_features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+                .pNext = nullptr,
+            };
+            VkPhysicalDeviceFeatures2 supported_features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &supported_vulkan_12_features,
+            };
+            vkGetPhysicalDeviceFeatures2(m_data->physical_device, &supported_features);
+
+            // GPU culling writes the number of draws in a buffer, so it needs vkCmdDrawIndexedIndirectCount
+            m_data->supports_draw_indirect_count = supported_vulkan_12_features.drawIndirectCount == VK_TRUE;
+
+            // Textures are sampled with anisotropic filtering when it is available
+            if (supported_features.features.samplerAnisotropy == VK_TRUE)
+            {
+                m_data->max_sampler_anisotropy = m_data->device_properties.limits.maxSamplerAnisotropy;
+            }
+
+            // Block-compressed textures are uploaded as is when they are supported
+            m_data->supports_block_compression = supported_features.features.textureCompressionBC == VK_TRUE;
+            m_data->uses_block_compression     = m_data->supports_block_compression;
+
+            // Bindless textures index a partially written array of textures, which is updated while it is bound
+            m_data->supports_bindless_textures =
+                supported_vulkan_12_features.shaderSampledImageArrayNonUniformIndexing == VK_TRUE
+                && supported_vulkan_12_features.descriptorBindingSampledImageUpdateAfterBind == VK_TRUE
+                && supported_vulkan_12_features.descriptorBindingUpdateUnusedWhilePending == VK_TRUE
+                && supported_vulkan_12_features.descriptorBindingPartiallyBound == VK_TRUE
+                && supported_vulkan_12_features.runtimeDescriptorArray == VK_TRUE;
+            const VkBool32 bindless_feature = m_data->supports_bindless_textures ? VK_TRUE : VK_FALSE;
+
+            // Features needed by the indirect draws, the synchronization of the uploads and the bindless textures
+            VkPhysicalDeviceVulkan12Features enabled_vulkan_12_features = {
+                .sType                                        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+                .pNext                                        = nullptr,
+                .drawIndirectCount                            = supported_vulkan_12_features.drawIndirectCount,
+                .shaderSampledImageArrayNonUniformIndexing    = bindless_feature,
+                .descriptorBindingSampledImageUpdateAfterBind = bindless_feature,
+                .descriptorBindingUpdateUnusedWhilePending    = bindless_feature,
+                .descriptorBindingPartiallyBound              = bindless_feature,
+                .runtimeDescriptorArray                       = bindless_feature,
+                .timelineSemaphore                            = VK_TRUE,
+            };
+            VkPhysicalDeviceFeatures2 enabled_features = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &enabled_vulkan_12_features,
+                .features =
+                    {
+                        .multiDrawIndirect         = VK_TRUE,
+                        .drawIndirectFirstInstance = VK_TRUE,
+                        .samplerAnisotropy         = supported_features.features.samplerAnisotropy,
+                        .textureCompressionBC      = supported_features.features.textureCompressionBC,
+                    },
             };
 
             // Create the logical device
             VkDeviceCreateInfo device_create_info = {
                 // Struct infos
                 .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-                .pNext = nullptr,
+                .pNext = &enabled_features,
                 // Queue infos
                 .queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size()),
                 .pQueueCreateInfos    = queue_create_infos.data(),
@@ -2946,7 +6847,8 @@ namespace rg
                                                 m_data->device,
                                                 m_data->physical_device,
                                                 m_data->graphics_queue.family_index,
-                                                m_data->transfer_queue.family_index));
+                                                m_data->transfer_queue.family_index,
+                                                m_data->supports_memory_budget));
 
         // --=== Swapchains ===--
 
@@ -3049,6 +6951,29 @@ namespace rg
                 vk_check(
                     vkCreateRenderPass(m_data->device, &render_pass_create_info, nullptr, &m_data->render_stages[i].vk_render_pass),
                     "Couldn't create \"" + std::string(stage_desc.name) + "\" (" + std::to_string(i) + ") render pass");
+
+                // With occlusion culling, the stage can be drawn a second time on top of the first one
+                if (stage_desc.occlusion_culling)
+                {
+                    check(stage_desc.uses_material_system && depth_reference_set,
+                          "Occlusion culling requires the \"" + std::string(stage_desc.name)
+                              + "\" stage to use the material system and to have a depth attachment.");
+
+                    m_data->render_stages[i].occlusion_culling      = true;
+                    m_data->render_stages[i].depth_attachment_index = depth_reference.attachment;
+
+                    // Keep what the first pass drew. Only the load operations and layouts differ, so both passes are compatible.
+                    for (auto &att : attachments)
+                    {
+                        att.loadOp        = VK_ATTACHMENT_LOAD_OP_LOAD;
+                        att.initialLayout = att.finalLayout;
+                    }
+                    vk_check(vkCreateRenderPass(m_data->device,
+                                                &render_pass_create_info,
+                                                nullptr,
+                                                &m_data->render_stages[i].vk_load_render_pass),
+                             "Couldn't create \"" + std::string(stage_desc.name) + "\" (" + std::to_string(i) + ") load render pass");
+                }
             }
         }
         // endregion
@@ -3062,9 +6987,82 @@ namespace rg
             .save_descriptor_set_layout(&m_data->swapchain_set_layout)
             // Object data
             .add_storage_buffer(VK_SHADER_STAGE_VERTEX_BIT)
-            .save_descriptor_set_layout(&m_data->global_set_layout);
+            .save_descriptor_set_layout(&m_data->global_set_layout)
+            // Culling shader: objects, instances, draws, visible instances, commands and counts
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .save_descriptor_set_layout(&m_data->culling_set_layout)
+            // Occlusion culling shader: hidden instances and depth pyramid
+            .add_storage_buffer(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_combined_image_sampler(VK_SHADER_STAGE_COMPUTE_BIT)
+            .save_descriptor_set_layout(&m_data->occlusion_set_layout)
+            // Depth reduction shader: source image and written level of the depth pyramid
+            .add_combined_image_sampler(VK_SHADER_STAGE_COMPUTE_BIT)
+            .add_storage_image(VK_SHADER_STAGE_COMPUTE_BIT)
+            .save_descriptor_set_layout(&m_data->depth_reduce_set_layout);
         m_data->buffer_config_version++;
 
+        // Create culling pipeline layout
+        // The pipeline itself is created when the culling shader is set
+        VkPushConstantRange culling_push_constant_range = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset     = 0,
+            .size       = sizeof(GPUCullingParameters),
+        };
+        VkPipelineLayoutCreateInfo culling_pipeline_layout_create_info = {
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext                  = nullptr,
+            .flags                  = 0,
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &m_data->culling_set_layout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &culling_push_constant_range,
+        };
+        vk_check(
+            vkCreatePipelineLayout(m_data->device, &culling_pipeline_layout_create_info, nullptr, &m_data->culling_pipeline_layout),
+            "Couldn't create culling pipeline layout");
+
+        // Same for occlusion culling, which uses the culling set and a second one for the depth pyramid
+        VkPushConstantRange occlusion_culling_push_constant_range = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset     = 0,
+            .size       = sizeof(GPUOcclusionCullingParameters),
+        };
+        const Array<VkDescriptorSetLayout> occlusion_culling_set_layouts = {m_data->culling_set_layout, m_data->occlusion_set_layout};
+        VkPipelineLayoutCreateInfo occlusion_culling_pipeline_layout_create_info = {
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext                  = nullptr,
+            .flags                  = 0,
+            .setLayoutCount         = static_cast<uint32_t>(occlusion_culling_set_layouts.size()),
+            .pSetLayouts            = occlusion_culling_set_layouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges    = &occlusion_culling_push_constant_range,
+        };
+        vk_check(vkCreatePipelineLayout(m_data->device,
+                                        &occlusion_culling_pipeline_layout_create_info,
+                                        nullptr,
+                                        &m_data->occlusion_culling_pipeline_layout),
+                 "Couldn't create occlusion culling pipeline layout");
+
+        VkPipelineLayoutCreateInfo depth_reduce_pipeline_layout_create_info = {
+            .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext                  = nullptr,
+            .flags                  = 0,
+            .setLayoutCount         = 1,
+            .pSetLayouts            = &m_data->depth_reduce_set_layout,
+            .pushConstantRangeCount = 0,
+            .pPushConstantRanges    = nullptr,
+        };
+        vk_check(vkCreatePipelineLayout(m_data->device,
+                                        &depth_reduce_pipeline_layout_create_info,
+                                        nullptr,
+                                        &m_data->depth_reduce_pipeline_layout),
+                 "Couldn't create depth reduction pipeline layout");
+
         // Create static descriptor pool
         m_data->static_descriptor_pool = DynamicDescriptorPool(m_data->device,
                                                                DescriptorBalance {
@@ -3073,6 +7071,7 @@ namespace rg
                                                                    0,
                                                                    // Lots of capacity for textures
                                                                    100,
+                                                                   0,
                                                                });
 
         // --=== Init frames ===--
@@ -3099,6 +7098,18 @@ namespace rg
                 .flags = 0,
             };
 
+            // Two timestamps per render stage: one before it and one after it
+            const auto stage_count = m_data->render_pipeline_description.stages.size();
+            m_data->stage_gpu_times = Array<double>(stage_count);
+
+            VkQueryPoolCreateInfo timestamp_pool_create_info = {
+                .sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                .pNext      = VK_NULL_HANDLE,
+                .flags      = 0,
+                .queryType  = VK_QUERY_TYPE_TIMESTAMP,
+                .queryCount = static_cast<uint32_t>(2 * stage_count),
+            };
+
             // For each frame
             for (auto &frame : m_data->frames)
             {
@@ -3126,14 +7137,21 @@ namespace rg
                 vk_check(vkCreateSemaphore(m_data->device, &semaphore_create_info, nullptr, &frame.render_semaphore),
                          "Couldn't create render semaphore");
 
+                // Create timestamp query pool
+                if (m_data->supports_timestamps && stage_count > 0)
+                {
+                    vk_check(vkCreateQueryPool(m_data->device, &timestamp_pool_create_info, nullptr, &frame.timestamp_pool),
+                             "Couldn't create timestamp query pool");
+                }
+
                 // Create buffers
                 frame.camera_info_buffer = m_data->allocator.create_buffer(m_data->pad_uniform_buffer_size(sizeof(GPUCameraData))
                                                                                * m_data->swapchain_capacity,
                                                                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
-                frame.object_info_buffer = m_data->allocator.create_buffer(sizeof(GPUObjectData) * m_data->object_data_capacity,
-                                                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
+                                                                           VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                                                           false,
+                                                                           true);
+                frame.object_info_buffer = m_data->create_object_buffer(sizeof(GPUObjectData) * m_data->object_data_capacity);
 
                 // Create descriptor pool
                 frame.descriptor_pool = DynamicDescriptorPool(m_data->device,
@@ -3142,6 +7160,7 @@ namespace rg
                                                                   0,
                                                                   2,
                                                                   0,
+                                                                  0,
                                                               });
             }
         }
@@ -3149,16 +7168,7 @@ namespace rg
 
         // --=== Init transfer context ===--
 
-        // Create command pool for the do_transfer queue
-        VkCommandPoolCreateInfo command_pool_create_info = {
-            .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-            .pNext            = VK_NULL_HANDLE,
-            .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-            .queueFamilyIndex = m_data->transfer_queue.family_index,
-        };
-        vk_check(vkCreateCommandPool(m_data->device, &command_pool_create_info, nullptr, &m_data->transfer_context.transfer_pool));
-        command_pool_create_info.queueFamilyIndex = m_data->graphics_queue.family_index;
-        vk_check(vkCreateCommandPool(m_data->device, &command_pool_create_info, nullptr, &m_data->transfer_context.graphics_pool));
+        m_data->init_transfer_context();
     }
     Renderer::Renderer(Renderer &&other) noexcept : m_data(other.m_data)
     {
@@ -3175,10 +7185,8 @@ namespace rg
         // Wait for all frames to finish rendering
         m_data->wait_for_all_fences();
 
-        // Destroy do_transfer context
-        m_data->reset_transfer_context();
-        vkDestroyCommandPool(m_data->device, m_data->transfer_context.transfer_pool, nullptr);
-        vkDestroyCommandPool(m_data->device, m_data->transfer_context.graphics_pool, nullptr);
+        // Destroy transfer context
+        m_data->destroy_transfer_context();
 
         // Destroy vertex and index buffers
         if (m_data->vertex_buffer.is_valid())
@@ -3191,13 +7199,49 @@ namespace rg
             m_data->allocator.destroy_buffer(m_data->index_buffer);
         }
 
+        // Destroy culling pipeline
+        if (m_data->culling_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_data->device, m_data->culling_pipeline, nullptr);
+        }
+        vkDestroyPipelineLayout(m_data->device, m_data->culling_pipeline_layout, nullptr);
+
+        // Destroy occlusion culling pipelines
+        if (m_data->occlusion_culling_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_data->device, m_data->occlusion_culling_pipeline, nullptr);
+        }
+        if (m_data->depth_reduce_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_data->device, m_data->depth_reduce_pipeline, nullptr);
+        }
+        vkDestroyPipelineLayout(m_data->device, m_data->occlusion_culling_pipeline_layout, nullptr);
+        vkDestroyPipelineLayout(m_data->device, m_data->depth_reduce_pipeline_layout, nullptr);
+
         // Destroy descriptor layouts
         vkDestroyDescriptorSetLayout(m_data->device, m_data->swapchain_set_layout, nullptr);
         vkDestroyDescriptorSetLayout(m_data->device, m_data->global_set_layout, nullptr);
+        vkDestroyDescriptorSetLayout(m_data->device, m_data->culling_set_layout, nullptr);
+        vkDestroyDescriptorSetLayout(m_data->device, m_data->occlusion_set_layout, nullptr);
+        vkDestroyDescriptorSetLayout(m_data->device, m_data->depth_reduce_set_layout, nullptr);
 
         // Destroy pool
         m_data->static_descriptor_pool.clear();
 
+        // Destroy bindless set
+        if (m_data->bindless_set_layout != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorPool(m_data->device, m_data->bindless_descriptor_pool, nullptr);
+            vkDestroyDescriptorSetLayout(m_data->device, m_data->bindless_set_layout, nullptr);
+        }
+        for (auto &material_buffer : m_data->material_buffers)
+        {
+            if (material_buffer.is_valid())
+            {
+                m_data->allocator.destroy_buffer(material_buffer);
+            }
+        }
+
         // Clear frames
         for (auto &frame : m_data->frames)
         {
@@ -3212,6 +7256,11 @@ namespace rg
             vkDestroySemaphore(m_data->device, frame.render_semaphore, nullptr);
             // Destroy fence
             vkDestroyFence(m_data->device, frame.render_fence, nullptr);
+            // Destroy query pool
+            if (frame.timestamp_pool != VK_NULL_HANDLE)
+            {
+                vkDestroyQueryPool(m_data->device, frame.timestamp_pool, nullptr);
+            }
             // Destroy command buffer
             vkFreeCommandBuffers(m_data->device, frame.command_pool, 1, &frame.command_buffer);
             // Destroy command pool
@@ -3223,6 +7272,9 @@ namespace rg
         clear_models();
         clear_mesh_parts();
         clear_textures();
+        // Every frame and transfer is done
+        m_data->release_retired_textures(true);
+        m_data->release_retired_buffers(true);
         clear_materials();
         clear_material_templates();
         clear_shader_effects();
@@ -3236,6 +7288,11 @@ namespace rg
         {
             vkDestroyRenderPass(m_data->device, stage.vk_render_pass, nullptr);
             stage.vk_render_pass = VK_NULL_HANDLE;
+            if (stage.vk_load_render_pass != VK_NULL_HANDLE)
+            {
+                vkDestroyRenderPass(m_data->device, stage.vk_load_render_pass, nullptr);
+                stage.vk_load_render_pass = VK_NULL_HANDLE;
+            }
         }
 
         // Destroy allocator
@@ -3359,7 +7416,11 @@ namespace rg
         swapchain.render_stages = Array<RenderStageInstance>(m_data->render_pipeline_description.stages.size());
 
         // Init descriptor pool for "swapchain-lived" sets
-        swapchain.swapchain_static_descriptor_pool = DynamicDescriptorPool(m_data->device, {.combined_image_sampler_count = 10});
+        swapchain.swapchain_static_descriptor_pool = DynamicDescriptorPool(m_data->device,
+                                                                           {
+                                                                               .combined_image_sampler_count = 10,
+                                                                               .storage_image_count          = 10,
+                                                                           });
 
         m_data->init_swapchain_inner(swapchain, extent);
 
@@ -3469,8 +7530,21 @@ namespace rg
         descriptor_set_layouts.push_back(m_data->swapchain_set_layout);
         descriptor_set_layouts.push_back(m_data->global_set_layout);
 
-        // Create texture set layout
-        if (!textures.is_empty())
+        // With bindless textures, the effects drawn with materials share the same set, and the textures of the materials are
+        // found in it. The other ones, like the lighting effects, still bind the textures of their stage.
+        bool uses_material_system = false;
+        for (size_t stage_i = 0; stage_i < m_data->render_pipeline_description.stages.size(); stage_i++)
+        {
+            const auto &stage_desc = m_data->render_pipeline_description.stages[stage_i];
+            uses_material_system |= stage_desc.kind == render_stage_kind && stage_desc.uses_material_system;
+        }
+
+        if (m_data->uses_bindless_textures && uses_material_system)
+        {
+            descriptor_set_layouts.push_back(m_data->bindless_set_layout);
+        }
+        // Otherwise, create texture set layout
+        else if (!textures.is_empty())
         {
             DescriptorSetLayoutBuilder builder(m_data->device);
             for (auto &texture_layout : textures)
@@ -3522,28 +7596,192 @@ namespace rg
             {
                 vkDestroyDescriptorSetLayout(m_data->device, res.value().textures_set_layout, nullptr);
             }
-
-            m_data->shader_modules.remove(id);
+
+            m_data->shader_modules.remove(id);
+        }
+        // No value = already deleted, in a sense. This is not an error since the contract is respected
+    }
+    void Renderer::clear_shader_effects()
+    {
+        for (auto &effect : m_data->shader_effects)
+        {
+            vkDestroyPipelineLayout(m_data->device, effect.value().pipeline_layout, nullptr);
+            if (effect.value().textures_set_layout != VK_NULL_HANDLE)
+            {
+                vkDestroyDescriptorSetLayout(m_data->device, effect.value().textures_set_layout, nullptr);
+            }
+        }
+        m_data->shader_effects.clear();
+    }
+
+    void Renderer::set_global_shader_effect(RenderStageKind stage_kind, ShaderEffectId effect_id)
+    {
+        // Override the old value
+        m_data->global_shader_effects.set(static_cast<HashMap::Key>(stage_kind), HashMap::Value {.as_size = effect_id});
+    }
+
+    bool Renderer::set_culling_shader(ShaderModuleId compute_shader)
+    {
+        // The pipeline may be used by frames in flight
+        m_data->wait_for_all_fences();
+
+        // Destroy the previous pipeline
+        if (m_data->culling_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_data->device, m_data->culling_pipeline, nullptr);
+            m_data->culling_pipeline = VK_NULL_HANDLE;
+        }
+
+        // The draw cache needs to know if the culling buffers are needed
+        m_data->draw_cache_version++;
+
+        // NULL_ID disables culling
+        if (compute_shader == NULL_ID)
+        {
+            return false;
+        }
+
+        // Without indirect count, we can't know how many draws were written by the shader
+        if (!m_data->supports_draw_indirect_count)
+        {
+            std::cout << "GPU culling is not supported by this device, every instance will be drawn.\n";
+            return false;
+        }
+
+        m_data->culling_pipeline = m_data->create_compute_pipeline(compute_shader, m_data->culling_pipeline_layout, "Culling");
+
+        return true;
+    }
+
+    bool Renderer::set_occlusion_culling_shaders(ShaderModuleId culling_shader, ShaderModuleId depth_reduce_shader)
+    {
+        // The pipelines may be used by frames in flight
+        m_data->wait_for_all_fences();
+
+        // Destroy the previous pipelines
+        if (m_data->occlusion_culling_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_data->device, m_data->occlusion_culling_pipeline, nullptr);
+            m_data->occlusion_culling_pipeline = VK_NULL_HANDLE;
+        }
+        if (m_data->depth_reduce_pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_data->device, m_data->depth_reduce_pipeline, nullptr);
+            m_data->depth_reduce_pipeline = VK_NULL_HANDLE;
+        }
+
+        // The draw cache needs to know if the occlusion buffers are needed
+        m_data->draw_cache_version++;
+
+        // NULL_ID disables occlusion culling
+        if (culling_shader == NULL_ID || depth_reduce_shader == NULL_ID)
+        {
+            return false;
+        }
+
+        // Like GPU culling, it relies on indirect count
+        if (!m_data->supports_draw_indirect_count)
+        {
+            std::cout << "Occlusion culling is not supported by this device, every instance will be drawn.\n";
+            return false;
+        }
+
+        m_data->occlusion_culling_pipeline =
+            m_data->create_compute_pipeline(culling_shader, m_data->occlusion_culling_pipeline_layout, "Occlusion culling");
+        m_data->depth_reduce_pipeline =
+            m_data->create_compute_pipeline(depth_reduce_shader, m_data->depth_reduce_pipeline_layout, "Depth reduction");
+
+        return true;
+    }
+
+    void Renderer::set_cpu_culling(bool enabled)
+    {
+        if (m_data->cpu_culling_enabled != enabled)
+        {
+            m_data->cpu_culling_enabled = enabled;
+
+            // The draw cache needs to know if the CPU copies are needed
+            m_data->draw_cache_version++;
+        }
+    }
+
+    bool Renderer::set_bindless_textures(bool enabled)
+    {
+        // The layouts of the pipelines and the sets of the materials depend on it
+        check(m_data->shader_effects.is_empty() && m_data->materials.is_empty(),
+              "Bindless textures must be enabled before the shader effects and the materials are created.");
+
+        if (enabled && !m_data->supports_bindless_textures)
+        {
+            std::cout << "Bindless textures are not supported by this device, each material will bind its textures.\n";
+            enabled = false;
+        }
+        if (enabled && m_data->bindless_sets[0] == VK_NULL_HANDLE)
+        {
+            m_data->init_bindless_textures();
+        }
+
+        m_data->uses_bindless_textures = enabled;
+        m_data->draw_cache_version++;
+        return enabled;
+    }
+
+    void Renderer::set_lod_bias(float bias)
+    {
+        // The selection is done each frame, so there is nothing to rebuild
+        m_data->lod_bias = bias;
+    }
+
+    void Renderer::set_upload_budget(size_t bytes_per_frame)
+    {
+        m_data->upload_budget = bytes_per_frame;
+    }
+
+    UploadStatistics Renderer::get_upload_statistics() const
+    {
+        UploadStatistics statistics = {
+            .pending_upload_count    = 0,
+            .pending_upload_bytes    = 0,
+            .last_frame_upload_bytes = m_data->frame_upload_bytes,
+            .uses_direct_writes      = m_data->allocator.has_host_visible_device_memory(),
+            .failed_texture_count    = 0,
+        };
+
+        for (const auto &upload : m_data->pending_texture_uploads)
+        {
+            if (m_data->textures.get(upload.texture_id).has_value())
+            {
+                statistics.pending_upload_count++;
+                statistics.pending_upload_bytes += upload.size;
+            }
+        }
+        for (const auto &res : m_data->mesh_parts)
+        {
+            const auto &part = res.value();
+            if (!part.is_uploaded)
+            {
+                statistics.pending_upload_count++;
+                statistics.pending_upload_bytes += Renderer::Data::get_upload_size(part.mesh_part);
+            }
         }
-        // No value = already deleted, in a sense. This is not an error since the contract is respected
-    }
-    void Renderer::clear_shader_effects()
-    {
-        for (auto &effect : m_data->shader_effects)
+        for (const auto &res : m_data->textures)
         {
-            vkDestroyPipelineLayout(m_data->device, effect.value().pipeline_layout, nullptr);
-            if (effect.value().textures_set_layout != VK_NULL_HANDLE)
+            if (res.value().has_failed)
             {
-                vkDestroyDescriptorSetLayout(m_data->device, effect.value().textures_set_layout, nullptr);
+                statistics.failed_texture_count++;
             }
         }
-        m_data->shader_effects.clear();
+        return statistics;
     }
 
-    void Renderer::set_global_shader_effect(RenderStageKind stage_kind, ShaderEffectId effect_id)
+    void Renderer::set_texture_memory_budget(size_t bytes)
     {
-        // Override the old value
-        m_data->global_shader_effects.set(static_cast<HashMap::Key>(stage_kind), HashMap::Value {.as_size = effect_id});
+        m_data->texture_memory_budget = bytes;
+    }
+
+    TextureStreamingStatistics Renderer::get_texture_streaming_statistics() const
+    {
+        return m_data->texture_streaming_statistics;
     }
 
     // endregion
@@ -3589,7 +7827,7 @@ namespace rg
         // Get layout
         auto mat_template = m_data->material_templates[material_template];
 
-        Array<VkDescriptorSet> descriptor_sets {textures.size()};
+        Array<VkDescriptorSet> descriptor_sets {textures.size() * NB_OVERLAPPING_FRAMES};
         DescriptorSetBuilder   builder(m_data->device, m_data->static_descriptor_pool);
 
         // For each supported effect that has textures
@@ -3597,27 +7835,38 @@ namespace rg
         {
             auto effect_texture_ids = textures[i];
 
-            if (!effect_texture_ids.is_empty())
+            // With bindless textures, the slots of the textures are written in the material buffer instead
+            if (!effect_texture_ids.is_empty() && !m_data->uses_bindless_textures)
             {
                 auto shader_effect = m_data->shader_effects[mat_template.shader_effects[i]];
 
-                // Create the descriptor set
-                for (auto tex_id : effect_texture_ids)
+                // Create the descriptor set of each frame
+                for (uint32_t frame_i = 0; frame_i < NB_OVERLAPPING_FRAMES; frame_i++)
                 {
-                    auto texture = m_data->textures[tex_id];
-                    builder.add_combined_image_sampler(texture.sampler, texture.image.image_view);
+                    for (auto tex_id : effect_texture_ids)
+                    {
+                        auto texture = m_data->textures[tex_id];
+                        builder.add_combined_image_sampler(texture.sampler, texture.image.image_view);
+                    }
+                    builder.save_descriptor_set(shader_effect.textures_set_layout,
+                                                &descriptor_sets[i * NB_OVERLAPPING_FRAMES + frame_i]);
                 }
-                builder.save_descriptor_set(shader_effect.textures_set_layout, &descriptor_sets[i]);
             }
             else
             {
                 // No textures, set to null
-                descriptor_sets[i] = VK_NULL_HANDLE;
+                for (uint32_t frame_i = 0; frame_i < NB_OVERLAPPING_FRAMES; frame_i++)
+                {
+                    descriptor_sets[i * NB_OVERLAPPING_FRAMES + frame_i] = VK_NULL_HANDLE;
+                }
             }
         }
 
         vk_check(builder.build());
 
+        // The material buffer needs to contain the new material
+        m_data->materials_version++;
+
         // Create material
         return m_data->materials.push({
             material_template,
@@ -3644,32 +7893,80 @@ namespace rg
 
     // region Mesh parts
 
-    MeshPartId Renderer::save_mesh_part(MeshPart &&mesh_part)
+    MeshPartId Renderer::save_mesh_part(MeshPart &&mesh_part, bool gpu_resident_only)
     {
+        // If a part with the same content was already saved, it is shared instead of being uploaded again
+        // The contents are compared when the hashes match, so that a collision doesn't draw the wrong geometry
+        const auto content_hash  = mesh_part.content_hash();
+        const auto existing_part = m_data->mesh_parts_by_content.get(content_hash);
+        if (existing_part.has_value())
+        {
+            const MeshPartId id          = existing_part.value()->as_size;
+            auto            &stored_part = m_data->mesh_parts[id];
+            if (m_data->has_same_content(stored_part, mesh_part))
+            {
+                stored_part.reference_count++;
+                return id;
+            }
+        }
+
         // New buffers to store
         m_data->should_update_mesh_buffers = true;
 
         // Store it in the storage
-        return m_data->mesh_parts.push(StoredMeshPart {
-            std::move(mesh_part),
-        });
+        // Its bounds were computed when it was created, or loaded from the mesh cache
+        StoredMeshPart stored_part(std::move(mesh_part), content_hash, gpu_resident_only);
+        const auto     id = m_data->mesh_parts.push(std::move(stored_part));
+
+        // A part whose content couldn't be compared, or that collided, isn't shared: the first part with that hash stays the one
+        // that is looked up
+        if (!existing_part.has_value())
+        {
+            m_data->mesh_parts_by_content.set(content_hash, HashMap::Value {.as_size = id});
+        }
+        return id;
     }
 
     void Renderer::destroy_mesh_part(MeshPartId id)
     {
-        // Maybe do not update buffers and let it there, and use a smarter way to update them
+        auto part = m_data->mesh_parts.get(id);
+        if (!part.has_value())
+        {
+            return;
+        }
+
+        // Each save of the same content returned that part, and needs to be destroyed before it is
+        part->reference_count--;
+        if (part->reference_count > 0)
+        {
+            return;
+        }
+
+        // The other parts stay in place in the mesh buffers, only the ranges of this one are freed
+        m_data->retire_mesh_part(*part);
+        const auto shared_part = m_data->mesh_parts_by_content.get(part->content_hash);
+        if (shared_part.has_value() && shared_part.value()->as_size == id)
+        {
+            m_data->mesh_parts_by_content.remove(part->content_hash);
+        }
         m_data->should_update_mesh_buffers = true;
+        m_data->draw_cache_version++;
 
-        // There is no special vulkan handle to destroy in the mesh part, so we just let the storage do its job
         m_data->mesh_parts.remove(id);
     }
 
     void Renderer::clear_mesh_parts()
     {
-        // Same here
+        // Same here, for every part
+        for (const auto &res : m_data->mesh_parts)
+        {
+            m_data->retire_mesh_part(res.value());
+        }
         m_data->should_update_mesh_buffers = true;
+        m_data->draw_cache_version++;
 
         m_data->mesh_parts.clear();
+        m_data->mesh_parts_by_content.clear();
     }
 
     // endregion
@@ -3693,6 +7990,10 @@ namespace rg
         check(mat.has_value(), "Material doesn't exist.");
         mat->models_using_material.push_back(model_id);
 
+        // The draw commands need to include the new model
+        m_data->draw_cache_version++;
+        m_data->object_layout_version++;
+
         return model_id;
     }
 
@@ -3709,6 +8010,8 @@ namespace rg
 
             // Remove it from the renderer
             m_data->models.remove(id);
+            m_data->draw_cache_version++;
+            m_data->object_layout_version++;
         }
         // No value = already deleted, in a sense. This is not an error since the contract is respected
     }
@@ -3723,6 +8026,8 @@ namespace rg
         }
 
         m_data->models.clear();
+        m_data->draw_cache_version++;
+        m_data->object_layout_version++;
     }
 
     Transform &Renderer::get_model_transform(ModelId id)
@@ -3746,6 +8051,10 @@ namespace rg
         check(model_res.has_value(), "Model doesn't exist.");
         model_res->instances.push_back(node_id);
 
+        // The instance count of the model changed, so the draw commands and the object buffer need to be updated
+        m_data->draw_cache_version++;
+        m_data->object_layout_version++;
+
         return node_id;
     }
 
@@ -3763,10 +8072,83 @@ namespace rg
 
             // Remove it from the renderer
             m_data->render_nodes.remove(id);
+            m_data->draw_cache_version++;
+            m_data->object_layout_version++;
         }
         // No value = already deleted, in a sense. This is not an error since the contract is respected
     }
 
+    Transform &Renderer::get_render_node_transform(RenderNodeId id)
+    {
+        return m_data->render_nodes[id].transform;
+    }
+
+    RenderNodeId Renderer::raycast_render_nodes(const Ray &ray, float max_distance) const
+    {
+        // The boxes are the ones of the last drawn frame, so the nodes may have been destroyed since then
+        uint32_t hit_object   = 0;
+        float    hit_distance = 0.0f;
+        bool     hit          = false;
+
+        if (m_data->is_scene_bvh_up_to_date())
+        {
+            hit = m_data->scene_bvh.raycast(ray, max_distance, hit_object, hit_distance);
+        }
+        else
+        {
+            // The hierarchy is being rebuilt, test every object
+            for (uint32_t object_i = 0; object_i < m_data->object_count; object_i++)
+            {
+                float distance = 0.0f;
+                if (m_data->object_boxes[object_i].intersects_ray(ray, hit ? hit_distance : max_distance, distance)
+                    && (!hit || distance < hit_distance))
+                {
+                    hit          = true;
+                    hit_object   = object_i;
+                    hit_distance = distance;
+                }
+            }
+        }
+
+        if (!hit || !m_data->render_nodes.get(m_data->object_nodes[hit_object]).has_value())
+        {
+            return NULL_ID;
+        }
+        return m_data->object_nodes[hit_object];
+    }
+
+    Vector<RenderNodeId> Renderer::get_render_nodes_in_box(const AABB &box) const
+    {
+        Vector<uint32_t> objects(16);
+        if (m_data->is_scene_bvh_up_to_date())
+        {
+            m_data->scene_bvh.query_box(box, objects);
+        }
+        else
+        {
+            // The hierarchy is being rebuilt, test every object
+            for (uint32_t object_i = 0; object_i < m_data->object_count; object_i++)
+            {
+                if (m_data->object_boxes[object_i].intersects(box))
+                {
+                    objects.push_back(object_i);
+                }
+            }
+        }
+
+        // Convert the objects to render nodes, skipping the ones destroyed since the last frame
+        Vector<RenderNodeId> nodes(objects.size() + 1);
+        for (const auto &object_i : objects)
+        {
+            const auto node_id = m_data->object_nodes[object_i];
+            if (m_data->render_nodes.get(node_id).has_value())
+            {
+                nodes.push_back(node_id);
+            }
+        }
+        return nodes;
+    }
+
     void Renderer::clear_render_nodes()
     {
         // Since all render nodes will be destroyed, none of them should still exist in the models after the operation
@@ -3777,6 +8159,8 @@ namespace rg
         }
 
         m_data->render_nodes.clear();
+        m_data->draw_cache_version++;
+        m_data->object_layout_version++;
     }
     // endregion
 
@@ -3784,163 +8168,132 @@ namespace rg
 
     TextureId Renderer::load_texture(const char *path, FilterMode filter_mode)
     {
-        // Load image
-        int32_t  width, height, tex_channels;
-        stbi_uc *pixels = stbi_load(path, &width, &height, &tex_channels, STBI_rgb_alpha);
-        if (pixels == nullptr)
+        return load_texture(path, TextureOptions {.filter_mode = filter_mode});
+    }
+
+    TextureId Renderer::load_texture(const char *path, const TextureOptions &options)
+    {
+        if (m_data->uses_bindless_textures && m_data->free_texture_slots.is_empty()
+            && m_data->texture_slot_count >= m_data->bindless_texture_capacity)
         {
-            std::cerr << "Failed to load texture: " << path << std::endl;
+            std::cerr << "Failed to load texture: " << path << " (the bindless texture array is full)" << std::endl;
             return NULL_ID;
         }
 
-        const VkDeviceSize image_size = width * height * 4;
-
-        // Create staging buffer
-        TransferCommand cmd = m_data->create_transfer_command(m_data->transfer_context.transfer_pool);
-        cmd.staging_buffer  = m_data->allocator.create_buffer(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-        // Copy pixels to staging buffer
-        void *data = m_data->allocator.map_buffer(cmd.staging_buffer);
-        memcpy(data, pixels, static_cast<size_t>(image_size));
-        m_data->allocator.unmap_buffer(cmd.staging_buffer);
-
-        // Free imported image
-        stbi_image_free(pixels);
-        pixels = nullptr;
+        // KTX2 files, streamed textures and images in other formats than RGBA8 are loaded with all their levels now, and copied as
+        // is at the upload
+        const size_t path_length = strlen(path);
+        const bool   is_ktx2     = path_length >= 5 && strcmp(path + path_length - 5, ".ktx2") == 0;
+        const bool   is_rgba8    = options.format == TextureFormat::RGBA8_SRGB || options.format == TextureFormat::RGBA8_UNORM;
+        const bool   is_encoded  = is_ktx2 || !is_rgba8 || options.streamed;
+
+        TextureData  *data       = nullptr;
+        TextureFormat format     = options.format;
+        VkExtent3D    extent     = {};
+        uint32_t      mip_levels = 1;
+        size_t        image_size = 0;
+        if (is_encoded)
+        {
+            TextureData texture_data = is_ktx2 ? TextureData::load_ktx2(path) : load_encoded_image(path, options);
+            if (!texture_data.is_valid())
+            {
+                std::cerr << "Failed to load texture: " << path << std::endl;
+                return NULL_ID;
+            }
+            format = texture_data.format();
 
-        constexpr VkFormat image_format = VK_FORMAT_R8G8B8A8_SRGB;
-        const VkExtent3D   extent       = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+            // If the device can't sample the format, the texels are decoded when they are uploaded
+            const VkFormatFeatureFlags sampled_features =
+                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+            if ((is_block_compressed(format) && !m_data->uses_block_compression)
+                || !m_data->supports_format_features(convert_texture_format(format), sampled_features))
+            {
+                if (format == TextureFormat::BC7_SRGB || format == TextureFormat::BC7_UNORM)
+                {
+                    std::cerr << "Failed to load texture: " << path << " (BC7 isn't supported by the device)" << std::endl;
+                    return NULL_ID;
+                }
+                format = get_decoded_format(format);
+            }
 
-        AllocatedImage image = m_data->allocator.create_image(image_format,
-                                                              extent,
-                                                              VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-                                                              VK_IMAGE_ASPECT_COLOR_BIT,
-                                                              VMA_MEMORY_USAGE_GPU_ONLY);
+            // The levels of the file can't be generated again, but the last ones can be dropped
+            const auto level_count = static_cast<uint32_t>(texture_data.levels().size());
+            extent                 = {texture_data.width(), texture_data.height(), 1};
+            mip_levels             = options.mip_levels == 0 ? level_count : std::min(options.mip_levels, level_count);
+            data                   = new TextureData(std::move(texture_data));
+        }
+        else
+        {
+            // Only read the size of the image for now: it is decoded by a worker, and uploaded once it is done
+            int32_t width, height, tex_channels;
+            if (stbi_info(path, &width, &height, &tex_channels) == 0)
+            {
+                std::cerr << "Failed to load texture: " << path << std::endl;
+                return NULL_ID;
+            }
+            extent     = {static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1};
+            image_size = get_texture_level_size(format, extent.width, extent.height);
 
-        // Do the transfer and conversion
-        cmd.begin();
+            // The full chain goes down to a single texel
+            const uint32_t full_mip_count = get_full_mip_count(extent.width, extent.height);
+            mip_levels                    = options.mip_levels == 0 ? full_mip_count : std::min(options.mip_levels, full_mip_count);
 
-        VkImageSubresourceRange subresource_range   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-        VkImageMemoryBarrier    barrier_to_transfer = {
-               .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-               .pNext = nullptr,
-               // Access mask
-               .srcAccessMask = 0,
-               .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-               // Image layout
-               .oldLayout        = VK_IMAGE_LAYOUT_UNDEFINED,
-               .newLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-               .image            = image.image,
-               .subresourceRange = subresource_range,
-        };
-        vkCmdPipelineBarrier(cmd.command_buffer,
-                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT,
-                             0,
-                             0,
-                             nullptr,
-                             0,
-                             nullptr,
-                             1,
-                             &barrier_to_transfer);
+            // They are generated with blits, so without them only the first level can be used
+            const VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+                                                       | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+            if (!m_data->supports_format_features(convert_texture_format(format), blit_features))
+            {
+                mip_levels = 1;
+            }
+        }
 
-        // Copy image data from staging buffer to image
-        VkBufferImageCopy copy_region = {
-            .bufferOffset      = 0,
-            .bufferRowLength   = 0,
-            .bufferImageHeight = 0,
-            .imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
-            .imageOffset       = {0, 0, 0},
-            .imageExtent       = extent,
+        Texture texture = {
+            .is_resident = false,
+            .mip_levels  = mip_levels,
+            .extent      = extent,
+            .format      = format,
+            .data        = data,
         };
-        vkCmdCopyBufferToImage(cmd.command_buffer,
-                               cmd.staging_buffer.buffer,
-                               image.image,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               1,
-                               &copy_region);
 
-        if (m_data->graphics_queue.family_index == m_data->transfer_queue.family_index)
+        // Streamed textures start with their least detailed levels, the other ones are loaded when they are needed
+        if (options.streamed && data != nullptr && mip_levels > 1)
         {
-            // Change its format again
-            VkImageMemoryBarrier barrier_to_readable = barrier_to_transfer;
-            barrier_to_readable.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier_to_readable.newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier_to_readable.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier_to_readable.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
-            vkCmdPipelineBarrier(cmd.command_buffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                 0,
-                                 0,
-                                 nullptr,
-                                 0,
-                                 nullptr,
-                                 1,
-                                 &barrier_to_readable);
+            uint32_t initial_mip = 0;
+            while (initial_mip + 1 < mip_levels
+                   && std::max(data->levels()[initial_mip].width, data->levels()[initial_mip].height) > TEXTURE_STREAMING_INITIAL_SIZE)
+            {
+                initial_mip++;
+            }
 
-            cmd.end_and_submit(m_data->transfer_queue.queue);
+            texture.is_streamed        = true;
+            texture.first_resident_mip = initial_mip;
+            texture.target_mip         = initial_mip;
+            texture.initial_mip        = initial_mip;
+            texture.wanted_mip         = initial_mip;
+            texture.last_used_frame    = m_data->current_frame_number;
         }
-        else
+        if (data != nullptr)
         {
-            // Change its format again
-            VkImageMemoryBarrier barrier_to_readable = barrier_to_transfer;
-            barrier_to_readable.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier_to_readable.newLayout            = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL;
-            barrier_to_readable.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier_to_readable.dstAccessMask        = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier_to_readable.srcQueueFamilyIndex  = m_data->transfer_queue.family_index;
-            barrier_to_readable.dstQueueFamilyIndex  = m_data->graphics_queue.family_index;
-            vkCmdPipelineBarrier(cmd.command_buffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 0,
-                                 0,
-                                 nullptr,
-                                 0,
-                                 nullptr,
-                                 1,
-                                 &barrier_to_readable);
-            cmd.end_and_submit(m_data->transfer_queue.queue);
-
-            // Continue from the graphics queue
-            TransferCommand cmd2 = m_data->create_transfer_command(m_data->transfer_context.graphics_pool);
-
-            cmd2.begin();
-
-            VkImageMemoryBarrier barrier_to_readable2 = barrier_to_transfer;
-            barrier_to_readable2.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier_to_readable2.newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier_to_readable2.srcAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier_to_readable2.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
-            barrier_to_readable2.srcQueueFamilyIndex  = m_data->transfer_queue.family_index;
-            barrier_to_readable2.dstQueueFamilyIndex  = m_data->graphics_queue.family_index;
-            vkCmdPipelineBarrier(cmd2.command_buffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                                 0,
-                                 0,
-                                 nullptr,
-                                 0,
-                                 nullptr,
-                                 1,
-                                 &barrier_to_readable2);
-
-            cmd2.end_and_submit(m_data->graphics_queue.queue);
-            m_data->transfer_context.commands.push_back(cmd2);
+            image_size = get_texture_upload_size(*data, format, texture.first_resident_mip, mip_levels);
         }
-
-        // Save command
-        m_data->transfer_context.commands.push_back(cmd);
+        texture.target_size = image_size;
+        texture.image       = m_data->create_texture_image(texture, texture.first_resident_mip);
 
         // Get filter
-        VkFilter filter = VK_FILTER_LINEAR;
-        switch (filter_mode)
+        VkFilter            filter      = VK_FILTER_LINEAR;
+        VkSamplerMipmapMode mipmap_mode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        switch (options.filter_mode)
         {
-            case FilterMode::NEAREST: filter = VK_FILTER_NEAREST; break;
+            case FilterMode::NEAREST:
+                filter      = VK_FILTER_NEAREST;
+                mipmap_mode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+                break;
             default: break;
         }
 
+        // Anisotropic filtering is clamped to what the device supports, and disabled if it isn't supported
+        const float max_anisotropy = std::min(options.max_anisotropy, m_data->max_sampler_anisotropy);
+
         // Create sampler
         VkSamplerCreateInfo sampler_info = {
             .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
@@ -3949,29 +8302,80 @@ namespace rg
             // Filter
             .magFilter  = filter,
             .minFilter  = filter,
-            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+            .mipmapMode = mipmap_mode,
             // Address mode
             .addressModeU            = VK_SAMPLER_ADDRESS_MODE_REPEAT,
             .addressModeV            = VK_SAMPLER_ADDRESS_MODE_REPEAT,
             .addressModeW            = VK_SAMPLER_ADDRESS_MODE_REPEAT,
-            .mipLodBias              = 0.0f,
-            .anisotropyEnable        = VK_FALSE,
-            .maxAnisotropy           = 1,
+            .mipLodBias              = options.lod_bias,
+            .anisotropyEnable        = max_anisotropy > 1.0f ? VK_TRUE : VK_FALSE,
+            .maxAnisotropy           = std::max(max_anisotropy, 1.0f),
             .compareEnable           = VK_FALSE,
             .compareOp               = VK_COMPARE_OP_ALWAYS,
             .minLod                  = 0.0f,
-            .maxLod                  = 0.0f,
+            .maxLod                  = static_cast<float>(mip_levels),
             .borderColor             = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
             .unnormalizedCoordinates = VK_FALSE,
         };
         VkSampler sampler = VK_NULL_HANDLE;
         vk_check(vkCreateSampler(m_data->device, &sampler_info, nullptr, &sampler), "Failed to create sampler");
 
+        // The slots of the destroyed textures are reused
+        if (m_data->free_texture_slots.is_empty())
+        {
+            texture.bindless_slot = m_data->texture_slot_count++;
+        }
+        else
+        {
+            texture.bindless_slot = m_data->free_texture_slots.last();
+            m_data->free_texture_slots.pop_back();
+        }
+
         // Store the image
-        return m_data->textures.push(Texture {
-            .image   = image,
-            .sampler = sampler,
+        texture.sampler            = sampler;
+        texture.has_pending_upload = true;
+        const uint32_t first_mip   = texture.first_resident_mip;
+        const auto     id          = m_data->textures.push(std::move(texture));
+
+        // The texels are uploaded at a later frame, within the upload budget
+        // Images are decoded in the meantime, directly in a staging buffer, so that the render thread doesn't decode them
+        ImageDecoding *decoding = nullptr;
+        if (data == nullptr)
+        {
+            decoding                 = new ImageDecoding;
+            decoding->path           = path;
+            decoding->staging_buffer = m_data->allocator.create_buffer(image_size,
+                                                                       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                                       VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                                                       false,
+                                                                       true);
+            decoding->result         = std::async(std::launch::async,
+                                                  [decoding, image_size, extent]()
+                                                  {
+                                                      return decode_image(decoding->path.c_str(),
+                                                                          decoding->staging_buffer.mapped_data,
+                                                                          image_size,
+                                                                          extent);
+                                                  });
+        }
+        m_data->pending_texture_uploads.push_back(PendingTextureUpload {
+            .texture_id = id,
+            .decoding   = decoding,
+            .size       = image_size,
+            .first_mip  = first_mip,
         });
+        return id;
+    }
+
+    bool Renderer::set_block_compression(bool enabled)
+    {
+        m_data->uses_block_compression = enabled && m_data->supports_block_compression;
+        return m_data->uses_block_compression;
+    }
+
+    TextureFormat Renderer::get_texture_format(TextureId id) const
+    {
+        return m_data->textures[id].format;
     }
 
     void Renderer::destroy_texture(TextureId id)
@@ -3980,11 +8384,8 @@ namespace rg
         auto texture = m_data->textures.get(id);
         if (texture.has_value())
         {
-            // Destroy the sampler
-            vkDestroySampler(m_data->device, texture->sampler, nullptr);
-
-            // Destroy the image
-            m_data->allocator.destroy_image(texture->image);
+            // Its image, sampler and slot are released once the frames and the transfers using them are done
+            m_data->retire_texture(id, *texture);
 
             // Remove the texture
             m_data->textures.remove(id);
@@ -3994,20 +8395,26 @@ namespace rg
 
     void Renderer::clear_textures()
     {
-        // Destroy all textures
-        for (auto &res : m_data->textures)
+        // Drop the pending uploads
+        for (auto &upload : m_data->pending_texture_uploads)
         {
-            auto &texture = res.value();
-
-            // Destroy the sampler
-            vkDestroySampler(m_data->device, texture.sampler, nullptr);
+            m_data->release_image_decoding(upload);
+        }
+        m_data->pending_texture_uploads.clear();
 
-            // Destroy the image
-            m_data->allocator.destroy_image(texture.image);
+        // Retire all textures
+        for (auto &res : m_data->textures)
+        {
+            m_data->retire_texture(res.key(), res.value());
         }
 
         // Clear the textures
         m_data->textures.clear();
+        for (const auto &replaced : m_data->replaced_texture_images)
+        {
+            m_data->retire_texture_image(replaced.image, VK_NULL_HANDLE, 0);
+        }
+        m_data->replaced_texture_images.clear();
     }
 
     // endregion
@@ -4028,17 +8435,38 @@ namespace rg
 
         // Wait for the fence
         m_data->wait_for_fence(current_frame.render_fence);
-        m_data->reset_transfer_context();
+        m_data->read_stage_gpu_times(current_frame);
+        m_data->read_draw_statistics(current_frame, current_frame_index);
+        // Reuse the staging memory of the transfers that are done, without waiting for the others
+        m_data->reclaim_transfer_batches(false);
+        m_data->release_retired_textures(false);
+        m_data->release_retired_buffers(false);
+        m_data->frame_upload_bytes      = 0;
+        m_data->upload_budget_exhausted = false;
 
         // Update SSBOs if needed
         m_data->update_storage_buffers(current_frame);
+        m_data->update_scene_bvh();
 
         // Update the descriptor sets if needed
         m_data->update_descriptor_sets(current_frame);
+        m_data->update_material_buffer(current_frame_index);
+
+        // Stream the levels of the textures needed by the visible objects
+        m_data->update_texture_streaming();
 
-        // Update meshes if needed
+        // Upload the pending textures and meshes, within the budget of the frame
+        m_data->upload_pending_textures();
+        m_data->update_replaced_texture_descriptors();
         m_data->update_mesh_buffers();
 
+        // Rebuild the draw cache once for all the data uploaded during the frame
+        if (m_data->has_new_uploads && m_data->draw_cache_skips_uploads)
+        {
+            m_data->draw_cache_version++;
+        }
+        m_data->has_new_uploads = false;
+
         // For each enabled camera
         for (auto &cam_entry : m_data->cameras)
         {
@@ -4053,7 +8481,9 @@ namespace rg
                 m_data->update_render_stages_output_sets(swapchain);
 
                 // Get camera infos and send them to the shader
-                m_data->send_camera_data(camera.target_swapchain_index, camera, current_frame);
+                const auto camera_data = Renderer::Data::get_camera_data(camera);
+                m_data->send_camera_data(camera.target_swapchain_index, camera_data, current_frame);
+                const auto lod_selection = m_data->get_lod_selection(camera_data, swapchain.viewport_extent);
 
                 // Update pipelines if needed
                 m_data->build_out_of_date_effects(swapchain);
@@ -4064,6 +8494,55 @@ namespace rg
                 // Begin recording
                 m_data->begin_recording();
 
+                // Cull the instances of the stages using the material system
+                // It needs to be done before the render passes begin
+                if (m_data->uses_gpu_culling())
+                {
+                    for (size_t stage_i = 0; stage_i < m_data->render_pipeline_description.stages.size(); stage_i++)
+                    {
+                        if (m_data->render_pipeline_description.stages[stage_i].uses_material_system)
+                        {
+                            auto      &stage             = swapchain.render_stages[stage_i];
+                            const bool occlusion_culling = m_data->uses_occlusion_culling(stage_i);
+                            m_data->update_culling_sets(stage, occlusion_culling, current_frame, current_frame_index);
+
+                            if (occlusion_culling)
+                            {
+                                // First phase: only draw the instances that are visible in the depth of the previous frame
+                                m_data->cull_stage_with_occlusion(stage,
+                                                                  current_frame.command_buffer,
+                                                                  current_frame_index,
+                                                                  camera_data,
+                                                                  lod_selection,
+                                                                  0);
+                            }
+                            else
+                            {
+                                m_data->cull_stage(stage,
+                                                   current_frame.command_buffer,
+                                                   current_frame_index,
+                                                   camera_data,
+                                                   lod_selection);
+                            }
+                        }
+                    }
+                }
+                else if (m_data->uses_cpu_culling())
+                {
+                    // Same on the CPU: the objects are tested once, then the commands of each stage are written
+                    m_data->cull_objects_on_cpu(camera_data);
+                    for (size_t stage_i = 0; stage_i < m_data->render_pipeline_description.stages.size(); stage_i++)
+                    {
+                        if (m_data->render_pipeline_description.stages[stage_i].uses_material_system)
+                        {
+                            m_data->cull_stage_on_cpu(swapchain.render_stages[stage_i], current_frame_index, lod_selection);
+                        }
+                    }
+                }
+
+                // The visible draws found by the GPU culling are counted once the frame is done
+                m_data->count_recorded_draws(swapchain, current_frame, current_frame_index);
+
                 // Get next image
                 auto image_index = m_data->get_next_swapchain_image(swapchain);
 
@@ -4073,6 +8552,16 @@ namespace rg
                     const auto &stage_desc = m_data->render_pipeline_description.stages[stage_i];
                     auto       &stage      = swapchain.render_stages[stage_i];
 
+                    // Time the stage
+                    const auto stage_query = static_cast<uint32_t>(2 * stage_i);
+                    if (current_frame.timestamp_pool != VK_NULL_HANDLE)
+                    {
+                        vkCmdWriteTimestamp(current_frame.command_buffer,
+                                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                            current_frame.timestamp_pool,
+                                            stage_query);
+                    }
+
                     // Get clear values of each attachment
                     Array<VkClearValue> clear_values(stage_desc.attachments.size());
                     for (size_t i = 0; i < stage_desc.attachments.size(); i++)
@@ -4089,44 +8578,84 @@ namespace rg
                         }
                     }
 
-                    // Begin render pass
-                    VkRenderPassBeginInfo render_pass_begin_info = {
-                        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                        .pNext = nullptr,
-                        // Render pass
-                        .renderPass = m_data->render_stages[stage_i].vk_render_pass,
-                        // Link framebuffer
-                        .framebuffer = stage.framebuffers[image_index],
-                        // Render area
-                        .renderArea = {.offset = {0, 0}, .extent = swapchain.viewport_extent},
-                        // Clear values
-                        .clearValueCount = static_cast<uint32_t>(clear_values.size()),
-                        .pClearValues    = clear_values.data(),
+                    const auto record_render_pass = [&](VkRenderPass render_pass)
+                    {
+                        // Begin render pass
+                        VkRenderPassBeginInfo render_pass_begin_info = {
+                            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                            .pNext = nullptr,
+                            // Render pass
+                            .renderPass = render_pass,
+                            // Link framebuffer
+                            .framebuffer = stage.framebuffers[image_index],
+                            // Render area
+                            .renderArea = {.offset = {0, 0}, .extent = swapchain.viewport_extent},
+                            // Clear values
+                            .clearValueCount = static_cast<uint32_t>(clear_values.size()),
+                            .pClearValues    = clear_values.data(),
+                        };
+                        vkCmdBeginRenderPass(current_frame.command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+                        if (stage_desc.uses_material_system)
+                        {
+                            // Bind the vertex buffer if needed. The index buffer is bound by each batch, with its index size.
+                            VkDeviceSize offset = 0;
+                            vkCmdBindVertexBuffers(current_frame.command_buffer, 0, 1, &m_data->vertex_buffer.buffer, &offset);
+
+                            // Draw
+                            m_data->draw_from_cache(stage, current_frame.command_buffer, current_frame, camera.target_swapchain_index);
+                        }
+                        else
+                        {
+                            // Just draw a quad if it doesn't use the material system
+                            m_data->draw_quad(swapchain,
+                                              stage_i,
+                                              image_index,
+                                              current_frame.command_buffer,
+                                              current_frame,
+                                              camera.target_swapchain_index);
+                        }
+
+                        vkCmdEndRenderPass(current_frame.command_buffer);
                     };
-                    vkCmdBeginRenderPass(current_frame.command_buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
-                    if (stage_desc.uses_material_system)
+                    record_render_pass(m_data->render_stages[stage_i].vk_render_pass);
+
+                    if (m_data->uses_occlusion_culling(stage_i))
                     {
-                        // Bind vertex and index buffers if needed
-                        VkDeviceSize offset = 0;
-                        vkCmdBindVertexBuffers(current_frame.command_buffer, 0, 1, &m_data->vertex_buffer.buffer, &offset);
-                        vkCmdBindIndexBuffer(current_frame.command_buffer, m_data->index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+                        // Second phase: test the hidden instances against the depth that was just drawn, and draw the ones that
+                        // turned out to be visible on top of the first pass
+                        // It is skipped when the first phase didn't have a depth pyramid: every instance was drawn
+                        if (stage.depth_pyramid_ready)
+                        {
+                            m_data->build_depth_pyramid(stage, stage_i, image_index, current_frame.command_buffer);
+                            m_data->cull_stage_with_occlusion(stage,
+                                                              current_frame.command_buffer,
+                                                              current_frame_index,
+                                                              camera_data,
+                                                              lod_selection,
+                                                              1);
+
+                            // The second pass loads the color attachments written by the first one
+                            insert_memory_barrier(current_frame.command_buffer,
+                                                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                                                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                  VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+                            record_render_pass(m_data->render_stages[stage_i].vk_load_render_pass);
+                        }
 
-                        // Draw
-                        m_data->draw_from_cache(stage, current_frame.command_buffer, current_frame, camera.target_swapchain_index);
+                        // Keep the complete depth for the first phase of the next frame
+                        m_data->build_depth_pyramid(stage, stage_i, image_index, current_frame.command_buffer);
                     }
-                    else
+
+                    if (current_frame.timestamp_pool != VK_NULL_HANDLE)
                     {
-                        // Just draw a quad if it doesn't use the material system
-                        m_data->draw_quad(swapchain,
-                                          stage_i,
-                                          image_index,
-                                          current_frame.command_buffer,
-                                          current_frame,
-                                          camera.target_swapchain_index);
+                        vkCmdWriteTimestamp(current_frame.command_buffer,
+                                            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                            current_frame.timestamp_pool,
+                                            stage_query + 1);
                     }
-
-                    vkCmdEndRenderPass(current_frame.command_buffer);
                 }
 
                 // End recording and submit
@@ -4150,6 +8679,18 @@ namespace rg
         m_data->current_frame_number++;
     }
 
+    double Renderer::get_stage_gpu_time(size_t stage_index) const
+    {
+        check(stage_index < m_data->stage_gpu_times.size(), "Invalid stage index");
+        // Stays at 0 if timestamps aren't supported
+        return m_data->stage_gpu_times[stage_index];
+    }
+
+    DrawStatistics Renderer::get_draw_statistics() const
+    {
+        return m_data->draw_statistics;
+    }
+
     // endregion
 
     // region Cameras
@@ -0,0 +1,555 @@
+#include "railguard/core/texture.h"
+
+#include <railguard/utils/hasher.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+namespace rg
+{
+    namespace
+    {
+        constexpr uint8_t KTX2_IDENTIFIER[12] = {0xab, 0x4b, 0x54, 0x58, 0x20, 0x32, 0x30, 0xbb, 0x0d, 0x0a, 0x1a, 0x0a};
+        constexpr uint8_t KTX2_PADDING[16]    = {};
+        /** Key of the metadata entry storing the source stamp. Keys starting with "KTX" or "ktx" are reserved. */
+        constexpr char KTX2_STAMP_KEY[]  = "rgSourceStamp";
+        constexpr char KTX2_WRITER_KEY[] = "KTXwriter";
+        constexpr char KTX2_WRITER[]     = "railguard";
+
+        struct Ktx2Header
+        {
+            uint8_t  identifier[12];
+            uint32_t vk_format;
+            uint32_t type_size;
+            uint32_t pixel_width;
+            uint32_t pixel_height;
+            uint32_t pixel_depth;
+            uint32_t layer_count;
+            uint32_t face_count;
+            uint32_t level_count;
+            uint32_t supercompression_scheme;
+            // Index
+            uint32_t dfd_byte_offset;
+            uint32_t dfd_byte_length;
+            uint32_t kvd_byte_offset;
+            uint32_t kvd_byte_length;
+            uint64_t sgd_byte_offset;
+            uint64_t sgd_byte_length;
+        };
+        static_assert(sizeof(Ktx2Header) == 80, "The KTX2 header must not have padding");
+
+        /** Entry of the level index, which follows the header. */
+        struct Ktx2Level
+        {
+            uint64_t byte_offset;
+            uint64_t byte_length;
+            uint64_t uncompressed_byte_length;
+        };
+
+        // Values of the data format descriptor, see the Khronos Data Format Specification
+        constexpr uint8_t  DF_MODEL_RGBSDA      = 1;
+        constexpr uint8_t  DF_MODEL_BC1A        = 128;
+        constexpr uint8_t  DF_MODEL_BC3         = 130;
+        constexpr uint8_t  DF_MODEL_BC4         = 131;
+        constexpr uint8_t  DF_MODEL_BC5         = 132;
+        constexpr uint8_t  DF_MODEL_BC7         = 134;
+        constexpr uint8_t  DF_PRIMARIES_BT709   = 1;
+        constexpr uint8_t  DF_TRANSFER_LINEAR   = 1;
+        constexpr uint8_t  DF_TRANSFER_SRGB     = 2;
+        constexpr uint8_t  DF_CHANNEL_ALPHA     = 15;
+        constexpr uint8_t  DF_SAMPLE_LINEAR     = 0x10;
+        constexpr uint16_t DF_VERSION           = 2;
+        constexpr uint32_t DF_BLOCK_HEADER_SIZE = 24;
+        constexpr uint32_t DF_SAMPLE_SIZE       = 16;
+
+        /** Description of a texture format in a KTX2 file, indexed by TextureFormat. */
+        struct FormatDescription
+        {
+            /** Value of VkFormat. */
+            uint32_t vk_format;
+            uint32_t block_size;
+            bool     is_block_compressed;
+            bool     is_srgb;
+            uint8_t  color_model;
+            // The samples split the texel block evenly
+            uint32_t sample_count;
+            uint8_t  sample_channels[4];
+        };
+
+        constexpr FormatDescription FORMAT_DESCRIPTIONS[TEXTURE_FORMAT_COUNT] = {
+            {43, 4, false, true, DF_MODEL_RGBSDA, 4, {0, 1, 2, DF_CHANNEL_ALPHA}},
+            {37, 4, false, false, DF_MODEL_RGBSDA, 4, {0, 1, 2, DF_CHANNEL_ALPHA}},
+            {9, 1, false, false, DF_MODEL_RGBSDA, 1, {0}},
+            {16, 2, false, false, DF_MODEL_RGBSDA, 2, {0, 1}},
+            {134, 8, true, true, DF_MODEL_BC1A, 1, {1}},
+            {133, 8, true, false, DF_MODEL_BC1A, 1, {1}},
+            {138, 16, true, true, DF_MODEL_BC3, 2, {DF_CHANNEL_ALPHA, 0}},
+            {137, 16, true, false, DF_MODEL_BC3, 2, {DF_CHANNEL_ALPHA, 0}},
+            {139, 8, true, false, DF_MODEL_BC4, 1, {0}},
+            {141, 16, true, false, DF_MODEL_BC5, 2, {0, 1}},
+            {146, 16, true, true, DF_MODEL_BC7, 1, {0}},
+            {145, 16, true, false, DF_MODEL_BC7, 1, {0}},
+        };
+
+        inline const FormatDescription &describe(TextureFormat format)
+        {
+            return FORMAT_DESCRIPTIONS[static_cast<uint32_t>(format)];
+        }
+
+        inline uint64_t align_offset(uint64_t offset, uint64_t alignment)
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+
+        /** The levels of a KTX2 file are aligned to the least common multiple of the block size and 4. */
+        inline uint64_t get_level_alignment(TextureFormat format)
+        {
+            const uint64_t block_size = describe(format).block_size;
+            return block_size % 4 == 0 ? block_size : 4;
+        }
+
+        // The levels of sRGB textures are averaged in linear space, otherwise they get darker
+
+        inline float srgb_to_linear(uint8_t value)
+        {
+            const float c = static_cast<float>(value) / 255.0f;
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        inline uint8_t linear_to_srgb(float value)
+        {
+            const float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            return static_cast<uint8_t>(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f));
+        }
+
+        /** Computes the next mip level of RGBA pixels, with a box filter. */
+        void downsample(const uint8_t *pixels, uint32_t width, uint32_t height, bool is_srgb, uint8_t *output)
+        {
+            const uint32_t next_width  = std::max(width / 2, 1u);
+            const uint32_t next_height = std::max(height / 2, 1u);
+
+            float srgb_table[256];
+            if (is_srgb)
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    srgb_table[i] = srgb_to_linear(static_cast<uint8_t>(i));
+                }
+            }
+
+            for (uint32_t y = 0; y < next_height; y++)
+            {
+                // A dimension of 1 is kept as is
+                const uint32_t y0 = std::min(y * 2, height - 1);
+                const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+                for (uint32_t x = 0; x < next_width; x++)
+                {
+                    const uint32_t x0 = std::min(x * 2, width - 1);
+                    const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+
+                    const uint8_t *texels[4] = {
+                        pixels + (static_cast<size_t>(y0) * width + x0) * 4,
+                        pixels + (static_cast<size_t>(y0) * width + x1) * 4,
+                        pixels + (static_cast<size_t>(y1) * width + x0) * 4,
+                        pixels + (static_cast<size_t>(y1) * width + x1) * 4,
+                    };
+                    uint8_t *result = output + (static_cast<size_t>(y) * next_width + x) * 4;
+                    for (uint32_t channel = 0; channel < 4; channel++)
+                    {
+                        // Alpha is always linear
+                        if (is_srgb && channel < 3)
+                        {
+                            float sum = 0.0f;
+                            for (const auto *texel : texels)
+                            {
+                                sum += srgb_table[texel[channel]];
+                            }
+                            result[channel] = linear_to_srgb(sum / 4.0f);
+                        }
+                        else
+                        {
+                            uint32_t sum = 0;
+                            for (const auto *texel : texels)
+                            {
+                                sum += texel[channel];
+                            }
+                            result[channel] = static_cast<uint8_t>((sum + 2) / 4);
+                        }
+                    }
+                }
+            }
+        }
+
+        /** Writes the data format descriptor of the format: its total size, then a basic descriptor block. */
+        Vector<uint32_t> create_data_format_descriptor(TextureFormat format)
+        {
+            const auto &description = describe(format);
+            const auto  block_size  = DF_BLOCK_HEADER_SIZE + DF_SAMPLE_SIZE * description.sample_count;
+
+            Vector<uint32_t> words(16);
+            words.push_back(4 + block_size);
+            // Khronos vendor, basic descriptor type
+            words.push_back(0);
+            words.push_back(DF_VERSION | (block_size << 16));
+            words.push_back(description.color_model | (DF_PRIMARIES_BT709 << 8)
+                            | ((description.is_srgb ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16));
+            // Dimensions of a texel block, minus one
+            words.push_back(description.is_block_compressed ? 0x0303 : 0);
+            // Bytes of the only plane
+            words.push_back(description.block_size);
+            words.push_back(0);
+
+            const uint32_t sample_bits = description.block_size * 8 / description.sample_count;
+            for (uint32_t i = 0; i < description.sample_count; i++)
+            {
+                uint32_t channel = description.sample_channels[i];
+                if (description.is_srgb && channel == DF_CHANNEL_ALPHA)
+                {
+                    channel |= DF_SAMPLE_LINEAR;
+                }
+                words.push_back((i * sample_bits) | ((sample_bits - 1) << 16) | (channel << 24));
+                words.push_back(0);
+                words.push_back(0);
+                words.push_back(description.is_block_compressed ? 0xffffffff : (1u << sample_bits) - 1);
+            }
+            return words;
+        }
+
+        /** Looks for the source stamp in the key/value data of a KTX2 file. Returns 0 if there is none. */
+        uint64_t find_source_stamp(const uint8_t *data, size_t size)
+        {
+            size_t offset = 0;
+            while (offset + sizeof(uint32_t) <= size)
+            {
+                uint32_t length = 0;
+                std::memcpy(&length, data + offset, sizeof(uint32_t));
+                offset += sizeof(uint32_t);
+                if (length > size - offset)
+                {
+                    return 0;
+                }
+
+                const auto *key = reinterpret_cast<const char *>(data + offset);
+                if (length == sizeof(KTX2_STAMP_KEY) + sizeof(uint64_t)
+                    && std::memcmp(key, KTX2_STAMP_KEY, sizeof(KTX2_STAMP_KEY)) == 0)
+                {
+                    uint64_t stamp = 0;
+                    std::memcpy(&stamp, data + offset + sizeof(KTX2_STAMP_KEY), sizeof(uint64_t));
+                    return stamp;
+                }
+                offset = align_offset(offset + length, 4);
+            }
+            return 0;
+        }
+    } // namespace
+
+    // region Formats
+
+    bool is_block_compressed(TextureFormat format)
+    {
+        return describe(format).is_block_compressed;
+    }
+
+    size_t get_texel_block_size(TextureFormat format)
+    {
+        return describe(format).block_size;
+    }
+
+    size_t get_texture_level_size(TextureFormat format, uint32_t width, uint32_t height)
+    {
+        const auto &description = describe(format);
+        if (description.is_block_compressed)
+        {
+            return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * description.block_size;
+        }
+        return static_cast<size_t>(width) * height * description.block_size;
+    }
+
+    TextureFormat get_decoded_format(TextureFormat format)
+    {
+        switch (format)
+        {
+            case TextureFormat::BC1_SRGB:
+            case TextureFormat::BC3_SRGB:
+            case TextureFormat::BC7_SRGB: return TextureFormat::RGBA8_SRGB;
+            case TextureFormat::BC1_UNORM:
+            case TextureFormat::BC3_UNORM:
+            case TextureFormat::BC7_UNORM: return TextureFormat::RGBA8_UNORM;
+            case TextureFormat::BC4_UNORM: return TextureFormat::R8_UNORM;
+            case TextureFormat::BC5_UNORM: return TextureFormat::RG8_UNORM;
+            default: return format;
+        }
+    }
+
+    uint32_t get_full_mip_count(uint32_t width, uint32_t height)
+    {
+        uint32_t count = 1;
+        for (auto size = std::max(width, height); size > 1; size /= 2)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    // endregion
+
+    // region Texture data
+
+    TextureData::TextureData(const uint8_t *pixels, uint32_t width, uint32_t height, TextureFormat format, uint32_t mip_levels)
+        : m_format(format)
+    {
+        // BC7 has too many modes to be encoded quickly: it can only be loaded
+        if (width == 0 || height == 0 || format == TextureFormat::BC7_SRGB || format == TextureFormat::BC7_UNORM)
+        {
+            return;
+        }
+
+        const auto full_mip_count = get_full_mip_count(width, height);
+        const auto level_count    = mip_levels == 0 ? full_mip_count : std::min(mip_levels, full_mip_count);
+
+        // Place the levels, aligned like in a KTX2 file so that they can be copied as is
+        size_t total_size = 0;
+        for (uint32_t level = 0; level < level_count; level++)
+        {
+            const uint32_t level_width  = std::max(width >> level, 1u);
+            const uint32_t level_height = std::max(height >> level, 1u);
+            const size_t   size         = get_texture_level_size(format, level_width, level_height);
+
+            total_size = align_offset(total_size, get_level_alignment(format));
+            m_levels.push_back(TextureLevel {
+                .width  = level_width,
+                .height = level_height,
+                .offset = total_size,
+                .size   = size,
+            });
+            total_size += size;
+        }
+        m_texels = Array<uint8_t>(total_size);
+
+        // Encode each level, downsampling the previous one
+        Array<uint8_t> previous_pixels;
+        Array<uint8_t> level_pixels;
+        const uint8_t *current_pixels = pixels;
+        for (uint32_t level = 0; level < level_count; level++)
+        {
+            const auto &info = m_levels[level];
+            if (level > 0)
+            {
+                const auto &previous = m_levels[level - 1];
+                level_pixels         = Array<uint8_t>(static_cast<size_t>(info.width) * info.height * 4);
+                downsample(current_pixels, previous.width, previous.height, describe(format).is_srgb, level_pixels.data());
+
+                // Keep the level alive until the next one is computed
+                previous_pixels = std::move(level_pixels);
+                current_pixels  = previous_pixels.data();
+            }
+            encode_level(current_pixels, info.width, info.height, m_texels.data() + info.offset);
+        }
+    }
+
+    TextureData TextureData::load_ktx2(const char *path, uint64_t source_stamp)
+    {
+        TextureData texture;
+
+        MappedFile file(path);
+        if (!file.is_valid() || file.size() < sizeof(Ktx2Header))
+        {
+            return texture;
+        }
+
+        const auto *bytes       = static_cast<const uint8_t *>(file.data());
+        const auto *header      = static_cast<const Ktx2Header *>(file.data());
+        const auto  level_count = std::max(header->level_count, 1u);
+        if (std::memcmp(header->identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0 || header->supercompression_scheme != 0
+            || header->pixel_width == 0 || header->pixel_height == 0 || header->pixel_depth != 0 || header->layer_count > 1
+            || header->face_count != 1 || level_count > get_full_mip_count(header->pixel_width, header->pixel_height)
+            || file.size() < sizeof(Ktx2Header) + level_count * sizeof(Ktx2Level))
+        {
+            // Not a 2D texture that can be copied as is
+            return texture;
+        }
+
+        // Find the format
+        bool found_format = false;
+        for (uint32_t i = 0; i < TEXTURE_FORMAT_COUNT; i++)
+        {
+            if (FORMAT_DESCRIPTIONS[i].vk_format == header->vk_format)
+            {
+                texture.m_format = static_cast<TextureFormat>(i);
+                found_format     = true;
+                break;
+            }
+        }
+        if (!found_format)
+        {
+            return texture;
+        }
+
+        // Check the stamp of the source
+        if (source_stamp != 0
+            && (static_cast<uint64_t>(header->kvd_byte_offset) + header->kvd_byte_length > file.size()
+                || find_source_stamp(bytes + header->kvd_byte_offset, header->kvd_byte_length) != source_stamp))
+        {
+            return texture;
+        }
+
+        // Check the whole level index before creating anything, so that a corrupted file is entirely ignored
+        const auto *levels = reinterpret_cast<const Ktx2Level *>(bytes + sizeof(Ktx2Header));
+        for (uint32_t level = 0; level < level_count; level++)
+        {
+            const uint32_t width  = std::max(header->pixel_width >> level, 1u);
+            const uint32_t height = std::max(header->pixel_height >> level, 1u);
+            const auto     size   = get_texture_level_size(texture.m_format, width, height);
+            if (levels[level].byte_length != size || levels[level].byte_offset > file.size()
+                || levels[level].byte_length > file.size() - levels[level].byte_offset)
+            {
+                texture.m_levels.clear();
+                return texture;
+            }
+
+            texture.m_levels.push_back(TextureLevel {
+                .width  = width,
+                .height = height,
+                .offset = levels[level].byte_offset,
+                .size   = size,
+            });
+        }
+
+        // The texture keeps the file mapped
+        texture.m_file = std::move(file);
+        return texture;
+    }
+
+    bool TextureData::save_ktx2(const char *path, uint64_t source_stamp) const
+    {
+        if (!is_valid())
+        {
+            return false;
+        }
+
+        const auto       level_count = static_cast<uint32_t>(m_levels.size());
+        Vector<uint32_t> dfd         = create_data_format_descriptor(m_format);
+
+        // Metadata: the writer, then the stamp, sorted by key
+        Vector<uint8_t> kvd(64);
+        const auto      add_entry = [&kvd](const char *key, size_t key_size, const void *value, size_t value_size)
+        {
+            const auto length = static_cast<uint32_t>(key_size + value_size);
+            for (size_t i = 0; i < sizeof(uint32_t); i++)
+            {
+                kvd.push_back(static_cast<uint8_t>(length >> (i * 8)));
+            }
+            for (size_t i = 0; i < key_size; i++)
+            {
+                kvd.push_back(static_cast<uint8_t>(key[i]));
+            }
+            for (size_t i = 0; i < value_size; i++)
+            {
+                kvd.push_back(static_cast<const uint8_t *>(value)[i]);
+            }
+            while (kvd.size() % 4 != 0)
+            {
+                kvd.push_back(0);
+            }
+        };
+        add_entry(KTX2_WRITER_KEY, sizeof(KTX2_WRITER_KEY), KTX2_WRITER, sizeof(KTX2_WRITER));
+        if (source_stamp != 0)
+        {
+            add_entry(KTX2_STAMP_KEY, sizeof(KTX2_STAMP_KEY), &source_stamp, sizeof(source_stamp));
+        }
+
+        Ktx2Header header = {};
+        std::memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+        header.vk_format       = describe(m_format).vk_format;
+        header.type_size       = 1;
+        header.pixel_width     = width();
+        header.pixel_height    = height();
+        header.face_count      = 1;
+        header.level_count     = level_count;
+        header.dfd_byte_offset = static_cast<uint32_t>(sizeof(Ktx2Header) + level_count * sizeof(Ktx2Level));
+        header.dfd_byte_length = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+        header.kvd_byte_offset = header.dfd_byte_offset + header.dfd_byte_length;
+        header.kvd_byte_length = static_cast<uint32_t>(kvd.size());
+
+        // The levels are stored from the smallest to the biggest
+        const auto        alignment = get_level_alignment(m_format);
+        Vector<Ktx2Level> level_index(level_count);
+        uint64_t          offset    = header.kvd_byte_offset + header.kvd_byte_length;
+        for (uint32_t level = level_count; level > 0; level--)
+        {
+            offset = align_offset(offset, alignment);
+            level_index.push_back(Ktx2Level {
+                .byte_offset              = offset,
+                .byte_length              = m_levels[level - 1].size,
+                .uncompressed_byte_length = m_levels[level - 1].size,
+            });
+            offset += m_levels[level - 1].size;
+        }
+
+        FILE *file = std::fopen(path, "wb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        bool success = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        // The index starts with the biggest level
+        for (size_t i = level_count; i > 0 && success; i--)
+        {
+            success = std::fwrite(&level_index[i - 1], sizeof(Ktx2Level), 1, file) == 1;
+        }
+        success = success && std::fwrite(dfd.data(), sizeof(uint32_t), dfd.size(), file) == dfd.size()
+                  && std::fwrite(kvd.data(), 1, kvd.size(), file) == kvd.size();
+
+        uint64_t written = header.kvd_byte_offset + header.kvd_byte_length;
+        for (size_t i = 0; i < level_count && success; i++)
+        {
+            const auto &entry   = level_index[i];
+            const auto  padding = entry.byte_offset - written;
+            success             = std::fwrite(KTX2_PADDING, 1, padding, file) == padding
+                                  && std::fwrite(level_data(level_count - 1 - i), 1, entry.byte_length, file) == entry.byte_length;
+            written             = entry.byte_offset + entry.byte_length;
+        }
+
+        success = std::fclose(file) == 0 && success;
+        if (!success)
+        {
+            // Don't leave a truncated file behind
+            std::remove(path);
+        }
+        return success;
+    }
+
+    uint64_t TextureData::get_source_stamp(const char *path, TextureFormat format, uint32_t mip_levels)
+    {
+        std::error_code ec;
+        const auto      size = std::filesystem::file_size(path, ec);
+        if (ec)
+        {
+            return 0;
+        }
+        const auto write_time = std::filesystem::last_write_time(path, ec);
+        if (ec)
+        {
+            return 0;
+        }
+
+        Hasher hasher;
+        hasher.add(static_cast<uint64_t>(size));
+        hasher.add(static_cast<uint64_t>(write_time.time_since_epoch().count()));
+        hasher.add(static_cast<uint64_t>(format));
+        hasher.add(static_cast<uint64_t>(mip_levels));
+        // 0 is reserved for "no stamp"
+        return hasher.hash != 0 ? hasher.hash : 1;
+    }
+
+    const uint8_t *TextureData::data() const
+    {
+        return m_file.is_valid() ? static_cast<const uint8_t *>(m_file.data()) : m_texels.data();
+    }
+
+    // endregion
+} // namespace rg
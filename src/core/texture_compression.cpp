@@ -0,0 +1,426 @@
+#include "railguard/core/texture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace rg
+{
+    namespace
+    {
+        /** Texels of a 4x4 block, in RGBA. The texels outside of the image repeat its edges. */
+        using Block = uint8_t[16][4];
+
+        void read_block(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t block_x, uint32_t block_y, Block &block)
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                const uint32_t image_y = std::min(block_y * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    const uint32_t image_x = std::min(block_x * 4 + x, width - 1);
+                    std::memcpy(block[y * 4 + x], pixels + (static_cast<size_t>(image_y) * width + image_x) * 4, 4);
+                }
+            }
+        }
+
+        // region Colors
+
+        inline uint16_t pack_565(const float color[3])
+        {
+            const auto r = static_cast<uint16_t>(std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+            const auto g = static_cast<uint16_t>(std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+            const auto b = static_cast<uint16_t>(std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        inline void unpack_565(uint16_t packed, uint32_t color[3])
+        {
+            const uint32_t r = (packed >> 11) & 0x1f;
+            const uint32_t g = (packed >> 5) & 0x3f;
+            const uint32_t b = packed & 0x1f;
+            color[0]         = (r << 3) | (r >> 2);
+            color[1]         = (g << 2) | (g >> 4);
+            color[2]         = (b << 3) | (b >> 2);
+        }
+
+        /**
+         * Computes the 4 colors of a BC1 block. Blocks with color0 <= color1 only have 3 colors and a transparent black, except in
+         * BC3, where there are always 4 colors.
+         */
+        void get_color_palette(uint16_t color0, uint16_t color1, bool always_four_colors, uint32_t palette[4][4])
+        {
+            unpack_565(color0, palette[0]);
+            unpack_565(color1, palette[1]);
+            palette[0][3] = 255;
+            palette[1][3] = 255;
+            if (color0 > color1 || always_four_colors)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+                }
+                palette[2][3] = 255;
+                palette[3][3] = 255;
+            }
+            else
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+                    palette[3][c] = 0;
+                }
+                palette[2][3] = 255;
+                palette[3][3] = 0;
+            }
+        }
+
+        /**
+         * Encodes the colors of a block in 8 bytes. The endpoints are the extremes of the texels along the principal axis of their
+         * colors, and each texel takes the closest of the 4 colors between them.
+         */
+        void encode_color_block(const Block &block, uint8_t *output)
+        {
+            // Mean and covariance of the colors
+            float mean[3] = {0.0f, 0.0f, 0.0f};
+            for (const auto &texel : block)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    mean[c] += static_cast<float>(texel[c]) / 16.0f;
+                }
+            }
+            float covariance[3][3] = {};
+            for (const auto &texel : block)
+            {
+                const float delta[3] = {texel[0] - mean[0], texel[1] - mean[1], texel[2] - mean[2]};
+                for (int i = 0; i < 3; i++)
+                {
+                    for (int j = 0; j < 3; j++)
+                    {
+                        covariance[i][j] += delta[i] * delta[j];
+                    }
+                }
+            }
+
+            // The principal axis is found by power iteration
+            float axis[3] = {1.0f, 1.0f, 1.0f};
+            for (int iteration = 0; iteration < 8; iteration++)
+            {
+                float next[3] = {};
+                for (int i = 0; i < 3; i++)
+                {
+                    next[i] = covariance[i][0] * axis[0] + covariance[i][1] * axis[1] + covariance[i][2] * axis[2];
+                }
+                const float length = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+                if (length < 1e-6f)
+                {
+                    // Uniform block: any axis works
+                    break;
+                }
+                for (int i = 0; i < 3; i++)
+                {
+                    axis[i] = next[i] / length;
+                }
+            }
+
+            // Extremes along the axis
+            float min_projection = 0.0f;
+            float max_projection = 0.0f;
+            int   min_texel      = 0;
+            int   max_texel      = 0;
+            for (int t = 0; t < 16; t++)
+            {
+                const float projection = block[t][0] * axis[0] + block[t][1] * axis[1] + block[t][2] * axis[2];
+                if (t == 0 || projection < min_projection)
+                {
+                    min_projection = projection;
+                    min_texel      = t;
+                }
+                if (t == 0 || projection > max_projection)
+                {
+                    max_projection = projection;
+                    max_texel      = t;
+                }
+            }
+
+            // Move the endpoints inwards a bit: the extremes are rarely worth an exact color
+            float max_color[3];
+            float min_color[3];
+            for (int c = 0; c < 3; c++)
+            {
+                const float inset = (static_cast<float>(block[max_texel][c]) - static_cast<float>(block[min_texel][c])) / 16.0f;
+                max_color[c]      = static_cast<float>(block[max_texel][c]) - inset;
+                min_color[c]      = static_cast<float>(block[min_texel][c]) + inset;
+            }
+
+            uint16_t color0 = pack_565(max_color);
+            uint16_t color1 = pack_565(min_color);
+            // The 4-color mode needs color0 > color1
+            if (color0 < color1)
+            {
+                std::swap(color0, color1);
+            }
+
+            uint32_t indices = 0;
+            if (color0 != color1)
+            {
+                uint32_t palette[4][4];
+                get_color_palette(color0, color1, true, palette);
+                for (uint32_t t = 0; t < 16; t++)
+                {
+                    uint32_t best_index    = 0;
+                    uint32_t best_distance = ~0u;
+                    for (uint32_t i = 0; i < 4; i++)
+                    {
+                        uint32_t distance = 0;
+                        for (int c = 0; c < 3; c++)
+                        {
+                            const int32_t delta = static_cast<int32_t>(block[t][c]) - static_cast<int32_t>(palette[i][c]);
+                            distance += static_cast<uint32_t>(delta * delta);
+                        }
+                        if (distance < best_distance)
+                        {
+                            best_distance = distance;
+                            best_index    = i;
+                        }
+                    }
+                    indices |= best_index << (t * 2);
+                }
+            }
+
+            std::memcpy(output, &color0, sizeof(uint16_t));
+            std::memcpy(output + 2, &color1, sizeof(uint16_t));
+            std::memcpy(output + 4, &indices, sizeof(uint32_t));
+        }
+
+        void decode_color_block(const uint8_t *input, bool always_four_colors, uint8_t texels[16][4])
+        {
+            uint16_t color0  = 0;
+            uint16_t color1  = 0;
+            uint32_t indices = 0;
+            std::memcpy(&color0, input, sizeof(uint16_t));
+            std::memcpy(&color1, input + 2, sizeof(uint16_t));
+            std::memcpy(&indices, input + 4, sizeof(uint32_t));
+
+            uint32_t palette[4][4];
+            get_color_palette(color0, color1, always_four_colors, palette);
+            for (uint32_t t = 0; t < 16; t++)
+            {
+                const auto &color = palette[(indices >> (t * 2)) & 0x3];
+                for (int c = 0; c < 4; c++)
+                {
+                    texels[t][c] = static_cast<uint8_t>(color[c]);
+                }
+            }
+        }
+
+        // endregion
+
+        // region Single channel
+
+        /** Computes the 8 values of a BC4 block. Blocks with value0 <= value1 have 6 values, then 0 and 255. */
+        void get_channel_palette(uint32_t value0, uint32_t value1, uint32_t palette[8])
+        {
+            palette[0] = value0;
+            palette[1] = value1;
+            if (value0 > value1)
+            {
+                for (uint32_t i = 2; i < 8; i++)
+                {
+                    palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+                }
+            }
+            else
+            {
+                for (uint32_t i = 2; i < 6; i++)
+                {
+                    palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+        }
+
+        /** Encodes a channel of a block in 8 bytes, with its extremes as endpoints. */
+        void encode_channel_block(const Block &block, uint32_t channel, uint8_t *output)
+        {
+            uint32_t min_value = 255;
+            uint32_t max_value = 0;
+            for (const auto &texel : block)
+            {
+                min_value = std::min<uint32_t>(min_value, texel[channel]);
+                max_value = std::max<uint32_t>(max_value, texel[channel]);
+            }
+
+            uint64_t indices = 0;
+            if (max_value != min_value)
+            {
+                uint32_t palette[8];
+                get_channel_palette(max_value, min_value, palette);
+                for (uint32_t t = 0; t < 16; t++)
+                {
+                    uint32_t best_index    = 0;
+                    uint32_t best_distance = ~0u;
+                    for (uint32_t i = 0; i < 8; i++)
+                    {
+                        const int32_t  delta    = static_cast<int32_t>(block[t][channel]) - static_cast<int32_t>(palette[i]);
+                        const uint32_t distance = static_cast<uint32_t>(delta * delta);
+                        if (distance < best_distance)
+                        {
+                            best_distance = distance;
+                            best_index    = i;
+                        }
+                    }
+                    indices |= static_cast<uint64_t>(best_index) << (t * 3);
+                }
+            }
+
+            output[0] = static_cast<uint8_t>(max_value);
+            output[1] = static_cast<uint8_t>(min_value);
+            for (uint32_t i = 0; i < 6; i++)
+            {
+                output[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+            }
+        }
+
+        void decode_channel_block(const uint8_t *input, uint8_t values[16])
+        {
+            uint64_t indices = 0;
+            for (uint32_t i = 0; i < 6; i++)
+            {
+                indices |= static_cast<uint64_t>(input[2 + i]) << (i * 8);
+            }
+
+            uint32_t palette[8];
+            get_channel_palette(input[0], input[1], palette);
+            for (uint32_t t = 0; t < 16; t++)
+            {
+                values[t] = static_cast<uint8_t>(palette[(indices >> (t * 3)) & 0x7]);
+            }
+        }
+
+        // endregion
+    } // namespace
+
+    void TextureData::encode_level(const uint8_t *pixels, uint32_t width, uint32_t height, uint8_t *output) const
+    {
+        const size_t texel_count = static_cast<size_t>(width) * height;
+        switch (m_format)
+        {
+            case TextureFormat::RGBA8_SRGB:
+            case TextureFormat::RGBA8_UNORM: std::memcpy(output, pixels, texel_count * 4); return;
+            case TextureFormat::R8_UNORM:
+            case TextureFormat::RG8_UNORM:
+            {
+                // Keep the first channels
+                const size_t channel_count = m_format == TextureFormat::R8_UNORM ? 1 : 2;
+                for (size_t i = 0; i < texel_count; i++)
+                {
+                    std::memcpy(output + i * channel_count, pixels + i * 4, channel_count);
+                }
+                return;
+            }
+            default: break;
+        }
+
+        const size_t block_size = get_texel_block_size(m_format);
+        const auto   blocks_x   = (width + 3) / 4;
+        const auto   blocks_y   = (height + 3) / 4;
+        Block        block;
+        for (uint32_t block_y = 0; block_y < blocks_y; block_y++)
+        {
+            for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+            {
+                read_block(pixels, width, height, block_x, block_y, block);
+                uint8_t *block_output = output + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_size;
+
+                switch (m_format)
+                {
+                    case TextureFormat::BC1_SRGB:
+                    case TextureFormat::BC1_UNORM: encode_color_block(block, block_output); break;
+                    case TextureFormat::BC3_SRGB:
+                    case TextureFormat::BC3_UNORM:
+                        encode_channel_block(block, 3, block_output);
+                        encode_color_block(block, block_output + 8);
+                        break;
+                    case TextureFormat::BC4_UNORM: encode_channel_block(block, 0, block_output); break;
+                    case TextureFormat::BC5_UNORM:
+                        encode_channel_block(block, 0, block_output);
+                        encode_channel_block(block, 1, block_output + 8);
+                        break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    bool TextureData::decode_level(size_t level, uint8_t *output) const
+    {
+        const auto    &info  = m_levels[level];
+        const uint8_t *input = level_data(level);
+        if (!is_block_compressed(m_format))
+        {
+            std::memcpy(output, input, info.size);
+            return true;
+        }
+        if (m_format == TextureFormat::BC7_SRGB || m_format == TextureFormat::BC7_UNORM)
+        {
+            return false;
+        }
+
+        const size_t block_size    = get_texel_block_size(m_format);
+        const size_t decoded_size  = get_texel_block_size(get_decoded_format(m_format));
+        const auto   blocks_x      = (info.width + 3) / 4;
+        const auto   blocks_y      = (info.height + 3) / 4;
+        uint8_t      texels[16][4] = {};
+        uint8_t      values[2][16] = {};
+        for (uint32_t block_y = 0; block_y < blocks_y; block_y++)
+        {
+            for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+            {
+                const uint8_t *block_input = input + (static_cast<size_t>(block_y) * blocks_x + block_x) * block_size;
+                switch (m_format)
+                {
+                    case TextureFormat::BC1_SRGB:
+                    case TextureFormat::BC1_UNORM: decode_color_block(block_input, false, texels); break;
+                    case TextureFormat::BC3_SRGB:
+                    case TextureFormat::BC3_UNORM:
+                        decode_color_block(block_input + 8, true, texels);
+                        decode_channel_block(block_input, values[0]);
+                        for (uint32_t t = 0; t < 16; t++)
+                        {
+                            texels[t][3] = values[0][t];
+                        }
+                        break;
+                    case TextureFormat::BC4_UNORM:
+                    case TextureFormat::BC5_UNORM:
+                        decode_channel_block(block_input, values[0]);
+                        if (m_format == TextureFormat::BC5_UNORM)
+                        {
+                            decode_channel_block(block_input + 8, values[1]);
+                        }
+                        for (uint32_t t = 0; t < 16; t++)
+                        {
+                            texels[t][0] = values[0][t];
+                            texels[t][1] = values[1][t];
+                        }
+                        break;
+                    default: break;
+                }
+
+                // Write the texels that are in the image
+                for (uint32_t y = 0; y < 4 && block_y * 4 + y < info.height; y++)
+                {
+                    for (uint32_t x = 0; x < 4 && block_x * 4 + x < info.width; x++)
+                    {
+                        const size_t texel = static_cast<size_t>(block_y * 4 + y) * info.width + block_x * 4 + x;
+                        std::memcpy(output + texel * decoded_size, texels[y * 4 + x], decoded_size);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+} // namespace rg
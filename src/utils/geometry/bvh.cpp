@@ -0,0 +1,390 @@
+#include "railguard/utils/geometry/bvh.h"
+
+#include <railguard/utils/geometry/frustum.h>
+#include <railguard/utils/geometry/ray.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace rg
+{
+    // Number of candidate split planes per axis, minus one
+    constexpr size_t BIN_COUNT = 16;
+    // Leaves bigger than that are split even if the heuristic doesn't find it worth it
+    constexpr uint32_t MAX_LEAF_SIZE = 8;
+    // Deeper nodes are turned into leaves. It bounds the size of the traversal stacks.
+    constexpr size_t MAX_DEPTH = 64;
+    // Flag set on the stack entries of subtrees entirely inside the frustum
+    constexpr uint32_t INSIDE_FLAG = 1u << 31;
+
+    // region Build
+
+    void BVH::build(const AABB *bounds, size_t count)
+    {
+        m_item_bounds  = Array<AABB>(count);
+        m_item_indices = Array<uint32_t>(count);
+        m_nodes        = Array<Node>(count > 0 ? 2 * count - 1 : 0);
+        m_node_count   = 0;
+        m_cost         = 0.0f;
+
+        if (count == 0)
+        {
+            return;
+        }
+
+        // The centers of the boxes are used to sort the items
+        Array<glm::vec3> centers(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            m_item_bounds[i]  = bounds[i];
+            m_item_indices[i] = i;
+            centers[i]        = bounds[i].is_empty() ? glm::vec3(0.0f) : bounds[i].center();
+        }
+
+        // Raw pointers avoid the bounds checks in the hot loops
+        uint32_t        *indices      = m_item_indices.data();
+        const AABB      *item_bounds  = m_item_bounds.data();
+        const glm::vec3 *item_centers = centers.data();
+
+        // Start with a single leaf containing everything, then split the leaves until it isn't worth it anymore
+        // Nodes are split in depth-first order
+        m_nodes[0]   = Node {.bounds = {}, .left_or_first = 0, .item_count = static_cast<uint32_t>(count)};
+        m_node_count = 1;
+
+        std::pair<uint32_t, size_t> stack[MAX_DEPTH + 2];
+        size_t                      stack_size = 0;
+        stack[stack_size++]                    = {0, 0};
+
+        while (stack_size > 0)
+        {
+            const auto [node_index, depth] = stack[--stack_size];
+            auto &node                     = m_nodes[node_index];
+
+            // Compute the bounds of the node, and of the centers of its items
+            AABB center_bounds;
+            for (uint32_t i = node.left_or_first; i < node.left_or_first + node.item_count; i++)
+            {
+                node.bounds.extend(item_bounds[indices[i]]);
+                center_bounds.extend(item_centers[indices[i]]);
+            }
+
+            if (node.item_count <= 1 || depth >= MAX_DEPTH)
+            {
+                continue;
+            }
+
+            // Find the best split plane with the surface area heuristic
+            // The cost of a split is proportional to the probability to visit each child times the number of items in it
+            float  best_cost  = static_cast<float>(node.item_count) * node.bounds.surface_area();
+            size_t best_axis  = 0;
+            size_t best_plane = BIN_COUNT;
+            for (size_t axis = 0; axis < 3; axis++)
+            {
+                const float axis_min    = center_bounds.min[axis];
+                const float axis_extent = center_bounds.max[axis] - axis_min;
+                if (axis_extent <= 0.0f)
+                {
+                    continue;
+                }
+
+                // Put the items in bins along the axis
+                AABB       bin_bounds[BIN_COUNT];
+                uint32_t   bin_counts[BIN_COUNT] = {};
+                const auto scale                 = static_cast<float>(BIN_COUNT) / axis_extent;
+                for (uint32_t i = node.left_or_first; i < node.left_or_first + node.item_count; i++)
+                {
+                    const auto item = indices[i];
+                    const auto bin  = std::min(BIN_COUNT - 1, static_cast<size_t>((item_centers[item][axis] - axis_min) * scale));
+                    bin_bounds[bin].extend(item_bounds[item]);
+                    bin_counts[bin]++;
+                }
+
+                // Sweep from the left and from the right to get the cost of each plane between two bins
+                float    left_areas[BIN_COUNT - 1];
+                uint32_t left_counts[BIN_COUNT - 1];
+                AABB     left_bounds;
+                uint32_t left_count = 0;
+                for (size_t plane = 0; plane < BIN_COUNT - 1; plane++)
+                {
+                    left_bounds.extend(bin_bounds[plane]);
+                    left_count += bin_counts[plane];
+                    left_areas[plane]  = left_bounds.surface_area();
+                    left_counts[plane] = left_count;
+                }
+
+                AABB     right_bounds;
+                uint32_t right_count = 0;
+                for (size_t plane = BIN_COUNT - 1; plane > 0; plane--)
+                {
+                    right_bounds.extend(bin_bounds[plane]);
+                    right_count += bin_counts[plane];
+
+                    // Both sides need at least one item
+                    const auto left_i = plane - 1;
+                    if (left_counts[left_i] == 0 || right_count == 0)
+                    {
+                        continue;
+                    }
+
+                    const float cost = static_cast<float>(left_counts[left_i]) * left_areas[left_i]
+                                       + static_cast<float>(right_count) * right_bounds.surface_area();
+                    if (cost < best_cost || (best_plane == BIN_COUNT && node.item_count > MAX_LEAF_SIZE))
+                    {
+                        best_cost  = cost;
+                        best_axis  = axis;
+                        best_plane = left_i;
+                    }
+                }
+            }
+
+            // No split is better than a leaf
+            if (best_plane == BIN_COUNT)
+            {
+                continue;
+            }
+
+            // Partition the items in place: the ones in the bins left of the plane go first
+            const float axis_min = center_bounds.min[best_axis];
+            const auto  scale    = static_cast<float>(BIN_COUNT) / (center_bounds.max[best_axis] - axis_min);
+            uint32_t    left_end = node.left_or_first;
+            uint32_t    right    = node.left_or_first + node.item_count;
+            while (left_end < right)
+            {
+                const auto item = indices[left_end];
+                const auto bin  = std::min(BIN_COUNT - 1, static_cast<size_t>((item_centers[item][best_axis] - axis_min) * scale));
+                if (bin <= best_plane)
+                {
+                    left_end++;
+                }
+                else
+                {
+                    std::swap(indices[left_end], indices[--right]);
+                }
+            }
+
+            // Create the children
+            const auto left_child  = static_cast<uint32_t>(m_node_count);
+            const auto first_item  = node.left_or_first;
+            const auto left_count  = left_end - first_item;
+            const auto right_count = node.item_count - left_count;
+
+            m_nodes[left_child]     = Node {.bounds = {}, .left_or_first = first_item, .item_count = left_count};
+            m_nodes[left_child + 1] = Node {.bounds = {}, .left_or_first = left_end, .item_count = right_count};
+            m_node_count += 2;
+
+            node.left_or_first = left_child;
+            node.item_count    = 0;
+
+            stack[stack_size++] = {left_child + 1, depth + 1};
+            stack[stack_size++] = {left_child, depth + 1};
+        }
+
+        m_cost = compute_cost();
+    }
+
+    void BVH::refit(const AABB *bounds)
+    {
+        memcpy(m_item_bounds.data(), bounds, m_item_bounds.size() * sizeof(AABB));
+
+        // Children are always after their parent, so going backwards updates them first
+        for (size_t node_index = m_node_count; node_index-- > 0;)
+        {
+            auto &node  = m_nodes[node_index];
+            node.bounds = AABB();
+            if (node.is_leaf())
+            {
+                for (uint32_t i = node.left_or_first; i < node.left_or_first + node.item_count; i++)
+                {
+                    node.bounds.extend(m_item_bounds[m_item_indices[i]]);
+                }
+            }
+            else
+            {
+                node.bounds.extend(m_nodes[node.left_or_first].bounds);
+                node.bounds.extend(m_nodes[node.left_or_first + 1].bounds);
+            }
+        }
+
+        m_cost = compute_cost();
+    }
+
+    float BVH::compute_cost() const
+    {
+        if (m_node_count == 0)
+        {
+            return 0.0f;
+        }
+
+        const float root_area = m_nodes[0].bounds.surface_area();
+        if (root_area <= 0.0f)
+        {
+            return 0.0f;
+        }
+
+        float cost = 0.0f;
+        for (size_t node_index = 0; node_index < m_node_count; node_index++)
+        {
+            const auto &node = m_nodes[node_index];
+            cost += node.bounds.surface_area() * static_cast<float>(node.is_leaf() ? node.item_count : 1);
+        }
+        return cost / root_area;
+    }
+
+    // endregion
+
+    // region Queries
+
+    void BVH::cull(const Frustum &frustum, uint8_t *visibility) const
+    {
+        memset(visibility, 0, m_item_bounds.size());
+        if (m_node_count == 0)
+        {
+            return;
+        }
+
+        uint32_t stack[MAX_DEPTH + 2];
+        size_t   stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const auto  entry  = stack[--stack_size];
+            const auto &node   = m_nodes[entry & ~INSIDE_FLAG];
+            bool        inside = (entry & INSIDE_FLAG) != 0;
+
+            // Once a node is entirely inside, its children are too: no need to test them
+            if (!inside)
+            {
+                const auto intersection = frustum.classify_box(node.bounds);
+                if (intersection == FrustumIntersection::OUTSIDE)
+                {
+                    continue;
+                }
+                inside = intersection == FrustumIntersection::INSIDE;
+            }
+
+            if (node.is_leaf())
+            {
+                for (uint32_t i = node.left_or_first; i < node.left_or_first + node.item_count; i++)
+                {
+                    const auto  item   = m_item_indices[i];
+                    const auto &bounds = m_item_bounds[item];
+                    visibility[item]   = (inside ? !bounds.is_empty() : frustum.intersects_box(bounds)) ? 1 : 0;
+                }
+            }
+            else
+            {
+                const uint32_t flag = inside ? INSIDE_FLAG : 0;
+                stack[stack_size++] = (node.left_or_first + 1) | flag;
+                stack[stack_size++] = node.left_or_first | flag;
+            }
+        }
+    }
+
+    bool BVH::raycast(const Ray &ray, float max_distance, uint32_t &hit_item, float &hit_distance) const
+    {
+        if (m_node_count == 0)
+        {
+            return false;
+        }
+
+        bool  hit           = false;
+        float closest       = max_distance;
+        float node_distance = 0.0f;
+
+        uint32_t stack[MAX_DEPTH + 2];
+        size_t   stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const auto &node = m_nodes[stack[--stack_size]];
+
+            // Skip the nodes that are further than the closest hit so far
+            if (!node.bounds.intersects_ray(ray, closest, node_distance))
+            {
+                continue;
+            }
+
+            if (node.is_leaf())
+            {
+                for (uint32_t i = node.left_or_first; i < node.left_or_first + node.item_count; i++)
+                {
+                    const auto item          = m_item_indices[i];
+                    float      item_distance = 0.0f;
+                    if (m_item_bounds[item].intersects_ray(ray, closest, item_distance) && (!hit || item_distance < closest))
+                    {
+                        hit          = true;
+                        closest      = item_distance;
+                        hit_item     = item;
+                        hit_distance = item_distance;
+                    }
+                }
+            }
+            else
+            {
+                // Visit the closest child first, so that the other one is more likely to be skipped
+                float      left_distance  = 0.0f;
+                float      right_distance = 0.0f;
+                const bool left_hit       = m_nodes[node.left_or_first].bounds.intersects_ray(ray, closest, left_distance);
+                const bool right_hit      = m_nodes[node.left_or_first + 1].bounds.intersects_ray(ray, closest, right_distance);
+                if (left_hit && right_hit)
+                {
+                    const bool left_first = left_distance <= right_distance;
+                    stack[stack_size++]   = left_first ? node.left_or_first + 1 : node.left_or_first;
+                    stack[stack_size++]   = left_first ? node.left_or_first : node.left_or_first + 1;
+                }
+                else if (left_hit)
+                {
+                    stack[stack_size++] = node.left_or_first;
+                }
+                else if (right_hit)
+                {
+                    stack[stack_size++] = node.left_or_first + 1;
+                }
+            }
+        }
+
+        return hit;
+    }
+
+    void BVH::query_box(const AABB &box, Vector<uint32_t> &results) const
+    {
+        if (m_node_count == 0)
+        {
+            return;
+        }
+
+        uint32_t stack[MAX_DEPTH + 2];
+        size_t   stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const auto &node = m_nodes[stack[--stack_size]];
+            if (!node.bounds.intersects(box))
+            {
+                continue;
+            }
+
+            if (node.is_leaf())
+            {
+                for (uint32_t i = node.left_or_first; i < node.left_or_first + node.item_count; i++)
+                {
+                    if (m_item_bounds[m_item_indices[i]].intersects(box))
+                    {
+                        results.push_back(m_item_indices[i]);
+                    }
+                }
+            }
+            else
+            {
+                stack[stack_size++] = node.left_or_first + 1;
+                stack[stack_size++] = node.left_or_first;
+            }
+        }
+    }
+
+    // endregion
+} // namespace rg
@@ -0,0 +1,179 @@
+#include "railguard/utils/geometry/frustum.h"
+
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#if defined(__AVX__)
+#define FRUSTUM_USE_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_USE_SSE
+#include <emmintrin.h>
+#endif
+
+namespace rg
+{
+    Frustum Frustum::from_view_projection(const glm::mat4 &view_projection)
+    {
+        // Gribb & Hartmann method: the planes are linear combinations of the rows of the matrix
+        // glm matrices are column major, so we need to transpose to get the rows
+        const auto m = glm::transpose(view_projection);
+
+        Frustum frustum {
+            .planes = {
+                m[3] + m[0], // Left
+                m[3] - m[0], // Right
+                m[3] + m[1], // Bottom
+                m[3] - m[1], // Top
+                m[3] + m[2], // Near
+                m[3] - m[2], // Far
+            },
+        };
+
+        // Normalize the planes so that the distances can be compared to radiuses
+        for (auto &plane : frustum.planes)
+        {
+            plane /= glm::length(glm::vec3(plane));
+        }
+
+        return frustum;
+    }
+
+    bool Frustum::intersects_sphere(const glm::vec3 &center, float radius) const
+    {
+        for (const auto &plane : planes)
+        {
+            // Sphere is entirely on the outer side of the plane
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Frustum::intersects_box(const AABB &box) const
+    {
+        for (const auto &plane : planes)
+        {
+            // Take the corner of the box that is the furthest along the normal
+            // If it is outside, the whole box is
+            const glm::vec3 positive_corner(plane.x >= 0 ? box.max.x : box.min.x,
+                                            plane.y >= 0 ? box.max.y : box.min.y,
+                                            plane.z >= 0 ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), positive_corner) + plane.w < 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    FrustumIntersection Frustum::classify_box(const AABB &box) const
+    {
+        auto result = FrustumIntersection::INSIDE;
+        for (const auto &plane : planes)
+        {
+            const glm::vec3 positive_corner(plane.x >= 0 ? box.max.x : box.min.x,
+                                            plane.y >= 0 ? box.max.y : box.min.y,
+                                            plane.z >= 0 ? box.max.z : box.min.z);
+            if (glm::dot(glm::vec3(plane), positive_corner) + plane.w < 0)
+            {
+                return FrustumIntersection::OUTSIDE;
+            }
+
+            // If the closest corner is outside, the box crosses the plane
+            const glm::vec3 negative_corner(plane.x >= 0 ? box.min.x : box.max.x,
+                                            plane.y >= 0 ? box.min.y : box.max.y,
+                                            plane.z >= 0 ? box.min.z : box.max.z);
+            if (glm::dot(glm::vec3(plane), negative_corner) + plane.w < 0)
+            {
+                result = FrustumIntersection::INTERSECTING;
+            }
+        }
+        return result;
+    }
+
+    void Frustum::cull_spheres(const float *x, const float *y, const float *z, const float *radius, size_t count, uint8_t *visibility)
+        const
+    {
+        size_t i = 0;
+
+#if defined(FRUSTUM_USE_AVX)
+        // Broadcast each plane component in its own register, that way we can test 8 spheres against a plane with a few operations
+        __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+        for (size_t p = 0; p < 6; p++)
+        {
+            plane_x[p] = _mm256_set1_ps(planes[p].x);
+            plane_y[p] = _mm256_set1_ps(planes[p].y);
+            plane_z[p] = _mm256_set1_ps(planes[p].z);
+            plane_w[p] = _mm256_set1_ps(planes[p].w);
+        }
+        const __m256 zero = _mm256_setzero_ps();
+
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 center_x     = _mm256_loadu_ps(x + i);
+            const __m256 center_y     = _mm256_loadu_ps(y + i);
+            const __m256 center_z     = _mm256_loadu_ps(z + i);
+            const __m256 minus_radius = _mm256_sub_ps(zero, _mm256_loadu_ps(radius + i));
+
+            // A sphere is visible if it isn't entirely on the outer side of any plane
+            __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (size_t p = 0; p < 6; p++)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(plane_x[p], center_x), _mm256_mul_ps(plane_y[p], center_y));
+                distance        = _mm256_add_ps(distance, _mm256_mul_ps(plane_z[p], center_z));
+                distance        = _mm256_add_ps(distance, plane_w[p]);
+                visible         = _mm256_and_ps(visible, _mm256_cmp_ps(distance, minus_radius, _CMP_GE_OQ));
+            }
+
+            const int mask = _mm256_movemask_ps(visible);
+            for (size_t k = 0; k < 8; k++)
+            {
+                visibility[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+            }
+        }
+#elif defined(FRUSTUM_USE_SSE)
+        // Same as AVX, but with 4 spheres at once
+        __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+        for (size_t p = 0; p < 6; p++)
+        {
+            plane_x[p] = _mm_set1_ps(planes[p].x);
+            plane_y[p] = _mm_set1_ps(planes[p].y);
+            plane_z[p] = _mm_set1_ps(planes[p].z);
+            plane_w[p] = _mm_set1_ps(planes[p].w);
+        }
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 center_x     = _mm_loadu_ps(x + i);
+            const __m128 center_y     = _mm_loadu_ps(y + i);
+            const __m128 center_z     = _mm_loadu_ps(z + i);
+            const __m128 minus_radius = _mm_sub_ps(zero, _mm_loadu_ps(radius + i));
+
+            __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (size_t p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(plane_x[p], center_x), _mm_mul_ps(plane_y[p], center_y));
+                distance        = _mm_add_ps(distance, _mm_mul_ps(plane_z[p], center_z));
+                distance        = _mm_add_ps(distance, plane_w[p]);
+                visible         = _mm_and_ps(visible, _mm_cmpge_ps(distance, minus_radius));
+            }
+
+            const int mask = _mm_movemask_ps(visible);
+            for (size_t k = 0; k < 4; k++)
+            {
+                visibility[i + k] = static_cast<uint8_t>((mask >> k) & 1);
+            }
+        }
+#endif
+
+        // Remaining spheres, or all of them if SIMD is not available
+        for (; i < count; i++)
+        {
+            visibility[i] = intersects_sphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+        }
+    }
+} // namespace rg
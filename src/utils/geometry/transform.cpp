@@ -13,5 +13,10 @@ namespace rg
         return view;
     }
 
+    bool Transform::operator==(const Transform &other) const
+    {
+        return position == other.position && rotation == other.rotation && scale == other.scale;
+    }
+
 
 } // namespace rg
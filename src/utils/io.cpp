@@ -3,6 +3,16 @@
 #include <cstdio>
 #include <stdexcept>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace rg
 {
     void *load_binary_file(const char *path, size_t *size)
@@ -36,4 +46,147 @@ namespace rg
 
         return data;
     }
-} // namespace rg
\ No newline at end of file
+
+    // region Mapped file
+
+    struct MappedFile::Data
+    {
+        const void *data      = nullptr;
+        size_t      size      = 0;
+        size_t      ref_count = 1;
+    };
+
+    MappedFile::MappedFile(const char *path)
+    {
+        const void *data = nullptr;
+        size_t      size = 0;
+
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+
+        LARGE_INTEGER file_size = {};
+        if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+        {
+            // The view keeps the mapping alive, so both handles can be closed right away
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping != nullptr)
+            {
+                data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                size = static_cast<size_t>(file_size.QuadPart);
+                CloseHandle(mapping);
+            }
+        }
+        CloseHandle(file);
+#else
+        const int file = open(path, O_RDONLY);
+        if (file < 0)
+        {
+            return;
+        }
+
+        struct stat file_stat = {};
+        if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+        {
+            // The mapping stays valid after the file is closed
+            void *mapping = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            if (mapping != MAP_FAILED)
+            {
+                data = mapping;
+                size = static_cast<size_t>(file_stat.st_size);
+            }
+        }
+        close(file);
+#endif
+
+        if (data != nullptr)
+        {
+            m_data = new Data {
+                .data      = data,
+                .size      = size,
+                .ref_count = 1,
+            };
+        }
+    }
+
+    MappedFile::MappedFile(const MappedFile &other) : m_data(other.m_data)
+    {
+        if (m_data != nullptr)
+        {
+            m_data->ref_count++;
+        }
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept : m_data(other.m_data)
+    {
+        other.m_data = nullptr;
+    }
+
+    MappedFile &MappedFile::operator=(const MappedFile &other)
+    {
+        if (this != &other)
+        {
+            release();
+            m_data = other.m_data;
+            if (m_data != nullptr)
+            {
+                m_data->ref_count++;
+            }
+        }
+        return *this;
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            release();
+            m_data       = other.m_data;
+            other.m_data = nullptr;
+        }
+        return *this;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        release();
+    }
+
+    void MappedFile::release()
+    {
+        if (m_data != nullptr)
+        {
+            m_data->ref_count--;
+            if (m_data->ref_count == 0)
+            {
+#ifdef _WIN32
+                UnmapViewOfFile(m_data->data);
+#else
+                munmap(const_cast<void *>(m_data->data), m_data->size);
+#endif
+                delete m_data;
+            }
+            m_data = nullptr;
+        }
+    }
+
+    bool MappedFile::is_valid() const
+    {
+        return m_data != nullptr;
+    }
+
+    const void *MappedFile::data() const
+    {
+        return m_data != nullptr ? m_data->data : nullptr;
+    }
+
+    size_t MappedFile::size() const
+    {
+        return m_data != nullptr ? m_data->size : 0;
+    }
+
+    // endregion
+} // namespace rg
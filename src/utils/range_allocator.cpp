@@ -0,0 +1,125 @@
+#include "railguard/utils/range_allocator.h"
+
+#include <stdexcept>
+
+namespace rg
+{
+    RangeAllocator::RangeAllocator(size_t capacity) : m_capacity(capacity)
+    {
+        if (capacity > 0)
+        {
+            m_free_ranges.push_back(Range {0, capacity});
+        }
+    }
+
+    void RangeAllocator::add_free_range(size_t offset, size_t size)
+    {
+        if (size == 0)
+        {
+            return;
+        }
+
+        // Merge the range with the free ones just before and after it, if any
+        // There is at most one of each, since free ranges are never adjacent
+        for (size_t i = 0; i < m_free_ranges.size();)
+        {
+            const auto &free_range = m_free_ranges[i];
+            if (free_range.offset + free_range.size == offset)
+            {
+                offset = free_range.offset;
+                size += free_range.size;
+                m_free_ranges.remove_at(i);
+            }
+            else if (offset + size == free_range.offset)
+            {
+                size += free_range.size;
+                m_free_ranges.remove_at(i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        m_free_ranges.push_back(Range {offset, size});
+    }
+
+    Optional<RangeAllocator::Range> RangeAllocator::allocate(size_t size, size_t alignment)
+    {
+        if (alignment == 0)
+        {
+            throw std::invalid_argument("The alignment of a range must not be 0.");
+        }
+        if (size == 0)
+        {
+            return none<Range>();
+        }
+
+        // Find the smallest free range in which the aligned range fits
+        size_t best_index   = m_free_ranges.size();
+        size_t best_size    = 0;
+        size_t best_aligned = 0;
+        for (size_t i = 0; i < m_free_ranges.size(); i++)
+        {
+            const auto  &free_range = m_free_ranges[i];
+            const size_t aligned    = (free_range.offset + alignment - 1) / alignment * alignment;
+            const bool   fits       = aligned + size <= free_range.offset + free_range.size;
+            if (fits && (best_index == m_free_ranges.size() || free_range.size < best_size))
+            {
+                best_index   = i;
+                best_size    = free_range.size;
+                best_aligned = aligned;
+            }
+        }
+
+        if (best_index == m_free_ranges.size())
+        {
+            return none<Range>();
+        }
+
+        // Take the range out of the list, and give back the padding before and the space after the allocation
+        const Range free_range = m_free_ranges[best_index];
+        m_free_ranges.remove_at(best_index);
+        add_free_range(free_range.offset, best_aligned - free_range.offset);
+        add_free_range(best_aligned + size, free_range.offset + free_range.size - best_aligned - size);
+
+        m_used_size += size;
+        return some(Range {best_aligned, size});
+    }
+
+    void RangeAllocator::free(const Range &range)
+    {
+        if (range.offset + range.size > m_capacity)
+        {
+            throw std::out_of_range("Tried to free a range outside of the allocator.");
+        }
+        if (range.size == 0)
+        {
+            return;
+        }
+
+        m_used_size -= range.size;
+        add_free_range(range.offset, range.size);
+    }
+
+    void RangeAllocator::grow(size_t new_capacity)
+    {
+        if (new_capacity <= m_capacity)
+        {
+            return;
+        }
+
+        add_free_range(m_capacity, new_capacity - m_capacity);
+        m_capacity = new_capacity;
+    }
+
+    void RangeAllocator::clear()
+    {
+        m_free_ranges.clear();
+        m_used_size = 0;
+        if (m_capacity > 0)
+        {
+            m_free_ranges.push_back(Range {0, m_capacity});
+        }
+    }
+} // namespace rg
@@ -160,6 +160,15 @@ void *VectorImpl::push_slot()
     return element;
 }
 
+void *VectorImpl::push_slots(size_t count)
+{
+    ensure_capacity(m_count + count);
+
+    char *first = m_data + (m_count * m_element_size);
+    m_count += count;
+    return first;
+}
+
 void *VectorImpl::last_element() const
 {
     // Return the last element
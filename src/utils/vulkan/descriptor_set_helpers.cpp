@@ -103,6 +103,13 @@ namespace rg
                 .descriptorCount = single_pool_balance.combined_image_sampler_count,
             });
         }
+        if (single_pool_balance.storage_image_count != 0)
+        {
+            pool_sizes.push_back(VkDescriptorPoolSize {
+                .type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .descriptorCount = single_pool_balance.storage_image_count,
+            });
+        }
 
         VkDescriptorPoolCreateInfo pool_info = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
@@ -345,7 +352,10 @@ namespace rg
         return add_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffer, range, offset);
     }
 
-    DescriptorSetBuilder &DescriptorSetBuilder::add_combined_image_sampler(VkSampler sampler, VkImageView image_view)
+    DescriptorSetBuilder &DescriptorSetBuilder::add_image(VkDescriptorType type,
+                                                          VkSampler        sampler,
+                                                          VkImageView      image_view,
+                                                          VkImageLayout    image_layout)
     {
         // Save index
         m_data->info_ptrs.push_back(InfoPtr {
@@ -353,11 +363,11 @@ namespace rg
             .info_type = InfoType::IMAGE,
         });
 
-        // Set buffer info
+        // Set image info
         m_data->image_infos.push_back(VkDescriptorImageInfo {
             .sampler     = sampler,
             .imageView   = image_view,
-            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .imageLayout = image_layout,
         });
 
         // Set write
@@ -368,14 +378,19 @@ namespace rg
             .dstBinding       = m_data->binding_index,
             .dstArrayElement  = 0,
             .descriptorCount  = 1,
-            .descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorType   = type,
             .pImageInfo       = nullptr,
             .pBufferInfo      = nullptr,
             .pTexelBufferView = nullptr,
         });
 
         // Update balance
-        m_data->current_balance.combined_image_sampler_count += 1;
+        switch (type)
+        {
+            case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER: m_data->current_balance.combined_image_sampler_count += 1; break;
+            case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE: m_data->current_balance.storage_image_count += 1; break;
+            default: throw std::runtime_error("DescriptorSetBuilder::add_image: unsupported descriptor type");
+        }
 
         // Increase binding index
         m_data->binding_index++;
@@ -383,6 +398,18 @@ namespace rg
         return *this;
     }
 
+    DescriptorSetBuilder &DescriptorSetBuilder::add_combined_image_sampler(VkSampler     sampler,
+                                                                           VkImageView   image_view,
+                                                                           VkImageLayout image_layout)
+    {
+        return add_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, image_view, image_layout);
+    }
+
+    DescriptorSetBuilder &DescriptorSetBuilder::add_storage_image(VkImageView image_view)
+    {
+        return add_image(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_NULL_HANDLE, image_view, VK_IMAGE_LAYOUT_GENERAL);
+    }
+
     DescriptorSetBuilder &DescriptorSetBuilder::save_descriptor_set(VkDescriptorSetLayout layout, VkDescriptorSet *set)
     {
         m_data->layouts.push_back(layout);
@@ -487,6 +514,10 @@ namespace rg
     {
         return add_buffer(stages, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
     }
+    DescriptorSetLayoutBuilder &DescriptorSetLayoutBuilder::add_storage_image(VkShaderStageFlags stages)
+    {
+        return add_buffer(stages, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    }
     DescriptorSetLayoutBuilder &DescriptorSetLayoutBuilder::save_descriptor_set_layout(VkDescriptorSetLayout *layout)
     {
         if (*layout != nullptr)
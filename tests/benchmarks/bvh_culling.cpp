@@ -0,0 +1,137 @@
+#include <railguard/utils/array.h>
+#include <railguard/utils/geometry/bvh.h>
+#include <railguard/utils/geometry/frustum.h>
+#include <railguard/utils/geometry/ray.h>
+
+#include <chrono>
+#include <cmath>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <iostream>
+#include <random>
+#include <test_framework/test_framework.hpp>
+
+using clock_type = std::chrono::high_resolution_clock;
+
+double elapsed_ms(const clock_type::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+TEST
+{
+    // Camera in the middle of the world, like a player in a big level
+    const auto projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 200.f);
+    const auto view       = glm::lookAt(glm::vec3(0.f, 5.f, 0.f), glm::vec3(1.f, 5.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+    const auto frustum    = rg::Frustum::from_view_projection(projection * view);
+
+    std::mt19937 generator(42);
+
+    for (const size_t instance_count : {10000, 100000, 1000000})
+    {
+        // Keep the same density: bigger scenes are wider, not more crowded
+        const float                           half_size = 2.f * std::cbrt(static_cast<float>(instance_count));
+        std::uniform_real_distribution<float> position_distribution(-half_size, half_size);
+        std::uniform_real_distribution<float> size_distribution(0.25f, 1.f);
+
+        rg::Array<rg::AABB> boxes(instance_count);
+        for (auto &box : boxes)
+        {
+            const glm::vec3 center(position_distribution(generator),
+                                   position_distribution(generator),
+                                   position_distribution(generator));
+            const glm::vec3 half_extent(size_distribution(generator), size_distribution(generator), size_distribution(generator));
+            box.extend(center - half_extent);
+            box.extend(center + half_extent);
+        }
+
+        // Build
+        rg::BVH    bvh;
+        const auto build_start = clock_type::now();
+        bvh.build(boxes.data(), instance_count);
+        const auto build_ms = elapsed_ms(build_start);
+        EXPECT_EQ(bvh.item_count(), instance_count);
+
+        // Refit after moving every box a bit
+        for (auto &box : boxes)
+        {
+            box.min.y += 0.5f;
+            box.max.y += 0.5f;
+        }
+        const auto refit_start = clock_type::now();
+        bvh.refit(boxes.data());
+        const auto refit_ms = elapsed_ms(refit_start);
+
+        // Brute force culling
+        constexpr size_t   iteration_count = 10;
+        rg::Array<uint8_t> expected_visibility(instance_count);
+        const auto         brute_force_start = clock_type::now();
+        for (size_t iteration = 0; iteration < iteration_count; iteration++)
+        {
+            for (size_t i = 0; i < instance_count; i++)
+            {
+                expected_visibility[i] = frustum.intersects_box(boxes[i]) ? 1 : 0;
+            }
+        }
+        const auto brute_force_ms = elapsed_ms(brute_force_start) / iteration_count;
+
+        // Hierarchical culling
+        rg::Array<uint8_t> visibility(instance_count);
+        const auto         bvh_start = clock_type::now();
+        for (size_t iteration = 0; iteration < iteration_count; iteration++)
+        {
+            bvh.cull(frustum, visibility.data());
+        }
+        const auto bvh_ms = elapsed_ms(bvh_start) / iteration_count;
+
+        // Both must find the same objects
+        size_t visible_count  = 0;
+        size_t mismatch_count = 0;
+        for (size_t i = 0; i < instance_count; i++)
+        {
+            visible_count += visibility[i];
+            mismatch_count += visibility[i] != expected_visibility[i] ? 1 : 0;
+        }
+        EXPECT_EQ(mismatch_count, static_cast<size_t>(0));
+        EXPECT_TRUE(visible_count > 0);
+
+        // The ray query must find the closest box along the ray
+        const rg::Ray ray {.origin = glm::vec3(0.f, 5.f, 0.f), .direction = glm::vec3(1.f, 0.f, 1.f)};
+        uint32_t      hit_item     = 0;
+        float         hit_distance = 0.0f;
+        const bool    hit          = bvh.raycast(ray, 1000.f, hit_item, hit_distance);
+
+        float expected_distance = 1000.f;
+        bool  expected_hit      = false;
+        for (const auto &box : boxes)
+        {
+            float distance = 0.0f;
+            if (box.intersects_ray(ray, expected_distance, distance))
+            {
+                expected_hit      = true;
+                expected_distance = std::min(expected_distance, distance);
+            }
+        }
+        EXPECT_EQ(hit, expected_hit);
+        if (hit)
+        {
+            EXPECT_TRUE(std::abs(hit_distance - expected_distance) < 1e-4f);
+        }
+
+        // Same for box queries
+        const rg::AABB       query_box {.min = glm::vec3(-20.f), .max = glm::vec3(20.f)};
+        rg::Vector<uint32_t> query_results(64);
+        bvh.query_box(query_box, query_results);
+        size_t expected_query_count = 0;
+        for (const auto &box : boxes)
+        {
+            expected_query_count += box.intersects(query_box) ? 1 : 0;
+        }
+        EXPECT_EQ(query_results.size(), expected_query_count);
+
+        std::cout << instance_count << " instances (" << visible_count << " visible):\n";
+        std::cout << "    Build: " << build_ms << " ms, refit: " << refit_ms << " ms\n";
+        std::cout << "    Brute force culling: " << brute_force_ms << " ms\n";
+        std::cout << "    BVH culling: " << bvh_ms << " ms\n";
+    }
+}
@@ -0,0 +1,94 @@
+#include <railguard/utils/array.h>
+#include <railguard/utils/geometry/frustum.h>
+
+#include <chrono>
+#include <cmath>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+#include <iostream>
+#include <random>
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    constexpr size_t instance_count  = 100000;
+    constexpr size_t iteration_count = 100;
+
+    // Camera in the middle of the scene, looking at the objects on one side
+    const auto projection = glm::perspective(glm::radians(70.f), 16.f / 9.f, 0.1f, 200.f);
+    const auto view       = glm::lookAt(glm::vec3(0.f, 5.f, 0.f), glm::vec3(1.f, 5.f, 1.f), glm::vec3(0.f, 1.f, 0.f));
+    const auto frustum    = rg::Frustum::from_view_projection(projection * view);
+
+    // Random spheres all around the camera, stored as a structure of arrays like in the renderer
+    std::mt19937                          generator(42);
+    std::uniform_real_distribution<float> position_distribution(-250.f, 250.f);
+    std::uniform_real_distribution<float> radius_distribution(0.1f, 5.f);
+
+    rg::Array<float> x(instance_count);
+    rg::Array<float> y(instance_count);
+    rg::Array<float> z(instance_count);
+    rg::Array<float> radius(instance_count);
+    for (size_t i = 0; i < instance_count; i++)
+    {
+        x[i]      = position_distribution(generator);
+        y[i]      = position_distribution(generator);
+        z[i]      = position_distribution(generator);
+        radius[i] = radius_distribution(generator);
+    }
+
+    // Batched culling
+    rg::Array<uint8_t> visibility(instance_count);
+    const auto         batched_start = std::chrono::high_resolution_clock::now();
+    for (size_t iteration = 0; iteration < iteration_count; iteration++)
+    {
+        frustum.cull_spheres(x.data(), y.data(), z.data(), radius.data(), instance_count, visibility.data());
+    }
+    const auto batched_end = std::chrono::high_resolution_clock::now();
+
+    // One sphere at a time, for reference
+    rg::Array<uint8_t> expected_visibility(instance_count);
+    const auto         scalar_start = std::chrono::high_resolution_clock::now();
+    for (size_t iteration = 0; iteration < iteration_count; iteration++)
+    {
+        for (size_t i = 0; i < instance_count; i++)
+        {
+            expected_visibility[i] = frustum.intersects_sphere(glm::vec3(x[i], y[i], z[i]), radius[i]) ? 1 : 0;
+        }
+    }
+    const auto scalar_end = std::chrono::high_resolution_clock::now();
+
+    // Both must give the same result. Spheres touching a plane may differ because of rounding, so ignore them.
+    size_t visible_count  = 0;
+    size_t mismatch_count = 0;
+    for (size_t i = 0; i < instance_count; i++)
+    {
+        visible_count += visibility[i];
+        if (visibility[i] != expected_visibility[i])
+        {
+            bool on_boundary = false;
+            for (const auto &plane : frustum.planes)
+            {
+                const float distance = glm::dot(glm::vec3(plane), glm::vec3(x[i], y[i], z[i])) + plane.w;
+                on_boundary |= std::abs(distance + radius[i]) < 1e-3f;
+            }
+            if (!on_boundary)
+            {
+                mismatch_count++;
+            }
+        }
+    }
+    EXPECT_EQ(mismatch_count, static_cast<size_t>(0));
+
+    // Some spheres are visible, but not all of them
+    EXPECT_TRUE(visible_count > 0);
+    EXPECT_TRUE(visible_count < instance_count);
+
+    // Print the cost per instance
+    const auto batched_ns = std::chrono::duration<double, std::nano>(batched_end - batched_start).count();
+    const auto scalar_ns  = std::chrono::duration<double, std::nano>(scalar_end - scalar_start).count();
+    const auto total      = static_cast<double>(instance_count * iteration_count);
+    std::cout << "Culled " << instance_count << " instances, " << visible_count << " visible.\n";
+    std::cout << "Batched: " << batched_ns / total << " ns per instance\n";
+    std::cout << "Scalar:  " << scalar_ns / total << " ns per instance\n";
+}
@@ -0,0 +1,127 @@
+#include <railguard/core/obj_parser.h>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <test_framework/test_framework.hpp>
+#include <thread>
+#include <tiny_obj_loader.h>
+
+using clock_type = std::chrono::high_resolution_clock;
+
+double elapsed_ms(const clock_type::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+/** Loads the file with tinyobjloader, with the same result as the native parser: one vertex per corner of each triangle. */
+bool load_with_tinyobj(const char *path, rg::ObjGeometry &geometry)
+{
+    tinyobj::attrib_t                attrib;
+    std::vector<tinyobj::shape_t>    shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string                      warn;
+    std::string                      err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path, nullptr))
+    {
+        return false;
+    }
+
+    geometry = rg::ObjGeometry {};
+    for (const auto &shape : shapes)
+    {
+        for (size_t i = 0; i < shape.mesh.indices.size(); i += 3)
+        {
+            const auto first = static_cast<uint32_t>(geometry.vertices.size());
+            for (size_t v = 0; v < 3; v++)
+            {
+                const auto idx    = shape.mesh.indices[i + v];
+                rg::Vertex vertex = {
+                    .position  = glm::vec3(attrib.vertices[3 * idx.vertex_index + 0],
+                                          attrib.vertices[3 * idx.vertex_index + 1],
+                                          attrib.vertices[3 * idx.vertex_index + 2]),
+                    .normal    = glm::vec3(0.0f),
+                    .tex_coord = glm::vec2(0.0f),
+                };
+                if (idx.normal_index >= 0)
+                {
+                    vertex.normal = glm::vec3(attrib.normals[3 * idx.normal_index + 0],
+                                              attrib.normals[3 * idx.normal_index + 1],
+                                              attrib.normals[3 * idx.normal_index + 2]);
+                }
+                if (idx.texcoord_index >= 0)
+                {
+                    vertex.tex_coord = glm::vec2(attrib.texcoords[2 * idx.texcoord_index + 0],
+                                                 1 - attrib.texcoords[2 * idx.texcoord_index + 1]);
+                }
+                geometry.vertices.push_back(vertex);
+            }
+            geometry.triangles.push_back(rg::Triangle(first, first + 1, first + 2));
+        }
+    }
+    return true;
+}
+
+/** The float parsers may round the last digit differently, so the values are compared with a tolerance. */
+bool nearly_equal(float a, float b)
+{
+    return std::abs(a - b) <= 1e-5f * std::max(1.0f, std::abs(a));
+}
+
+TEST
+{
+    const uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    for (const char *path : {"resources/meshes/lost_empire.obj", "resources/meshes/monkey.obj"})
+    {
+        constexpr size_t iteration_count = 5;
+
+        // Reference
+        rg::ObjGeometry expected;
+        const auto      tinyobj_start = clock_type::now();
+        for (size_t iteration = 0; iteration < iteration_count; iteration++)
+        {
+            ASSERT_TRUE(load_with_tinyobj(path, expected));
+        }
+        const auto tinyobj_ms = elapsed_ms(tinyobj_start) / iteration_count;
+
+        // Native parser, on a single thread then on all of them
+        double          native_ms[2] = {};
+        rg::ObjGeometry geometry;
+        std::string     error;
+        for (size_t run = 0; run < 2; run++)
+        {
+            const uint32_t threads      = run == 0 ? 1 : thread_count;
+            const auto     native_start = clock_type::now();
+            for (size_t iteration = 0; iteration < iteration_count; iteration++)
+            {
+                ASSERT_TRUE(rg::parse_obj(path, rg::ObjImportMode::DUPLICATED_VERTICES, geometry, error, threads));
+            }
+            native_ms[run] = elapsed_ms(native_start) / iteration_count;
+        }
+
+        // Both must find the same triangles, in the same order
+        ASSERT_EQ(geometry.vertices.size(), expected.vertices.size());
+        ASSERT_EQ(geometry.triangles.size(), expected.triangles.size());
+        size_t mismatch_count = 0;
+        for (size_t i = 0; i < geometry.vertices.size(); i++)
+        {
+            const auto &a = geometry.vertices[i];
+            const auto &b = expected.vertices[i];
+            for (int c = 0; c < 3; c++)
+            {
+                mismatch_count += nearly_equal(a.position[c], b.position[c]) && nearly_equal(a.normal[c], b.normal[c]) ? 0 : 1;
+            }
+            for (int c = 0; c < 2; c++)
+            {
+                mismatch_count += nearly_equal(a.tex_coord[c], b.tex_coord[c]) ? 0 : 1;
+            }
+        }
+        EXPECT_EQ(mismatch_count, static_cast<size_t>(0));
+
+        std::cout << path << " (" << geometry.triangles.size() << " triangles):\n";
+        std::cout << "    tinyobjloader: " << tinyobj_ms << " ms\n";
+        std::cout << "    Native parser, 1 thread: " << native_ms[0] << " ms\n";
+        std::cout << "    Native parser, " << thread_count << " threads: " << native_ms[1] << " ms\n";
+    }
+}
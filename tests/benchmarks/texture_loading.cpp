@@ -0,0 +1,127 @@
+#include <railguard/core/engine.h>
+#include <railguard/core/mesh.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stb_image.h>
+#include <test_framework/test_framework.hpp>
+#include <vector>
+
+using clock_type = std::chrono::high_resolution_clock;
+
+double elapsed_ms(const clock_type::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+}
+
+TEST
+{
+    constexpr size_t texture_count = 6;
+    const char      *path          = "resources/textures/lost_empire-RGBA.png";
+
+    // Reference: decoding the images on the calling thread in a heap buffer, then copying them in staging memory, as load_texture
+    // used to do
+    size_t     decoded_bytes   = 0;
+    size_t     largest_size    = 0;
+    const auto reference_start = clock_type::now();
+    for (size_t i = 0; i < texture_count; i++)
+    {
+        int32_t  width, height, tex_channels;
+        stbi_uc *pixels = stbi_load(path, &width, &height, &tex_channels, STBI_rgb_alpha);
+        ASSERT_TRUE(pixels != nullptr);
+        const auto           size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+        std::vector<uint8_t> staging(size);
+        memcpy(staging.data(), pixels, size);
+        stbi_image_free(pixels);
+
+        // Each texture waiting for its upload kept its decoded copy, and the upload needed a second one in staging memory
+        decoded_bytes += size;
+        largest_size   = std::max(largest_size, size);
+    }
+    const double reference_time = elapsed_ms(reference_start);
+
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    auto &renderer = engine.renderer();
+
+    auto vertex_shader   = renderer.load_shader_module("resources/shaders/textured/textured.vert.spv", rg::ShaderStage::VERTEX);
+    auto fragment_shader = renderer.load_shader_module("resources/shaders/textured/textured.frag.spv", rg::ShaderStage::FRAGMENT);
+
+    auto effect = renderer.create_shader_effect({vertex_shader, fragment_shader},
+                                                rg::RenderStageKind::FORWARD,
+                                                {{rg::ShaderStage::FRAGMENT}});
+
+    auto material_template = renderer.create_material_template({effect});
+
+    auto cube = rg::MeshPart::load_from_obj("resources/meshes/cube.obj", engine.renderer());
+    ASSERT_TRUE(cube != rg::NULL_ID);
+
+    // Loading them only reads their size: they are decoded by workers, directly in their staging memory
+    const auto load_start = clock_type::now();
+    for (size_t i = 0; i < texture_count; i++)
+    {
+        auto texture = renderer.load_texture(path, rg::TextureOptions {});
+        ASSERT_TRUE(texture != rg::NULL_ID);
+
+        auto  material       = renderer.create_material(material_template, {{texture}});
+        auto  node           = renderer.create_render_node(renderer.create_model(cube, material));
+        auto &node_transform = renderer.get_render_node_transform(node);
+
+        node_transform.position.x = static_cast<float>(i) * 3.f - 7.5f;
+    }
+    const double load_time = elapsed_ms(load_start);
+
+    auto  camera                = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 200.0f);
+    auto &camera_transform      = renderer.get_camera_transform(camera);
+    camera_transform.position.z = -10;
+
+    // Measure the frames until every texture is uploaded: they shouldn't be longer than the other ones, since they don't decode
+    double upload_time         = 0.0;
+    double longest_upload_time = 0.0;
+    size_t upload_frame_count  = 0;
+    double other_time          = 0.0;
+    size_t other_frame_count   = 0;
+    bool   uploaded            = false;
+    engine.on_update()->subscribe(
+        [&](double delta_time)
+        {
+            const double frame_time = delta_time * 1000.0;
+            if (!uploaded)
+            {
+                upload_time         += frame_time;
+                longest_upload_time  = std::max(longest_upload_time, frame_time);
+                upload_frame_count++;
+                uploaded = renderer.get_upload_statistics().pending_upload_count == 0;
+            }
+            else
+            {
+                other_time += frame_time;
+                other_frame_count++;
+            }
+        });
+
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    const auto statistics = renderer.get_upload_statistics();
+    EXPECT_TRUE(uploaded);
+    EXPECT_EQ(statistics.failed_texture_count, static_cast<size_t>(0));
+
+    std::cout << "Decoding on the calling thread: " << reference_time << " ms for " << texture_count << " textures, up to "
+              << decoded_bytes + largest_size << " bytes of CPU memory\n"
+              << "load_texture: " << load_time << " ms, up to " << decoded_bytes << " bytes of staging memory\n"
+              << "Uploads: " << upload_frame_count << " frames, " << upload_time << " ms, longest frame: " << longest_upload_time
+              << " ms\n";
+    if (other_frame_count > 0)
+    {
+        std::cout << "Other frames: " << other_time / static_cast<double>(other_frame_count) << " ms on average\n";
+    }
+}
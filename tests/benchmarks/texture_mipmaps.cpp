@@ -0,0 +1,120 @@
+#include <railguard/core/engine.h>
+#include <railguard/core/mesh.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+#include <railguard/utils/vector.h>
+
+#include <iostream>
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    auto &renderer = engine.renderer();
+
+    // Load shaders
+    auto vertex_shader   = renderer.load_shader_module("resources/shaders/textured/textured.vert.spv", rg::ShaderStage::VERTEX);
+    auto fragment_shader = renderer.load_shader_module("resources/shaders/textured/textured.frag.spv", rg::ShaderStage::FRAGMENT);
+
+    auto effect = renderer.create_shader_effect({vertex_shader, fragment_shader},
+                                                rg::RenderStageKind::FORWARD,
+                                                {{rg::ShaderStage::FRAGMENT}});
+
+    auto material_template = renderer.create_material_template({effect});
+
+    // Same texture, with and without mip levels
+    auto texture_without_mips = renderer.load_texture("resources/textures/lost_empire-RGBA.png",
+                                                      rg::TextureOptions {.mip_levels = 1, .max_anisotropy = 1.0f});
+    auto texture_with_mips    = renderer.load_texture("resources/textures/lost_empire-RGBA.png", rg::TextureOptions {});
+    ASSERT_TRUE(texture_without_mips != rg::NULL_ID);
+    ASSERT_TRUE(texture_with_mips != rg::NULL_ID);
+
+    auto material_without_mips = renderer.create_material(material_template, {{texture_without_mips}});
+    auto material_with_mips    = renderer.create_material(material_template, {{texture_with_mips}});
+
+    auto scene_parts = rg::MeshPart::load_parts_from_obj("resources/meshes/lost_empire.obj",
+                                                         engine.renderer(),
+                                                         {
+                                                             .vertex_format     = rg::VertexFormat::COMPRESSED,
+                                                             .gpu_resident_only = true,
+                                                         });
+    ASSERT_FALSE(scene_parts.is_empty());
+
+    rg::Vector<rg::ModelId> models_without_mips(scene_parts.size());
+    rg::Vector<rg::ModelId> models_with_mips(scene_parts.size());
+    for (const auto scene_part : scene_parts)
+    {
+        models_without_mips.push_back(renderer.create_model(scene_part, material_without_mips));
+        models_with_mips.push_back(renderer.create_model(scene_part, material_with_mips));
+    }
+
+    const auto show_models = [&renderer](const rg::Vector<rg::ModelId> &models)
+    {
+        renderer.clear_render_nodes();
+        for (const auto model : models)
+        {
+            renderer.create_render_node(model);
+        }
+    };
+    show_models(models_without_mips);
+
+    // Look at the distant parts of the scene, where the texels are much smaller than the pixels
+    auto  camera           = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 200.0f);
+    auto &camera_transform = renderer.get_camera_transform(camera);
+
+    camera_transform.position = glm::vec3(4.f, 20.f, -10.f);
+    camera_transform.rotation = glm::rotate(camera_transform.rotation, glm::radians(-20.f), glm::vec3(1, 0, 0));
+
+    // Render each version for half of the run. The first frames of each half are skipped: they include the uploads.
+    constexpr double half_duration = 2.5;
+    constexpr size_t skipped_count = 30;
+
+    double time                = 0.0;
+    bool   uses_mips           = false;
+    size_t frame_count[2]      = {0, 0};
+    double total_stage_time[2] = {0.0, 0.0};
+    size_t frames_since_switch = 0;
+    engine.on_update()->subscribe(
+        [&](double delta_time)
+        {
+            time += delta_time;
+            frames_since_switch++;
+
+            if (frames_since_switch > skipped_count)
+            {
+                frame_count[uses_mips]++;
+                total_stage_time[uses_mips] += renderer.get_stage_gpu_time(0);
+            }
+
+            if (!uses_mips && time > half_duration)
+            {
+                show_models(models_with_mips);
+                uses_mips           = true;
+                frames_since_switch = 0;
+            }
+        });
+
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    // Timestamps are optional, so the times can be 0
+    for (const bool with_mips : {false, true})
+    {
+        const auto count = frame_count[with_mips];
+        std::cout << (with_mips ? "With mip levels: " : "Without mip levels: ");
+        if (count > 0)
+        {
+            std::cout << total_stage_time[with_mips] / static_cast<double>(count) << " ms per frame in the forward stage ("
+                      << count << " frames)\n";
+        }
+        else
+        {
+            std::cout << "no measured frame\n";
+        }
+    }
+}
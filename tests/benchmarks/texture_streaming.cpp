@@ -0,0 +1,81 @@
+#include <railguard/core/engine.h>
+#include <railguard/core/mesh.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <algorithm>
+#include <iostream>
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    auto &renderer = engine.renderer();
+
+    // Load shaders
+    auto vertex_shader   = renderer.load_shader_module("resources/shaders/textured/textured.vert.spv", rg::ShaderStage::VERTEX);
+    auto fragment_shader = renderer.load_shader_module("resources/shaders/textured/textured.frag.spv", rg::ShaderStage::FRAGMENT);
+
+    auto effect = renderer.create_shader_effect({vertex_shader, fragment_shader},
+                                                rg::RenderStageKind::FORWARD,
+                                                {{rg::ShaderStage::FRAGMENT}});
+
+    auto material_template = renderer.create_material_template({effect});
+
+    // Only the least detailed levels are loaded at first
+    auto texture = renderer.load_texture("resources/textures/lost_empire-RGBA.png", rg::TextureOptions {.streamed = true});
+    ASSERT_TRUE(texture != rg::NULL_ID);
+    auto material = renderer.create_material(material_template, {{texture}});
+
+    auto scene_parts = rg::MeshPart::load_parts_from_obj("resources/meshes/lost_empire.obj",
+                                                         engine.renderer(),
+                                                         {
+                                                             .vertex_format     = rg::VertexFormat::COMPRESSED,
+                                                             .gpu_resident_only = true,
+                                                         });
+    ASSERT_FALSE(scene_parts.is_empty());
+    for (const auto scene_part : scene_parts)
+    {
+        renderer.create_render_node(renderer.create_model(scene_part, material));
+    }
+
+    // Start far from the scene, then get close to it: the detailed levels are streamed in when they are needed
+    auto  camera           = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 400.0f);
+    auto &camera_transform = renderer.get_camera_transform(camera);
+
+    camera_transform.position = glm::vec3(4.f, 20.f, -200.f);
+
+    constexpr double duration = 5.0;
+
+    double time                 = 0.0;
+    size_t missing_level_frames = 0;
+    size_t frame_count          = 0;
+    engine.on_update()->subscribe(
+        [&](double delta_time)
+        {
+            time += delta_time;
+            frame_count++;
+            camera_transform.position.z = static_cast<float>(-200.0 + 190.0 * std::min(time / duration, 1.0));
+
+            if (renderer.get_texture_streaming_statistics().missing_level_texture_count > 0)
+            {
+                missing_level_frames++;
+            }
+        });
+
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    const auto statistics = renderer.get_texture_streaming_statistics();
+    std::cout << "Frames with missing levels: " << missing_level_frames << " / " << frame_count << "\n"
+              << "Resident: " << statistics.resident_bytes << " bytes, wanted: " << statistics.wanted_bytes
+              << " bytes, budget: " << statistics.budget_bytes << " bytes\n"
+              << "Streamed in: " << statistics.streamed_in_count << " times (" << statistics.streamed_in_bytes << " bytes), "
+              << "evicted: " << statistics.evicted_count << " times (" << statistics.evicted_bytes << " bytes)\n";
+    EXPECT_EQ(statistics.streamed_texture_count, static_cast<size_t>(1));
+}
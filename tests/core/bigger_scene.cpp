@@ -37,16 +37,24 @@ TEST
     // Create a material
     auto material = renderer.create_material(material_template, {{texture}});
 
-    // Create a scene mesh part
-    auto scene = rg::MeshPart::load_from_obj("resources/meshes/lost_empire.obj", engine.renderer(), true);
-    ASSERT_TRUE(scene != rg::NULL_ID);
-
-    // Create a model
-    auto  model           = renderer.create_model(scene, material);
-    auto &model_transform = renderer.get_model_transform(model);
-
-    // Create a render node
-    auto render_node = renderer.create_render_node(model);
+    // Create the scene mesh parts
+    // The scene is big, so its vertices are compressed to halve the memory they take
+    // It is also split in several parts, so that the parts that are not visible can be culled
+    // Its data is only needed on the GPU, so the CPU copies are released once uploaded
+    auto scene_parts = rg::MeshPart::load_parts_from_obj("resources/meshes/lost_empire.obj",
+                                                         engine.renderer(),
+                                                         {
+                                                             .vertex_format     = rg::VertexFormat::COMPRESSED,
+                                                             .gpu_resident_only = true,
+                                                         });
+    ASSERT_FALSE(scene_parts.is_empty());
+
+    // Create a model and a render node for each part
+    for (const auto scene_part : scene_parts)
+    {
+        auto model = renderer.create_model(scene_part, material);
+        renderer.create_render_node(model);
+    }
 
     // Create a camera
     auto  camera                = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 200.0f);
@@ -0,0 +1,85 @@
+#include "test_scene.h"
+
+#include <railguard/core/engine.h>
+#include <railguard/core/mesh.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    auto &renderer = engine.renderer();
+
+    // Must be enabled before creating the effects. If the device doesn't support it, the textures are bound per material.
+    bool bindless = false;
+    EXPECT_NO_THROWS(bindless = renderer.set_bindless_textures(true));
+
+    // Load shaders
+    const char *vertex_path   = bindless ? "resources/shaders/textured/textured_bindless.vert.spv"
+                                         : "resources/shaders/textured/textured.vert.spv";
+    const char *fragment_path = bindless ? "resources/shaders/textured/textured_bindless.frag.spv"
+                                         : "resources/shaders/textured/textured.frag.spv";
+    auto material_template    = create_test_material_template(renderer, vertex_path, fragment_path, {{rg::ShaderStage::FRAGMENT}});
+
+    // Two materials with different textures: with bindless textures, they are still drawn in the same batch
+    auto rgb_texture  = renderer.load_texture("resources/textures/lost_empire-RGB.png", rg::TextureOptions {});
+    auto rgba_texture = renderer.load_texture("resources/textures/lost_empire-RGBA.png", rg::TextureOptions {});
+    ASSERT_TRUE(rgb_texture != rg::NULL_ID);
+    ASSERT_TRUE(rgba_texture != rg::NULL_ID);
+    auto rgb_material  = renderer.create_material(material_template, {{rgb_texture}});
+    auto rgba_material = renderer.create_material(material_template, {{rgba_texture}});
+
+    auto monkey = rg::MeshPart::load_from_obj("resources/meshes/monkey.obj", engine.renderer());
+    auto cube   = rg::MeshPart::load_from_obj("resources/meshes/cube.obj", engine.renderer());
+    ASSERT_TRUE(monkey != rg::NULL_ID);
+    ASSERT_TRUE(cube != rg::NULL_ID);
+
+    // Create a grid of render nodes, alternating each mesh with each material
+    auto nodes = create_test_grid(renderer,
+                                  {
+                                      renderer.create_model(monkey, rgb_material),
+                                      renderer.create_model(monkey, rgba_material),
+                                      renderer.create_model(cube, rgb_material),
+                                      renderer.create_model(cube, rgba_material),
+                                  },
+                                  10,
+                                  false);
+
+    // A material created while drawing moves the texture slots of the materials in the buffer
+    bool created_material = false;
+
+    create_test_camera(renderer, glm::vec3(0.0f, 5.0f, -10.0f));
+
+    engine.on_update()->subscribe(
+        [&](double)
+        {
+            if (!created_material)
+            {
+                auto material = renderer.create_material(material_template, {{rgba_texture}});
+                renderer.create_render_node(renderer.create_model(cube, material));
+                created_material = true;
+            }
+        });
+    rotate_test_nodes(engine, nodes);
+
+    // Run engine
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    // The node of the new material is drawn as well, with every texture uploaded
+    const auto statistics = renderer.get_draw_statistics();
+    EXPECT_EQ(statistics.instance_count, nodes.size() + 1);
+    EXPECT_TRUE(statistics.visible_instance_count > 0);
+    EXPECT_TRUE(statistics.visible_instance_count <= statistics.instance_count);
+
+    const auto upload_statistics = renderer.get_upload_statistics();
+    EXPECT_EQ(upload_statistics.pending_upload_count, static_cast<size_t>(0));
+    EXPECT_EQ(upload_statistics.failed_texture_count, static_cast<size_t>(0));
+}
@@ -50,12 +50,16 @@ TEST
     auto material = renderer.create_material(material_template, {{texture}});
 
     // Create a scene mesh part
-    auto scene = rg::MeshPart::load_from_obj("resources/meshes/lost_empire.obj", engine.renderer(), true);
+    auto scene = rg::MeshPart::load_from_obj("resources/meshes/lost_empire.obj", engine.renderer());
 
     // Create a model
     auto  model           = renderer.create_model(scene, material);
     auto &model_transform = renderer.get_model_transform(model);
 
+    // Create a render node
+    auto render_node = renderer.create_render_node(model);
+    ASSERT_TRUE(render_node != rg::NULL_ID);
+
     // Create a camera
     auto  camera                = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 200.0f);
     auto &camera_transform      = renderer.get_camera_transform(camera);
@@ -0,0 +1,72 @@
+#include "test_scene.h"
+
+#include <railguard/core/mesh.h>
+#include <railguard/core/engine.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    // Setup scene
+
+    auto &renderer = engine.renderer();
+
+    // Enable GPU culling
+    // If the device doesn't support it, the instances are culled on the CPU, which gives the same counts
+    auto culling_shader = renderer.load_shader_module("resources/shaders/culling/culling.comp.spv", rg::ShaderStage::COMPUTE);
+    EXPECT_NO_THROWS(renderer.set_culling_shader(culling_shader));
+
+    auto material_template =
+        create_test_material_template(renderer, "resources/shaders/hello/test.vert.spv", "resources/shaders/hello/test.frag.spv");
+    auto material = renderer.create_material(material_template, {{}});
+
+    // Create mesh parts
+    // The monkey has levels of detail, selected by the culling shader depending on the distance
+    auto monkey = rg::MeshPart::load_from_obj("resources/meshes/monkey.obj", engine.renderer(), {.lod_count = 4});
+    ASSERT_TRUE(monkey != rg::NULL_ID);
+    auto cube = rg::MeshPart::load_from_obj("resources/meshes/cube.obj", engine.renderer());
+    ASSERT_TRUE(cube != rg::NULL_ID);
+
+    // Create a big grid of render nodes all around the camera, so that most of them are outside the frustum
+    constexpr int32_t grid_size = 60;
+    auto              nodes     = create_test_grid(renderer,
+                                      {renderer.create_model(monkey, material), renderer.create_model(cube, material)},
+                                      grid_size,
+                                      true);
+    for (const auto &node : nodes)
+    {
+        renderer.get_render_node_transform(node).scale = glm::vec3(0.5f);
+    }
+
+    // Create a camera in the middle of the grid
+    auto  camera           = create_test_camera(renderer, glm::vec3(0.0f, -2.0f, 0.0f));
+    auto &camera_transform = renderer.get_camera_transform(camera);
+
+    // Turn around, so that different instances get culled
+    engine.on_update()->subscribe(
+        [&camera_transform](double delta_time)
+        {
+            camera_transform.rotation = glm::rotate(camera_transform.rotation,
+                                                    glm::radians(0.05f) * static_cast<float>(delta_time),
+                                                    glm::vec3(0.0f, 1.0f, 0.0f));
+        });
+
+    // Run engine
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    // Every instance was submitted, but the ones behind the camera were culled
+    const auto statistics = renderer.get_draw_statistics();
+    EXPECT_EQ(statistics.instance_count, static_cast<size_t>(grid_size * grid_size));
+    EXPECT_TRUE(statistics.visible_instance_count > 0);
+    EXPECT_TRUE(statistics.visible_instance_count < statistics.instance_count);
+    EXPECT_TRUE(statistics.visible_draw_count <= statistics.draw_count);
+}
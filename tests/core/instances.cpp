@@ -0,0 +1,58 @@
+#include "test_scene.h"
+
+#include <railguard/core/mesh.h>
+#include <railguard/core/engine.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    // Setup scene
+
+    auto &renderer = engine.renderer();
+
+    auto material_template =
+        create_test_material_template(renderer, "resources/shaders/hello/test.vert.spv", "resources/shaders/hello/test.frag.spv");
+    auto material = renderer.create_material(material_template, {{}});
+
+    // Create a monkey mesh part
+    auto monkey = rg::MeshPart::load_from_obj("resources/meshes/monkey.obj", engine.renderer());
+    ASSERT_TRUE(monkey != rg::NULL_ID);
+
+    // Create a grid of render nodes with a single model: they are all drawn with the same indirect command
+    constexpr int32_t grid_size = 20;
+    auto              nodes     = create_test_grid(renderer, {renderer.create_model(monkey, material)}, grid_size, false);
+    EXPECT_EQ(nodes.size(), static_cast<size_t>(grid_size * grid_size));
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        renderer.get_render_node_transform(nodes[i]).scale = glm::vec3(0.5f + 0.05f * static_cast<float>(i % 10));
+    }
+
+    // Destroying a node in the middle must not break the other ones
+    renderer.destroy_render_node(nodes[0]);
+    nodes.remove_at(0);
+
+    create_test_camera(renderer, glm::vec3(0.0f, 5.0f, -10.0f));
+
+    // Rotate each monkey individually
+    rotate_test_nodes(engine, nodes);
+
+    // Run engine
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    // The destroyed node isn't drawn anymore, and the other ones share a single draw
+    const auto statistics = renderer.get_draw_statistics();
+    EXPECT_EQ(statistics.instance_count, nodes.size());
+    EXPECT_EQ(statistics.draw_count, static_cast<size_t>(1));
+    EXPECT_TRUE(statistics.visible_instance_count > 0);
+    EXPECT_TRUE(statistics.visible_instance_count <= statistics.instance_count);
+}
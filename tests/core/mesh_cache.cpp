@@ -0,0 +1,132 @@
+#include <railguard/core/mesh.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <test_framework/test_framework.hpp>
+#include <vector>
+
+/** Creates a grid part in the given format. */
+rg::MeshPart create_grid(uint32_t size, uint32_t lod_count, rg::VertexFormat format)
+{
+    rg::Vector<rg::Vertex>   vertices((size + 1) * (size + 1));
+    rg::Vector<rg::Triangle> triangles(size * size * 2);
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            const float u = static_cast<float>(x) / static_cast<float>(size);
+            const float v = static_cast<float>(y) / static_cast<float>(size);
+            vertices.push_back(rg::Vertex {
+                .position  = glm::vec3(u * 10.0f, 0.0f, v * 4.0f),
+                .normal    = glm::vec3(0.0f, 1.0f, 0.0f),
+                .tex_coord = glm::vec2(u, v),
+            });
+        }
+    }
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            const uint32_t i = y * (size + 1) + x;
+            triangles.push_back(rg::Triangle(i, i + size + 1, i + 1));
+            triangles.push_back(rg::Triangle(i + 1, i + size + 1, i + size + 2));
+        }
+    }
+
+    rg::MeshPart part(std::move(vertices), std::move(triangles));
+    part.generate_lods(lod_count);
+    part.set_vertex_format(format);
+    return part;
+}
+
+std::vector<uint8_t> encode_vertices(const rg::MeshPart &part)
+{
+    std::vector<uint8_t> result(part.vertex_count() * part.vertex_byte_size());
+    part.write_vertices(result.data());
+    return result;
+}
+
+std::vector<uint8_t> encode_indices(const rg::MeshPart &part)
+{
+    std::vector<uint8_t> result(part.total_triangle_count() * 3 * part.index_byte_size());
+    part.write_indices(result.data());
+    return result;
+}
+
+TEST
+{
+    const auto path = (std::filesystem::temp_directory_path() / "railguard_mesh_cache_test.rgmesh").string();
+    std::remove(path.c_str());
+
+    // Nothing to load yet
+    EXPECT_EQ(rg::MeshPart::load_cache(path.c_str(), 42).size(), static_cast<size_t>(0));
+
+    rg::MeshPart parts[] = {
+        create_grid(16, 3, rg::VertexFormat::FULL),
+        create_grid(300, 1, rg::VertexFormat::COMPRESSED),
+    };
+    ASSERT_TRUE(rg::MeshPart::save_cache(path.c_str(), parts, 2, 42));
+
+    // The stamp must match
+    EXPECT_EQ(rg::MeshPart::load_cache(path.c_str(), 43).size(), static_cast<size_t>(0));
+
+    auto cached_parts = rg::MeshPart::load_cache(path.c_str(), 42);
+    ASSERT_EQ(cached_parts.size(), static_cast<size_t>(2));
+    for (size_t i = 0; i < 2; i++)
+    {
+        const auto &original = parts[i];
+        const auto &cached   = cached_parts[i];
+
+        EXPECT_TRUE(cached.is_cached());
+        EXPECT_FALSE(original.is_cached());
+        EXPECT_TRUE(cached.vertex_format() == original.vertex_format());
+        EXPECT_EQ(cached.vertex_count(), original.vertex_count());
+        EXPECT_EQ(cached.total_triangle_count(), original.total_triangle_count());
+        EXPECT_EQ(cached.triangle_count(), original.triangle_count());
+        EXPECT_EQ(cached.uses_16_bit_indices(), original.uses_16_bit_indices());
+        EXPECT_TRUE(cached.position_offset() == original.position_offset());
+        EXPECT_TRUE(cached.position_scale() == original.position_scale());
+        EXPECT_TRUE(cached.bounds().min == original.bounds().min);
+        EXPECT_TRUE(cached.bounds().max == original.bounds().max);
+        EXPECT_TRUE(cached.bounding_sphere() == original.bounding_sphere());
+        EXPECT_TRUE(cached.uv_density() == original.uv_density());
+
+        ASSERT_EQ(cached.lod_count(), original.lod_count());
+        for (size_t level = 0; level < cached.lod_count(); level++)
+        {
+            EXPECT_EQ(cached.lods()[level].first_index, original.lods()[level].first_index);
+            EXPECT_EQ(cached.lods()[level].index_count, original.lods()[level].index_count);
+            EXPECT_TRUE(cached.lods()[level].error == original.lods()[level].error);
+        }
+
+        // The data is copied as is
+        EXPECT_TRUE(encode_vertices(cached) == encode_vertices(original));
+        EXPECT_TRUE(encode_indices(cached) == encode_indices(original));
+
+        // So the content is the same
+        EXPECT_EQ(cached.content_hash(), original.content_hash());
+    }
+    EXPECT_NEQ(parts[0].content_hash(), parts[1].content_hash());
+    EXPECT_NEQ(parts[0].content_hash(), create_grid(16, 3, rg::VertexFormat::COMPRESSED).content_hash());
+
+    // The grids map the texture once on 10 x 4 units
+    EXPECT_TRUE(std::abs(cached_parts[0].uv_density() - std::sqrt(1.0f / 40.0f)) < 1e-5f);
+
+    // The second grid is too big for 16-bit indices
+    EXPECT_TRUE(cached_parts[0].uses_16_bit_indices());
+    EXPECT_FALSE(cached_parts[1].uses_16_bit_indices());
+
+    // Cached parts can't be modified
+    cached_parts[0].generate_lods(2);
+    EXPECT_EQ(cached_parts[0].lod_count(), parts[0].lod_count());
+
+    // A truncated file is ignored
+    cached_parts.clear();
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+    EXPECT_EQ(rg::MeshPart::load_cache(path.c_str(), 42).size(), static_cast<size_t>(0));
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,132 @@
+#include <railguard/core/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/geometric.hpp>
+#include <random>
+#include <test_framework/test_framework.hpp>
+#include <vector>
+
+// Decoding functions, doing the same as the vertex input and the vertex shaders
+
+float from_snorm16(int16_t value)
+{
+    return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+float from_half(uint16_t value)
+{
+    const int32_t exponent = (value >> 10) & 0x1f;
+    const int32_t mantissa = value & 0x3ff;
+    const float   sign     = (value & 0x8000) != 0 ? -1.0f : 1.0f;
+
+    if (exponent == 0)
+    {
+        return sign * std::ldexp(static_cast<float>(mantissa), -24);
+    }
+    return sign * std::ldexp(static_cast<float>(mantissa + 1024), exponent - 25);
+}
+
+glm::vec3 decode_normal(const int16_t *encoded)
+{
+    glm::vec3 normal(from_snorm16(encoded[0]), from_snorm16(encoded[1]), 0.0f);
+    normal.z      = 1.0f - std::abs(normal.x) - std::abs(normal.y);
+    const float t = std::max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -t : t;
+    normal.y += normal.y >= 0.0f ? -t : t;
+    return glm::normalize(normal);
+}
+
+TEST
+{
+    std::mt19937                          generator(42);
+    std::uniform_real_distribution<float> position_distribution(-50.0f, 150.0f);
+    std::uniform_real_distribution<float> normal_distribution(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> tex_coord_distribution(0.0f, 1.0f);
+
+    constexpr size_t         vertex_count = 3000;
+    rg::Vector<rg::Vertex>   vertices(vertex_count);
+    rg::Vector<rg::Triangle> triangles(vertex_count / 3);
+    for (size_t i = 0; i < vertex_count; i++)
+    {
+        glm::vec3 normal(normal_distribution(generator), normal_distribution(generator), normal_distribution(generator));
+        vertices.push_back(rg::Vertex {
+            .position  = glm::vec3(position_distribution(generator),
+                                  position_distribution(generator) * 0.1f,
+                                  position_distribution(generator)),
+            .normal    = glm::normalize(normal),
+            .tex_coord = glm::vec2(tex_coord_distribution(generator), tex_coord_distribution(generator)),
+        });
+    }
+    for (uint32_t i = 0; i < vertex_count; i += 3)
+    {
+        triangles.push_back(rg::Triangle(i, i + 1, i + 2));
+    }
+
+    rg::MeshPart part(std::move(vertices), std::move(triangles));
+
+    // The full format is the default, and is copied as is
+    EXPECT_TRUE(part.vertex_format() == rg::VertexFormat::FULL);
+    EXPECT_EQ(part.vertex_byte_size(), sizeof(rg::Vertex));
+    std::vector<rg::Vertex> full_vertices(vertex_count);
+    part.write_vertices(full_vertices.data());
+    EXPECT_TRUE(std::memcmp(full_vertices.data(), part.vertices().data(), vertex_count * sizeof(rg::Vertex)) == 0);
+
+    // The compressed format takes half the space
+    part.set_vertex_format(rg::VertexFormat::COMPRESSED);
+    EXPECT_EQ(part.vertex_byte_size(), sizeof(rg::Vertex) / 2);
+    EXPECT_TRUE(part.position_scale() > 0.0f);
+
+    std::vector<rg::CompressedVertex> compressed_vertices(vertex_count);
+    part.write_vertices(compressed_vertices.data());
+
+    float max_position_error  = 0.0f;
+    float min_normal_dot      = 1.0f;
+    float max_tex_coord_error = 0.0f;
+    for (size_t i = 0; i < vertex_count; i++)
+    {
+        const auto &original   = part.vertices()[i];
+        const auto &compressed = compressed_vertices[i];
+
+        // The dequantization is done by the object transform
+        const glm::vec3 position = part.position_offset()
+                                 + part.position_scale()
+                                       * glm::vec3(from_snorm16(compressed.position[0]),
+                                                   from_snorm16(compressed.position[1]),
+                                                   from_snorm16(compressed.position[2]));
+        max_position_error = std::max(max_position_error, glm::length(position - original.position));
+
+        min_normal_dot = std::min(min_normal_dot, glm::dot(decode_normal(compressed.normal), original.normal));
+
+        max_tex_coord_error = std::max({
+            max_tex_coord_error,
+            std::abs(from_half(compressed.tex_coord[0]) - original.tex_coord.x),
+            std::abs(from_half(compressed.tex_coord[1]) - original.tex_coord.y),
+        });
+    }
+
+    // The positions are quantized on the biggest extent of the part: 200 units over 16 bits
+    EXPECT_TRUE(max_position_error < 200.0f / 65535.0f * 2.0f);
+    // Less than a tenth of a degree
+    EXPECT_TRUE(min_normal_dot > std::cos(0.1f * 3.14159265f / 180.0f));
+    // Half floats have 11 bits of precision
+    EXPECT_TRUE(max_tex_coord_error < 1.0f / 2048.0f);
+
+    // The part has few vertices, so the indices take 16 bits
+    ASSERT_TRUE(part.uses_16_bit_indices());
+    EXPECT_EQ(part.index_byte_size(), sizeof(uint16_t));
+    std::vector<uint16_t> indices(part.total_triangle_count() * 3);
+    part.write_indices(indices.data());
+    bool indices_match = true;
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        indices_match &= indices[i] == part.triangles()[i / 3].index[i % 3];
+    }
+    EXPECT_TRUE(indices_match);
+
+    // Going back to the full format removes the dequantization
+    part.set_vertex_format(rg::VertexFormat::FULL);
+    EXPECT_TRUE(part.position_scale() == 1.0f);
+    EXPECT_TRUE(part.position_offset() == glm::vec3(0.0f));
+}
@@ -0,0 +1,93 @@
+#include <railguard/core/mesh.h>
+
+#include <cmath>
+#include <test_framework/test_framework.hpp>
+
+/** Creates a grid of size x size quads, with a vertical offset given by the function. */
+template<typename F>
+rg::MeshPart create_grid(uint32_t size, F &&height)
+{
+    rg::Vector<rg::Vertex>   vertices((size + 1) * (size + 1));
+    rg::Vector<rg::Triangle> triangles(size * size * 2);
+
+    for (uint32_t y = 0; y <= size; y++)
+    {
+        for (uint32_t x = 0; x <= size; x++)
+        {
+            const float fx = static_cast<float>(x) / static_cast<float>(size);
+            const float fy = static_cast<float>(y) / static_cast<float>(size);
+            vertices.push_back(rg::Vertex {
+                .position  = glm::vec3(fx, height(fx, fy), fy),
+                .normal    = glm::vec3(0.0f, 1.0f, 0.0f),
+                .tex_coord = glm::vec2(fx, fy),
+            });
+        }
+    }
+
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            const uint32_t i = y * (size + 1) + x;
+            triangles.push_back(rg::Triangle(i, i + size + 1, i + 1));
+            triangles.push_back(rg::Triangle(i + 1, i + size + 1, i + size + 2));
+        }
+    }
+
+    return rg::MeshPart(std::move(vertices), std::move(triangles));
+}
+
+TEST
+{
+    // Without generation, there is only the base level
+    auto flat = create_grid(32, [](float, float) { return 0.0f; });
+    ASSERT_TRUE(flat.lod_count() == 1);
+    EXPECT_EQ(flat.lods()[0].first_index, 0u);
+    EXPECT_EQ(flat.lods()[0].index_count, static_cast<uint32_t>(flat.triangle_count() * 3));
+
+    // A flat grid can be simplified without any error
+    flat.generate_lods(4, 0.5f);
+    ASSERT_TRUE(flat.lod_count() > 1);
+    for (size_t level = 1; level < flat.lod_count(); level++)
+    {
+        EXPECT_TRUE(flat.lods()[level].error < 1e-3f);
+    }
+
+    // A curved surface loses details at each level
+    auto bumpy = create_grid(64, [](float x, float y) { return 0.1f * std::sin(x * 12.0f) * std::cos(y * 9.0f); });
+    bumpy.generate_lods(4, 0.5f);
+    ASSERT_TRUE(bumpy.lod_count() == 4);
+
+    const auto &lods = bumpy.lods();
+    for (size_t level = 1; level < lods.size(); level++)
+    {
+        // Each level is smaller and less precise than the previous one
+        EXPECT_TRUE(lods[level].index_count < lods[level - 1].index_count);
+        EXPECT_TRUE(lods[level].index_count > 0);
+        EXPECT_TRUE(lods[level].error >= lods[level - 1].error);
+
+        // The levels follow each other after the base triangles
+        EXPECT_EQ(lods[level].first_index, lods[level - 1].first_index + lods[level - 1].index_count);
+    }
+    EXPECT_EQ(lods[lods.size() - 1].first_index + lods[lods.size() - 1].index_count,
+              static_cast<uint32_t>(bumpy.total_triangle_count() * 3));
+    EXPECT_TRUE(lods[1].error > 0.0f);
+
+    // The simplified levels reuse the vertices of the part
+    bool indices_valid = true;
+    for (const auto &triangle : bumpy.lod_triangles())
+    {
+        for (const auto index : triangle.index)
+        {
+            indices_valid &= index < bumpy.vertex_count();
+        }
+        indices_valid &= triangle.index[0] != triangle.index[1] && triangle.index[1] != triangle.index[2]
+                      && triangle.index[2] != triangle.index[0];
+    }
+    EXPECT_TRUE(indices_valid);
+
+    // Generating again replaces the previous levels
+    bumpy.generate_lods(2, 0.25f);
+    EXPECT_EQ(bumpy.lod_count(), static_cast<size_t>(2));
+    EXPECT_EQ(bumpy.lods()[1].index_count, static_cast<uint32_t>(bumpy.lod_triangles().size() * 3));
+}
@@ -0,0 +1,138 @@
+#include <railguard/core/mesh.h>
+
+#include <algorithm>
+#include <array>
+#include <random>
+#include <test_framework/test_framework.hpp>
+#include <vector>
+
+using TrianglePositions = std::array<float, 9>;
+
+/** Lists the positions of the corners of each triangle, in a canonical order, to compare the shape of two parts. */
+std::vector<TrianglePositions> get_triangle_positions(const rg::MeshPart &part)
+{
+    std::vector<TrianglePositions> result;
+    for (const auto &triangle : part.triangles())
+    {
+        // Start with the smallest index, to keep the winding while allowing rotations
+        std::array<glm::vec3, 3> corners;
+        for (size_t i = 0; i < 3; i++)
+        {
+            corners[i] = part.vertices()[triangle.index[i]].position;
+        }
+        auto less = [](const glm::vec3 &a, const glm::vec3 &b)
+        {
+            return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+        };
+        std::rotate(corners.begin(), std::min_element(corners.begin(), corners.end(), less), corners.end());
+
+        result.push_back({corners[0].x,
+                          corners[0].y,
+                          corners[0].z,
+                          corners[1].x,
+                          corners[1].y,
+                          corners[1].z,
+                          corners[2].x,
+                          corners[2].y,
+                          corners[2].z});
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+TEST
+{
+    // Grid of size x size quads, with three vertices per triangle like a non-indexed file, in a random order
+    constexpr uint32_t size = 48;
+
+    std::vector<rg::Triangle> grid_triangles;
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            const uint32_t i = y * (size + 1) + x;
+            grid_triangles.emplace_back(i, i + size + 1, i + 1);
+            grid_triangles.emplace_back(i + 1, i + size + 1, i + size + 2);
+        }
+    }
+    std::mt19937 generator(42);
+    std::shuffle(grid_triangles.begin(), grid_triangles.end(), generator);
+
+    rg::Vector<rg::Vertex>   vertices(grid_triangles.size() * 3);
+    rg::Vector<rg::Triangle> triangles(grid_triangles.size());
+    for (const auto &grid_triangle : grid_triangles)
+    {
+        const auto first = static_cast<uint32_t>(vertices.size());
+        for (const auto index : grid_triangle.index)
+        {
+            const float x = static_cast<float>(index % (size + 1)) / static_cast<float>(size);
+            const float y = static_cast<float>(index / (size + 1)) / static_cast<float>(size);
+            vertices.push_back(rg::Vertex {
+                .position  = glm::vec3(x, 0.0f, y),
+                .normal    = glm::vec3(0.0f, 1.0f, 0.0f),
+                .tex_coord = glm::vec2(x, y),
+            });
+        }
+        triangles.push_back(rg::Triangle(first, first + 1, first + 2));
+    }
+
+    rg::MeshPart part(std::move(vertices), std::move(triangles));
+    const auto   expected_shape = get_triangle_positions(part);
+
+    // Nothing is shared at first
+    EXPECT_TRUE(part.acmr() == 3.0f);
+
+    // Each grid point becomes a single vertex
+    const auto removed_count = part.deduplicate_vertices();
+    EXPECT_EQ(part.vertex_count(), static_cast<size_t>((size + 1) * (size + 1)));
+    EXPECT_EQ(removed_count, grid_triangles.size() * 3 - part.vertex_count());
+    EXPECT_TRUE(get_triangle_positions(part) == expected_shape);
+
+    // Merging again does nothing
+    EXPECT_EQ(part.deduplicate_vertices(), static_cast<size_t>(0));
+
+    // In a random order, the cache is not of much use
+    const auto shuffled_acmr = part.acmr();
+    EXPECT_TRUE(shuffled_acmr > 1.5f);
+
+    // After optimization, most vertices are reused. A grid cannot go below 0.5.
+    part.optimize_vertex_cache();
+    const auto optimized_acmr = part.acmr();
+    EXPECT_TRUE(optimized_acmr < 0.85f);
+    EXPECT_TRUE(optimized_acmr >= 0.5f);
+    EXPECT_TRUE(get_triangle_positions(part) == expected_shape);
+
+    // The vertices are then sorted by first use, which does not change the cache behavior
+    part.optimize_vertex_fetch();
+    EXPECT_EQ(part.vertex_count(), static_cast<size_t>((size + 1) * (size + 1)));
+    EXPECT_TRUE(part.acmr() == optimized_acmr);
+    EXPECT_TRUE(get_triangle_positions(part) == expected_shape);
+
+    uint32_t next_new_vertex = 0;
+    bool     sequential      = true;
+    for (const auto &triangle : part.triangles())
+    {
+        for (const auto index : triangle.index)
+        {
+            sequential &= index <= next_new_vertex;
+            if (index == next_new_vertex)
+            {
+                next_new_vertex++;
+            }
+        }
+    }
+    EXPECT_TRUE(sequential);
+
+    // The levels of detail are optimized as well
+    part.generate_lods(3, 0.5f);
+    ASSERT_TRUE(part.lod_count() > 1);
+    bool indices_valid = true;
+    for (const auto &triangle : part.lod_triangles())
+    {
+        for (const auto index : triangle.index)
+        {
+            indices_valid &= index < part.vertex_count();
+        }
+    }
+    EXPECT_TRUE(indices_valid);
+}
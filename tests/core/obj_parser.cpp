@@ -0,0 +1,109 @@
+#include <railguard/core/obj_parser.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <test_framework/test_framework.hpp>
+
+bool same_geometry(const rg::ObjGeometry &a, const rg::ObjGeometry &b)
+{
+    if (a.vertices.size() != b.vertices.size() || a.triangles.size() != b.triangles.size() || a.shapes.size() != b.shapes.size())
+    {
+        return false;
+    }
+    return std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(rg::Vertex)) == 0
+           && std::memcmp(a.triangles.data(), b.triangles.data(), a.triangles.size() * sizeof(rg::Triangle)) == 0
+           && std::memcmp(a.shapes.data(), b.shapes.data(), a.shapes.size() * sizeof(rg::ObjShape)) == 0;
+}
+
+TEST
+{
+    const auto path = (std::filesystem::temp_directory_path() / "railguard_obj_parser_test.obj").string();
+
+    // Small file with the different syntaxes
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "# Comment\r\n"
+                "mtllib test.mtl\n"
+                "o first\n"
+                "v 0 0 0\n"
+                "v 1 0 0\n"
+                "v 1 1 0\n"
+                "v 0 1 +0.5e1\n"
+                "vt 0 0\n"
+                "vt 1 0.25\n"
+                "vn 0 0 1\n"
+                "f 1/1/1 2/2/1 3/2/1 4/1/1\r\n"
+                "g second\n"
+                "usemtl material\n"
+                "f -4//-1 -3//-1 -2//-1\n"
+                "  f\t-3 -2 -1\n";
+    }
+
+    rg::ObjGeometry geometry;
+    std::string     error;
+    ASSERT_TRUE(rg::parse_obj(path.c_str(), rg::ObjImportMode::DUPLICATED_VERTICES, geometry, error));
+
+    // The quad is split in two triangles
+    ASSERT_EQ(geometry.triangles.size(), static_cast<size_t>(4));
+    ASSERT_EQ(geometry.vertices.size(), static_cast<size_t>(12));
+    EXPECT_TRUE(geometry.vertices[3].position == glm::vec3(0.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(geometry.vertices[5].position == glm::vec3(0.0f, 1.0f, 5.0f));
+    EXPECT_TRUE(geometry.vertices[1].normal == glm::vec3(0.0f, 0.0f, 1.0f));
+    // The texture coordinates are flipped vertically
+    EXPECT_TRUE(geometry.vertices[1].tex_coord == glm::vec2(1.0f, 0.75f));
+    // Missing attributes are zero
+    EXPECT_TRUE(geometry.vertices[6].tex_coord == glm::vec2(0.0f));
+    EXPECT_TRUE(geometry.vertices[9].normal == glm::vec3(0.0f));
+    EXPECT_TRUE(geometry.vertices[11].position == glm::vec3(0.0f, 1.0f, 5.0f));
+
+    ASSERT_EQ(geometry.shapes.size(), static_cast<size_t>(2));
+    EXPECT_EQ(geometry.shapes[0].first_triangle, 0u);
+    EXPECT_EQ(geometry.shapes[0].triangle_count, 2u);
+    EXPECT_EQ(geometry.shapes[1].first_triangle, 2u);
+    EXPECT_EQ(geometry.shapes[1].triangle_count, 2u);
+
+    // With shared positions, the indices of the file are kept
+    ASSERT_TRUE(rg::parse_obj(path.c_str(), rg::ObjImportMode::SHARED_POSITIONS, geometry, error));
+    ASSERT_EQ(geometry.vertices.size(), static_cast<size_t>(4));
+    EXPECT_EQ(geometry.triangles[1].index[0], 0u);
+    EXPECT_EQ(geometry.triangles[1].index[1], 2u);
+    EXPECT_EQ(geometry.triangles[1].index[2], 3u);
+
+    // Errors
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+    }
+    EXPECT_FALSE(rg::parse_obj(path.c_str(), rg::ObjImportMode::DUPLICATED_VERTICES, geometry, error));
+    EXPECT_FALSE(rg::parse_obj("this/file/does/not/exist.obj", rg::ObjImportMode::DUPLICATED_VERTICES, geometry, error));
+
+    // A big file is split in several chunks, which must give the same result as a single thread
+    {
+        std::ofstream file(path, std::ios::binary);
+        for (int i = 0; i < 40000; i++)
+        {
+            if (i % 1000 == 0)
+            {
+                file << "o shape" << i << '\n';
+            }
+            file << "v " << i << " " << i * 0.5f << " 1.0\nvt 0.5 " << i * 0.001f << '\n';
+            if (i >= 2)
+            {
+                // Mix relative and absolute indices, which may refer to the previous chunks
+                file << "f -3/-3 " << i << "/" << i << " -1/-1\n";
+            }
+        }
+    }
+
+    rg::ObjGeometry single_thread_geometry;
+    ASSERT_TRUE(rg::parse_obj(path.c_str(), rg::ObjImportMode::INDEXED, single_thread_geometry, error, 1));
+    ASSERT_TRUE(rg::parse_obj(path.c_str(), rg::ObjImportMode::INDEXED, geometry, error, 4));
+    EXPECT_EQ(geometry.triangles.size(), static_cast<size_t>(39998));
+    EXPECT_EQ(geometry.shapes.size(), static_cast<size_t>(40));
+    EXPECT_TRUE(same_geometry(geometry, single_thread_geometry));
+
+    std::remove(path.c_str());
+}
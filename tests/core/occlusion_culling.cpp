@@ -0,0 +1,95 @@
+#include <railguard/core/mesh.h>
+#include <railguard/core/engine.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <cmath>
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::Engine engine;
+
+    // Enable occlusion culling in the forward stage
+    auto render_pipeline                        = rg::basic_forward_render_pipeline();
+    render_pipeline.stages[0].occlusion_culling = true;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, std::move(render_pipeline)));
+
+    // Setup scene
+
+    auto &renderer = engine.renderer();
+
+    // Load shaders
+    auto vertex_shader   = renderer.load_shader_module("resources/shaders/hello/test.vert.spv", rg::ShaderStage::VERTEX);
+    auto fragment_shader = renderer.load_shader_module("resources/shaders/hello/test.frag.spv", rg::ShaderStage::FRAGMENT);
+    auto culling_shader  = renderer.load_shader_module("resources/shaders/culling/culling.comp.spv", rg::ShaderStage::COMPUTE);
+    auto occlusion_culling_shader =
+        renderer.load_shader_module("resources/shaders/culling/occlusion_culling.comp.spv", rg::ShaderStage::COMPUTE);
+    auto depth_reduce_shader = renderer.load_shader_module("resources/shaders/culling/depth_reduce.comp.spv", rg::ShaderStage::COMPUTE);
+
+    // Enable GPU and occlusion culling
+    // If the device doesn't support it, everything will be drawn, which is still a valid result
+    EXPECT_NO_THROWS(renderer.set_culling_shader(culling_shader));
+    EXPECT_NO_THROWS(renderer.set_occlusion_culling_shaders(occlusion_culling_shader, depth_reduce_shader));
+
+    // Create a shader effect
+    auto hello_effect = renderer.create_shader_effect({vertex_shader, fragment_shader}, rg::RenderStageKind::FORWARD, {});
+
+    // Create a material template
+    auto material_template = renderer.create_material_template({hello_effect});
+
+    // Create a material
+    auto material = renderer.create_material(material_template, {{}});
+
+    // Create mesh parts
+    auto monkey = rg::MeshPart::load_from_obj("resources/meshes/monkey.obj", engine.renderer());
+    ASSERT_TRUE(monkey != rg::NULL_ID);
+    auto cube = rg::MeshPart::load_from_obj("resources/meshes/cube.obj", engine.renderer());
+    ASSERT_TRUE(cube != rg::NULL_ID);
+
+    // Create models
+    auto monkey_model = renderer.create_model(monkey, material);
+    auto cube_model   = renderer.create_model(cube, material);
+
+    // A big wall in front of the camera
+    auto  wall           = renderer.create_render_node(cube_model);
+    auto &wall_transform = renderer.get_render_node_transform(wall);
+
+    wall_transform.position.z = -10.f;
+    wall_transform.scale      = glm::vec3(20.f, 20.f, 1.f);
+
+    // A lot of monkeys behind it, which are only visible when the wall doesn't hide them
+    constexpr int32_t grid_size = 40;
+    for (int32_t x = 0; x < grid_size; x++)
+    {
+        for (int32_t z = 0; z < grid_size; z++)
+        {
+            auto  node           = renderer.create_render_node(monkey_model);
+            auto &node_transform = renderer.get_render_node_transform(node);
+
+            node_transform.position.x = static_cast<float>(x - grid_size / 2) * 2.f;
+            node_transform.position.z = -15.f - static_cast<float>(z) * 2.f;
+            node_transform.scale      = glm::vec3(0.5f);
+        }
+    }
+
+    // Create a camera looking at the wall
+    auto  camera           = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 200.0f);
+    auto &camera_transform = renderer.get_camera_transform(camera);
+
+    // Slide sideways, so that monkeys appear from behind the wall and disappear again
+    double time = 0.0;
+    engine.on_update()->subscribe(
+        [&camera_transform, &time](double delta_time)
+        {
+            time += delta_time;
+            camera_transform.position.x = static_cast<float>(std::sin(time)) * 30.f;
+        });
+
+    // Run engine
+    EXPECT_NO_THROWS(engine.run_main_loop());
+}
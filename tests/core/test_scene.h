@@ -0,0 +1,75 @@
+#pragma once
+
+#include <railguard/core/engine.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/utils/array.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+#include <railguard/utils/vector.h>
+
+// Setup shared by the tests drawing a scene
+
+/**
+ * Loads the shaders at the given paths and creates a forward shader effect with them, then a material template using it.
+ * @param textures Layouts of the textures of the effect.
+ */
+inline rg::MaterialTemplateId create_test_material_template(rg::Renderer                       &renderer,
+                                                            const char                         *vertex_path,
+                                                            const char                         *fragment_path,
+                                                            const rg::Array<rg::TextureLayout> &textures = {})
+{
+    auto vertex_shader   = renderer.load_shader_module(vertex_path, rg::ShaderStage::VERTEX);
+    auto fragment_shader = renderer.load_shader_module(fragment_path, rg::ShaderStage::FRAGMENT);
+    auto effect          = renderer.create_shader_effect({vertex_shader, fragment_shader}, rg::RenderStageKind::FORWARD, textures);
+    return renderer.create_material_template({effect});
+}
+
+/** Creates a perspective camera in the first window, at the given position. */
+inline rg::CameraId create_test_camera(rg::Renderer &renderer, const glm::vec3 &position)
+{
+    auto  camera              = renderer.create_perspective_camera(0, glm::radians(70.f), 0.01f, 200.0f);
+    auto &camera_transform    = renderer.get_camera_transform(camera);
+    camera_transform.position = position;
+    return camera;
+}
+
+/**
+ * Creates a grid of render nodes on the XZ plane, 3 units apart, alternating the given models.
+ * The grid is centered on the origin along X, and along Z as well if centered is true. Otherwise, it starts at Z = 0.
+ */
+inline rg::Vector<rg::RenderNodeId>
+    create_test_grid(rg::Renderer &renderer, const rg::Array<rg::ModelId> &models, int32_t grid_size, bool centered)
+{
+    rg::Vector<rg::RenderNodeId> nodes(grid_size * grid_size);
+    for (int32_t x = 0; x < grid_size; x++)
+    {
+        for (int32_t z = 0; z < grid_size; z++)
+        {
+            auto  node           = renderer.create_render_node(models[(x + z) % models.size()]);
+            auto &node_transform = renderer.get_render_node_transform(node);
+
+            node_transform.position.x = static_cast<float>(x - grid_size / 2) * 3.f;
+            node_transform.position.z = static_cast<float>(centered ? z - grid_size / 2 : z) * 3.f;
+
+            nodes.push_back(node);
+        }
+    }
+    return nodes;
+}
+
+/** Rotates each node a bit at each update. */
+inline void rotate_test_nodes(rg::Engine &engine, const rg::Vector<rg::RenderNodeId> &nodes)
+{
+    auto &renderer = engine.renderer();
+    engine.on_update()->subscribe(
+        [&renderer, &nodes](double delta_time)
+        {
+            for (const auto &node : nodes)
+            {
+                auto &node_transform    = renderer.get_render_node_transform(node);
+                node_transform.rotation = rotate(node_transform.rotation,
+                                                 glm::radians(0.1f),
+                                                 glm::vec3(0.0f, 0.1f, 0.0f) * static_cast<float>(delta_time));
+            }
+        });
+}
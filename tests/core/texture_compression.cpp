@@ -0,0 +1,152 @@
+#include <railguard/core/texture.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <test_framework/test_framework.hpp>
+#include <vector>
+
+// Peak signal-to-noise ratio of the first channels of decoded texels, compared to the RGBA source
+double compute_psnr(const uint8_t *source, const uint8_t *decoded, size_t texel_count, size_t texel_size, size_t channel_count)
+{
+    double squared_error = 0.0;
+    for (size_t i = 0; i < texel_count; i++)
+    {
+        for (size_t c = 0; c < channel_count; c++)
+        {
+            const double delta = static_cast<double>(source[i * 4 + c]) - static_cast<double>(decoded[i * texel_size + c]);
+            squared_error += delta * delta;
+        }
+    }
+    const double mse = squared_error / static_cast<double>(texel_count * channel_count);
+    return mse == 0.0 ? 100.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+TEST
+{
+    // Smooth image with a bit of noise, whose size isn't a multiple of the blocks
+    constexpr uint32_t width  = 61;
+    constexpr uint32_t height = 37;
+
+    std::mt19937                       generator(42);
+    std::uniform_int_distribution<int> noise_distribution(-4, 4);
+    std::vector<uint8_t>               pixels(width * height * 4);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const float fx       = static_cast<float>(x) / width;
+            const float fy       = static_cast<float>(y) / height;
+            const float value[4] = {
+                200.0f * fx + 20.0f,
+                180.0f * fy + 30.0f,
+                128.0f + 100.0f * std::sin(fx * 6.0f + fy * 3.0f),
+                255.0f * fx * fy,
+            };
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                const int noisy                 = static_cast<int>(value[c]) + noise_distribution(generator);
+                pixels[(y * width + x) * 4 + c] = static_cast<uint8_t>(std::clamp(noisy, 0, 255));
+            }
+        }
+    }
+
+    // Sizes of the formats
+    EXPECT_EQ(rg::get_texture_level_size(rg::TextureFormat::RGBA8_SRGB, width, height), static_cast<size_t>(width * height * 4));
+    EXPECT_EQ(rg::get_texture_level_size(rg::TextureFormat::BC1_SRGB, width, height), static_cast<size_t>(16 * 10 * 8));
+    EXPECT_EQ(rg::get_texture_level_size(rg::TextureFormat::BC7_UNORM, width, height), static_cast<size_t>(16 * 10 * 16));
+    EXPECT_EQ(rg::get_full_mip_count(width, height), 6u);
+    EXPECT_EQ(rg::get_full_mip_count(1, 1), 1u);
+
+    // BC1 has a 1-bit alpha, so only its color is compared
+    struct FormatCase
+    {
+        rg::TextureFormat format;
+        size_t            channel_count;
+        double            min_psnr;
+    };
+    const FormatCase format_cases[] = {
+        {rg::TextureFormat::RGBA8_SRGB, 4, 100.0},
+        {rg::TextureFormat::R8_UNORM, 1, 100.0},
+        {rg::TextureFormat::RG8_UNORM, 2, 100.0},
+        {rg::TextureFormat::BC1_SRGB, 3, 33.0},
+        {rg::TextureFormat::BC3_UNORM, 4, 33.0},
+        {rg::TextureFormat::BC4_UNORM, 1, 45.0},
+        {rg::TextureFormat::BC5_UNORM, 2, 45.0},
+    };
+
+    for (const auto &format_case : format_cases)
+    {
+        rg::TextureData texture(pixels.data(), width, height, format_case.format, 0);
+        ASSERT_TRUE(texture.is_valid());
+        EXPECT_TRUE(texture.format() == format_case.format);
+        EXPECT_EQ(texture.width(), width);
+        EXPECT_EQ(texture.height(), height);
+
+        // Full chain, down to a single texel
+        const auto &levels = texture.levels();
+        ASSERT_EQ(levels.size(), static_cast<size_t>(6));
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            EXPECT_EQ(levels[level].width, std::max(width >> level, 1u));
+            EXPECT_EQ(levels[level].height, std::max(height >> level, 1u));
+            EXPECT_EQ(levels[level].size, rg::get_texture_level_size(format_case.format, levels[level].width, levels[level].height));
+            EXPECT_EQ(levels[level].offset % rg::get_texel_block_size(format_case.format) % 4, static_cast<size_t>(0));
+        }
+        EXPECT_EQ(levels.last().width, 1u);
+        EXPECT_EQ(levels.last().height, 1u);
+
+        // Decoded, it stays close to the source
+        const auto           texel_size = rg::get_texel_block_size(rg::get_decoded_format(format_case.format));
+        std::vector<uint8_t> decoded(width * height * texel_size);
+        ASSERT_TRUE(texture.decode_level(0, decoded.data()));
+        const auto psnr = compute_psnr(pixels.data(), decoded.data(), width * height, texel_size, format_case.channel_count);
+        EXPECT_TRUE(psnr >= format_case.min_psnr);
+
+        // The KTX2 file contains the same texels
+        const char *path = "texture_compression_test.ktx2";
+        ASSERT_TRUE(texture.save_ktx2(path, 1234));
+        auto loaded = rg::TextureData::load_ktx2(path, 1234);
+        ASSERT_TRUE(loaded.is_valid());
+        EXPECT_TRUE(loaded.format() == format_case.format);
+        ASSERT_EQ(loaded.levels().size(), levels.size());
+        for (size_t level = 0; level < levels.size(); level++)
+        {
+            EXPECT_EQ(loaded.levels()[level].size, levels[level].size);
+            EXPECT_TRUE(std::memcmp(loaded.level_data(level), texture.level_data(level), levels[level].size) == 0);
+        }
+
+        // Without a stamp, any file is accepted, but another stamp means that the file is outdated
+        EXPECT_TRUE(rg::TextureData::load_ktx2(path).is_valid());
+        EXPECT_FALSE(rg::TextureData::load_ktx2(path, 5678).is_valid());
+        std::remove(path);
+    }
+
+    // Limited mip chain
+    rg::TextureData two_levels(pixels.data(), width, height, rg::TextureFormat::BC1_UNORM, 2);
+    EXPECT_EQ(two_levels.levels().size(), static_cast<size_t>(2));
+
+    // A uniform image keeps its color in every level, and in every block
+    std::vector<uint8_t> uniform_pixels(width * height * 4);
+    for (size_t i = 0; i < uniform_pixels.size(); i += 4)
+    {
+        uniform_pixels[i]     = 255;
+        uniform_pixels[i + 1] = 0;
+        uniform_pixels[i + 2] = 255;
+        uniform_pixels[i + 3] = 255;
+    }
+    rg::TextureData uniform(uniform_pixels.data(), width, height, rg::TextureFormat::BC1_SRGB, 0);
+    for (size_t level = 0; level < uniform.levels().size(); level++)
+    {
+        const auto          &info = uniform.levels()[level];
+        std::vector<uint8_t> decoded(info.width * info.height * 4);
+        ASSERT_TRUE(uniform.decode_level(level, decoded.data()));
+        EXPECT_TRUE(std::memcmp(decoded.data(), uniform_pixels.data(), decoded.size()) == 0);
+    }
+
+    // BC7 can only be loaded
+    EXPECT_FALSE(rg::TextureData(pixels.data(), width, height, rg::TextureFormat::BC7_SRGB, 1).is_valid());
+    EXPECT_FALSE(rg::TextureData::load_ktx2("missing.ktx2").is_valid());
+}
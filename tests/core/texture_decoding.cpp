@@ -0,0 +1,93 @@
+#include "test_scene.h"
+
+#include <railguard/core/engine.h>
+#include <railguard/core/mesh.h>
+#include <railguard/core/renderer/render_pipeline.h>
+#include <railguard/core/renderer/renderer.h>
+#include <railguard/core/texture.h>
+#include <railguard/core/window.h>
+#include <railguard/utils/event_sender.h>
+#include <railguard/utils/geometry/transform.h>
+
+#include <cstdio>
+#include <fstream>
+#include <test_framework/test_framework.hpp>
+#include <vector>
+
+TEST
+{
+    // Gradient image
+    constexpr uint32_t   size = 64;
+    std::vector<uint8_t> pixels(size * size * 4);
+    for (uint32_t y = 0; y < size; y++)
+    {
+        for (uint32_t x = 0; x < size; x++)
+        {
+            pixels[(y * size + x) * 4]     = static_cast<uint8_t>(x * 4);
+            pixels[(y * size + x) * 4 + 1] = static_cast<uint8_t>(y * 4);
+            pixels[(y * size + x) * 4 + 2] = 128;
+            pixels[(y * size + x) * 4 + 3] = 255;
+        }
+    }
+
+    const char *bc1_path = "texture_decoding_test_bc1.ktx2";
+    const char *bc7_path = "texture_decoding_test_bc7.ktx2";
+    ASSERT_TRUE(rg::TextureData(pixels.data(), size, size, rg::TextureFormat::BC1_SRGB, 0).save_ktx2(bc1_path));
+
+    // BC7 can't be encoded, but its blocks have the size of the BC5 ones: the file of a BC5 texture is saved with the BC7 format
+    ASSERT_TRUE(rg::TextureData(pixels.data(), size, size, rg::TextureFormat::BC5_UNORM, 0).save_ktx2(bc7_path));
+    {
+        // The format is the VkFormat value after the 12 bytes of the identifier
+        constexpr uint32_t bc7_unorm_vk_format = 145;
+        std::fstream       file(bc7_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(12);
+        file.write(reinterpret_cast<const char *>(&bc7_unorm_vk_format), sizeof(bc7_unorm_vk_format));
+    }
+    auto bc7_data = rg::TextureData::load_ktx2(bc7_path);
+    ASSERT_TRUE(bc7_data.is_valid());
+    EXPECT_TRUE(bc7_data.format() == rg::TextureFormat::BC7_UNORM);
+    std::vector<uint8_t> decoded(size * size * 4);
+    EXPECT_FALSE(bc7_data.decode_level(0, decoded.data()));
+
+    rg::Engine engine;
+
+    ASSERT_NO_THROWS(engine = rg::Engine("My wonderful game", 500, 500, rg::basic_forward_render_pipeline()));
+
+    auto &renderer = engine.renderer();
+
+    // Same as a device that doesn't support the block-compressed formats
+    EXPECT_FALSE(renderer.set_block_compression(false));
+
+    // The BC1 texture is decoded before its upload
+    auto texture = renderer.load_texture(bc1_path, rg::TextureOptions {});
+    ASSERT_TRUE(texture != rg::NULL_ID);
+    EXPECT_TRUE(renderer.get_texture_format(texture) == rg::TextureFormat::RGBA8_SRGB);
+
+    // The BC7 one can't be decoded, so it isn't loaded
+    EXPECT_TRUE(renderer.load_texture(bc7_path, rg::TextureOptions {}) == rg::NULL_ID);
+
+    // Draw the decoded texture
+    auto material_template = create_test_material_template(renderer,
+                                                           "resources/shaders/textured/textured.vert.spv",
+                                                           "resources/shaders/textured/textured.frag.spv",
+                                                           {{rg::ShaderStage::FRAGMENT}});
+    auto material          = renderer.create_material(material_template, {{texture}});
+
+    auto cube = rg::MeshPart::load_from_obj("resources/meshes/cube.obj", engine.renderer());
+    ASSERT_TRUE(cube != rg::NULL_ID);
+    auto node = renderer.create_render_node(renderer.create_model(cube, material));
+    ASSERT_TRUE(node != rg::NULL_ID);
+
+    create_test_camera(renderer, glm::vec3(0.0f, 0.0f, -5.0f));
+
+    // Run engine
+    EXPECT_NO_THROWS(engine.run_main_loop());
+
+    // The decoded texels were uploaded
+    const auto statistics = renderer.get_upload_statistics();
+    EXPECT_EQ(statistics.pending_upload_count, static_cast<size_t>(0));
+    EXPECT_EQ(statistics.failed_texture_count, static_cast<size_t>(0));
+
+    std::remove(bc1_path);
+    std::remove(bc7_path);
+}
@@ -4,6 +4,11 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 tex_coords;
+// Per-instance input: index of the object in the object buffer
+layout (location = 3) in uint object_index;
+
+// Vertex format, given by the renderer: 0 for full vertices, 1 for compressed ones
+layout (constant_id = 0) const uint VERTEX_FORMAT = 0;
 
 // Camera data
 layout(set = 0, binding = 0) uniform CameraData {
@@ -25,13 +30,27 @@ layout (location = 0) out vec2 out_tex_coords;
 layout (location = 1) out vec3 out_position;
 layout (location = 2) out vec3 out_normal;
 
+// Compressed normals are encoded on an octahedron
+vec3 decode_normal(vec3 encoded) {
+    if (VERTEX_FORMAT == 0) {
+        return encoded;
+    }
+    vec3 normal = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // Fold the lower half back
+    float t = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(t), vec2(-t), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
+
 void main() {
     //output the position of each vertex
-    ObjectData current_object = objectBuffer.objects[0];
-    gl_Position = camera.view_projection * current_object.transform * vec4(position, 1.0f);
+    ObjectData current_object = objectBuffer.objects[object_index];
+    // The transform also restores the compressed positions, so the position is transmitted in world space
+    vec4 world_position = current_object.transform * vec4(position, 1.0f);
+    gl_Position = camera.view_projection * world_position;
 
     // Transmit info to fragment shader
     out_tex_coords = tex_coords;
-    out_position = position;
-    out_normal = normal;
+    out_position = world_position.xyz;
+    out_normal = decode_normal(normal);
 }
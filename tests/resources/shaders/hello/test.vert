@@ -4,6 +4,11 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 tex_coords;
+// Per-instance input: index of the object in the object buffer
+layout (location = 3) in uint object_index;
+
+// Vertex format, given by the renderer: 0 for full vertices, 1 for compressed ones
+layout (constant_id = 0) const uint VERTEX_FORMAT = 0;
 
 // Camera data
 layout(set = 0, binding = 0) uniform CameraData {
@@ -22,9 +27,21 @@ layout(set = 1, binding = 0) readonly buffer ObjectBuffer {
 
 layout (location = 0) out vec3 outColor;
 
+// Compressed normals are encoded on an octahedron
+vec3 decode_normal(vec3 encoded) {
+    if (VERTEX_FORMAT == 0) {
+        return encoded;
+    }
+    vec3 normal = vec3(encoded.xy, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // Fold the lower half back
+    float t = max(-normal.z, 0.0);
+    normal.xy += mix(vec2(t), vec2(-t), greaterThanEqual(normal.xy, vec2(0.0)));
+    return normalize(normal);
+}
+
 void main() {
     //output the position of each vertex
-    ObjectData current_object = objectBuffer.objects[0];
+    ObjectData current_object = objectBuffer.objects[object_index];
     gl_Position = camera.view_projection * current_object.transform * vec4(position, 1.0f);
-    outColor = normal;
+    outColor = decode_normal(normal);
 }
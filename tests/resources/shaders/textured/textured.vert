@@ -3,6 +3,8 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 tex_coords;
+// Per-instance input: index of the object in the object buffer
+layout (location = 3) in uint object_index;
 
 // Camera data
 layout(set = 0, binding = 0) uniform CameraData {
@@ -24,7 +26,7 @@ layout (location = 0) out vec2 out_tex_coords;
 
 void main() {
     //output the position of each vertex
-    ObjectData current_object = objectBuffer.objects[0];
+    ObjectData current_object = objectBuffer.objects[object_index];
     gl_Position = camera.view_projection * current_object.transform * vec4(position, 1.0f);
     out_tex_coords = tex_coords;
 }
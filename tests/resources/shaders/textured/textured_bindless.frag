@@ -0,0 +1,22 @@
+//glsl version 4.5
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+//output write
+layout (location = 0) out vec4 out_frag_color;
+layout (location = 0) in vec2 in_tex_coord;
+layout (location = 1) flat in uint in_material_index;
+
+// Slots of the textures of each material, in the array of all the textures
+layout(set = 2, binding = 0) readonly buffer MaterialBuffer {
+    uint texture_slots[];
+} materialBuffer;
+layout(set = 2, binding = 1) uniform sampler2D textures[];
+
+void main()
+{
+    // The material can differ between the invocations of a draw
+    uint slot = materialBuffer.texture_slots[in_material_index];
+    vec3 color = texture(textures[nonuniformEXT(slot)], in_tex_coord).xyz;
+    out_frag_color = vec4(color, 1.0f);
+}
@@ -0,0 +1,35 @@
+#version 450
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 tex_coords;
+// Per-instance inputs: index of the object in the object buffer, and of the texture slots of its material in the material buffer
+layout (location = 3) in uint object_index;
+layout (location = 4) in uint material_index;
+
+// Camera data
+layout(set = 0, binding = 0) uniform CameraData {
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+} camera;
+
+// Global data
+struct ObjectData {
+    mat4 transform;
+};
+layout(set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+// Output
+layout (location = 0) out vec2 out_tex_coords;
+layout (location = 1) flat out uint out_material_index;
+
+void main() {
+    //output the position of each vertex
+    ObjectData current_object = objectBuffer.objects[object_index];
+    gl_Position = camera.view_projection * current_object.transform * vec4(position, 1.0f);
+    out_tex_coords = tex_coords;
+    out_material_index = material_index;
+}
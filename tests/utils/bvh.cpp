@@ -0,0 +1,104 @@
+#include <railguard/utils/array.h>
+#include <railguard/utils/geometry/bvh.h>
+#include <railguard/utils/geometry/frustum.h>
+#include <railguard/utils/geometry/ray.h>
+#include <railguard/utils/vector.h>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::BVH  bvh;
+    uint32_t hit_item     = 0;
+    float    hit_distance = 0.0f;
+
+    const glm::vec3 x_axis(1.f, 0.f, 0.f);
+    const auto      raycast = [&](const glm::vec3 &origin, const glm::vec3 &direction, float max_distance)
+    {
+        return bvh.raycast({.origin = origin, .direction = direction}, max_distance, hit_item, hit_distance);
+    };
+
+    // An empty tree doesn't find anything
+    bvh.build(nullptr, 0);
+    EXPECT_TRUE(bvh.is_empty());
+    EXPECT_FALSE(raycast(glm::vec3(0.f), x_axis, 100.f));
+
+    // A row of unit boxes along X, 3 units apart, with an empty one in the middle
+    constexpr size_t    count      = 16;
+    constexpr uint32_t  empty_item = 5;
+    rg::Array<rg::AABB> boxes(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (i != empty_item)
+        {
+            const float x = 3.f * static_cast<float>(i);
+            boxes[i]      = {.min = glm::vec3(x, 0.f, 0.f), .max = glm::vec3(x + 1.f, 1.f, 1.f)};
+        }
+    }
+
+    bvh.build(boxes.data(), count);
+    EXPECT_FALSE(bvh.is_empty());
+    EXPECT_EQ(bvh.item_count(), count);
+    EXPECT_TRUE(bvh.cost() > 0.0f);
+    const float built_cost = bvh.cost();
+
+    // Raycasts return the closest box
+    ASSERT_TRUE(raycast(glm::vec3(-5.f, 0.5f, 0.5f), x_axis, 100.f));
+    EXPECT_EQ(hit_item, 0u);
+    EXPECT_EQ(hit_distance, 5.0f);
+    ASSERT_TRUE(raycast(glm::vec3(7.5f, 0.5f, 0.5f), x_axis, 100.f));
+    EXPECT_EQ(hit_item, 3u);
+    EXPECT_EQ(hit_distance, 1.5f);
+    ASSERT_TRUE(raycast(glm::vec3(0.5f, -2.f, 0.5f), glm::vec3(0.f, 1.f, 0.f), 100.f));
+    EXPECT_EQ(hit_item, 0u);
+    EXPECT_EQ(hit_distance, 2.0f);
+
+    // The empty box is never hit
+    ASSERT_TRUE(raycast(glm::vec3(14.f, 0.5f, 0.5f), x_axis, 100.f));
+    EXPECT_EQ(hit_item, 6u);
+    EXPECT_EQ(hit_distance, 4.0f);
+
+    // Too far, or next to the boxes
+    EXPECT_FALSE(raycast(glm::vec3(7.5f, 0.5f, 0.5f), x_axis, 1.f));
+    EXPECT_FALSE(raycast(glm::vec3(-5.f, 5.f, 0.5f), x_axis, 100.f));
+
+    // The camera looks towards -Z, the frustum is the box [0, 10] x [-5, 5] x [-5, 5]: only the first 4 boxes are visible
+    const auto frustum = rg::Frustum::from_view_projection(glm::ortho(0.f, 10.f, -5.f, 5.f, -5.f, 5.f));
+    uint8_t    visibility[count];
+    bvh.cull(frustum, visibility);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        EXPECT_EQ(visibility[i], static_cast<uint8_t>(i <= 3 ? 1 : 0));
+    }
+
+    // Move every box up: the structure is kept, but the queries use the new boxes
+    for (auto &box : boxes)
+    {
+        if (!box.is_empty())
+        {
+            box.min.y += 100.f;
+            box.max.y += 100.f;
+        }
+    }
+    bvh.refit(boxes.data());
+    EXPECT_EQ(bvh.item_count(), count);
+    // The boxes were only translated, so the relative cost doesn't change
+    EXPECT_EQ(bvh.cost(), built_cost);
+
+    bvh.cull(frustum, visibility);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        EXPECT_EQ(visibility[i], static_cast<uint8_t>(0));
+    }
+
+    EXPECT_FALSE(raycast(glm::vec3(-5.f, 0.5f, 0.5f), x_axis, 100.f));
+    ASSERT_TRUE(raycast(glm::vec3(-5.f, 100.5f, 0.5f), x_axis, 100.f));
+    EXPECT_EQ(hit_item, 0u);
+
+    // Box query overlapping the third and fourth boxes
+    rg::Vector<uint32_t> results(4);
+    bvh.query_box({.min = glm::vec3(5.f, 100.f, 0.f), .max = glm::vec3(11.f, 101.f, 1.f)}, results);
+    ASSERT_EQ(results.size(), static_cast<size_t>(2));
+    EXPECT_TRUE((results[0] == 2 && results[1] == 3) || (results[0] == 3 && results[1] == 2));
+}
@@ -0,0 +1,50 @@
+#include <railguard/utils/geometry/frustum.h>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    // The camera is at the origin and looks towards -Z: the frustum is the box [-10, 10] x [-10, 10] x [-100, -1]
+    const auto frustum = rg::Frustum::from_view_projection(glm::ortho(-10.f, 10.f, -10.f, 10.f, 1.f, 100.f));
+
+    // The count isn't a multiple of the SIMD width, so that the remaining spheres are tested as well
+    constexpr size_t count           = 11;
+    const float      x[count]        = {0.f, 20.f, -10.5f, 0.f, 0.f, 0.f, 0.f, 9.f, 0.f, -30.f, 0.f};
+    const float      y[count]        = {0.f, 0.f, 0.f, 0.f, 0.f, -12.f, 10.9f, 9.f, 0.f, -30.f, 0.f};
+    const float      z[count]        = {-50.f, -50.f, -50.f, 5.f, -102.f, -50.f, -50.f, -99.5f, -0.5f, -50.f, -50.f};
+    const float      radius[count]   = {1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 1.f, 5.f, 100.f};
+    const uint8_t    expected[count] = {
+        1, // Inside
+        0, // Right of the frustum
+        1, // Crosses the left plane
+        0, // Behind the camera
+        0, // Beyond the far plane
+        0, // Below the frustum
+        1, // Crosses the top plane
+        1, // In a corner, near the far plane
+        1, // Crosses the near plane
+        0, // Outside of two planes
+        1, // Contains the whole frustum
+    };
+
+    uint8_t visibility[count] = {};
+
+    frustum.cull_spheres(x, y, z, radius, count, visibility);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        EXPECT_EQ(visibility[i], expected[i]);
+        // The batched test must agree with the one of a single sphere
+        EXPECT_EQ(visibility[i] == 1, frustum.intersects_sphere(glm::vec3(x[i], y[i], z[i]), radius[i]));
+    }
+
+    // Boxes
+    EXPECT_TRUE(frustum.classify_box({.min = glm::vec3(-1.f, -1.f, -51.f), .max = glm::vec3(1.f, 1.f, -49.f)})
+                == rg::FrustumIntersection::INSIDE);
+    EXPECT_TRUE(frustum.classify_box({.min = glm::vec3(9.f, -1.f, -51.f), .max = glm::vec3(11.f, 1.f, -49.f)})
+                == rg::FrustumIntersection::INTERSECTING);
+    EXPECT_TRUE(frustum.classify_box({.min = glm::vec3(-1.f, -1.f, 2.f), .max = glm::vec3(1.f, 1.f, 4.f)})
+                == rg::FrustumIntersection::OUTSIDE);
+    EXPECT_FALSE(frustum.intersects_box({.min = glm::vec3(11.f, -1.f, -51.f), .max = glm::vec3(13.f, 1.f, -49.f)}));
+}
@@ -0,0 +1,66 @@
+#include <railguard/utils/range_allocator.h>
+
+#include <test_framework/test_framework.hpp>
+
+TEST
+{
+    rg::RangeAllocator allocator(1024);
+
+    EXPECT_EQ(allocator.capacity(), static_cast<size_t>(1024));
+    EXPECT_EQ(allocator.used_size(), static_cast<size_t>(0));
+    EXPECT_EQ(allocator.free_range_count(), static_cast<size_t>(1));
+
+    // Ranges are placed one after the other, aligned
+    auto a = allocator.allocate(100, 32);
+    ASSERT_TRUE(a.has_value());
+    EXPECT_EQ(a->offset, static_cast<size_t>(0));
+    EXPECT_EQ(a->size, static_cast<size_t>(100));
+
+    auto b = allocator.allocate(200, 32);
+    ASSERT_TRUE(b.has_value());
+    EXPECT_EQ(b->offset, static_cast<size_t>(128));
+
+    auto c = allocator.allocate(50, 4);
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(c->offset, static_cast<size_t>(328));
+    EXPECT_EQ(allocator.used_size(), static_cast<size_t>(350));
+
+    // Too big
+    EXPECT_FALSE(allocator.allocate(1000, 4).has_value());
+
+    // The freed range is reused by a smaller allocation, even if there is more space at the end
+    allocator.free(*b);
+    auto d = allocator.allocate(150, 32);
+    ASSERT_TRUE(d.has_value());
+    EXPECT_EQ(d->offset, static_cast<size_t>(128));
+
+    // Best fit: the smallest free range that fits is taken
+    auto e = allocator.allocate(40, 8);
+    ASSERT_TRUE(e.has_value());
+    EXPECT_EQ(e->offset, static_cast<size_t>(280));
+
+    // Growing adds space at the end, without moving the existing ranges
+    EXPECT_FALSE(allocator.allocate(900, 4).has_value());
+    allocator.grow(2048);
+    EXPECT_EQ(allocator.capacity(), static_cast<size_t>(2048));
+    auto f = allocator.allocate(900, 4);
+    ASSERT_TRUE(f.has_value());
+    EXPECT_EQ(f->offset, static_cast<size_t>(380));
+
+    // When everything is freed, the free ranges are merged back into a single one
+    allocator.free(*a);
+    allocator.free(*f);
+    allocator.free(*c);
+    allocator.free(*e);
+    allocator.free(*d);
+    EXPECT_EQ(allocator.used_size(), static_cast<size_t>(0));
+    EXPECT_EQ(allocator.free_range_count(), static_cast<size_t>(1));
+    auto g = allocator.allocate(2048, 1);
+    ASSERT_TRUE(g.has_value());
+    EXPECT_EQ(g->offset, static_cast<size_t>(0));
+
+    // Clear frees everything at once
+    allocator.clear();
+    EXPECT_EQ(allocator.used_size(), static_cast<size_t>(0));
+    EXPECT_EQ(allocator.free_range_count(), static_cast<size_t>(1));
+}
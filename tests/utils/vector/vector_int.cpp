@@ -23,6 +23,17 @@ TEST {
 
     v.pop_back();
 
+    // Push several elements at once, then fill them in place
+    int *slots = v.push_uninitialized(4);
+    for (int i = 0; i < 4; i++)
+    {
+        slots[i] = 10 + i;
+    }
+    EXPECT_EQ(v.size(), static_cast<size_t>(6));
+    EXPECT_EQ(v[1], 2);
+    EXPECT_EQ(v[2], 10);
+    EXPECT_EQ(v[5], 13);
+
     // Try to create one in the heap
     auto *v2 = new rg::Vector<int>(3);
     v2->push_back(1);